@@ -0,0 +1,65 @@
+#version 460 core
+
+#include "frame.glsl"
+#include "atmosphere.glsl"
+
+layout (location = 0) out vec4 scatteringOut;    // rgb in-scattered light, a = distance through the atmosphere
+layout (location = 1) out vec4 transmittanceOut; // rgb
+
+uniform sampler2D DepthTex;             // full resolution
+uniform sampler2D HistoryScattering;    // last frame's output of this pass
+uniform sampler2D HistoryTransmittance;
+
+uniform int resolutionDivisor;
+uniform bool historyValid;
+uniform float historyWeight;
+uniform vec3 atmosphereMotion;          // last frame's atmosphere position minus this frame's
+uniform int frameIndex;
+
+// Jimenez's interleaved gradient noise - neighbouring texels get well spread offsets
+float interleavedGradientNoise(vec2 position) {
+    return fract(52.9829189 * fract(dot(position, vec2(0.06711056, 0.00583715))));
+}
+
+/*  One texel per resolutionDivisor² pixels, shaded at a fixed full
+ *  resolution pixel inside its block; the upsample pass looks up the same
+ *  pixel's depth to decide which texels belong to which surface.
+ */
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 fullSize = textureSize(DepthTex, 0);
+    ivec2 pixel = min(texel * resolutionDivisor + resolutionDivisor / 2, fullSize - 1);
+
+    vec2 ndc = (vec2(pixel) + 0.5) / vec2(fullSize) * 2.0 - 1.0;
+    vec3 rayDir = viewRay(ndc);
+    float dstToScene = sceneDistance(texelFetch(DepthTex, pixel, 0).r, rayDir);
+
+    // A new step offset each frame; the golden ratio keeps successive frames far apart
+    float offset = fract(interleavedGradientNoise(vec2(texel)) + 0.618034 * float(frameIndex));
+    AtmosphereSample s = marchAtmosphere(rayDir, dstToScene, historyValid && historyWeight > 0.0 ? offset : 0.5);
+
+    vec3 scattering = s.inScattered;
+    vec3 transmittance = s.transmittance;
+
+    if (historyValid && historyWeight > 0.0 && s.pathLength > 0.0) {
+        // Reproject where the ray leaves the atmosphere (or meets the scene), relative to the planet
+        vec3 rayEnd = cameraPos.xyz + rayDir * (s.start + s.pathLength);
+        vec4 previousClip = prevWorldToClip * vec4(rayEnd + atmosphereMotion, 1.0);
+        vec2 previousUv = previousClip.xy / previousClip.w * 0.5 + 0.5;
+
+        if (previousClip.w > 0.0 && all(greaterThanEqual(previousUv, vec2(0.0))) &&
+            all(lessThanEqual(previousUv, vec2(1.0)))) {
+            vec4 history = texture(HistoryScattering, previousUv);
+
+            // A different distance through the atmosphere means the history saw another surface (a limb
+            // moving over the sky, say), so it is dropped rather than smeared across the edge
+            if (abs(history.a - s.pathLength) <= 0.05 * max(history.a, s.pathLength)) {
+                scattering = mix(scattering, history.rgb, historyWeight);
+                transmittance = mix(transmittance, texture(HistoryTransmittance, previousUv).rgb, historyWeight);
+            }
+        }
+    }
+
+    scatteringOut = vec4(scattering, s.pathLength);
+    transmittanceOut = vec4(transmittance, 1.0);
+}
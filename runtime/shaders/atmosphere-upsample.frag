@@ -0,0 +1,53 @@
+#version 460 core
+
+out vec3 fragColour;
+
+uniform sampler2D MainTex;
+uniform sampler2D DepthTex;
+uniform sampler2D ScatteringTex;    // reduced resolution, see atmosphere-reduced.frag
+uniform sampler2D TransmittanceTex;
+
+uniform int resolutionDivisor;
+
+// Reversed-Z depth is near / distance, so its relative difference is the same as the distances'
+float depthWeight(float depth, float sampleDepth) {
+    float difference = abs(depth - sampleDepth) / max(max(depth, sampleDepth), 1e-30);
+    return 1.0 / (difference + 1e-4);
+}
+
+/*  Joint bilateral upsample: the four nearest reduced texels, weighted
+ *  bilinearly and by how close the depth they were shaded at is to this
+ *  pixel's. Across a planet's limb the texels on the other side of the
+ *  edge get almost no weight, so neither side bleeds into the other.
+ */
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 fullSize = textureSize(DepthTex, 0);
+    ivec2 reducedSize = textureSize(ScatteringTex, 0);
+    float depth = texelFetch(DepthTex, pixel, 0).r;
+
+    // Reduced texel i was shaded at pixel i * divisor + divisor / 2
+    vec2 position = (vec2(pixel) - float(resolutionDivisor / 2)) / float(resolutionDivisor);
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+
+    vec3 scattering = vec3(0.0);
+    vec3 transmittance = vec3(0.0);
+    float totalWeight = 0.0;
+
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), reducedSize - 1);
+        ivec2 shadedPixel = min(texel * resolutionDivisor + resolutionDivisor / 2, fullSize - 1);
+
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float weight = max(bilinear.x * bilinear.y, 1e-3) * depthWeight(depth, texelFetch(DepthTex, shadedPixel, 0).r);
+
+        scattering += texelFetch(ScatteringTex, texel, 0).rgb * weight;
+        transmittance += texelFetch(TransmittanceTex, texel, 0).rgb * weight;
+        totalWeight += weight;
+    }
+
+    vec3 originalCol = texelFetch(MainTex, pixel, 0).rgb;
+    fragColour = originalCol * (transmittance / totalWeight) + scattering / totalWeight;
+}
@@ -0,0 +1,116 @@
+// Shared by the atmosphere passes, see src/includes/atmosphere.h; include frame.glsl first
+
+const float INF = 1.0 / 0.0;
+
+uniform sampler2D TransmittanceLut;       // optical depth to the top of the atmosphere, see AtmosphereLuts
+uniform sampler2D MultipleScatteringLut;  // rgb, light scattered more than once
+
+uniform vec3 sunPosition;
+
+uniform vec3 atmospherePosition;
+uniform float atmosphereRadius;
+uniform float planetRadius;
+uniform float scaleHeight;
+uniform int numInScatteringPoints;
+uniform vec3 scatteringCoefficients;
+
+struct AtmosphereSample {
+    vec3 inScattered;
+    vec3 transmittance;
+    float start;      // distance from the camera to where the ray enters the atmosphere
+    float pathLength; // distance the ray travels through it before leaving or hitting the scene, 0 if it misses
+};
+
+vec2 raySphere(vec3 sphereCentre, float sphereRadius, vec3 rayOrigin, vec3 rayDir) {
+    vec3 offset = rayOrigin - sphereCentre;
+    float a = 1;
+    float b = 2 * dot(offset, rayDir);
+    float c = dot(offset, offset) - sphereRadius * sphereRadius;
+    float d = b * b - 4 * a * c;
+
+    if (d > 0) {
+        float s = sqrt(d);
+        float dstToSphereNear = max(0, (-b - s) / (2 * a));
+        float dstToSphereFar = (-b + s) / (2 * a);
+
+        if (dstToSphereFar >= 0) {
+            return vec2(dstToSphereNear, dstToSphereFar - dstToSphereNear);
+        }
+    }
+
+    return vec2(INF, 0);
+}
+
+// Must match transmittanceUv in src/rendering/atmosphere.cpp
+vec2 transmittanceUv(float r, float mu) {
+    float horizon = sqrt(atmosphereRadius * atmosphereRadius - planetRadius * planetRadius);
+    float rho = sqrt(max(r * r - planetRadius * planetRadius, 0.0));
+    float discriminant = r * r * (mu * mu - 1.0) + atmosphereRadius * atmosphereRadius;
+    float d = max(0.0, -r * mu + sqrt(max(discriminant, 0.0)));
+    float dMin = atmosphereRadius - r;
+    float dMax = rho + horizon;
+    return vec2(dMax > dMin ? (d - dMin) / (dMax - dMin) : 0.0, rho / horizon);
+}
+
+vec3 sunTransmittance(float r, float muS) {
+    // Below the planet's horizon the sun is hidden behind it
+    if (muS < 0.0 && r * r * (muS * muS - 1.0) + planetRadius * planetRadius >= 0.0) return vec3(0.0);
+    return exp(-scatteringCoefficients * texture(TransmittanceLut, transmittanceUv(r, muS)).r);
+}
+
+vec3 multipleScattering(float r, float muS) {
+    vec2 lutUv = vec2(muS * 0.5 + 0.5, (r - planetRadius) / (atmosphereRadius - planetRadius));
+    return texture(MultipleScatteringLut, lutUv).rgb;
+}
+
+// Camera-relative direction through a point in normalised device coordinates
+vec3 viewRay(vec2 ndc) {
+    vec4 eyePos = invProj * vec4(ndc, 1.0, 1.0);
+    eyePos /= eyePos.w;
+    return normalize((invView * eyePos).xyz - (invView * vec4(0.0, 0.0, 0.0, 1.0)).xyz);
+}
+
+// Distance along `rayDir` to whatever the scene drew, from the reversed-Z depth
+float sceneDistance(float depth, vec3 rayDir) {
+    vec3 viewForward = -invView[2].xyz;
+    return viewDepth(depth) / dot(rayDir, viewForward);
+}
+
+/*  Marches the view ray only; everything towards the sun comes from the
+ *  lookup tables. `offset` in [0, 1) places the sample within each step -
+ *  0.5 is the midpoint rule, a different offset every frame lets temporal
+ *  accumulation integrate between the steps.
+ */
+AtmosphereSample marchAtmosphere(vec3 rayDir, float dstToScene, float offset) {
+    AtmosphereSample result;
+    result.inScattered = vec3(0.0);
+    result.transmittance = vec3(1.0);
+
+    vec2 sphereHit = raySphere(atmospherePosition, atmosphereRadius, cameraPos.xyz, rayDir);
+    result.start = sphereHit.x;
+    result.pathLength = max(0.0, min(sphereHit.y, dstToScene - sphereHit.x));
+    if (result.pathLength <= 0.0) return result;
+
+    vec3 rayStart = cameraPos.xyz + rayDir * result.start;
+    float stepSize = result.pathLength / numInScatteringPoints;
+    float viewRayOpticalDepth = 0;
+
+    for (int i = 0; i < numInScatteringPoints; i++) {
+        vec3 samplePoint = rayStart + rayDir * ((i + offset) * stepSize);
+        vec3 up = samplePoint - atmospherePosition;
+        float r = length(up);
+        up /= r;
+
+        float localDensity = exp(-(r - planetRadius) / scaleHeight) * stepSize;
+        vec3 viewTransmittance = exp(-scatteringCoefficients * (viewRayOpticalDepth + 0.5 * localDensity));
+
+        float muS = dot(up, normalize(sunPosition - samplePoint));
+        vec3 light = sunTransmittance(r, muS) + multipleScattering(r, muS);
+
+        result.inScattered += localDensity * scatteringCoefficients * viewTransmittance * light;
+        viewRayOpticalDepth += localDensity;
+    }
+
+    result.transmittance = exp(-scatteringCoefficients * viewRayOpticalDepth);
+    return result;
+}
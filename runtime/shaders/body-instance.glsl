@@ -0,0 +1,12 @@
+// Per-body data shared by the mesh, impostor and point-sprite tiers, see src/includes/bodyInstance.h
+struct Instance {
+    vec4 positionRadius; // centre and radius
+    vec4 diffuse;        // a = 1 when emissive
+    vec4 emission;       // alpha is intensity
+    uvec4 shadow;        // x = first occluder in shadows.glsl's buffer, y = how many
+    vec4 motion;         // xyz = last frame's centre minus this frame's
+};
+
+layout (std430, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
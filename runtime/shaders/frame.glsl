@@ -0,0 +1,20 @@
+// Frame-constant data shared by every program, see src/includes/frameUniforms.h
+layout (std140, binding = 0) uniform FrameUniforms {
+    mat4 worldToClip;
+    mat4 view;
+    mat4 proj;          // reversed-Z, infinite far plane - near plane is proj[3][2]
+    mat4 invView;
+    mat4 invProj;
+    mat4 prevWorldToClip; // last frame's worldToClip, for its own camera-relative positions
+    vec4 cameraPos;     // xyz
+    vec4 lightPos;      // xyz camera-relative centre, w = the light's radius
+    vec4 lightColour;   // rgb
+    vec4 screenSize;    // xy in pixels, zw = 1 / xy
+    vec4 time;          // x = wall-clock seconds, y = simulation seconds, z = frame delta
+    vec4 jitter;        // xy = this frame's projection offset in NDC, zw = last frame's
+};
+
+// Distance along the view axis for a reversed-Z depth value; the cleared depth of 0 is infinitely far
+float viewDepth(float depth) {
+    return depth > 0.0 ? proj[3][2] / depth : 1.0 / 0.0;
+}
@@ -3,18 +3,15 @@
 
 #version 460 core
 
+#include "frame.glsl"
+
 out vec4 fragColour;
 
 in vec3 nearPoint;
 in vec3 farPoint;
 
-uniform mat4 proj;
-uniform mat4 view;
-
-uniform mat4 projFar;
-
-uniform float nearPlane;
-uniform float farPlane;
+uniform float fadeDistance; // the grid has faded out completely at half this distance
+uniform vec3 cameraOffset;  // camera position relative to the focus body, positions here are camera-relative
 
 vec4 grid(vec3 fragPos, float scale, bool drawAxisLines) {
     vec2 coord = fragPos.xz * scale;
@@ -37,25 +34,21 @@ vec4 grid(vec3 fragPos, float scale, bool drawAxisLines) {
 }
 
 float computeDepth(vec3 pos) {
-    vec4 clipSpacePos = projFar * view * vec4(pos, 1.0);
-    return (clipSpacePos.z / clipSpacePos.w) * 0.5 + 0.5;
-}
-
-float computeLinearDepth(vec3 pos) {
-    vec4 clipSpacePos = proj * view * vec4(pos, 1.0);
-    float clipDepth = clipSpacePos.z / clipSpacePos.w;
-    float linearDepth = (2.0 * nearPlane * farPlane) / (farPlane + nearPlane - clipDepth * (farPlane - nearPlane));
-    return linearDepth / farPlane;
+    vec4 clipSpacePos = worldToClip * vec4(pos, 1.0);
+    return clipSpacePos.z / clipSpacePos.w;
 }
 
 void main() {
-    float t = -nearPoint.y / (farPoint.y - nearPoint.y);
-    vec3 fragPos = nearPoint + t * (farPoint - nearPoint);
+    // Intersect the view ray with the focus body's y = 0 plane
+    float t = -(nearPoint.y + cameraOffset.y) / (farPoint.y - nearPoint.y);
+    vec3 relativePos = nearPoint + t * (farPoint - nearPoint);
+
+    float depth = computeDepth(relativePos);
+    gl_FragDepth = depth;
 
-    gl_FragDepth = computeDepth(fragPos);
+    float fading = max(0, 0.5 - viewDepth(depth) / fadeDistance);
 
-    float linearDepth = computeLinearDepth(fragPos);
-    float fading = max(0, 0.5 - linearDepth);
+    vec3 fragPos = relativePos + cameraOffset; // grid lines are fixed to the focus body
 
     vec4 grid100m = grid(fragPos, 0.1, false);
     vec4 grid1km = grid(fragPos, 0.01, false);
@@ -3,11 +3,7 @@
 
 #version 460 core
 
-uniform mat4 proj;
-uniform mat4 inv_proj;
-uniform mat4 view;
-uniform mat4 inv_view;
-uniform vec3 cameraPos;
+#include "frame.glsl"
 
 out vec3 nearPoint;
 out vec3 farPoint;
@@ -22,13 +18,14 @@ const vec3 Positions[6] = vec3[6](
 );
 
 vec3 unprojectPoint(vec3 point) {
-    vec4 unprojectedPoint = inv_view * inv_proj * vec4(point, 1.0);
+    vec4 unprojectedPoint = invView * invProj * vec4(point, 1.0);
     return unprojectedPoint.xyz / unprojectedPoint.w;
 }
 
 void main() {
     vec3 p = Positions[gl_VertexID];
-    nearPoint = unprojectPoint(vec3(p.xy, 0.0));
-    farPoint = unprojectPoint(vec3(p.xy, 1.0));
+    // Reversed-Z: depth 1 is the near plane and 0 is at infinity, so take the second point at twice the near distance
+    nearPoint = unprojectPoint(vec3(p.xy, 1.0));
+    farPoint = unprojectPoint(vec3(p.xy, 0.5));
     gl_Position = vec4(p, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+// Screen-space motion for TemporalAa, see src/includes/temporalAa.h. Needs frame.glsl.
+// Scene programs write it to colour attachment 1, which only exists while TAA is on.
+
+// Marks pixels no opaque draw covered; the resolve reprojects them from depth instead
+const vec2 NoMotion = vec2(1.0e4);
+
+// NDC from where `position` (camera-relative, this frame) was last frame to where it is now, both without
+// their frame's jitter. `motion` is the owner's own movement relative to the camera, last frame minus now.
+vec2 motionVector(vec3 position, vec3 motion) {
+    vec4 current = worldToClip * vec4(position, 1.0);
+    vec4 previous = prevWorldToClip * vec4(position + motion, 1.0);
+    return (current.xy / current.w - jitter.xy) - (previous.xy / previous.w - jitter.zw);
+}
@@ -0,0 +1,9 @@
+// Inverse of OctahedralEncode in src/includes/vertex.h
+vec3 octahedralDecode(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0) {
+        vec2 folded = 1.0 - abs(e.yx);
+        v.xy = vec2(e.x >= 0.0 ? folded.x : -folded.x, e.y >= 0.0 ? folded.y : -folded.y);
+    }
+    return normalize(v);
+}
@@ -0,0 +1,37 @@
+#version 460 core
+
+#include "frame.glsl"
+#include "shadows.glsl"
+#include "motion.glsl"
+
+layout (location = 0) out vec3 fragColour;
+layout (location = 1) out vec2 fragMotion;
+
+in vec3 normal;
+in vec2 uv;
+in vec3 fragPos;
+
+flat in vec3 diffuse;
+flat in int emissive;
+flat in vec4 emission; // alpha is intensity
+flat in uvec2 occluderRange;
+flat in vec3 bodyMotion;
+
+uniform int hasTexture;
+uniform sampler2D albedoTex;
+
+void main() {
+    vec3 dirToLight = normalize(lightPos.xyz - fragPos);
+    float diff = max(dot(normal, dirToLight) * lightVisibility(fragPos, occluderRange.x, occluderRange.y), 0.03);
+    vec3 texCol = vec3(1);
+    if (hasTexture == 1) texCol = texture(albedoTex, uv).rgb;
+    vec3 lit = diffuse * texCol * diff;
+    vec3 glow = emission.rgb * emission.a;
+
+    if (emissive == 1) {
+        fragColour = glow;
+    } else {
+        fragColour = lit + glow;
+    }
+    fragMotion = motionVector(fragPos, bodyMotion);
+}
@@ -0,0 +1,38 @@
+#version 460 core
+
+#include "frame.glsl"
+#include "octahedral.glsl"
+#include "body-instance.glsl"
+
+layout (location = 0) in vec2 aDirection; // octahedral-encoded, see PackedVertex
+layout (location = 1) in vec2 aTexcoord;
+
+out vec3 normal;
+out vec2 uv;
+out vec3 fragPos;
+
+flat out vec3 diffuse;
+flat out int emissive;
+flat out vec4 emission;
+flat out uvec2 occluderRange;
+flat out vec3 bodyMotion;
+
+void main() {
+    // A unit sphere: the direction is both the position and the normal
+    vec3 direction = octahedralDecode(aDirection);
+
+    Instance instance = instances[gl_BaseInstance + gl_InstanceID];
+
+    vec3 worldPos = direction * instance.positionRadius.w + instance.positionRadius.xyz;
+    gl_Position = worldToClip * vec4(worldPos, 1.0);
+
+    normal = direction;
+    uv = aTexcoord;
+    fragPos = worldPos;
+
+    diffuse = instance.diffuse.rgb;
+    emissive = instance.diffuse.a > 0.5 ? 1 : 0;
+    emission = instance.emission;
+    occluderRange = instance.shadow.xy;
+    bodyMotion = instance.motion.xyz;
+}
@@ -0,0 +1,12 @@
+#version 460 core
+
+out vec4 fragColour;
+
+in float progress;
+
+uniform vec4 colour;
+
+void main() {
+    // Fade the path out towards the end of the prediction horizon
+    fragColour = vec4(colour.rgb, colour.a * (1.0 - progress * 0.85));
+}
@@ -0,0 +1,14 @@
+#version 460 core
+
+#include "frame.glsl"
+
+layout (location = 0) in vec4 aPosition; // xyz = position relative to the focus body, w = progress along the prediction
+
+uniform vec3 focusOffset;                // the focus body relative to the camera
+
+out float progress;
+
+void main() {
+    gl_Position = worldToClip * vec4(aPosition.xyz + focusOffset, 1.0);
+    progress = aPosition.w;
+}
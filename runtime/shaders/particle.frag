@@ -0,0 +1,15 @@
+#version 460 core
+
+in vec3 particleColour;
+
+out vec4 fragColour;
+
+void main()
+{
+    /* round dot, soft towards the edge; blended additively */
+    vec2 centred = gl_PointCoord * 2.0 - 1.0;
+    float r2 = dot(centred, centred);
+    if (r2 > 1.0) discard;
+
+    fragColour = vec4(particleColour, 1.0 - r2 * r2);
+}
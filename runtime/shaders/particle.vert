@@ -0,0 +1,28 @@
+#version 460 core
+
+#include "frame.glsl"
+
+layout (location = 0) in vec3 aPosition; // camera-relative, SU
+
+uniform vec3 colour;
+uniform float pointSize;
+uniform float referenceDistance; // full size and brightness at this distance
+uniform int attenuateSize;
+uniform int attenuateBrightness;
+uniform float minBrightness;
+
+out vec3 particleColour;
+
+void main()
+{
+    gl_Position = worldToClip * vec4(aPosition, 1.0);
+
+    float falloff = referenceDistance / max(length(aPosition - cameraPos.xyz), 1e-6);
+
+    /* shrink with distance down to a single pixel, never grow past the set size */
+    gl_PointSize = attenuateSize == 1 ? clamp(pointSize * falloff, 1.0, pointSize) : pointSize;
+
+    /* inverse square, with a floor so distant belts still read as a haze */
+    float brightness = attenuateBrightness == 1 ? clamp(falloff * falloff, minBrightness, 1.0) : 1.0;
+    particleColour = colour * brightness;
+}
@@ -0,0 +1,38 @@
+#version 460 core
+
+#include "frame.glsl"
+#include "body-instance.glsl"
+
+uniform float pointSize;
+
+out vec4 colour;                            // rgb, a = coverage
+
+void main()
+{
+    Instance instance = instances[gl_BaseInstance + gl_InstanceID];
+    vec3 centre = instance.positionRadius.xyz;
+    float radius = instance.positionRadius.w;
+
+    gl_Position = worldToClip * vec4(centre, 1.0);
+    gl_PointSize = pointSize;
+
+    vec3 toCamera = cameraPos.xyz - centre;
+    float dist = length(toCamera);
+    float radiusPx = radius / dist * proj[1][1] * screenSize.y * 0.5;
+
+    if (instance.diffuse.a > 0.5) {
+        /* emissive bodies stay visible however far away they are */
+        colour = vec4(instance.emission.rgb * instance.emission.a, 1.0);
+        return;
+    }
+
+    /* lit fraction of the disc as seen from the camera, (1 + cos(phase)) / 2 */
+    vec3 toLight = normalize(lightPos.xyz - centre);
+    float lit = 0.5 + 0.5 * dot(toLight, toCamera / dist);
+    vec3 glow = instance.emission.rgb * instance.emission.a;
+
+    /* fraction of the sprite the body would really cover, with a floor so it never vanishes */
+    float coverage = clamp(radiusPx * radiusPx * 4.0 / (pointSize * pointSize), 0.2, 1.0);
+
+    colour = vec4(instance.diffuse.rgb * max(lit, 0.03) + glow, coverage);
+}
@@ -0,0 +1,41 @@
+// Eclipse shadows against a receiver's culled occluder list, see src/includes/shadows.h.
+// Needs frame.glsl for the light.
+layout (std430, binding = 2) readonly buffer Occluders {
+    vec4 occluders[]; // camera-relative centre and radius
+};
+
+// Area of overlap of two discs with radii a and b whose centres are d apart
+float discOverlap(float a, float b, float d) {
+    if (d >= a + b) return 0.0;
+    float smaller = min(a, b);
+    if (d <= abs(a - b)) return 3.14159265 * smaller * smaller;
+
+    float alpha = acos(clamp((d * d + a * a - b * b) / (2.0 * d * a), -1.0, 1.0));
+    float beta = acos(clamp((d * d + b * b - a * a) / (2.0 * d * b), -1.0, 1.0));
+    float kite = sqrt(max((-d + a + b) * (d + a - b) * (d - a + b) * (d + a + b), 0.0));
+    return a * a * alpha + b * b * beta - 0.5 * kite;
+}
+
+// Fraction of the light's disc visible from `position` past occluders [first, first + count):
+// 0 in the umbra, between 0 and 1 in the penumbra, 1 - (occluder / light)² inside an annular antumbra
+float lightVisibility(vec3 position, uint first, uint count) {
+    vec3 toLight = lightPos.xyz - position;
+    float lightDistance = length(toLight);
+    vec3 lightDir = toLight / lightDistance;
+    float lightAngle = asin(min(lightPos.w / lightDistance, 1.0));
+    float lightArea = 3.14159265 * lightAngle * lightAngle;
+
+    float visible = 1.0;
+    for (uint i = first; i < first + count; ++i) {
+        vec3 toOccluder = occluders[i].xyz - position;
+        float occluderDistance = length(toOccluder);
+        vec3 occluderDir = toOccluder / occluderDistance;
+        if (occluderDistance >= lightDistance || dot(occluderDir, lightDir) <= 0.0) continue;
+
+        float occluderAngle = asin(min(occluders[i].w / occluderDistance, 1.0));
+        // atan of sine over cosine keeps the tiny angles involved, where acos of a dot product loses them
+        float separation = atan(length(cross(lightDir, occluderDir)), dot(lightDir, occluderDir));
+        visible *= 1.0 - min(discOverlap(lightAngle, occluderAngle, separation) / lightArea, 1.0);
+    }
+    return visible;
+}
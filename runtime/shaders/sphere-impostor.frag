@@ -0,0 +1,66 @@
+#version 460 core
+
+#include "frame.glsl"
+#include "shadows.glsl"
+#include "motion.glsl"
+
+#define PI 3.14159265359
+
+layout(depth_greater) out float gl_FragDepth; // reversed-Z: the sphere is never behind its quad, keeps early-Z where supported
+
+in vec3 rayTarget;
+
+flat in vec3 centre;
+flat in float radius;
+flat in float radiusPx;
+flat in vec3 diffuse;
+flat in int emissive;
+flat in vec4 emission; // alpha is intensity
+flat in uvec2 occluderRange;
+flat in vec3 bodyMotion;
+
+uniform int hasTexture;
+uniform sampler2D albedoTex;
+
+layout (location = 0) out vec3 fragColour;
+layout (location = 1) out vec2 fragMotion;
+
+void main()
+{
+    /* ----- ray / sphere intersection ----- */
+    vec3 origin = cameraPos.xyz;
+    vec3 dir = normalize(rayTarget - origin);
+    vec3 oc = origin - centre;
+    float b = dot(oc, dir);
+    float c = dot(oc, oc) - radius * radius;
+    float h = b * b - c;
+    if (h < 0.0) discard;                   // missed the sphere
+
+    float t = -b - sqrt(h);
+    vec3 fragPos = origin + dir * t;
+    vec3 normal = (fragPos - centre) / radius;
+
+    /* ----- same mapping as the octahedron mesh uvs ----- */
+    vec3 texCol = vec3(1);
+    if (hasTexture == 1) {
+        vec2 uv;
+        uv.x = atan(normal.x, normal.z) / (-2.0 * PI);
+        if (uv.x < 0.0) uv.x += 1.0;
+        uv.y = asin(clamp(normal.y, -1.0, 1.0)) / PI + 0.5;
+
+        // explicit mip, screen derivatives break down at the uv seam
+        float lod = log2(max(float(textureSize(albedoTex, 0).x) / (2.0 * PI * radiusPx), 1.0));
+        texCol = textureLod(albedoTex, uv, lod).rgb;
+    }
+
+    vec3 dirToLight = normalize(lightPos.xyz - fragPos);
+    float diff = max(dot(normal, dirToLight) * lightVisibility(fragPos, occluderRange.x, occluderRange.y), 0.03);
+    vec3 lit = diffuse * texCol * diff;
+    vec3 glow = emission.rgb * emission.a;
+
+    fragColour = emissive == 1 ? glow : lit + glow;
+    fragMotion = motionVector(fragPos, bodyMotion);
+
+    vec4 clipPos = worldToClip * vec4(fragPos, 1.0);
+    gl_FragDepth = clipPos.z / clipPos.w;
+}
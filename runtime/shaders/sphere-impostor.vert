@@ -0,0 +1,49 @@
+#version 460 core
+
+#include "frame.glsl"
+#include "body-instance.glsl"
+
+layout(location = 0) in vec2 aPos;          // (-0.5 … +0.5)
+layout(location = 1) in vec2 aUv;
+
+out vec3 rayTarget;                         // world-space point on the quad, the ray goes camera -> here
+
+flat out vec3 centre;
+flat out float radius;
+flat out float radiusPx;                    // projected radius, picks the texture mip
+flat out vec3 diffuse;
+flat out int emissive;
+flat out vec4 emission;
+flat out uvec2 occluderRange;
+flat out vec3 bodyMotion;
+
+void main()
+{
+    Instance instance = instances[gl_BaseInstance + gl_InstanceID];
+    centre = instance.positionRadius.xyz;
+    radius = instance.positionRadius.w;
+
+    /* camera-facing basis through the centre */
+    vec3 toCamera = cameraPos.xyz - centre;
+    float dist = length(toCamera);
+    vec3 forward = toCamera / dist;
+    vec3 right = cross(vec3(0, 1, 0), forward);
+    if (dot(right, right) < 1e-4) right = vec3(1, 0, 0);
+    right = normalize(right);
+    vec3 up = cross(forward, right);
+
+    /* in perspective the silhouette is a little wider than the radius: r * d / sqrt(d² - r²) */
+    float tangent = sqrt(max(dist * dist - radius * radius, 1e-6 * dist * dist));
+    float halfSize = radius * dist / tangent;
+
+    vec2 centred = aPos * 2.0;              // (-1 … +1)
+    rayTarget = centre + (centred.x * right + centred.y * up) * halfSize;
+    gl_Position = worldToClip * vec4(rayTarget, 1.0);
+
+    radiusPx = radius / tangent * proj[1][1] * screenSize.y * 0.5;
+    diffuse = instance.diffuse.rgb;
+    emissive = instance.diffuse.a > 0.5 ? 1 : 0;
+    emission = instance.emission;
+    occluderRange = instance.shadow.xy;
+    bodyMotion = instance.motion.xyz;
+}
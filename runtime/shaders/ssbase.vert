@@ -1,10 +1,6 @@
 #version 460 core
 
-uniform mat4 proj;
-uniform mat4 inv_proj;
-uniform mat4 view;
-uniform mat4 inv_view;
-uniform vec3 cameraPos;
+#include "frame.glsl"
 
 out vec2 vPos;
 out vec2 uv;
@@ -0,0 +1,108 @@
+#version 460 core
+
+#include "frame.glsl"
+#include "motion.glsl"
+
+// Blends this frame's jittered image into the reprojected history, see src/includes/temporalAa.h
+
+out vec4 fragColour;
+
+in vec2 vPos;
+in vec2 uv;
+
+uniform sampler2D MainTex;
+uniform sampler2D DepthTex;
+uniform sampler2D MotionTex;
+uniform sampler2D HistoryTex;
+
+uniform bool historyValid;
+uniform vec3 cameraMotion;   // this frame's camera position minus last frame's, relative to the focus body, SU
+uniform float feedbackStill; // history weight for pixels that don't move
+uniform float feedbackMoving; // ... and for those moving MovingPixels or more a frame
+uniform float clipGamma;     // neighbourhood box half-size, in standard deviations
+
+const float MovingPixels = 8.0;
+
+// Clamping in luma/chroma keeps hue shifts out of the box and tightens it along brightness
+vec3 toYCoCg(vec3 c) {
+    return vec3(dot(c, vec3(0.25, 0.5, 0.25)), dot(c, vec3(0.5, 0.0, -0.5)), dot(c, vec3(-0.25, 0.5, -0.25)));
+}
+
+vec3 fromYCoCg(vec3 c) {
+    return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+// Pulls `history` along the line towards the box centre until it is inside, rather than clamping per axis,
+// which would give a colour that was never in the neighbourhood
+vec3 clipToBox(vec3 history, vec3 centre, vec3 extent) {
+    vec3 offset = history - centre;
+    vec3 units = abs(offset / max(extent, vec3(1e-5)));
+    float furthest = max(units.x, max(units.y, units.z));
+    return furthest > 1.0 ? centre + offset / furthest : history;
+}
+
+// Motion for pixels no opaque draw wrote one for: the point at that depth (or, with nothing there, the
+// direction) is taken to be fixed relative to the focus body, so only the camera moved
+vec2 cameraOnlyMotion(ivec2 pixel, float depth) {
+    vec2 ndc = (vec2(pixel) + 0.5) * screenSize.zw * 2.0 - 1.0 - jitter.xy;
+    vec4 nearPoint = invProj * vec4(ndc, 1.0, 1.0);
+    vec3 viewRay = normalize(nearPoint.xyz / nearPoint.w);
+    vec3 direction = mat3(invView) * viewRay;
+
+    if (depth <= 0.0) {
+        vec4 previous = prevWorldToClip * vec4(direction, 0.0);
+        return ndc - (previous.xy / previous.w - jitter.zw);
+    }
+
+    // viewDepth is distance along the view axis, the ray is scaled to match
+    vec3 position = direction * (viewDepth(depth) / max(-viewRay.z, 1e-6));
+    return motionVector(position, cameraMotion);
+}
+
+void main() {
+    ivec2 size = textureSize(MainTex, 0);
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+    // Neighbourhood moments for the clip box, and the nearest depth for the motion vector: taking the
+    // nearest surface's motion keeps the history of a moving edge attached to it
+    vec3 current = vec3(0.0);
+    vec3 sum = vec3(0.0);
+    vec3 sumSquares = vec3(0.0);
+    float nearest = -1.0;
+    ivec2 nearestPixel = pixel;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            ivec2 p = clamp(pixel + ivec2(x, y), ivec2(0), size - 1);
+            vec3 c = toYCoCg(texelFetch(MainTex, p, 0).rgb);
+            if (x == 0 && y == 0) current = c;
+            sum += c;
+            sumSquares += c * c;
+
+            float depth = texelFetch(DepthTex, p, 0).r; // reversed-Z, nearest is largest
+            if (depth > nearest) {
+                nearest = depth;
+                nearestPixel = p;
+            }
+        }
+    }
+
+    vec2 motion = texelFetch(MotionTex, nearestPixel, 0).xy;
+    if (motion.x >= NoMotion.x * 0.5) motion = cameraOnlyMotion(nearestPixel, nearest);
+
+    vec2 previousUv = (vec2(pixel) + 0.5) / vec2(size) - motion * 0.5;
+    bool onScreen = all(greaterThanEqual(previousUv, vec2(0.0))) && all(lessThanEqual(previousUv, vec2(1.0)));
+    if (!historyValid || !onScreen) {
+        fragColour = vec4(fromYCoCg(current), 1.0);
+        return;
+    }
+
+    vec3 mean = sum / 9.0;
+    vec3 deviation = sqrt(max(sumSquares / 9.0 - mean * mean, 0.0));
+    vec3 history = clipToBox(toYCoCg(texture(HistoryTex, previousUv).rgb), mean, deviation * clipGamma);
+
+    // Moving pixels lean on the current frame, where the history is resampled and blurrier
+    float movedPixels = length(motion * 0.5 * vec2(size));
+    float feedback = mix(feedbackStill, feedbackMoving, clamp(movedPixels / MovingPixels, 0.0, 1.0));
+
+    fragColour = vec4(fromYCoCg(mix(current, history, feedback)), 1.0);
+}
@@ -0,0 +1,50 @@
+#version 460 core
+
+#include "frame.glsl"
+#include "shadows.glsl"
+#include "motion.glsl"
+
+layout (location = 0) out vec3 fragColour;
+layout (location = 1) out vec2 fragMotion;
+
+in vec3 normal;
+in vec3 fragPos;
+in vec3 fromCentre;
+
+uniform float planetRadius;
+uniform float maxHeight;
+
+uniform vec3 diffuse;
+uniform vec4 emission; // alpha is intensity
+uniform int useAlbedo;
+uniform sampler2D albedo; // equirectangular, mapped as Octahedron maps its uvs
+uniform int occluderFirst;
+uniform int occluderCount;
+uniform vec3 bodyMotion; // the planet's, see motion.glsl
+
+const float PI = 3.14159265358979;
+
+void main() {
+    vec3 direction = normalize(fromCentre);
+
+    vec3 colour = diffuse;
+    if (useAlbedo == 1) {
+        // Per-fragment uvs; the gradients come from the continuous direction so the seam at ±180° doesn't pick the smallest mip
+        vec2 uv = vec2(fract(atan(direction.x, direction.z) / (-2.0 * PI)), asin(clamp(direction.y, -1.0, 1.0)) / PI + 0.5);
+        vec2 dx = dFdx(uv), dy = dFdy(uv);
+        dx.x -= round(dx.x);
+        dy.x -= round(dy.x);
+        colour *= textureGrad(albedo, uv, dx, dy).rgb;
+    } else {
+        // Without a texture, shade by height so the relief reads
+        float height = (length(fromCentre) - planetRadius) / max(maxHeight, 1e-9);
+        colour *= mix(vec3(0.55, 0.6, 0.5), vec3(1.0), smoothstep(-0.2, 0.8, height));
+    }
+
+    vec3 dirToLight = normalize(lightPos.xyz - fragPos);
+    float shadow = lightVisibility(fragPos, uint(occluderFirst), uint(occluderCount));
+    float diff = max(dot(normalize(normal), dirToLight) * shadow, 0.03);
+
+    fragColour = colour * diff + emission.rgb * emission.a;
+    fragMotion = motionVector(fragPos, bodyMotion);
+}
@@ -0,0 +1,27 @@
+#version 460 core
+
+#include "frame.glsl"
+#include "octahedral.glsl"
+
+layout (location = 0) in vec3 aPosition; // SU, relative to the patch centre
+layout (location = 1) in vec2 aNormal;   // octahedral-encoded
+
+// Patch centres relative to the camera, one per sub-draw of the multi-draw
+layout (std430, binding = 1) readonly buffer PatchOrigins {
+    vec4 origins[];
+};
+
+uniform vec3 planetCentre;
+
+out vec3 normal;
+out vec3 fragPos;
+out vec3 fromCentre; // SU, planet centre to the vertex
+
+void main() {
+    vec3 worldPos = origins[gl_DrawID].xyz + aPosition;
+    gl_Position = worldToClip * vec4(worldPos, 1.0);
+
+    normal = octahedralDecode(aNormal);
+    fragPos = worldPos;
+    fromCentre = worldPos - planetCentre;
+}
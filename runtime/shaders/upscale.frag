@@ -0,0 +1,32 @@
+#version 460 core
+
+// Bilinear upscale of the scene to the output, followed by a contrast-adaptive sharpen: the sharpening
+// backs off where the neighbourhood already has contrast, so edges don't ring and noise isn't amplified
+
+in vec2 uv;
+
+out vec3 fragColour;
+
+uniform sampler2D MainTex;
+uniform float sharpness; // 0 is a plain bilinear upscale
+
+void main() {
+    vec2 texel = 1.0 / vec2(textureSize(MainTex, 0));
+
+    vec3 centre = texture(MainTex, uv).rgb;
+    vec3 north = texture(MainTex, uv + vec2(0.0, texel.y)).rgb;
+    vec3 south = texture(MainTex, uv - vec2(0.0, texel.y)).rgb;
+    vec3 east = texture(MainTex, uv + vec2(texel.x, 0.0)).rgb;
+    vec3 west = texture(MainTex, uv - vec2(texel.x, 0.0)).rgb;
+
+    vec3 lowest = min(centre, min(min(north, south), min(east, west)));
+    vec3 highest = max(centre, max(max(north, south), max(east, west)));
+
+    // Headroom left before clipping, relative to the brightest neighbour, per channel
+    vec3 amount = sqrt(clamp(min(lowest, 1.0 - highest) / max(highest, 1e-4), 0.0, 1.0));
+    vec3 weight = -amount * mix(0.125, 0.2, clamp(sharpness, 0.0, 1.0));
+
+    vec3 sharpened = (centre + (north + south + east + west) * weight) / (1.0 + 4.0 * weight);
+    vec3 colour = mix(centre, clamp(sharpened, lowest, highest), step(1e-3, sharpness));
+    fragColour = colour;
+}
@@ -1,3 +1,3 @@
 #include "celestialBody.h"
 
-unsigned int CelestialBody::nextId = 0;
\ No newline at end of file
+std::atomic<unsigned int> CelestialBody::nextId{0};
\ No newline at end of file
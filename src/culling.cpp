@@ -0,0 +1,344 @@
+#include "culling.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "profiler.h"
+#include "radixSort.h"
+#include "threadPool.h"
+
+Culling::Stats Culling::stats{};
+
+namespace {
+    // Spreads the low 10 bits of v out to every third bit
+    std::uint32_t spreadBits(std::uint32_t v) {
+        v &= 0x3FF;
+        v = (v | v << 16) & 0x030000FF;
+        v = (v | v << 8) & 0x0300F00F;
+        v = (v | v << 4) & 0x030C30C3;
+        v = (v | v << 2) & 0x09249249;
+        return v;
+    }
+
+    // Smallest sphere around two spheres, either of which may be empty (negative radius)
+    void mergeSpheres(const glm::vec3 &centreA, float radiusA, const glm::vec3 &centreB, float radiusB,
+                      glm::vec3 &centre, float &radius) {
+        if (radiusB < 0.0f) { centre = centreA; radius = radiusA; return; }
+        if (radiusA < 0.0f) { centre = centreB; radius = radiusB; return; }
+
+        const glm::vec3 offset = centreB - centreA;
+        const float distance = glm::length(offset);
+        if (distance + radiusB <= radiusA) { centre = centreA; radius = radiusA; return; }
+        if (distance + radiusA <= radiusB) { centre = centreB; radius = radiusB; return; }
+
+        radius = 0.5f * (distance + radiusA + radiusB);
+        centre = centreA + offset * ((radius - radiusA) / distance);
+    }
+}
+
+const std::vector<std::uint32_t> &Culling::Cull(const std::vector<glm::vec3> &centres,
+                                                const std::vector<float> &radii,
+                                                const glm::mat4 &worldToClip,
+                                                const glm::vec3 &cameraPos) {
+    PROFILE_SCOPE("Culling::Cull");
+
+    const std::size_t count = centres.size();
+    visibleBodies.clear();
+    stats = Stats{};
+    stats.bodies = count;
+    if (count == 0) {
+        builtCount = 0; // nothing left for Query to walk
+        return visibleBodies;
+    }
+
+    if (count != builtCount || ++framesSinceBuild >= RebuildInterval) rebuildOrder(centres);
+
+    // Frustum planes (Gribb & Hartmann), moved so they apply to camera-relative positions
+    const glm::mat4 clip = worldToClip * glm::translate(glm::mat4(1.0f), cameraPos);
+    const glm::vec4 rows[4] = {
+        glm::vec4(clip[0][0], clip[1][0], clip[2][0], clip[3][0]),
+        glm::vec4(clip[0][1], clip[1][1], clip[2][1], clip[3][1]),
+        glm::vec4(clip[0][2], clip[1][2], clip[2][2], clip[3][2]),
+        glm::vec4(clip[0][3], clip[1][3], clip[2][3], clip[3][3]),
+    };
+    // Reversed-Z: the near plane is z <= w, and the projection has no far plane to test against
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    planes[4] = rows[3] - rows[2];
+    for (glm::vec4 &plane: planes) plane /= glm::length(glm::vec3(plane));
+
+    refit(centres, radii);
+    selectOccluders(centres, radii);
+
+    Counters counters;
+    if (count >= ParallelThreshold && ThreadPool::WorkerCount() > 0) {
+        PROFILE_SCOPE("Culling::Traverse");
+
+        // Start from a tree level with a few subtrees per thread, then stitch the results back in order
+        std::size_t roots = 1;
+        const std::size_t wanted = 4 * (ThreadPool::WorkerCount() + 1);
+        while (roots < wanted && roots * 2 <= firstLeaf) roots *= 2;
+
+        subtreeVisible.resize(roots);
+        subtreeCounters.assign(roots, Counters{});
+        ThreadPool::ParallelFor(roots, 1, [roots](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                subtreeVisible[i].clear();
+                traverse(roots + i, subtreeVisible[i], subtreeCounters[i]);
+            }
+        });
+
+        for (std::size_t i = 0; i < roots; ++i) {
+            visibleBodies.insert(visibleBodies.end(), subtreeVisible[i].begin(), subtreeVisible[i].end());
+            counters.frustumCulled += subtreeCounters[i].frustumCulled;
+            counters.occluded += subtreeCounters[i].occluded;
+        }
+    } else {
+        PROFILE_SCOPE("Culling::Traverse");
+        traverse(1, visibleBodies, counters);
+    }
+
+    stats.visible = visibleBodies.size();
+    stats.frustumCulled = counters.frustumCulled;
+    stats.occluded = counters.occluded;
+    stats.occluders = occluders.size();
+    return visibleBodies;
+}
+
+void Culling::rebuildOrder(const std::vector<glm::vec3> &centres) {
+    PROFILE_SCOPE("Culling::Rebuild");
+
+    const std::size_t count = centres.size();
+    builtCount = count;
+    framesSinceBuild = 0;
+
+    float loX = std::numeric_limits<float>::max(), loY = loX, loZ = loX;
+    float hiX = std::numeric_limits<float>::lowest(), hiY = hiX, hiZ = hiX;
+    for (const glm::vec3 &centre: centres) {
+        loX = std::min(loX, centre.x);
+        loY = std::min(loY, centre.y);
+        loZ = std::min(loZ, centre.z);
+        hiX = std::max(hiX, centre.x);
+        hiY = std::max(hiY, centre.y);
+        hiZ = std::max(hiZ, centre.z);
+    }
+
+    // 10 bits an axis is plenty - the order only has to keep neighbours in the same leaves
+    constexpr float Cells = 1023.0f;
+    const float scaleX = Cells / std::max(hiX - loX, 1e-6f);
+    const float scaleY = Cells / std::max(hiY - loY, 1e-6f);
+    const float scaleZ = Cells / std::max(hiZ - loZ, 1e-6f);
+
+    mortonKeys.resize(count);
+    order.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const glm::vec3 &centre = centres[i];
+        mortonKeys[i] = spreadBits(static_cast<std::uint32_t>((centre.x - loX) * scaleX)) |
+                        spreadBits(static_cast<std::uint32_t>((centre.y - loY) * scaleY)) << 1 |
+                        spreadBits(static_cast<std::uint32_t>((centre.z - loZ) * scaleZ)) << 2;
+    }
+    std::iota(order.begin(), order.end(), 0u);
+    RadixSort(mortonKeys, order, keyScratch, orderScratch);
+
+    // Complete binary tree over the leaves, padded with empty nodes up to a power of two
+    leafCount = (count + LeafSize - 1) / LeafSize;
+    firstLeaf = std::bit_ceil(leafCount);
+    nodes.assign(firstLeaf * 2, Node{glm::vec3(0), -1.0f, 0});
+
+    leafX.resize(leafCount * LeafSize);
+    leafY.resize(leafCount * LeafSize);
+    leafZ.resize(leafCount * LeafSize);
+    leafR.resize(leafCount * LeafSize);
+    leafBody.resize(leafCount * LeafSize);
+}
+
+void Culling::refit(const std::vector<glm::vec3> &centres, const std::vector<float> &radii) {
+    PROFILE_SCOPE("Culling::Refit");
+
+    if (centres.size() >= ParallelThreshold) {
+        ThreadPool::ParallelFor(leafCount, 256, [&](std::size_t begin, std::size_t end) {
+            refitLeaves(centres, radii, begin, end);
+        });
+    } else {
+        refitLeaves(centres, radii, 0, leafCount);
+    }
+
+    for (std::size_t i = firstLeaf - 1; i >= 1; --i) {
+        const Node &a = nodes[i * 2];
+        const Node &b = nodes[i * 2 + 1];
+        Node &node = nodes[i];
+        mergeSpheres(a.centre, a.radius, b.centre, b.radius, node.centre, node.radius);
+        node.count = a.count + b.count;
+    }
+}
+
+void Culling::refitLeaves(const std::vector<glm::vec3> &centres, const std::vector<float> &radii,
+                          std::size_t begin, std::size_t end) {
+    // Plain floats rather than vector maths - this is the one loop that touches every body every frame
+    const std::size_t bodyCount = order.size();
+    for (std::size_t leaf = begin; leaf < end; ++leaf) {
+        const std::size_t base = leaf * LeafSize;
+        const std::size_t count = std::min(LeafSize, bodyCount - base);
+        float loX = std::numeric_limits<float>::max(), loY = loX, loZ = loX;
+        float hiX = std::numeric_limits<float>::lowest(), hiY = hiX, hiZ = hiX;
+
+        for (std::size_t k = base; k < base + count; ++k) {
+            const std::uint32_t body = order[k];
+            const glm::vec3 &centre = centres[body];
+            const float radius = radii[body];
+            leafX[k] = centre.x;
+            leafY[k] = centre.y;
+            leafZ[k] = centre.z;
+            leafR[k] = radius;
+            leafBody[k] = body;
+
+            loX = std::min(loX, centre.x - radius);
+            loY = std::min(loY, centre.y - radius);
+            loZ = std::min(loZ, centre.z - radius);
+            hiX = std::max(hiX, centre.x + radius);
+            hiY = std::max(hiY, centre.y + radius);
+            hiZ = std::max(hiZ, centre.z + radius);
+        }
+        for (std::size_t k = base + count; k < base + LeafSize; ++k) {
+            leafX[k] = leafY[k] = leafZ[k] = 0.0f;
+            leafR[k] = -1.0f;
+            leafBody[k] = UINT32_MAX;
+        }
+
+        const float cx = 0.5f * (loX + hiX), cy = 0.5f * (loY + hiY), cz = 0.5f * (loZ + hiZ);
+        float radius = 0.0f;
+        for (std::size_t k = base; k < base + count; ++k) {
+            const float dx = leafX[k] - cx, dy = leafY[k] - cy, dz = leafZ[k] - cz;
+            radius = std::max(radius, std::sqrt(dx * dx + dy * dy + dz * dz) + leafR[k]);
+        }
+        nodes[firstLeaf + leaf] = Node{glm::vec3(cx, cy, cz), radius, static_cast<std::uint32_t>(count)};
+    }
+}
+
+void Culling::selectOccluders(const std::vector<glm::vec3> &centres, const std::vector<float> &radii) {
+    // The largest bodies by angular size, kept sorted so the smallest is last
+    occluders.clear();
+    float smallest = MinOccluderSine * MinOccluderSine;
+
+    for (std::size_t i = 0; i < centres.size(); ++i) {
+        const float distanceSquared = glm::dot(centres[i], centres[i]);
+        const float radius = radii[i];
+        if (radius * radius >= distanceSquared) continue; // the camera is inside it
+        const float sineSquared = radius * radius / distanceSquared;
+        if (sineSquared < smallest) continue;
+
+        const float distance = std::sqrt(distanceSquared);
+        const float sine = radius / distance;
+        Occluder occluder{centres[i] / distance, distance, sine, std::sqrt(1.0f - sineSquared)};
+
+        auto position = std::find_if(occluders.begin(), occluders.end(),
+                                     [sine](const Occluder &other) { return other.sine < sine; });
+        occluders.insert(position, occluder);
+        if (occluders.size() > MaxOccluders) occluders.pop_back();
+        if (occluders.size() == MaxOccluders) smallest = occluders.back().sine * occluders.back().sine;
+    }
+}
+
+void Culling::traverse(std::size_t root, std::vector<std::uint32_t> &visible, Counters &counters) {
+    // Planes a node is already entirely inside are masked off for everything beneath it
+    struct Entry {
+        std::size_t node;
+        unsigned int planeMask;
+    };
+    Entry stack[64];
+    int top = 0;
+    stack[top++] = {root, 0};
+
+    while (top > 0) {
+        const Entry entry = stack[--top];
+        const Node &node = nodes[entry.node];
+        if (node.radius < 0.0f) continue;
+
+        unsigned int mask = entry.planeMask;
+        bool outside = false;
+        for (unsigned int p = 0; p < PlaneCount && !outside; ++p) {
+            if (mask & (1u << p)) continue;
+            const float distance = glm::dot(glm::vec3(planes[p]), node.centre) + planes[p].w;
+            if (distance < -node.radius) outside = true;
+            else if (distance > node.radius) mask |= 1u << p;
+        }
+        if (outside) {
+            counters.frustumCulled += node.count;
+            continue;
+        }
+
+        // Hidden if the sphere lies inside the occluder's silhouette cone and beyond its centre
+        const float centreDistance = glm::length(node.centre);
+        bool hidden = false;
+        for (const Occluder &occluder: occluders) {
+            if (centreDistance - node.radius < occluder.distance) continue;
+            if (node.radius > occluder.sine * centreDistance) continue;
+            const float tangent = std::sqrt(std::max(centreDistance * centreDistance - node.radius * node.radius, 0.0f));
+            if (glm::dot(node.centre, occluder.direction) >= occluder.cosine * tangent + occluder.sine * node.radius) {
+                hidden = true;
+                break;
+            }
+        }
+        if (hidden) {
+            counters.occluded += node.count;
+            continue;
+        }
+
+        if (entry.node >= firstLeaf) {
+            testLeaf(entry.node - firstLeaf, mask, visible, counters);
+        } else {
+            stack[top++] = {entry.node * 2 + 1, mask};
+            stack[top++] = {entry.node * 2, mask};
+        }
+    }
+}
+
+void Culling::testLeaf(std::size_t leaf, unsigned int planeMask, std::vector<std::uint32_t> &visible,
+                       Counters &counters) {
+    // Same tests as the nodes, written branch-free over the whole leaf so they vectorise
+    const std::size_t base = leaf * LeafSize;
+    const float *x = &leafX[base];
+    const float *y = &leafY[base];
+    const float *z = &leafZ[base];
+    const float *r = &leafR[base];
+
+    std::uint32_t inside[LeafSize];
+    std::uint32_t hidden[LeafSize];
+    for (std::size_t k = 0; k < LeafSize; ++k) {
+        inside[k] = r[k] >= 0.0f;
+        hidden[k] = 0;
+    }
+
+    for (unsigned int p = 0; p < PlaneCount; ++p) {
+        if (planeMask & (1u << p)) continue;
+        const glm::vec4 plane = planes[p];
+        for (std::size_t k = 0; k < LeafSize; ++k)
+            inside[k] &= plane.x * x[k] + plane.y * y[k] + plane.z * z[k] + plane.w >= -r[k];
+    }
+
+    for (const Occluder &occluder: occluders) {
+        for (std::size_t k = 0; k < LeafSize; ++k) {
+            const float distanceSquared = x[k] * x[k] + y[k] * y[k] + z[k] * z[k];
+            const float distance = std::sqrt(distanceSquared);
+            const float tangent = std::sqrt(std::max(distanceSquared - r[k] * r[k], 0.0f));
+            const float along = x[k] * occluder.direction.x + y[k] * occluder.direction.y + z[k] * occluder.direction.z;
+            hidden[k] |= static_cast<std::uint32_t>(distance - r[k] >= occluder.distance) &
+                         static_cast<std::uint32_t>(r[k] <= occluder.sine * distance) &
+                         static_cast<std::uint32_t>(along >= occluder.cosine * tangent + occluder.sine * r[k]);
+        }
+    }
+
+    for (std::size_t k = 0; k < LeafSize; ++k) {
+        if (r[k] < 0.0f) continue;
+        if (!inside[k]) ++counters.frustumCulled;
+        else if (hidden[k]) ++counters.occluded;
+        else visible.push_back(leafBody[base + k]);
+    }
+}
@@ -0,0 +1,387 @@
+#include "eventDetector.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/norm.hpp>
+
+#include "maths.h"
+#include "profiler.h"
+
+std::mutex EventDetector::pendingMutex;
+std::vector<EventDetector::Watch> EventDetector::pendingWatches{};
+double EventDetector::pendingApproachRadius = 0.0;
+bool EventDetector::pendingChanges = false;
+
+std::vector<EventDetector::Watch> EventDetector::watches{};
+std::vector<EventDetector::Watch> EventDetector::approachWatches{};
+std::vector<std::uint32_t> EventDetector::bodyIds{};
+std::unordered_map<std::uint32_t, std::uint32_t> EventDetector::bodyIndices{};
+double EventDetector::approachRadius = 0.0;
+unsigned int EventDetector::stepsSinceRebuild = 0;
+
+std::size_t EventDetector::trackedWatches = 0;
+std::atomic<bool> EventDetector::hasWatches{false};
+std::atomic<bool> EventDetector::restarted{false};
+std::atomic<std::uint64_t> EventDetector::droppedEvents{0};
+SpscQueue<SimulationEvent, 1024> EventDetector::events{};
+
+const char *eventTypeName(EventType type) {
+    switch (type) {
+        case EventType::Periapsis: return "Periapsis";
+        case EventType::Apoapsis: return "Apoapsis";
+        case EventType::CloseApproach: return "Close approach";
+        case EventType::SoiEntry: return "SOI entry";
+        case EventType::SoiExit: return "SOI exit";
+        case EventType::EclipseBegin: return "Eclipse begins";
+        case EventType::EclipseEnd: return "Eclipse ends";
+    }
+    return "Unknown";
+}
+
+void EventDetector::TrackApsides(std::uint32_t primary, std::uint32_t secondary, double maxDistance) {
+    Watch watch;
+    watch.kind = WatchKind::Apsides;
+    watch.idA = primary;
+    watch.idB = secondary;
+    watch.radius = maxDistance;
+
+    std::lock_guard lock(pendingMutex);
+    pendingWatches.push_back(watch);
+    pendingChanges = true;
+    ++trackedWatches;
+    enable();
+}
+
+void EventDetector::TrackSphereOfInfluence(std::uint32_t parent, std::uint32_t body, double soiRadius) {
+    Watch watch;
+    watch.kind = WatchKind::SphereOfInfluence;
+    watch.idA = parent;
+    watch.idB = body;
+    watch.radius = soiRadius;
+
+    std::lock_guard lock(pendingMutex);
+    pendingWatches.push_back(watch);
+    pendingChanges = true;
+    ++trackedWatches;
+    enable();
+}
+
+void EventDetector::TrackEclipse(std::uint32_t light, std::uint32_t occluder, std::uint32_t receiver,
+                                 double lightRadius, double occluderRadius, double receiverRadius,
+                                 double maxDistance) {
+    Watch watch;
+    watch.kind = WatchKind::Eclipse;
+    watch.idA = occluder;
+    watch.idB = receiver;
+    watch.idLight = light;
+    watch.radius = maxDistance;
+    watch.lightRadius = lightRadius;
+    watch.occluderRadius = occluderRadius;
+    watch.receiverRadius = receiverRadius;
+
+    std::lock_guard lock(pendingMutex);
+    pendingWatches.push_back(watch);
+    pendingChanges = true;
+    ++trackedWatches;
+    enable();
+}
+
+void EventDetector::TrackCloseApproaches(double radius) {
+    std::lock_guard lock(pendingMutex);
+    pendingApproachRadius = radius;
+    pendingChanges = true;
+    if (radius > 0.0) enable();
+    else if (trackedWatches == 0) hasWatches = false; // nothing left to detect, the physics thread can skip it
+}
+
+void EventDetector::enable() {
+    // Coming back from idle, last values are from however long ago detection stopped
+    if (!hasWatches.exchange(true)) restarted = true;
+}
+
+double EventDetector::evaluate(const Watch &watch, const StateView &state, double s) {
+    auto position = [&](std::uint32_t i) {
+        if (s >= 1.0) return (*state.p1)[i];
+        if (s <= 0.0) return (*state.p0)[i];
+        return hermitePosition((*state.p0)[i], (*state.v0)[i], (*state.p1)[i], (*state.v1)[i], state.dt, s);
+    };
+    auto velocity = [&](std::uint32_t i) {
+        if (s >= 1.0) return (*state.v1)[i];
+        if (s <= 0.0) return (*state.v0)[i];
+        return hermiteVelocity((*state.p0)[i], (*state.v0)[i], (*state.p1)[i], (*state.v1)[i], state.dt, s);
+    };
+
+    switch (watch.kind) {
+        case WatchKind::Apsides:
+        case WatchKind::CloseApproach:
+            // Radial velocity: negative while approaching, crosses zero at the closest point
+            return glm::dot(position(watch.b) - position(watch.a), velocity(watch.b) - velocity(watch.a));
+
+        case WatchKind::SphereOfInfluence:
+            return glm::length(position(watch.b) - position(watch.a)) - watch.radius;
+
+        case WatchKind::Eclipse: {
+            // Distance of the receiver's limb from the occluder's penumbral cone, negative inside it
+            glm::dvec3 light = position(watch.light);
+            glm::dvec3 occluder = position(watch.a);
+            glm::dvec3 receiver = position(watch.b);
+
+            glm::dvec3 axis = occluder - light;
+            double lightDistance = glm::length(axis);
+            axis /= lightDistance;
+
+            glm::dvec3 toReceiver = receiver - occluder;
+            double behind = glm::dot(toReceiver, axis);
+            if (behind <= 0.0) {
+                // On the lit side the cone degenerates to the occluder itself, which keeps g continuous
+                return glm::length(toReceiver) - (watch.occluderRadius + watch.receiverRadius);
+            }
+
+            double offAxis = glm::length(toReceiver - axis * behind);
+            double penumbra = watch.occluderRadius + behind * (watch.lightRadius + watch.occluderRadius) / lightDistance;
+            return offAxis - (penumbra + watch.receiverRadius);
+        }
+    }
+    return 0.0;
+}
+
+bool EventDetector::refineAndEmit(const Watch &watch, const StateView &state, double time, double g0, double g1) {
+    const bool rising = g1 >= 0.0;
+
+    // Illinois variant of regula falsi on the dense output - converges in a handful of evaluations
+    double lo = 0.0, hi = 1.0;
+    double gLo = g0, gHi = g1;
+    double s = 0.5;
+    int side = 0;
+
+    for (int iteration = 0; iteration < 50; ++iteration) {
+        s = (lo * gHi - hi * gLo) / (gHi - gLo);
+        double g = evaluate(watch, state, s);
+
+        if (g == 0.0 || hi - lo < 1e-12) break;
+
+        if ((g < 0.0) == (gLo < 0.0)) {
+            lo = s;
+            gLo = g;
+            if (side == -1) gHi *= 0.5;
+            side = -1;
+        } else {
+            hi = s;
+            gHi = g;
+            if (side == +1) gLo *= 0.5;
+            side = +1;
+        }
+    }
+
+    glm::dvec3 pa = hermitePosition((*state.p0)[watch.a], (*state.v0)[watch.a], (*state.p1)[watch.a], (*state.v1)[watch.a], state.dt, s);
+    glm::dvec3 pb = hermitePosition((*state.p0)[watch.b], (*state.v0)[watch.b], (*state.p1)[watch.b], (*state.v1)[watch.b], state.dt, s);
+
+    SimulationEvent event;
+    event.time = time + s * state.dt;
+    event.bodyA = watch.idA;
+    event.bodyB = watch.idB;
+    event.distance = glm::length(pb - pa);
+
+    switch (watch.kind) {
+        case WatchKind::Apsides:
+            if (event.distance > watch.radius) return false;
+            event.type = rising ? EventType::Periapsis : EventType::Apoapsis;
+            break;
+        case WatchKind::CloseApproach:
+            if (!rising || event.distance > watch.radius) return false;
+            event.type = EventType::CloseApproach;
+            break;
+        case WatchKind::SphereOfInfluence:
+            event.type = rising ? EventType::SoiExit : EventType::SoiEntry;
+            break;
+        case WatchKind::Eclipse:
+            event.type = rising ? EventType::EclipseEnd : EventType::EclipseBegin;
+            break;
+    }
+
+    pushEvent(event);
+    return true;
+}
+
+void EventDetector::pushEvent(const SimulationEvent &event) {
+    if (!events.tryPush(event)) droppedEvents.fetch_add(1, std::memory_order_relaxed);
+}
+
+void EventDetector::resolve(Watch &watch) {
+    auto indexOf = [](std::uint32_t id) {
+        auto found = bodyIndices.find(id);
+        return found != bodyIndices.end() ? found->second : Unresolved;
+    };
+
+    watch.a = indexOf(watch.idA);
+    watch.b = indexOf(watch.idB);
+    watch.light = watch.kind == WatchKind::Eclipse ? indexOf(watch.idLight) : 0;
+    watch.active = watch.hasValue = false;
+}
+
+void EventDetector::SetBodyLayout(const std::vector<std::uint32_t> &ids) {
+    bodyIds = ids;
+    bodyIndices.clear();
+    for (std::uint32_t i = 0; i < ids.size(); ++i) bodyIndices[ids[i]] = i;
+
+    for (auto &watch: watches) resolve(watch);
+
+    // Wildcard pairs are index-based, so find them again on the next step
+    approachWatches.clear();
+    stepsSinceRebuild = 0;
+}
+
+void EventDetector::rebuildCandidates(const std::vector<glm::dvec3> &positions,
+                                      const std::vector<glm::dvec3> &velocities, double dt) {
+    PROFILE_SCOPE("Events::RebuildCandidates");
+
+    // Pick up newly registered watches without ever waiting on the UI thread
+    if (std::unique_lock lock(pendingMutex, std::try_to_lock); lock.owns_lock() && pendingChanges) {
+        for (auto &watch: pendingWatches) {
+            resolve(watch);
+            watches.push_back(watch);
+        }
+        pendingWatches.clear();
+        approachRadius = pendingApproachRadius;
+        pendingChanges = false;
+    }
+
+    const std::size_t count = positions.size();
+    const double window = RebuildInterval * dt;
+
+    for (auto &watch: watches) {
+        if (watch.a >= count || watch.b >= count || watch.light >= count) {
+            watch.active = watch.hasValue = false;
+            continue;
+        }
+
+        double distance = glm::distance(positions[watch.a], positions[watch.b]);
+        // Anything that can't close this gap within the window is skipped until the next rebuild
+        double margin = 2.0 * glm::distance(velocities[watch.a], velocities[watch.b]) * window + 1.0;
+
+        bool active = watch.kind == WatchKind::SphereOfInfluence
+                          ? std::abs(distance - watch.radius) <= margin
+                          : distance <= watch.radius + margin;
+
+        if (!active) watch.hasValue = false;
+        watch.active = active;
+    }
+
+    if (approachRadius <= 0.0) {
+        approachWatches.clear();
+        return;
+    }
+
+    // Spatial hash over all bodies - only bodies in neighbouring cells become candidate pairs
+    double maxSpeed2 = 0.0;
+    for (const auto &v: velocities) maxSpeed2 = std::max(maxSpeed2, glm::length2(v));
+    const double margin = 4.0 * std::sqrt(maxSpeed2) * window + 1.0;
+    const double reach = approachRadius + margin;
+    const double cellSize = reach;
+
+    auto cellOf = [&](const glm::dvec3 &p) {
+        return glm::ivec3(static_cast<int>(std::floor(p.x / cellSize)),
+                          static_cast<int>(std::floor(p.y / cellSize)),
+                          static_cast<int>(std::floor(p.z / cellSize)));
+    };
+    auto cellKey = [](const glm::ivec3 &c) {
+        // Collisions only ever merge cells, which the exact distance test below filters out again
+        return static_cast<std::uint64_t>(c.x) * 73856093ull ^
+               static_cast<std::uint64_t>(c.y) * 19349663ull ^
+               static_cast<std::uint64_t>(c.z) * 83492791ull;
+    };
+
+    std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> grid;
+    grid.reserve(count);
+    for (std::uint32_t i = 0; i < count; ++i)
+        grid[cellKey(cellOf(positions[i]))].push_back(i);
+
+    std::unordered_map<std::uint64_t, double> previousValues;
+    previousValues.reserve(approachWatches.size());
+    for (const auto &watch: approachWatches)
+        if (watch.hasValue) previousValues[(static_cast<std::uint64_t>(watch.a) << 32) | watch.b] = watch.lastValue;
+
+    approachWatches.clear();
+    const double reach2 = reach * reach;
+
+    for (std::uint32_t i = 0; i < count; ++i) {
+        glm::ivec3 cell = cellOf(positions[i]);
+
+        // Hash collisions can map two neighbours to the same bucket, so visit each bucket once
+        std::uint64_t neighbours[27];
+        int neighbourCount = 0;
+        for (int dx = -1; dx <= 1; ++dx)
+            for (int dy = -1; dy <= 1; ++dy)
+                for (int dz = -1; dz <= 1; ++dz) {
+                    std::uint64_t key = cellKey(cell + glm::ivec3(dx, dy, dz));
+                    if (std::find(neighbours, neighbours + neighbourCount, key) == neighbours + neighbourCount)
+                        neighbours[neighbourCount++] = key;
+                }
+
+        for (int n = 0; n < neighbourCount; ++n) {
+            auto it = grid.find(neighbours[n]);
+            if (it == grid.end()) continue;
+
+            for (std::uint32_t j: it->second) {
+                if (j <= i) continue;
+                if (glm::distance2(positions[i], positions[j]) > reach2) continue;
+
+                std::uint64_t key = (static_cast<std::uint64_t>(i) << 32) | j;
+
+                Watch watch;
+                watch.kind = WatchKind::CloseApproach;
+                watch.a = i;
+                watch.b = j;
+                watch.idA = bodyIds[i];
+                watch.idB = bodyIds[j];
+                watch.radius = approachRadius;
+                watch.active = true;
+                if (auto previous = previousValues.find(key); previous != previousValues.end()) {
+                    watch.hasValue = true;
+                    watch.lastValue = previous->second;
+                }
+                approachWatches.push_back(watch);
+            }
+        }
+    }
+}
+
+bool EventDetector::ProcessStep(double time, double dt,
+                                const std::vector<glm::dvec3> &previousPositions,
+                                const std::vector<glm::dvec3> &previousVelocities,
+                                const std::vector<glm::dvec3> &positions,
+                                const std::vector<glm::dvec3> &velocities) {
+    PROFILE_SCOPE("Events::ProcessStep");
+
+    if (restarted.exchange(false)) {
+        for (auto &watch: watches) watch.hasValue = false;
+        approachWatches.clear();
+        stepsSinceRebuild = 0;
+    }
+
+    if (stepsSinceRebuild++ % RebuildInterval == 0)
+        rebuildCandidates(previousPositions, previousVelocities, dt);
+
+    const StateView state{&previousPositions, &previousVelocities, &positions, &velocities, dt};
+    bool emitted = false;
+
+    auto check = [&](Watch &watch) {
+        double g0 = watch.hasValue ? watch.lastValue : evaluate(watch, state, 0.0);
+        double g1 = evaluate(watch, state, 1.0);
+
+        if ((g0 < 0.0) != (g1 < 0.0))
+            emitted |= refineAndEmit(watch, state, time, g0, g1);
+
+        watch.lastValue = g1;
+        watch.hasValue = true;
+    };
+
+    for (auto &watch: watches)
+        if (watch.active) check(watch);
+    for (auto &watch: approachWatches)
+        check(watch);
+
+    return emitted;
+}
@@ -0,0 +1,174 @@
+#include "heightField.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "profiler.h"
+
+namespace {
+    constexpr double Pi = 3.14159265358979323846;
+
+    std::uint32_t hash(std::int64_t x, std::int64_t y, std::int64_t z, std::uint32_t seed) {
+        std::uint64_t h = static_cast<std::uint64_t>(x) * 0x9E3779B97F4A7C15ull ^
+                          static_cast<std::uint64_t>(y) * 0xC2B2AE3D27D4EB4Full ^
+                          static_cast<std::uint64_t>(z) * 0x165667B19E3779F9ull ^ seed;
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        return static_cast<std::uint32_t>(h);
+    }
+
+    // In [-1, 1] at every lattice point
+    double lattice(std::int64_t x, std::int64_t y, std::int64_t z, std::uint32_t seed) {
+        return hash(x, y, z, seed) * (2.0 / 4294967295.0) - 1.0;
+    }
+
+    double fade(double t) {
+        return t * t * t * (t * (t * 6.0 - 15.0) + 10.0);
+    }
+
+    // Value noise with quintic interpolation, so the surface normals are continuous too
+    double valueNoise(const glm::dvec3 &p, std::uint32_t seed) {
+        const double fx = std::floor(p.x), fy = std::floor(p.y), fz = std::floor(p.z);
+        const auto x = static_cast<std::int64_t>(fx), y = static_cast<std::int64_t>(fy), z = static_cast<std::int64_t>(fz);
+        const double u = fade(p.x - fx), v = fade(p.y - fy), w = fade(p.z - fz);
+
+        auto lerp = [](double a, double b, double t) { return a + (b - a) * t; };
+        const double x00 = lerp(lattice(x, y, z, seed), lattice(x + 1, y, z, seed), u);
+        const double x10 = lerp(lattice(x, y + 1, z, seed), lattice(x + 1, y + 1, z, seed), u);
+        const double x01 = lerp(lattice(x, y, z + 1, seed), lattice(x + 1, y, z + 1, seed), u);
+        const double x11 = lerp(lattice(x, y + 1, z + 1, seed), lattice(x + 1, y + 1, z + 1, seed), u);
+        return lerp(lerp(x00, x10, v), lerp(x01, x11, v), w);
+    }
+
+    std::int64_t tileKey(int row, int column) {
+        return static_cast<std::int64_t>(row) << 32 | static_cast<std::uint32_t>(column);
+    }
+}
+
+HeightField::HeightField(double radius, const TerrainSettings &settings)
+    : radius(radius), settings(settings) {
+    useTiles = !settings.tileDirectory.empty() && settings.tileRows > 0 && settings.tileColumns > 0 &&
+               settings.tileSize > 1;
+    if (!settings.tileDirectory.empty() && !useTiles)
+        std::cerr << "[HeightField] Tile grid for " << settings.tileDirectory << " is incomplete, using noise" << std::endl;
+}
+
+double HeightField::maxHeight() const {
+    // Tiles are int16 metres
+    return useTiles ? 32.768 : settings.maxHeight;
+}
+
+double HeightField::height(const glm::dvec3 &direction) const {
+    return useTiles ? tiled(direction) : procedural(direction);
+}
+
+double HeightField::procedural(const glm::dvec3 &direction) const {
+    glm::dvec3 p = direction * (radius / settings.featureSize);
+    double amplitude = 1.0, total = 0.0, sum = 0.0;
+
+    for (int octave = 0; octave < settings.octaves; ++octave) {
+        sum += valueNoise(p, settings.seed + octave * 101u) * amplitude;
+        total += amplitude;
+        amplitude *= 0.5;
+        p *= 2.0;
+    }
+    return settings.maxHeight * sum / total;
+}
+
+double HeightField::tiled(const glm::dvec3 &direction) const {
+    const double latitude = std::asin(std::clamp(direction.y, -1.0, 1.0));
+    const double longitude = std::atan2(direction.x, direction.z);
+
+    // Global texel coordinates, texel centres at integers
+    const double width = static_cast<double>(settings.tileColumns) * settings.tileSize;
+    const double height = static_cast<double>(settings.tileRows) * settings.tileSize;
+    const double x = (longitude + Pi) / (2.0 * Pi) * width - 0.5;
+    const double y = (0.5 * Pi - latitude) / Pi * height - 0.5;
+
+    const double fx = std::floor(x), fy = std::floor(y);
+    const auto x0 = static_cast<long long>(fx), y0 = static_cast<long long>(fy);
+    const double tx = x - fx, ty = y - fy;
+
+    // Texel by texel, so bilinear filtering carries on across tile edges
+    const double top = tileSample(x0, y0) * (1.0 - tx) + tileSample(x0 + 1, y0) * tx;
+    const double bottom = tileSample(x0, y0 + 1) * (1.0 - tx) + tileSample(x0 + 1, y0 + 1) * tx;
+    return (top * (1.0 - ty) + bottom * ty) * 0.001;
+}
+
+double HeightField::tileSample(long long x, long long y) const {
+    const long long width = static_cast<long long>(settings.tileColumns) * settings.tileSize;
+    const long long height = static_cast<long long>(settings.tileRows) * settings.tileSize;
+    x = ((x % width) + width) % width; // longitude wraps
+    y = std::clamp(y, 0ll, height - 1);
+
+    const int row = static_cast<int>(y / settings.tileSize);
+    const int column = static_cast<int>(x / settings.tileSize);
+
+    // Neighbouring samples almost always come from the same tile, so skip the cache lock for it
+    thread_local std::uint64_t lastField = 0;
+    thread_local std::shared_ptr<const Tile> lastTile;
+    if (lastField != id || !lastTile || lastTile->row != row || lastTile->column != column) {
+        lastTile = tile(row, column);
+        lastField = id;
+    }
+
+    if (lastTile->heights.empty()) return 0.0;
+    return lastTile->heights[(y % settings.tileSize) * settings.tileSize + x % settings.tileSize];
+}
+
+std::shared_ptr<const HeightField::Tile> HeightField::tile(int row, int column) const {
+    const std::int64_t key = tileKey(row, column);
+    {
+        std::lock_guard lock(cacheMutex);
+        if (auto found = cache.find(key); found != cache.end()) {
+            recent.splice(recent.begin(), recent, found->second);
+            return *found->second;
+        }
+    }
+
+    // Read outside the lock; if two threads race for the same tile the second copy is simply dropped
+    std::shared_ptr<const Tile> loaded = load(row, column);
+
+    std::lock_guard lock(cacheMutex);
+    if (auto found = cache.find(key); found != cache.end()) return *found->second;
+
+    recent.push_front(loaded);
+    cache[key] = recent.begin();
+    cachedBytes += loaded->heights.size() * sizeof(std::int16_t);
+
+    while (cachedBytes > settings.tileCacheBytes && recent.size() > 1) {
+        const std::shared_ptr<const Tile> &oldest = recent.back();
+        cachedBytes -= oldest->heights.size() * sizeof(std::int16_t);
+        cache.erase(tileKey(oldest->row, oldest->column));
+        recent.pop_back();
+    }
+    return loaded;
+}
+
+std::shared_ptr<const HeightField::Tile> HeightField::load(int row, int column) const {
+    PROFILE_SCOPE("HeightField::LoadTile");
+
+    auto tile = std::make_shared<Tile>();
+    tile->row = row;
+    tile->column = column;
+
+    const std::string path = settings.tileDirectory + "/" + std::to_string(row) + "_" + std::to_string(column) + ".r16";
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return tile; // missing tiles are sea level
+
+    const std::size_t count = static_cast<std::size_t>(settings.tileSize) * settings.tileSize;
+    std::vector<unsigned char> bytes(count * 2);
+    if (!file.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+        std::cerr << "[HeightField] " << path << " is shorter than " << settings.tileSize << "x"
+                  << settings.tileSize << " samples" << std::endl;
+        return tile;
+    }
+
+    tile->heights.resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+        tile->heights[i] = static_cast<std::int16_t>(bytes[i * 2] | bytes[i * 2 + 1] << 8);
+    return tile;
+}
@@ -1,61 +1,149 @@
 #ifndef ATMOSPHERE_H
 #define ATMOSPHERE_H
 
-#include "camera.h"
+#include <future>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
 #include "shader.h"
 
 struct AtmosphereSettings {
     float atmosphereRadius;
     float planetRadius;
-    int numInScatteringPoints = 10;
-    int numOpticalDepthPoints = 10;
+    int numInScatteringPoints = 10;  // samples along each view ray, per pixel
+    int numOpticalDepthPoints = 40;  // samples along each ray when baking the lookup tables
     float densityFalloff = 0.0f;
+    float scaleHeight = 10.0f;       // height over which the density falls by 1/e
     glm::vec3 wavelengths = { 700, 530, 440 };
     float scatteringStrength = 1;
+
+    int resolutionDivisor = 2;  // 1 marches every pixel; 2 or 4 march a half or quarter resolution target
+    float historyWeight = 0.9f; // share of the reprojected history kept each frame when reduced, 0 disables it
+
+    // Rayleigh-style 1/λ⁴ scattering per unit density
+    [[nodiscard]] glm::vec3 scatteringCoefficients() const;
+
+    // True if the lookup tables baked for `other` are valid for these settings too
+    [[nodiscard]] bool sameTables(const AtmosphereSettings &other) const;
 };
 
+/*  Lookup tables for one set of AtmosphereSettings, baked on the thread
+ *  pool whenever the settings change and uploaded once finished:
+ *
+ *  - transmittance: optical depth from a point at radius r to the top of
+ *    the atmosphere along a direction at cos(zenith) μ, for every ray that
+ *    misses the planet (rays that hit it are simply in shadow). Uses the
+ *    horizon-aware mapping of Bruneton & Neyret, so the texels are spent
+ *    where the optical depth changes fastest.
+ *  - multiple scattering: light scattered more than once arriving at radius
+ *    r with the sun at cos(zenith) μs, using Hillaire's isotropic
+ *    approximation - second order scattering over the whole sphere of
+ *    directions, summed as a geometric series of higher orders.
+ *
+ *  With both tables the fragment shader only marches the view ray, with
+ *  two texture lookups per step instead of a secondary march to the sun.
+ */
+class AtmosphereLuts {
+public:
+    static constexpr int TransmittanceWidth = 256;  // μ
+    static constexpr int TransmittanceHeight = 64;  // r
+    static constexpr int ScatteringWidth = 32;      // μs
+    static constexpr int ScatteringHeight = 32;     // r
+    static constexpr int ScatteringDirections = 64;
+
+    // Starts a bake if the tables don't match `settings`, and uploads a finished one; main thread only
+    void update(const AtmosphereSettings &settings);
+    // Tables for the current settings are on the GPU; stale ones stay in use while a rebake runs
+    [[nodiscard]] bool ready() const { return transmittance != 0; }
+
+    [[nodiscard]] GLuint transmittanceTexture() const { return transmittance; }
+    [[nodiscard]] GLuint multipleScatteringTexture() const { return multipleScattering; }
+
+    void release();
+
+private:
+    struct Tables {
+        std::vector<float> opticalDepth;           // TransmittanceWidth * TransmittanceHeight
+        std::vector<glm::vec3> multipleScattering; // ScatteringWidth * ScatteringHeight
+    };
+
+    static std::shared_ptr<Tables> bake(const AtmosphereSettings &settings);
+    void upload(const Tables &tables);
+
+    GLuint transmittance = 0;
+    GLuint multipleScattering = 0;
+
+    bool hasSettings = false;
+    AtmosphereSettings requested{};  // what's baked, or being baked
+    std::future<void> pending;
+    std::shared_ptr<std::shared_ptr<Tables>> pendingResult;
+};
+
+/*  Draws one planet's atmosphere over SceneTarget's resolved scene.
+ *
+ *  At full resolution every pixel marches its own view ray. With a
+ *  resolutionDivisor of 2 or 4 the march runs on a reduced target instead,
+ *  a quarter or a sixteenth of the rays, and a joint bilateral filter
+ *  guided by the full resolution depth brings it back up, so the limb
+ *  stays as sharp as the scene behind it. The reduced march also starts
+ *  each frame at a different offset within its steps and blends with the
+ *  previous frames, reprojected through last frame's camera, which hides
+ *  the banding of so few samples per ray.
+ */
 class Atmosphere {
 public:
-    static void Initialise(Shader* shader) {
+    static void Initialise(Shader* shader, Shader* reducedShader, Shader* upsampleShader) {
         sShader = shader;
+        sReducedShader = reducedShader;
+        sUpsampleShader = upsampleShader;
     }
 
     Atmosphere() {
         glGenVertexArrays(1, &sVAO);
     }
 
-    void render(AtmosphereSettings settings, Camera *camera, glm::vec3 atmospherePosition, glm::vec3 sunPosition) {
-        sShader->bind();
-        sShader->setMat4("inv_proj", camera->getInvProjectionMatrix());
-        sShader->setMat4("inv_view", camera->getInvViewMatrix());
-        sShader->setVec3("cameraPos", camera->Position);
-        sShader->setInt("MainTex", 0);
-        sShader->setInt("DepthTex", 1);
-
-        sShader->setVec3("sunPosition", sunPosition);
-
-        sShader->setVec3("atmospherePosition", atmospherePosition);
-
-        sShader->setFloat("atmosphereRadius", settings.atmosphereRadius);
-        sShader->setFloat("planetRadius", settings.planetRadius);
-        sShader->setInt("numInScatteringPoints", settings.numInScatteringPoints);
-        sShader->setInt("numOpticalDepthPoints", settings.numOpticalDepthPoints);
-        sShader->setFloat("densityFalloff", settings.densityFalloff);
-
-        float scatterR = pow(400 / settings.wavelengths.r, 4) * settings.scatteringStrength;
-        float scatterG = pow(400 / settings.wavelengths.g, 4) * settings.scatteringStrength;
-        float scatterB = pow(400 / settings.wavelengths.b, 4) * settings.scatteringStrength;
-        sShader->setVec3("scatteringCoefficients", glm::vec3(scatterR, scatterG, scatterB));
-
-        glDisable(GL_CULL_FACE);
-        glBindVertexArray(sVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
-        glEnable(GL_CULL_FACE);
-    }
+    /*  Composites the resolved scene with the atmosphere into
+     *  SceneTarget's composite framebuffer, at the render size, which is
+     *  left bound for Present. Positions are camera-relative.
+     *  Returns false without drawing until the lookup tables for `settings`
+     *  have been baked at least once.
+     */
+    bool render(const AtmosphereSettings &settings, glm::vec3 atmospherePosition, glm::vec3 sunPosition);
+
+    // GL objects must go before the context does
+    void release();
+
 private:
+    void setUniforms(const Shader &shader, const AtmosphereSettings &settings, glm::vec3 atmospherePosition,
+                     glm::vec3 sunPosition) const;
+    void renderReduced(const AtmosphereSettings &settings, glm::vec3 atmospherePosition, glm::vec3 sunPosition);
+
+    // Creates, resizes or releases the reduced targets to suit `divisor`. Binds behind GlState's back,
+    // so it runs before a pass binds anything.
+    void updateTargets(int divisor);
+    void createTargets(glm::ivec2 size);
+    void releaseTargets();
+
     static inline Shader* sShader = nullptr;
+    static inline Shader* sReducedShader = nullptr;
+    static inline Shader* sUpsampleShader = nullptr;
     GLuint sVAO    = 0;
+    AtmosphereLuts luts;
+
+    // Reduced resolution targets, ping-ponged so each frame reads the other's output as its history
+    GLuint reducedFbo[2] = {};
+    GLuint scatteringTexture[2] = {};    // rgb in-scattered light, a = distance through the atmosphere
+    GLuint transmittanceTexture[2] = {}; // rgb
+    glm::ivec2 reducedSize{0};
+    int reducedDivisor = 0;
+    int current = 0;
+
+    bool historyValid = false;
+    glm::vec3 previousPosition{0.0f}; // atmospherePosition last frame
+    int frameIndex = 0;
 };
 
 #endif //ATMOSPHERE_H
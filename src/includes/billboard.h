@@ -1,47 +1,44 @@
 #ifndef BILLBOARD_H
 #define BILLBOARD_H
 
+#include <vector>
 #include <glm/glm.hpp>
+
+#include "bodyInstance.h"
+#include "material.h"
+#include "renderQueue.h"
 #include "shader.h"
 
-/*  A light‑weight, RAII billboard that always faces the camera.
- *  Geometry and shader are shared by every instance; only
- *  position and radius are per‑object.
+/*  Camera-facing quads. The only user left is the sphere impostor
+ *  tier, which draws the one shared quad per recorded body.
  */
 class Billboard
 {
 public:
     // call once at start‑up (after an OpenGL context exists)
-    static void InitialiseShared(const char* vertPath,
-                                 const char* fragPath);
+    static void InitialiseShared();
 
     // optional tidy‑up, e.g. before glfwTerminate()
     static void ShutdownShared();
 
-    // create an individual billboard
-    Billboard(const glm::vec3& worldPos, float radius = 1.0f);
-    ~Billboard() = default;                                    // nothing to free
-
-    // draw this billboard
-    void draw(const glm::mat4& view,
-              const glm::mat4& proj,
-              const glm::vec3& cameraPos,
-              const glm::vec3& lightPosWS   = glm::vec3(0),
-              const glm::vec3& lightColour  = glm::vec3(1)) const;
-
-    // helpers
-    void setPosition(const glm::vec3& p) { mPosWS = p; }
-    void setRadius  (float r)            { mRadius = r; }
+    /* Impostor path for mid-distance bodies: the shared quad is drawn once per
+     * recorded body, each one ray-tracing its sphere in the fragment shader.
+     * Impostors write depth, so they sort with the opaque meshes. Needs
+     * InitialiseShared first. */
+    static void InitialiseImpostors(const char* vertPath,
+                                    const char* fragPath);
+    static void RecordImpostor(RenderRecorder& recorder, const glm::vec3& position, float radius,
+                               const Material& material, float depth, glm::uvec2 occluders = glm::uvec2(0),
+                               const glm::vec3& motion = glm::vec3(0.0f));
 
 private:
-    glm::vec3 mPosWS;
-    float     mRadius;
-
     /* ---- shared GPU state (one copy for all billboards) ---- */
-    static inline Shader*   sShader = nullptr;
     static inline GLuint    sVAO    = 0;
     static inline GLuint    sVBO    = 0;
     static inline GLuint    sEBO    = 0;
+
+    static inline Shader*         sImpostorShader = nullptr;
+    static inline const DrawCall* sImpostorCall   = nullptr;
 };
 
 #endif //BILLBOARD_H
@@ -0,0 +1,41 @@
+#ifndef BLOCKCOMPRESSION_H
+#define BLOCKCOMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/*  CPU-side texture preparation for the texture cache, run on worker
+ *  threads: box-filtered mip chains and BC7 compression, so textures reach
+ *  the GPU at a quarter of their RGBA8 size with nothing left to decode.
+ *
+ *  The encoder only uses BC7 mode 6 - one RGBA line per 4x4 block with 16
+ *  steps along it, endpoints fitted to the block's principal axis and then
+ *  refined by least squares. A full mode search does better on sharp
+ *  edges, but this is fast enough to run on a first load and suits smooth
+ *  planet maps.
+ */
+class BlockCompression {
+public:
+    static constexpr std::size_t BlockBytes = 16; // per 4x4 block
+
+    struct MipLevel {
+        glm::ivec2 size;
+        std::vector<std::uint8_t> rgba; // tightly packed RGBA8
+    };
+
+    // Level 0 is a copy of `rgba`; each further level halves down to 1x1
+    static std::vector<MipLevel> BuildMipChain(const std::uint8_t *rgba, glm::ivec2 size);
+
+    static std::size_t CompressedSize(glm::ivec2 size);
+
+    // Blocks in row-major order, edge blocks padded by repeating the last row and column
+    static std::vector<std::uint8_t> CompressBc7(const MipLevel &level);
+
+    // `texels` is one 4x4 block of RGBA8, row by row
+    static void EncodeBc7Block(const std::uint8_t texels[64], std::uint8_t out[BlockBytes]);
+};
+
+#endif //BLOCKCOMPRESSION_H
@@ -0,0 +1,28 @@
+#ifndef BODYINSTANCE_H
+#define BODYINSTANCE_H
+
+#include <glm/glm.hpp>
+
+#include "material.h"
+
+// Per-body data shared by every LOD tier, laid out to match the std430 buffer in body-instance.glsl
+struct BodyInstance {
+    glm::vec4 positionRadius; // centre and radius in SU
+    glm::vec4 diffuse;        // rgb diffuse, a = 1 when emissive
+    glm::vec4 emission;       // rgb colour, a = intensity
+    glm::uvec4 shadow{0};     // x = first occluder, y = occluder count (see Shadows), zw unused
+    glm::vec4 motion{0.0f};   // xyz = last frame's camera-relative centre minus this frame's, SU
+
+    BodyInstance() = default;
+    BodyInstance(const glm::vec3 &position, float radius, const Material &material,
+                 glm::uvec2 occluders = glm::uvec2(0), const glm::vec3 &motion = glm::vec3(0.0f))
+        : positionRadius(position, radius),
+          diffuse(material.diffuse, material.emissive ? 1.0f : 0.0f),
+          emission(material.emission),
+          shadow(occluders.x, occluders.y, 0u, 0u),
+          motion(motion, 0.0f) { }
+};
+
+static_assert(sizeof(BodyInstance) == 80, "BodyInstance must match the std430 layout");
+
+#endif //BODYINSTANCE_H
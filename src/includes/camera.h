@@ -1,6 +1,8 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include <cmath>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -17,7 +19,10 @@ public:
         updateProjection();
     }
 
-    glm::vec3 Position;
+    static constexpr float FieldOfView = 65.0f; // vertical, degrees
+    static constexpr float NearPlane = 1e-4f;   // 10 m, low enough to stand on terrain; there is no far plane, see updateProjection
+
+    glm::dvec3 Position; // SU, relative to the focus body; never sent to the GPU, see update
     float Yaw, Pitch;
 
     glm::vec3 Front;
@@ -30,27 +35,55 @@ public:
         updateProjection();
     }
 
+    // Offsets the projection by a fraction of a pixel, in NDC, from the next update on; TemporalAa
+    // varies it every frame so successive frames sample different points inside each pixel
+    void setJitter(const glm::vec2 &ndcOffset) { jitter = ndcOffset; }
+    [[nodiscard]] glm::vec2 getJitter() const { return appliedJitter; }
+    [[nodiscard]] glm::vec2 previousJitter() const { return previous_jitter; }
+
     [[nodiscard]] glm::mat4 worldToClip() const { return matrix_projectionView; }
+    // worldToClip as of the previous update, for reprojecting last frame's images
+    [[nodiscard]] glm::mat4 previousWorldToClip() const { return previous_projectionView; }
 
-    [[nodiscard]] glm::mat4 getProjectionMatrix() const { return projection; }
-    [[nodiscard]] glm::mat4 getProjectionNearMatrix() const { return projectionNear; }
+    [[nodiscard]] glm::mat4 getProjectionMatrix() const { return jitteredProjection; }
     [[nodiscard]] glm::mat4 getViewMatrix() const { return view; }
+    // Unjittered: view rays a fraction of a pixel out are of no consequence
     [[nodiscard]] glm::mat4 getInvProjectionMatrix() const { return inv_projection; }
-    [[nodiscard]] glm::mat4 getInvProjectionNearMatrix() const { return inv_projectionNear; }
     [[nodiscard]] glm::mat4 getInvViewMatrix() const { return inv_view; }
 
+    // World-space direction of the view ray through a point on screen, given in NDC
+    [[nodiscard]] glm::vec3 screenRay(const glm::vec2 &ndc) const {
+        const glm::vec4 nearPoint = inv_projection * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+        return glm::normalize(glm::vec3(inv_view * glm::vec4(glm::vec3(nearPoint) / nearPoint.w, 0.0f)));
+    }
+
+    // Rendering uses a floating origin at the camera: the view matrix only rotates, and everything
+    // drawn is positioned relative to Position in double before being narrowed to float
     void update()
     {
+        previous_projectionView = matrix_projectionView;
+        previous_jitter = appliedJitter;
         updateVectors();
 
-        view = glm::lookAt(Position, Position + Front, Up);
+        view = glm::lookAt(glm::vec3(0.0f), Front, Up);
         inv_view = glm::inverse(view);
-        
-        matrix_projectionView = projection * view;
+
+        // clip.w is -z, so a z term in x and y shifts the whole image by a constant in NDC
+        jitteredProjection = projection;
+        jitteredProjection[2][0] = -jitter.x;
+        jitteredProjection[2][1] = -jitter.y;
+        appliedJitter = jitter;
+
+        matrix_projectionView = jitteredProjection * view;
+        if (!updated) {
+            previous_projectionView = matrix_projectionView;
+            previous_jitter = appliedJitter;
+        }
+        updated = true;
     }
 
-    void move(const glm::vec3& offset) { Position += offset; }
-    void setPosition(const glm::vec3& pos) { Position = pos; }
+    void move(const glm::vec3& offset) { Position += glm::dvec3(offset); }
+    void setPosition(const glm::dvec3& pos) { Position = pos; }
 
     void rotate(const float yaw, const float pitch) {
         Yaw += yaw;
@@ -61,25 +94,47 @@ public:
     
 private:
     glm::mat4 projection;
-    glm::mat4 projectionNear;
+    glm::mat4 jitteredProjection;
     glm::mat4 view;
 
     glm::mat4 inv_projection;
-    glm::mat4 inv_projectionNear;
     glm::mat4 inv_view;
 
     glm::mat4 matrix_projectionView;
-    
+    glm::mat4 previous_projectionView;
+    bool updated = false;
+
+    glm::vec2 jitter{0.0f};
+    glm::vec2 appliedJitter{0.0f};
+    glm::vec2 previous_jitter{0.0f};
+
     glm::vec3 WorldUp;
 
     float aspect;
 
+    /*  Reversed-Z with an infinite far plane, for glClipControl's zero-to-one
+     *  depth range: depth = near / distance, 1 at the near plane falling
+     *  towards 0 at infinity. Paired with a float depth buffer the relative
+     *  precision is about the same at every distance, so one projection
+     *  covers a cockpit-sized grid and the far side of the solar system.
+     */
     void updateProjection()
     {
-        projection = glm::perspective(glm::radians(65.0f), aspect, 1.0f, 150000000.0f);
-        projectionNear = glm::perspective(glm::radians(65.0f), aspect, 0.5f, 5000.0f);
-        inv_projection = glm::inverse(projection);
-        inv_projectionNear = glm::inverse(projectionNear);
+        const float f = 1.0f / std::tan(glm::radians(FieldOfView) * 0.5f);
+
+        projection = glm::mat4(0.0f);
+        projection[0][0] = f / aspect;
+        projection[1][1] = f;
+        projection[2][3] = -1.0f;
+        projection[3][2] = NearPlane;
+        jitteredProjection = projection;
+
+        // Written out rather than glm::inverse, which loses the near plane to rounding
+        inv_projection = glm::mat4(0.0f);
+        inv_projection[0][0] = aspect / f;
+        inv_projection[1][1] = 1.0f / f;
+        inv_projection[2][3] = 1.0f / NearPlane;
+        inv_projection[3][2] = -1.0f;
     }
 
     void updateVectors()
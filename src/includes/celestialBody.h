@@ -1,12 +1,18 @@
 #ifndef CELESTIALBODY_H
 #define CELESTIALBODY_H
 
+#include <atomic>
 #include <bits/unique_ptr.h>
 #include <glm/glm.hpp>
 #include <utility>
 
+#include "billboard.h"
+#include "lod.h"
 #include "octahedron.h"
 #include "maths.h"
+#include "pointSprites.h"
+#include "renderQueue.h"
+#include "terrain.h"
 
 struct CelestialBody {
     std::string name;
@@ -19,10 +25,17 @@ struct CelestialBody {
     glm::dvec3 velocity;
 
     const unsigned int instanceId;
-    static unsigned int nextId;
+    static std::atomic<unsigned int> nextId; // shared with Physics::SpawnBody, which may run on any thread
+
+    bool simulated = false; // set once the physics thread has picked the body up
+
+    LodSelection lod; // last tier drawn with, kept for hysteresis
+
+    // Camera-relative centre as of last frame, SU, for motion vectors; w = 0 until there is one
+    glm::vec4 lastCentre{0.0f};
 
     Material material;
-    std::unique_ptr<Octahedron> gfx;
+    std::unique_ptr<Terrain> terrain; // near-field surface, for bodies that have one
 
     CelestialBody(std::string name, double mass, double radius, glm::dvec3 position,
                   glm::dvec3 velocity, Material material)
@@ -32,8 +45,7 @@ struct CelestialBody {
           surfaceGravity(deriveSurfaceGravity(mass, radius)),
           position(position),
           velocity(velocity),
-          instanceId(nextId++),
-          gfx(std::make_unique<Octahedron>(position, kmToSu(radius))) {
+          instanceId(nextId++) {
         this->material = material;
     }
 
@@ -46,14 +58,35 @@ struct CelestialBody {
 
     ~CelestialBody() = default;
 
-    void draw(const glm::mat4 &worldToClip,
-              const glm::vec3 &cameraPos,
-              const glm::vec3 &lightPosWS,
-              const glm::vec3 &lightColour,
-              const glm::dvec3 &relativePosition) {
-        glm::vec3 posSU    = glm::vec3((position - relativePosition) / SU_IN_KM);
-        gfx->setPosition(posSU);
-        gfx->draw(worldToClip, cameraPos, material, lightPosWS, lightColour);
+    // `cameraRelative` is the centre relative to the camera in SU, worked out in double by the caller.
+    // Picks a LOD tier from the projected size and records the body with that tier's draw call.
+    // Safe to call for different bodies on different threads, each with its own recorder.
+    // `occluders` is the body's range from Shadows::Range; point sprites are never shadowed.
+    // `motion` is last frame's camera-relative centre minus this frame's, for TAA's motion vectors.
+    void queueDraw(RenderRecorder &recorder, const glm::vec3 &cameraRelative, float pixelScale,
+                   glm::uvec2 occluders = glm::uvec2(0), const glm::vec3 &motion = glm::vec3(0.0f)) {
+        float radiusSU = static_cast<float>(kmToSu(radius));
+
+        float distance = glm::length(cameraRelative);
+        float projectedRadius = Lod::ProjectedRadius(radiusSU, distance, pixelScale);
+        lod = Lod::Select(lod, projectedRadius, Octahedron::LevelThresholds());
+
+        switch (lod.tier) {
+            case LodTier::Mesh:
+                // Up close the terrain takes over from the finest sphere, once it has something to show
+                if (terrain && lod.meshLevel == 0 && terrain->ready())
+                    terrain->record(recorder, distance, occluders, motion);
+                else
+                    Octahedron::Record(recorder, cameraRelative, radiusSU, material, lod.meshLevel, distance,
+                                       occluders, motion);
+                break;
+            case LodTier::Impostor:
+                Billboard::RecordImpostor(recorder, cameraRelative, radiusSU, material, distance, occluders, motion);
+                break;
+            case LodTier::Point:
+                PointSprites::Record(recorder, cameraRelative, radiusSU, material, distance);
+                break;
+        }
     }
 };
 
@@ -0,0 +1,135 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/*  Decides which bodies can be seen before any of them are queued for
+ *  drawing. Bodies are kept in a bounding-sphere hierarchy over their
+ *  camera-relative positions: leaves of LeafSize bodies in Morton order,
+ *  with a complete binary tree above them. The order is only re-sorted when
+ *  the body count changes or every RebuildInterval frames; every other
+ *  frame just refits the spheres, which is a single linear pass.
+ *
+ *  Nodes are rejected against the view frustum and against the largest
+ *  bodies in view used as analytic sphere occluders - a sphere is hidden if
+ *  it sits entirely inside an occluder's silhouette cone and beyond it.
+ *  Leaves test all of their bodies at once in structure-of-arrays form, and
+ *  large scenes split the traversal across the thread pool.
+ */
+class Culling {
+public:
+    static constexpr std::size_t LeafSize = 8;
+    static constexpr std::size_t MaxOccluders = 8;
+    static constexpr float MinOccluderSine = 0.01f;       // occluders must subtend at least ~0.6 degrees
+    static constexpr unsigned int RebuildInterval = 120;  // frames between Morton re-sorts
+    static constexpr std::size_t ParallelThreshold = 16384; // bodies
+
+    struct Stats {
+        std::size_t bodies = 0;
+        std::size_t visible = 0;
+        std::size_t frustumCulled = 0;
+        std::size_t occluded = 0;
+        std::size_t occluders = 0;
+    };
+
+    // `centres` are relative to the camera, `radii` in the same units. Returns the indices of every
+    // body that may be visible; valid until the next call.
+    static const std::vector<std::uint32_t> &Cull(const std::vector<glm::vec3> &centres,
+                                                  const std::vector<float> &radii,
+                                                  const glm::mat4 &worldToClip,
+                                                  const glm::vec3 &cameraPos);
+
+    static Stats LastStats() { return stats; }
+
+    // Appends every body whose bounding sphere `overlaps(centre, radius)` accepts, walking the hierarchy the
+    // last Cull refitted - so only for that call's centres and radii. `overlaps` is asked about whole subtrees
+    // too and must accept a subtree's sphere whenever it would accept any body inside. Safe to call from
+    // several threads at once.
+    template<typename Overlaps>
+    static void Query(const Overlaps &overlaps, std::vector<std::uint32_t> &found);
+
+private:
+    struct Node {
+        glm::vec3 centre;
+        float radius;        // negative for an empty node
+        std::uint32_t count; // bodies underneath
+    };
+
+    struct Occluder {
+        glm::vec3 direction; // unit, from the camera
+        float distance;
+        float sine;          // sin and cos of the angular radius
+        float cosine;
+    };
+
+    struct Counters {
+        std::size_t frustumCulled = 0;
+        std::size_t occluded = 0;
+    };
+
+    static void rebuildOrder(const std::vector<glm::vec3> &centres);
+    static void refit(const std::vector<glm::vec3> &centres, const std::vector<float> &radii);
+    static void refitLeaves(const std::vector<glm::vec3> &centres, const std::vector<float> &radii,
+                            std::size_t begin, std::size_t end);
+    static void selectOccluders(const std::vector<glm::vec3> &centres, const std::vector<float> &radii);
+
+    static void traverse(std::size_t root, std::vector<std::uint32_t> &visible, Counters &counters);
+    static void testLeaf(std::size_t leaf, unsigned int planeMask, std::vector<std::uint32_t> &visible,
+                         Counters &counters);
+
+    static constexpr unsigned int PlaneCount = 5;
+    static inline std::array<glm::vec4, PlaneCount> planes{}; // camera-relative, xyz normal pointing inwards
+    static inline std::vector<Occluder> occluders;
+
+    static inline std::vector<std::uint32_t> order; // body indices in Morton order
+    static inline std::vector<std::uint32_t> mortonKeys;
+    static inline std::vector<std::uint32_t> keyScratch;
+    static inline std::vector<std::uint32_t> orderScratch;
+    static inline std::size_t builtCount = 0;
+    static inline unsigned int framesSinceBuild = 0;
+
+    // Leaves store their bodies as structure of arrays so one leaf is one batch of LeafSize tests
+    static inline std::size_t leafCount = 0;
+    static inline std::size_t firstLeaf = 0; // heap index of the first leaf node
+    static inline std::vector<Node> nodes;   // heap order, root at 1
+    static inline std::vector<float> leafX, leafY, leafZ, leafR;
+    static inline std::vector<std::uint32_t> leafBody;
+
+    static inline std::vector<std::uint32_t> visibleBodies;
+    static inline std::vector<std::vector<std::uint32_t>> subtreeVisible;
+    static inline std::vector<Counters> subtreeCounters;
+    static Stats stats;
+};
+
+template<typename Overlaps>
+void Culling::Query(const Overlaps &overlaps, std::vector<std::uint32_t> &found) {
+    if (builtCount == 0) return;
+
+    std::size_t stack[64];
+    int top = 0;
+    stack[top++] = 1;
+
+    while (top > 0) {
+        const std::size_t index = stack[--top];
+        const Node &node = nodes[index];
+        if (node.radius < 0.0f || !overlaps(node.centre, node.radius)) continue;
+
+        if (index >= firstLeaf) {
+            const std::size_t base = (index - firstLeaf) * LeafSize;
+            for (std::size_t k = base; k < base + LeafSize; ++k) {
+                if (leafR[k] >= 0.0f && overlaps(glm::vec3(leafX[k], leafY[k], leafZ[k]), leafR[k]))
+                    found.push_back(leafBody[k]);
+            }
+        } else {
+            stack[top++] = index * 2 + 1;
+            stack[top++] = index * 2;
+        }
+    }
+}
+
+#endif //CULLING_H
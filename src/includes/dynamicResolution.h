@@ -0,0 +1,97 @@
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+struct DynamicResolutionSettings {
+    double targetFrameMs = 1000.0 / 60.0;
+
+    // Fractions of the target: quality drops once the GPU stays above the first and comes back only once it
+    // has stayed below the second for much longer, so the two never chase each other
+    double lowerAbove = 0.92;
+    double raiseBelow = 0.72;
+    int lowerAfterFrames = 6;
+    int raiseAfterFrames = 90;
+    int cooldownFrames = 30; // after a change, long enough for its frames to reach the timer readback
+
+    float scaleStep = 0.05f;
+    int maxSamples = 8;
+};
+
+/*  Holds the frame rate at a target by trading image quality for GPU
+ *  time. Each frame's GPU time is measured with timestamp queries, read
+ *  back a few frames later without stalling, and smoothed; the render
+ *  thread's own CPU time for the frame is measured alongside. When the GPU
+ *  is the one over budget, the controller steps down a quality ladder:
+ *
+ *      8x MSAA -> 4x MSAA -> render scale 1.0 ... MinScale -> 2x -> none
+ *
+ *  and climbs back up it, one rung at a time, once there is clear
+ *  headroom. Scale steps down in proportion to the overshoot (pixel cost
+ *  goes with scale squared) but only ever up by scaleStep. If the CPU is
+ *  over budget while the GPU isn't, nothing is lowered - fewer pixels
+ *  wouldn't help. Changes are applied through SceneTarget::SetQuality.
+ */
+class DynamicResolution {
+public:
+    static constexpr std::size_t FramesInFlight = 4;
+    static constexpr int MidSamples = 4;
+
+    struct Stats {
+        double gpuMs = 0.0; // smoothed
+        double cpuMs = 0.0; // smoothed
+        float scale = 1.0f;
+        int samples = 0;
+        bool gpuBound = false;
+        std::uint64_t changes = 0;
+    };
+
+    // Needs the GL context and an initialised SceneTarget; stays off if timer queries are missing
+    static void Initialise(const DynamicResolutionSettings &settings);
+    static void Shutdown();
+
+    static bool IsEnabled() { return enabled; }
+
+    // The top of the MSAA ladder, for when the anti-aliasing mode changes; callers set the samples
+    // themselves through SceneTarget::SetQuality first
+    static void SetMaxSamples(int samples);
+
+    // Bracket everything the render thread does for a frame except waiting on the swap
+    static void BeginFrame();
+    static void EndFrame();
+
+    static Stats LastStats() { return stats; }
+
+private:
+    struct FrameQueries {
+        GLuint begin;
+        GLuint end;
+        bool pending;
+    };
+
+    static void readBack();
+    static void decide(double cpuMs);
+    static void lower();
+    static void raise();
+    static void apply(float scale, int samples);
+
+    static inline bool enabled = false;
+    static inline DynamicResolutionSettings settings{};
+
+    static inline std::array<FrameQueries, FramesInFlight> queries;
+    static inline std::size_t frameIndex = 0;
+    static inline std::chrono::steady_clock::time_point cpuBegin{};
+
+    static inline bool haveGpuTime = false;
+    static inline int overFrames = 0;
+    static inline int underFrames = 0;
+    static inline int cooldown = 0;
+
+    static Stats stats;
+};
+
+#endif //DYNAMICRESOLUTION_H
@@ -0,0 +1,125 @@
+#ifndef EVENTDETECTOR_H
+#define EVENTDETECTOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "spscQueue.h"
+
+enum class EventType : std::uint8_t {
+    Periapsis,
+    Apoapsis,
+    CloseApproach,
+    SoiEntry,
+    SoiExit,
+    EclipseBegin,
+    EclipseEnd
+};
+
+const char *eventTypeName(EventType type);
+
+struct SimulationEvent {
+    EventType type = EventType::Periapsis;
+    double time = 0.0;          // exact simulation time of the event in seconds
+    std::uint32_t bodyA = 0;    // id of the primary / parent / occluder
+    std::uint32_t bodyB = 0;    // id of the secondary / orbiting body / receiver
+    double distance = 0.0;      // separation of A and B in km at the event
+};
+
+/*  Finds events inside the integrator rather than by polling afterwards.
+ *  Every step each candidate's event function g(t) is evaluated at the new
+ *  state; a sign change is refined to an exact time by root-finding on the
+ *  Hermite dense output of the step. Candidates are re-filtered every
+ *  RebuildInterval steps with a spatial hash, so far-apart pairs cost nothing.
+ *
+ *  Bodies are named by id (BodyId); watches on bodies that don't exist
+ *  (yet) simply stay idle. Track* may be called from any thread; events
+ *  are consumed with PollEvent.
+ */
+class EventDetector {
+public:
+    static constexpr unsigned int RebuildInterval = 64;
+
+    // Periapsis and apoapsis of `secondary` around `primary` while they are within maxDistance km
+    static void TrackApsides(std::uint32_t primary, std::uint32_t secondary, double maxDistance);
+    // `body` entering or leaving a sphere of influence of soiRadius km around `parent`
+    static void TrackSphereOfInfluence(std::uint32_t parent, std::uint32_t body, double soiRadius);
+    // `receiver` entering or leaving the penumbra that `occluder` casts away from `light`
+    static void TrackEclipse(std::uint32_t light, std::uint32_t occluder, std::uint32_t receiver,
+                             double lightRadius, double occluderRadius, double receiverRadius,
+                             double maxDistance);
+    // Closest approach of any two bodies passing within radius km of each other (0 disables)
+    static void TrackCloseApproaches(double radius);
+
+    // UI thread: returns false once the queue is empty
+    static bool PollEvent(SimulationEvent &event) { return events.tryPop(event); }
+    static std::uint64_t DroppedEvents() { return droppedEvents.load(std::memory_order_relaxed); }
+
+    // Physics thread only
+    static bool HasWatches() { return hasWatches.load(std::memory_order_relaxed); }
+    // Ids of the physics arrays in order; call whenever bodies are added, removed or reordered
+    static void SetBodyLayout(const std::vector<std::uint32_t> &ids);
+    // Returns true if at least one event was emitted during the step [time, time + dt]
+    static bool ProcessStep(double time, double dt,
+                            const std::vector<glm::dvec3> &previousPositions,
+                            const std::vector<glm::dvec3> &previousVelocities,
+                            const std::vector<glm::dvec3> &positions,
+                            const std::vector<glm::dvec3> &velocities);
+
+private:
+    enum class WatchKind : std::uint8_t { Apsides, SphereOfInfluence, Eclipse, CloseApproach };
+
+    static constexpr std::uint32_t Unresolved = UINT32_MAX;
+
+    struct Watch {
+        WatchKind kind = WatchKind::Apsides;
+        std::uint32_t idA = 0, idB = 0, idLight = 0;
+        std::uint32_t a = Unresolved, b = Unresolved, light = Unresolved; // indices into the physics arrays
+        double radius = 0.0;
+        double lightRadius = 0.0, occluderRadius = 0.0, receiverRadius = 0.0;
+
+        bool active = false;
+        bool hasValue = false;
+        double lastValue = 0.0;
+    };
+
+    // State of the bodies a watch depends on, either at a step boundary or interpolated inside it
+    struct StateView {
+        const std::vector<glm::dvec3> *p0, *v0, *p1, *v1;
+        double dt;
+    };
+
+    static double evaluate(const Watch &watch, const StateView &state, double s);
+    static bool refineAndEmit(const Watch &watch, const StateView &state, double time, double g0, double g1);
+    static void rebuildCandidates(const std::vector<glm::dvec3> &positions, const std::vector<glm::dvec3> &velocities, double dt);
+    static void pushEvent(const SimulationEvent &event);
+    static void resolve(Watch &watch);
+    // With pendingMutex held
+    static void enable();
+
+    static std::mutex pendingMutex;
+    static std::vector<Watch> pendingWatches;
+    static double pendingApproachRadius;
+    static bool pendingChanges;
+    static std::size_t trackedWatches; // apsides, SOI and eclipse watches registered so far
+
+    // Physics-thread state
+    static std::vector<Watch> watches;
+    static std::vector<Watch> approachWatches;
+    static std::vector<std::uint32_t> bodyIds;
+    static std::unordered_map<std::uint32_t, std::uint32_t> bodyIndices;
+    static double approachRadius;
+    static unsigned int stepsSinceRebuild;
+
+    static std::atomic<bool> hasWatches;
+    static std::atomic<bool> restarted; // set when detection resumes after HasWatches was false
+    static std::atomic<std::uint64_t> droppedEvents;
+    static SpscQueue<SimulationEvent, 1024> events;
+};
+
+#endif //EVENTDETECTOR_H
@@ -0,0 +1,83 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "spscQueue.h"
+
+/*  Records rendered frames to disk without stalling the renderer.
+ *  Capture starts an asynchronous glReadPixels into the next of a small
+ *  ring of pixel buffer objects and fences it; readbacks are only mapped
+ *  once their fence has signalled, a frame or two later, so the CPU waits
+ *  only if the whole ring is still in flight. Mapped pixels are copied into
+ *  pooled frames and handed to a writer thread, which does the row flip,
+ *  RGB conversion and file I/O. When the writer falls behind, Capture
+ *  waits for a pooled frame rather than dropping one, so every rendered
+ *  frame ends up in the output.
+ *
+ *  An output path ending in ".rgb" is written as one raw RGB24 stream
+ *  (ffmpeg -f rawvideo -pixel_format rgb24 -video_size WxH; a named pipe
+ *  works too), anything else as a directory of frame-NNNNNN.ppm images.
+ */
+class FrameCapture {
+public:
+    static constexpr int RingSize = 3;             // readbacks in flight on the GPU
+    static constexpr std::size_t PoolSize = 8;     // frames queued for, or being written by, the writer
+
+    static bool Initialise(const std::string &output, glm::ivec2 size);
+    // Collects outstanding readbacks, waits for the writer to empty its queue and closes the output
+    static void Finish();
+
+    static bool IsEnabled() { return enabled; }
+
+    // Main thread, once per frame. Reads colour attachment 0, or the back buffer for framebuffer 0.
+    static void Capture(GLuint framebuffer);
+
+    static std::uint64_t FramesWritten() { return written.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        std::uint64_t index = 0;
+    };
+
+    struct Frame {
+        std::vector<std::uint8_t> pixels; // RGBA, bottom row first, as GL reads them
+        std::uint64_t index = 0;
+    };
+
+    // Copies a finished readback into a pooled frame and queues it; false if `wait` is false and it isn't done
+    static bool collect(Slot &slot, bool wait);
+    static void writerLoop();
+    static bool writeFrame(const Frame &frame, std::vector<std::uint8_t> &rgb);
+
+    static inline bool enabled = false;
+    static inline glm::ivec2 size{0};
+    static inline std::string output;
+    static inline bool rawStream = false;
+    static inline std::FILE *stream = nullptr;
+
+    static Slot slots[RingSize];
+    static inline std::uint64_t issued = 0;    // readbacks started
+    static inline std::uint64_t collected = 0; // readbacks handed to the writer
+
+    static inline std::vector<std::unique_ptr<Frame>> pool;
+    static inline SpscQueue<Frame *, PoolSize> pending;   // main thread -> writer
+    static inline SpscQueue<Frame *, PoolSize> available; // writer -> main thread
+
+    static inline std::thread writer;
+    static inline std::atomic<bool> stopping{false};
+    static inline std::atomic<std::uint64_t> written{0};
+};
+
+#endif //FRAMECAPTURE_H
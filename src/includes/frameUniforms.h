@@ -0,0 +1,43 @@
+#ifndef FRAMEUNIFORMS_H
+#define FRAMEUNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// std140 mirror of the FrameUniforms block in runtime/shaders/frame.glsl - keep the two in sync
+struct FrameUniformData {
+    glm::mat4 worldToClip;
+    glm::mat4 view;
+    glm::mat4 proj;          // reversed-Z, infinite far plane - near plane is proj[3][2]
+    glm::mat4 invView;
+    glm::mat4 invProj;
+    glm::mat4 prevWorldToClip; // last frame's worldToClip, for its own camera-relative positions
+    glm::vec4 cameraPos;     // xyz
+    glm::vec4 lightPos;      // xyz camera-relative centre, w = the light's radius
+    glm::vec4 lightColour;   // rgb
+    glm::vec4 screenSize;    // xy in pixels, zw = 1 / xy
+    glm::vec4 time;          // x = wall-clock seconds, y = simulation seconds, z = frame delta
+    glm::vec4 jitter;        // xy = this frame's projection offset in NDC, zw = last frame's
+};
+
+static_assert(sizeof(FrameUniformData) == 6 * 64 + 6 * 16, "FrameUniformData must match the std140 layout");
+
+/*  Frame-constant shader data in one uniform buffer, uploaded once per
+ *  frame and bound at a fixed binding point that every program's
+ *  FrameUniforms block is attached to when the program is reflected.
+ */
+class FrameUniforms {
+public:
+    static constexpr GLuint Binding = 0;
+    static constexpr const char *BlockName = "FrameUniforms";
+
+    static void Initialise();
+    static void Shutdown();
+
+    static void Update(const FrameUniformData &data);
+
+private:
+    static inline GLuint sUBO = 0;
+};
+
+#endif //FRAMEUNIFORMS_H
@@ -0,0 +1,73 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <array>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+enum class BlendMode : std::uint8_t {
+    None,
+    Alpha,
+    Additive // src * alpha + dst, for light that only ever adds up
+};
+
+// Fixed-function state a draw needs; everything else is left as set up in main
+struct RenderState {
+    BlendMode blend = BlendMode::None;
+    bool depthTest = true;
+    bool depthWrite = true;
+    bool cullBackFaces = true;
+    bool allowWireframe = true; // follows the global wireframe toggle, otherwise always filled
+
+    bool operator==(const RenderState &) const = default;
+};
+
+/*  Shadow copy of the GL state the renderers change, so binding something
+ *  that is already bound costs a comparison instead of a driver call.
+ *  Anything that changes state behind its back (ImGui, one-off set-up code)
+ *  must be followed by Invalidate, after which the next call of each kind
+ *  goes through unconditionally.
+ */
+class GlState {
+public:
+    static constexpr GLuint TextureUnits = 8;
+    static constexpr GLuint StorageBindings = 4;
+
+    static void Invalidate();
+
+    static void Apply(const RenderState &state, bool wireframe);
+    static void UseProgram(GLuint program);
+    static void BindVertexArray(GLuint vao);
+    static void BindTexture2D(GLuint unit, GLuint texture);
+    static void BindStorageBuffer(GLuint index, GLuint buffer);
+
+    // Calls that reached GL, and calls filtered out as redundant
+    static std::uint64_t Changes() { return changes; }
+    static std::uint64_t Skipped() { return skipped; }
+
+private:
+    static constexpr GLuint Unknown = UINT32_MAX;
+
+    // true if `value` had to be updated
+    static bool update(GLuint &cached, GLuint value);
+    static bool update(int &cached, int value);
+
+    static inline GLuint program = Unknown;
+    static inline GLuint vertexArray = Unknown;
+    static inline GLuint activeUnit = Unknown;
+    static inline std::array<GLuint, TextureUnits> textures{};
+    static inline std::array<GLuint, StorageBindings> storageBuffers{};
+
+    // -1 while unknown
+    static inline int blend = -1; // a BlendMode
+    static inline int depthTest = -1;
+    static inline int depthWrite = -1;
+    static inline int cullFace = -1;
+    static inline int wireframe = -1;
+
+    static inline std::uint64_t changes = 0;
+    static inline std::uint64_t skipped = 0;
+};
+
+#endif //GLSTATE_H
@@ -0,0 +1,80 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "profiler.h"
+
+/*  GPU zones measured with GL_TIMESTAMP queries. Results are read back a
+ *  few frames later (never stalling on the GPU), mapped onto the CPU clock
+ *  and recorded into a "GPU" track next to the CPU threads.
+ */
+class GpuProfiler {
+public:
+    static constexpr std::size_t FramesInFlight = 4;
+
+    // Call once after the GL context exists; silently stays off if timer queries are missing
+    static void Initialise();
+    static void Shutdown();
+
+    // Resolves the frame that was recorded FramesInFlight frames ago
+    static void BeginFrame();
+
+    static std::size_t BeginZone(const char *name);
+    static void EndZone(std::size_t zone);
+
+    static constexpr std::size_t InvalidZone = SIZE_MAX;
+
+private:
+    struct Zone {
+        const char *name;
+        GLuint beginQuery;
+        GLuint endQuery;
+        std::uint32_t depth;
+    };
+
+    struct FrameQueries {
+        std::vector<Zone> zones;
+        std::vector<GLuint> freeQueries;
+    };
+
+    static GLuint acquireQuery(FrameQueries &frame);
+    static void calibrate();
+
+    static inline bool available = false;
+    static inline std::array<FrameQueries, FramesInFlight> frames;
+    static inline std::size_t frameIndex = 0;
+    static inline std::uint32_t depth = 0;
+
+    static inline std::int64_t gpuToCpuOffset = 0; // ns to add to a GPU timestamp to land on Profiler::Now()
+    static inline std::uint64_t lastCalibration = 0;
+
+    static inline Profiler::Track *track = nullptr;
+};
+
+// A CPU zone and a GPU zone under the same name; the CPU one opens first and closes last
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const char *name) : mCpu(name), mZone(GpuProfiler::BeginZone(name)) {}
+    ~GpuProfileScope() { GpuProfiler::EndZone(mZone); }
+
+    GpuProfileScope(const GpuProfileScope &) = delete;
+    GpuProfileScope &operator=(const GpuProfileScope &) = delete;
+
+private:
+    ProfileScope mCpu;
+    std::size_t mZone;
+};
+
+#if PROFILER_ENABLED
+// Times the enclosing scope on both the CPU and the GPU
+#define GPU_PROFILE_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#else
+#define GPU_PROFILE_SCOPE(name) ((void)0)
+#endif
+
+#endif //GPUPROFILER_H
@@ -0,0 +1,25 @@
+#ifndef HEADLESSCONTEXT_H
+#define HEADLESSCONTEXT_H
+
+#include <glad/glad.h>
+
+/*  An OpenGL context with no window and no display server, for batch
+ *  rendering on machines without a GPU or X: EGL on Mesa's surfaceless
+ *  platform (llvmpipe when there is no GPU), falling back to the default
+ *  EGL display. There is no default framebuffer, so everything has to be
+ *  drawn into framebuffer objects - see SceneTarget's offscreen output.
+ *
+ *  Only built where CMake finds EGL (SPACESIM_EGL); elsewhere Create
+ *  reports that and fails.
+ */
+class HeadlessContext {
+public:
+    // Makes a 4.6 core context current on the calling thread; false if the driver has no 4.6
+    static bool Create(bool debug);
+    static void Destroy();
+
+    // For gladLoadGLLoader and anything else that needs entry points
+    static GLADloadproc Loader();
+};
+
+#endif //HEADLESSCONTEXT_H
@@ -0,0 +1,77 @@
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct TerrainSettings {
+    // Procedural relief, used when there are no height tiles
+    double maxHeight = 8.0;        // km, largest height above or depth below the radius
+    double featureSize = 2500.0;   // km, wavelength of the coarsest noise octave
+    int octaves = 14;
+    std::uint32_t seed = 1;
+
+    /*  Height tiles: an equirectangular grid of tileRows x tileColumns files
+     *  named "<row>_<column>.r16" in tileDirectory, row 0 at the north pole
+     *  and column 0 at -180°. Each is tileSize² little-endian int16 heights
+     *  in metres. Only the tiles patches actually touch are read, and at
+     *  most tileCacheBytes of them stay in memory, so the set can be far
+     *  larger than RAM.
+     */
+    std::string tileDirectory;
+    int tileRows = 0;
+    int tileColumns = 0;
+    int tileSize = 0;
+    std::size_t tileCacheBytes = std::size_t(256) << 20;
+};
+
+/*  Surface height of a planet in any direction. Thread safe: terrain
+ *  patches are generated on the thread pool, and all of them sample the
+ *  same field so neighbouring patches agree along their shared edges.
+ */
+class HeightField {
+public:
+    HeightField(double radius, const TerrainSettings &settings); // radius in km
+
+    // km above (or below) the planet's radius; `direction` must be unit length
+    [[nodiscard]] double height(const glm::dvec3 &direction) const;
+
+    [[nodiscard]] double maxHeight() const;
+
+private:
+    struct Tile {
+        int row, column;
+        std::vector<std::int16_t> heights; // empty if the file is missing
+    };
+
+    [[nodiscard]] double procedural(const glm::dvec3 &direction) const;
+    [[nodiscard]] double tiled(const glm::dvec3 &direction) const;
+    [[nodiscard]] double tileSample(long long x, long long y) const; // metres, in global texels
+
+    std::shared_ptr<const Tile> tile(int row, int column) const;
+    std::shared_ptr<const Tile> load(int row, int column) const;
+
+    static inline std::atomic<std::uint64_t> nextId{1};
+    const std::uint64_t id = nextId++; // tells fields apart in the per-thread tile shortcut
+
+    double radius;
+    TerrainSettings settings;
+    bool useTiles = false;
+
+    // Least recently used tiles are dropped first; entries in flight elsewhere survive through their shared_ptr
+    mutable std::mutex cacheMutex;
+    mutable std::list<std::shared_ptr<const Tile>> recent; // most recent first
+    mutable std::unordered_map<std::int64_t, std::list<std::shared_ptr<const Tile>>::iterator> cache;
+    mutable std::size_t cachedBytes = 0;
+};
+
+#endif //HEIGHTFIELD_H
@@ -0,0 +1,47 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <cstdint>
+#include <vector>
+
+/*  Distance tiers for drawing bodies, picked by projected screen-space radius:
+ *  a sphere mesh (from a chain of subdivision levels) up close, a ray-traced
+ *  impostor on a billboard further out, and a point sprite once the body is
+ *  about a pixel across.
+ *
+ *  Every body keeps its last selection. Moving to a finer tier happens as soon
+ *  as a threshold is crossed, moving back only once the body has shrunk a
+ *  further HysteresisBand below it, so nothing flickers on a boundary.
+ */
+enum class LodTier : std::uint8_t {
+    Mesh,
+    Impostor,
+    Point
+};
+
+struct LodSelection {
+    LodTier tier = LodTier::Mesh;
+    std::uint8_t meshLevel = 0; // 0 is the finest mesh
+};
+
+class Lod {
+public:
+    static constexpr float ImpostorBelowPx = 24.0f; // projected radius where meshes give way to impostors
+    static constexpr float PointBelowPx = 1.5f;     // ... and impostors to point sprites
+    static constexpr float TargetEdgePx = 8.0f;     // mesh levels aim for edges about this long on screen
+    static constexpr float HysteresisBand = 0.2f;
+
+    // Pixels per unit of (radius / distance) for a viewport height and vertical field of view
+    static float PixelScale(float viewportHeight, float fovYRadians);
+    // Projected radius of a sphere in pixels; huge once the camera is inside it
+    static float ProjectedRadius(float radius, float distance, float pixelScale);
+
+    // `meshThresholds[i]` is the smallest projected radius mesh level i is used for, finest first
+    static LodSelection Select(LodSelection previous, float projectedRadius, const std::vector<float> &meshThresholds);
+
+private:
+    static unsigned rank(LodSelection selection, std::size_t meshLevels);
+    static LodSelection classify(float projectedRadius, const std::vector<float> &meshThresholds);
+};
+
+#endif //LOD_H
@@ -1,6 +1,10 @@
 #ifndef MATHS_H
 #define MATHS_H
 
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+
 // --- Central definition ---
 constexpr double SU_IN_KM = 100.0; // 1 SU = 1 km
 constexpr double KM_IN_M = 1000.0;
@@ -28,9 +32,48 @@ inline glm::dvec3 kmToM(glm::dvec3 d) { return d * KM_IN_M; }
 inline double mToSu(double d) { return d * M_IN_SU; }
 inline double suToM(double d) { return d * SU_IN_M; }
 
+// Floating origin: a position in km relative to `originKm`, in SU. The difference is taken in double,
+// so only the small result is rounded to float however far both are from the system origin.
+inline glm::vec3 relativeSu(const glm::dvec3 &positionKm, const glm::dvec3 &originKm) {
+    return glm::vec3((positionKm - originKm) * KM_IN_SU);
+}
+
+// FNV-1a, for cache keys that must come out the same from one build to the next (unlike std::hash).
+// Chain calls through `hash` to cover several pieces.
+inline std::uint64_t fnv1a(std::string_view bytes, std::uint64_t hash = 14695981039346656037ull) {
+    for (unsigned char c: bytes) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
 // Returns the surface gravity of a body in m/s^2
 inline double deriveSurfaceGravity(double mass, double radius) {
     return ((GravitationalConstant * mass) / (radius * radius)) * 1000.0;
 }
 
+// Cubic Hermite interpolation between two states dt seconds apart, s in [0, 1].
+// Used as the dense output of the leapfrog integrator when sampling between steps.
+inline glm::dvec3 hermitePosition(const glm::dvec3 &p0, const glm::dvec3 &v0,
+                                  const glm::dvec3 &p1, const glm::dvec3 &v1, double dt, double s) {
+    double s2 = s * s;
+    double s3 = s2 * s;
+    return p0 * (2 * s3 - 3 * s2 + 1) + v0 * (dt * (s3 - 2 * s2 + s)) +
+           p1 * (-2 * s3 + 3 * s2) + v1 * (dt * (s3 - s2));
+}
+
+// Derivative of hermitePosition, i.e. the interpolated velocity
+inline glm::dvec3 hermiteVelocity(const glm::dvec3 &p0, const glm::dvec3 &v0,
+                                  const glm::dvec3 &p1, const glm::dvec3 &v1, double dt, double s) {
+    double s2 = s * s;
+    return (p0 * (6 * s2 - 6 * s) + p1 * (-6 * s2 + 6 * s)) / dt +
+           v0 * (3 * s2 - 4 * s + 1) + v1 * (3 * s2 - 2 * s);
+}
+
+// Laplace sphere of influence radius of a body orbiting a much heavier parent at `distance` km
+inline double deriveSphereOfInfluence(double parentMass, double bodyMass, double distance) {
+    return distance * std::pow(bodyMass / parentMass, 0.4);
+}
+
 #endif // MATHS_H
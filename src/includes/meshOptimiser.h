@@ -0,0 +1,41 @@
+#ifndef MESHOPTIMISER_H
+#define MESHOPTIMISER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*  Index-buffer preparation for static triangle meshes, run once at load.
+ *
+ *  OptimiseVertexCache reorders triangles so vertices are reused while
+ *  they are still in the GPU's post-transform cache (Forsyth's linear-speed
+ *  algorithm); OptimiseVertexFetch then renumbers vertices in the order
+ *  that triangle list first touches them, so fetches walk the vertex
+ *  buffer forwards. SplitShortIndices turns the result into 16-bit index
+ *  runs, each drawn with its own base vertex.
+ */
+class MeshOptimiser {
+public:
+    static constexpr std::size_t CacheSize = 32; // modelled post-transform cache entries
+
+    static void OptimiseVertexCache(std::vector<unsigned int> &indices, std::size_t vertexCount);
+
+    // Rewrites `indices` and returns each old vertex's new index; reorder the vertices to match
+    static std::vector<unsigned int> OptimiseVertexFetch(std::vector<unsigned int> &indices, std::size_t vertexCount);
+
+    // Vertices transformed per triangle with a FIFO cache of CacheSize: 0.5 is ideal, 3 is no reuse at all
+    static float AverageCacheMissRatio(const std::vector<unsigned int> &indices, std::size_t vertexCount);
+
+    struct Chunk {
+        std::size_t firstIndex; // into the 16-bit index array
+        std::size_t indexCount;
+        unsigned int baseVertex; // added to every index in the chunk
+    };
+
+    // Appends `indices` to `shortIndices` as whole triangles, in runs that each reference at most 65536 vertices.
+    // Throws std::runtime_error if one triangle's own vertices are further apart than that.
+    static std::vector<Chunk> SplitShortIndices(const std::vector<unsigned int> &indices,
+                                                std::vector<std::uint16_t> &shortIndices);
+};
+
+#endif //MESHOPTIMISER_H
@@ -0,0 +1,130 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+/*  Lock-free log-linear histogram of durations in nanoseconds.
+ *  Writers only ever fetch_add a bucket; readers diff two copies of the
+ *  counts to get the distribution over any window they like.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int SubBuckets = 8;                        // linear steps per power of two
+    static constexpr int Octaves = 40;                          // up to ~2^40 ns ≈ 18 minutes
+    static constexpr int BucketCount = Octaves * SubBuckets;
+
+    using Counts = std::array<std::uint64_t, BucketCount>;
+
+    void record(std::uint64_t ns) {
+        mBuckets[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void read(Counts &counts) const {
+        for (int i = 0; i < BucketCount; ++i) counts[i] = mBuckets[i].load(std::memory_order_relaxed);
+    }
+
+    // Percentile (0..1) of the samples recorded between two reads, in ns
+    static double percentile(const Counts &from, const Counts &to, double p);
+
+    static int bucketOf(std::uint64_t ns);
+    static double bucketValue(int bucket); // midpoint of the bucket in ns
+
+private:
+    std::array<std::atomic<std::uint64_t>, BucketCount> mBuckets{};
+};
+
+// Derived values over one sampling window, produced by Metrics::Sample
+struct MetricsSnapshot {
+    double wallTime = 0.0;            // seconds since start-up
+    double windowSeconds = 0.0;
+
+    double fps = 0.0;
+    double frameTimeAverage = 0.0;    // ms
+    double frameTimeP50 = 0.0;        // ms
+    double frameTimeP99 = 0.0;        // ms
+    double frameTimeMax = 0.0;        // ms, approximate (bucket resolution)
+
+    double physicsStepsPerSecond = 0.0;
+    double requestedWarp = 0.0;
+    double achievedWarp = 0.0;        // simulated seconds per wall-clock second
+    double accumulatorBacklog = 0.0;  // simulated seconds still waiting to be stepped
+    double simulationTime = 0.0;
+
+    double forceEvaluationsPerSecond = 0.0;
+    std::uint64_t forceEvaluations = 0;
+    std::uint64_t bodyCount = 0;
+
+    std::uint64_t residentBytes = 0;
+
+    std::string toJson() const;
+};
+
+/*  Process-wide performance counters. Every update from the hot loops is a
+ *  single relaxed atomic operation; all the maths happens in Sample().
+ */
+class Metrics {
+public:
+    // Each consumer (HUD, exporter) keeps its own window so they don't disturb each other
+    struct Window {
+        std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+        LatencyHistogram::Counts frameCounts{};
+        std::uint64_t frames = 0;
+        std::uint64_t frameNanoseconds = 0;
+        std::uint64_t physicsSteps = 0;
+        std::uint64_t forceEvaluations = 0;
+        double simulationTime = 0.0;
+    };
+
+    static void RecordFrame(std::uint64_t nanoseconds) {
+        frameTimes.record(nanoseconds);
+        frames.fetch_add(1, std::memory_order_relaxed);
+        frameNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    }
+
+    static void RecordPhysics(std::uint64_t steps, double simTime, double backlog, double warp, std::uint64_t bodies) {
+        physicsSteps.fetch_add(steps, std::memory_order_relaxed);
+        requestedWarp.store(warp, std::memory_order_relaxed);
+        simulationTime.store(simTime, std::memory_order_relaxed);
+        accumulatorBacklog.store(backlog, std::memory_order_relaxed);
+        bodyCount.store(bodies, std::memory_order_relaxed);
+    }
+
+    static void RecordForceEvaluations(std::uint64_t count) {
+        forceEvaluations.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    static MetricsSnapshot Sample(Window &window);
+
+    static std::uint64_t ResidentMemoryBytes();
+
+    // Periodically writes MetricsSnapshot::toJson() lines to `target`: a file path, or "unix:/path" for a
+    // datagram socket that monitoring can listen on
+    static void StartExporter(const std::string &target, std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+    static void StopExporter();
+
+private:
+    static void exporterLoop(std::string target, std::chrono::milliseconds interval);
+
+    static inline const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    static inline LatencyHistogram frameTimes;
+    static inline std::atomic<std::uint64_t> frames{0};
+    static inline std::atomic<std::uint64_t> frameNanoseconds{0};
+
+    static inline std::atomic<std::uint64_t> physicsSteps{0};
+    static inline std::atomic<std::uint64_t> forceEvaluations{0};
+    static inline std::atomic<std::uint64_t> bodyCount{0};
+    static inline std::atomic<double> simulationTime{0.0};
+    static inline std::atomic<double> accumulatorBacklog{0.0};
+    static inline std::atomic<double> requestedWarp{1.0};
+
+    static inline std::atomic<bool> exporterRunning{false};
+    static inline std::thread exporterThread;
+};
+
+#endif //METRICS_H
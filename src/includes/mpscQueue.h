@@ -0,0 +1,76 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*  Bounded multi-producer / single-consumer ring buffer.
+ *  Each cell carries a sequence number, so producers only contend on one
+ *  compare-exchange of the head and never wait on each other or the
+ *  consumer: tryPush fails when full, tryPop when empty.
+ *  Capacity must be a power of two.
+ */
+template<typename T, std::size_t Capacity>
+class MpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "MpscQueue capacity must be a power of two");
+
+public:
+    MpscQueue() {
+        for (std::size_t i = 0; i < Capacity; ++i) mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    // Any thread
+    bool tryPush(const T &value) {
+        Cell *cell;
+        std::size_t head = mHead.load(std::memory_order_relaxed);
+
+        while (true) {
+            cell = &mCells[head & (Capacity - 1)];
+            const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(head);
+
+            if (difference == 0) {
+                // The cell is free for this lap - claim it
+                if (mHead.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) break;
+            } else if (difference < 0) {
+                return false; // the consumer hasn't freed this cell yet
+            } else {
+                head = mHead.load(std::memory_order_relaxed); // another producer got there first
+            }
+        }
+
+        cell->value = value;
+        cell->sequence.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only
+    bool tryPop(T &value) {
+        const std::size_t tail = mTail.load(std::memory_order_relaxed);
+        Cell &cell = mCells[tail & (Capacity - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != tail + 1) return false;
+
+        value = cell.value;
+        cell.sequence.store(tail + Capacity, std::memory_order_release);
+        mTail.store(tail + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T value{};
+    };
+
+    std::array<Cell, Capacity> mCells;
+
+    alignas(64) std::atomic<std::size_t> mHead{0};
+    alignas(64) std::atomic<std::size_t> mTail{0};
+};
+
+#endif //MPSCQUEUE_H
@@ -1,11 +1,16 @@
 #ifndef OCTAHEDRON_H
 #define OCTAHEDRON_H
 
+#include <array>
 #include <iosfwd>
+#include <vector>
 #include <glm/glm.hpp>
 #include <glad/glad.h>
 
+#include "bodyInstance.h"
+#include "lod.h"
 #include "material.h"
+#include "renderQueue.h"
 #include "shader.h"
 #include "vertex.h"
 
@@ -16,33 +21,50 @@ public:
     static void CreateLowerStrip(int steps, int vTop, int vBottom, std::vector<unsigned int> & triangles);
     static void CreateUpperStrip(int steps, int vTop, int vBottom, std::vector<unsigned int> & triangles);
 
-    static void InitialiseShared(unsigned int subdivisions,
-                                 const char *vertPath,
-                                 const char *fragPath);
+    // Appends one octahedron sphere, indices relative to its own first vertex
+    static void BuildSphere(unsigned int subdivisions, std::vector<Vertex> &vertices, std::vector<unsigned int> &triangles);
+
+    // Builds the LOD chain from `subdivisions` down to MinLevelSubdivisions, one level per step, and uploads
+    // it as PackedVertex with vertex cache optimised 16-bit indices
+    static void InitialiseShared(unsigned int subdivisions);
 
     static void ShutdownShared();
 
-    Octahedron(const glm::vec3& worldPos, float radius = 1.0f) : position(worldPos), radius(radius) { }
+    static constexpr unsigned int MinLevelSubdivisions = 3;
+
+    // Smallest projected radius (pixels) each mesh level is used for, finest first - see Lod::Select
+    static const std::vector<float> &LevelThresholds() { return sLevelThresholds; }
 
-    void draw(const glm::mat4& worldToClip,
-              const glm::vec3& cameraPos,
-              const Material& material,
-              const glm::vec3& lightPos     = glm::vec3(0),
-              const glm::vec3& lightColour  = glm::vec3(1)) const;
+    // Instanced path: one registered draw call per mesh level, bodies sharing a level and texture merge into one draw
+    static void InitialiseInstancing(const char *vertPath, const char *fragPath);
+    // `occluders` is the body's range from Shadows::Range, `motion` as in BodyInstance
+    static void Record(RenderRecorder &recorder, const glm::vec3 &position, float radius, const Material &material,
+                       unsigned int level, float depth, glm::uvec2 occluders = glm::uvec2(0),
+                       const glm::vec3 &motion = glm::vec3(0.0f));
 
-    void setPosition(const glm::vec3& p) { position = p; }
-    void setRadius  (float r)            { radius = r; }
 private:
-    /* ---- shared GPU state (one copy for all octahedrons) - whilst this means one subdivision for each, only one copy needs to be made for however many planets ---- */
-    static inline Shader *sShader = nullptr;
+    /* ---- shared GPU state (one copy of the LOD chain for all octahedrons, however many planets there are) ---- */
     static inline GLuint sVAO = 0;
     static inline GLuint sVBO = 0;
     static inline GLuint sEBO = 0;
 
-    static inline unsigned int numTriangles = 0;
+    // 16-bit indices only reach 65536 vertices, so the finer levels are drawn as several chunks
+    struct MeshChunk {
+        GLsizei indexCount;
+        std::size_t firstIndex;
+        GLint baseVertex;
+    };
+
+    struct MeshLevel {
+        unsigned int subdivisions;
+        std::vector<MeshChunk> chunks;
+    };
+
+    static inline std::vector<MeshLevel> sLevels;
+    static inline std::vector<float> sLevelThresholds;
 
-    glm::vec3 position;
-    float radius;
+    static inline Shader *sInstancedShader = nullptr;
+    static inline std::vector<std::vector<const DrawCall *>> sLevelCalls; // one per chunk of each level
 };
 
 #endif //OCTAHEDRON_H
@@ -0,0 +1,52 @@
+#ifndef ORBITLINES_H
+#define ORBITLINES_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "orbitPredictor.h"
+#include "renderQueue.h"
+#include "shader.h"
+
+/*  Draws the predicted paths from OrbitPredictor as one line strip per body.
+ *  The vertex buffer is only rebuilt when a new prediction is published or
+ *  the focus body changes, otherwise drawing is a single multi-draw call.
+ */
+class OrbitLines {
+public:
+    static void InitialiseShared(const char *vertPath, const char *fragPath);
+    static void ShutdownShared();
+
+    // Paths are drawn relative to the predicted path of `relativeBodyIndex`, so orbits stay closed, and placed at
+    // `focusOffset`, that body's position relative to the camera.
+    // Main thread only: a new prediction is uploaded here, before the packet is recorded.
+    static void Record(RenderRecorder &recorder,
+                       const OrbitTrajectories &trajectories,
+                       std::size_t relativeBodyIndex,
+                       const glm::vec3 &focusOffset,
+                       const glm::vec4 &colour = glm::vec4(0.35f, 0.6f, 1.0f, 0.8f));
+
+private:
+    static void upload(const OrbitTrajectories &trajectories, std::size_t relativeBodyIndex);
+    static void drawPaths(const DrawPacket &packet);
+
+    static inline Shader *sShader = nullptr;
+    static inline GLuint sVAO = 0;
+    static inline GLuint sVBO = 0;
+    static inline const DrawCall *sCall = nullptr;
+
+    static inline glm::vec4 drawColour{};
+    static inline glm::vec3 drawOffset{};
+
+    static inline std::uint64_t uploadedVersion = 0;
+    static inline std::size_t uploadedRelativeIndex = SIZE_MAX;
+    static inline std::size_t vboCapacity = 0;
+
+    static inline std::vector<GLint> firsts;
+    static inline std::vector<GLsizei> counts;
+};
+
+#endif //ORBITLINES_H
@@ -0,0 +1,97 @@
+#ifndef ORBITPREDICTOR_H
+#define ORBITPREDICTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "physics.h"
+
+struct OrbitPredictionSettings {
+    double horizon = 60.0 * 60.0 * 24.0 * 30.0;      // seconds of simulation time to look ahead
+    unsigned int sampleCount = 512;                  // polyline vertices per body across the horizon
+    double integrationStep = 60.0;                   // largest predictor step in seconds
+    double positionTolerance = 100.0;                // km of drift from the prediction before it is thrown away
+    double velocityTolerance = 0.01;                 // km/s jump that counts as an abrupt change
+    std::chrono::milliseconds interval{50};          // how often the worker looks at a new snapshot
+};
+
+// A finished prediction, never modified once published.
+// points[body * sampleCount + k] is the position of `body` at startTime + k * sampleInterval;
+// ids[body] says which simulated body that is. Only massive bodies are included.
+struct OrbitTrajectories {
+    std::uint64_t version = 0;
+    double startTime = 0.0;
+    double sampleInterval = 0.0;
+    std::size_t bodyCount = 0;
+    std::size_t sampleCount = 0;
+    std::vector<BodyId> ids;
+    std::vector<glm::dvec3> points;
+
+    // Index of a body in `points`, or bodyCount if it isn't part of this prediction
+    std::size_t indexOf(BodyId id) const {
+        for (std::size_t i = 0; i < ids.size(); ++i)
+            if (ids[i] == id) return i;
+        return bodyCount;
+    }
+};
+
+/*  Predicts future paths for every massive body on a background thread.
+ *  Massless probes are left out: they can't bend anyone else's path and
+ *  there can be far too many of them to keep a polyline each.
+ *  It only ever reads Physics snapshots, so it can't hold up the physics
+ *  step, and it only extends the part of the prediction that time has
+ *  consumed unless the real state has drifted away from it.
+ */
+class OrbitPredictor {
+public:
+    static void Initialise(const OrbitPredictionSettings &settings = {});
+    static void Shutdown();
+
+    // Changing the settings forces a full recompute on the next update
+    static void SetSettings(const OrbitPredictionSettings &settings);
+    static OrbitPredictionSettings GetSettings();
+
+    static void Invalidate();
+
+    // Latest finished trajectories, or null if nothing has been predicted yet
+    static std::shared_ptr<const OrbitTrajectories> GetTrajectories() { return trajectories.load(std::memory_order_acquire); }
+
+private:
+    struct Frame {
+        double time = 0.0;
+        std::vector<glm::dvec3> positions;
+        std::vector<glm::dvec3> velocities;
+    };
+
+    static void workerLoop();
+    static void update(const PhysicsSnapshot &snapshot, const OrbitPredictionSettings &settings, bool full);
+    static bool diverged(const Frame &now, const OrbitPredictionSettings &settings);
+    static Frame integrate(const Frame &from, double duration, double maxStep);
+    static void publish();
+
+    static std::thread workerThread;
+    static std::mutex settingsMutex;
+    static std::condition_variable wake;
+    static OrbitPredictionSettings currentSettings;
+    static bool running;
+    static bool dirty;
+
+    // Worker-owned prediction state
+    static std::deque<Frame> frames;
+    static std::vector<BodyId> ids;
+    static std::vector<double> masses;
+    static std::uint64_t version;
+
+    static std::atomic<std::shared_ptr<const OrbitTrajectories>> trajectories;
+};
+
+#endif //ORBITPREDICTOR_H
@@ -0,0 +1,89 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "renderQueue.h"
+#include "shader.h"
+
+struct PhysicsSnapshot;
+
+struct ParticleSettings {
+    glm::vec3 colour{0.85f, 0.8f, 0.72f};
+    float brightness = 1.0f;
+    float pointSizePx = 2.0f;
+
+    // Both scale by referenceDistance / distance (squared for brightness), done per vertex on the GPU
+    bool attenuateSize = true;
+    bool attenuateBrightness = true;
+    float referenceDistance = 5000.0f; // SU at which particles are full size and brightness
+    float minBrightness = 0.05f;
+};
+
+/*  Draws every simulated body that has no render body of its own - the
+ *  massless probes spawned with Physics::SpawnBody, for rings, belts or
+ *  star fields - as additive GL_POINTS in a single draw.
+ *
+ *  Positions go from the physics snapshot straight into a persistently
+ *  mapped buffer split into Regions regions, one per frame in flight. The
+ *  region for this frame is only written once the fence placed after the
+ *  draw that last read it has signalled, so the GPU never sees a
+ *  half-written frame and the CPU normally never waits. The buffer is
+ *  immutable storage and only reallocated when the particle count
+ *  outgrows it. Filling is split across the thread pool.
+ */
+class Particles {
+public:
+    static constexpr int Regions = 3;
+    static constexpr std::size_t InitialCapacity = std::size_t(1) << 16; // particles per region
+    static constexpr std::size_t ParallelGrain = 1 << 16;
+
+    struct Stats {
+        std::size_t particles = 0;
+        std::size_t capacity = 0;
+        std::uint64_t stalls = 0; // frames that had to wait for the GPU to finish with their region
+    };
+
+    static void InitialiseShared(const char *vertPath, const char *fragPath);
+    static void ShutdownShared();
+
+    static void SetSettings(const ParticleSettings &newSettings) { settings = newSettings; }
+
+    // Main thread, once per frame after SyncBodies
+    static void Update(const PhysicsSnapshot &snapshot, const glm::dvec3 &originKm);
+    static void Record(RenderRecorder &recorder);
+
+    static Stats LastStats() { return stats; }
+
+private:
+    static void allocate(std::size_t capacity);
+    static void waitForRegion(int index);
+    static void drawParticles(const DrawPacket &packet);
+
+    static inline Shader *sShader = nullptr;
+    static inline GLuint sVAO = 0;
+    static inline GLuint sVBO = 0;
+    static inline const DrawCall *sCall = nullptr;
+
+    static inline glm::vec3 *mapped = nullptr; // Regions * capacity camera-relative positions, SU
+    static inline std::size_t capacity = 0;
+    static inline GLsync fences[Regions] = {};
+    static inline int region = 0;
+
+    // Snapshot indices of the bodies drawn as particles, rebuilt when the snapshot layout changes
+    static inline std::vector<std::uint32_t> sources;
+    static inline std::uint64_t sourcesLayout = UINT64_MAX;
+
+    static inline GLint drawFirst = 0;
+    static inline GLsizei drawCount = 0;
+
+    static inline ParticleSettings settings{};
+    static Stats stats;
+};
+
+#endif //PARTICLES_H
@@ -0,0 +1,39 @@
+#ifndef PERFORMANCEHUD_H
+#define PERFORMANCEHUD_H
+
+#include <array>
+#include <chrono>
+
+#include "metrics.h"
+
+struct GLFWwindow;
+
+/*  On-screen overlay for the numbers collected by Metrics. The summary is
+ *  re-sampled a few times a second; the frame-time graph gets every frame
+ *  so single spikes stay visible.
+ */
+class PerformanceHud {
+public:
+    static constexpr std::size_t HistoryLength = 240;
+    static constexpr auto SampleInterval = std::chrono::milliseconds(250);
+
+    // Needs the GL context to be current. Input callbacks are left alone, the overlay is display-only
+    static void Initialise(GLFWwindow *window);
+    static void Shutdown();
+
+    static void Draw(double frameMilliseconds);
+
+    static inline bool Visible = true;
+
+private:
+    static inline bool initialised = false;
+
+    static inline Metrics::Window window;
+    static inline MetricsSnapshot latest;
+    static inline std::chrono::steady_clock::time_point lastSample{};
+
+    static inline std::array<float, HistoryLength> frameHistory{};
+    static inline std::size_t historyOffset = 0;
+};
+
+#endif //PERFORMANCEHUD_H
@@ -3,6 +3,9 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include <thread>
 
@@ -12,19 +15,105 @@
 
 #include "celestialBody.h"
 #include "maths.h"
+#include "mpscQueue.h"
+
+// Stable handle of a simulated body, the same as CelestialBody::instanceId
+using BodyId = std::uint32_t;
+
+// Immutable copy of the simulation state, published by the physics thread once per outer loop.
+// Bodies are stored densely and may be reordered when one is removed, so look them up through `ids`.
+struct PhysicsSnapshot {
+    double time = 0.0;         // simulation time in seconds
+    std::uint64_t step = 0;    // number of fixed steps taken so far
+    std::uint64_t layout = 0;  // changes whenever bodies are added, removed or reordered
+
+    std::vector<BodyId> ids;
+    std::vector<double> masses;
+    std::vector<glm::dvec3> positions;
+    std::vector<glm::dvec3> velocities;
+};
+
+enum class PhysicsCommandType : std::uint8_t {
+    Spawn,
+    Remove,
+    SetMass,
+    SetState,
+    Pause,
+    Resume,
+    Step
+};
+
+// Applied by the physics thread between steps, in the order they were submitted
+struct PhysicsCommand {
+    PhysicsCommandType type = PhysicsCommandType::Pause;
+    BodyId id = 0;
+    std::uint32_t steps = 0;   // Step
+    double mass = 0.0;         // Spawn, SetMass
+    glm::dvec3 position{0.0};  // Spawn, SetState
+    glm::dvec3 velocity{0.0};  // Spawn, SetState
+};
 
 class Physics {
 public:
     static void Initialise();
 
+    static constexpr std::size_t CommandCapacity = 4096;
+
+    static constexpr double FixedTimeStep = 1.0 / 100;
+    static constexpr unsigned int SkipBatchSteps = 20000; // steps per outer loop while skipping to an event
+
     static std::atomic<double> gTimeScale;
+    // Runs the simulation flat out until the EventDetector reports the next event
+    static std::atomic<bool> gSkipToNextEvent;
+    // Render-side bodies, owned by the main thread and kept up to date by SyncBodies.
+    // The physics thread never touches them - it only sees the commands below.
     static std::vector<CelestialBody> Bodies;
 
+    // Main thread: creates the render body and spawns it in the simulation
+    template<typename... Args>
+    static CelestialBody &AddBody(Args &&... args) {
+        CelestialBody &body = Bodies.emplace_back(std::forward<Args>(args)...);
+        Submit({PhysicsCommandType::Spawn, body.instanceId, 0, body.mass, body.position, body.velocity});
+        return body;
+    }
+
+    // Main thread: copies the latest snapshot into Bodies and drops bodies the simulation has removed
+    static void SyncBodies();
+    static CelestialBody *FindBody(BodyId id);
+
+    // Any thread. Bodies spawned without AddBody are simulated but have nothing to draw.
+    static BodyId SpawnBody(double mass, const glm::dvec3 &position, const glm::dvec3 &velocity);
+    static void RemoveBody(BodyId id);
+    static void SetBodyMass(BodyId id, double mass);
+    static void SetBodyState(BodyId id, const glm::dvec3 &position, const glm::dvec3 &velocity);
+    static void SetPaused(bool paused);
+    static bool IsPaused() { return pausedState.load(std::memory_order_relaxed); }
+    // Advances a paused simulation by whole fixed steps
+    static void SingleStep(std::uint32_t steps = 1);
+
+    // Waits (yielding) only if the command queue is full
+    static void Submit(const PhysicsCommand &command);
+
+    // Latest published state. Never blocks the physics thread; may be null before the first step.
+    static std::shared_ptr<const PhysicsSnapshot> GetSnapshot() { return latestSnapshot.load(std::memory_order_acquire); }
+
+    static std::vector<glm::dvec3> computeAccelerations(const std::vector<double> &masses, const std::vector<glm::dvec3> &positions);
+    // Fills accelerations[begin, end) - lets callers split the O(N²) loop across threads
+    static void computeAccelerations(const std::vector<double> &masses, const std::vector<glm::dvec3> &positions,
+                                     std::vector<glm::dvec3> &accelerations, std::size_t begin, std::size_t end);
+
 private:
-    static std::vector<glm::dvec3> computeAccelerations(const std::vector<CelestialBody> &Bodies, const std::vector<glm::dvec3>& positions);
     static void updatePhysics();
 
     static std::thread physicsThread;
+    static std::atomic<std::shared_ptr<const PhysicsSnapshot>> latestSnapshot;
+
+    static MpscQueue<PhysicsCommand, CommandCapacity> commands;
+    static std::atomic<bool> pausedState;
+
+    // Main-thread lookup from id to snapshot index, rebuilt when the snapshot layout changes
+    static std::uint64_t syncedLayout;
+    static std::unordered_map<BodyId, std::size_t> syncedIndices;
 };
 
-#endif //PHYSICS_H
\ No newline at end of file
+#endif //PHYSICS_H
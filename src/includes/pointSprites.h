@@ -0,0 +1,36 @@
+#ifndef POINTSPRITES_H
+#define POINTSPRITES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "bodyInstance.h"
+#include "material.h"
+#include "renderQueue.h"
+#include "shader.h"
+
+/*  Bodies smaller than a pixel or so, drawn as GL_POINTS pulled straight
+ *  from the render queue's instance buffer - no vertex attributes, no
+ *  textures, and every point in the frame merges into a single draw.
+ *  Each point is shaded by its phase angle and faded by how much of a
+ *  pixel the body covers.
+ */
+class PointSprites {
+public:
+    static constexpr float PointSizePx = 2.0f;
+
+    static void InitialiseShared(const char *vertPath, const char *fragPath);
+    static void ShutdownShared();
+
+    static void Record(RenderRecorder &recorder, const glm::vec3 &position, float radius, const Material &material,
+                       float depth);
+
+private:
+    static void prepare(const DrawCall &call);
+
+    static inline Shader *sShader = nullptr;
+    static inline GLuint sVAO = 0; // empty, core profile needs one bound to draw
+    static inline const DrawCall *sCall = nullptr;
+};
+
+#endif //POINTSPRITES_H
@@ -0,0 +1,132 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*  Hierarchical scoped profiler with Chrome trace / Perfetto export.
+ *
+ *  PROFILE_SCOPE("name") records a zone into the calling thread's ring
+ *  buffer. While no capture is running a zone is a single relaxed atomic
+ *  load, so it is left compiled into release builds; define
+ *  PROFILER_ENABLED=0 (cmake -DSPACESIM_PROFILER=OFF) to strip it entirely.
+ *
+ *  Zone names must be string literals (or otherwise outlive the capture).
+ */
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+struct ProfileEvent {
+    const char *name = nullptr;
+    std::uint64_t start = 0;   // ns since Profiler::Now() epoch
+    std::uint64_t end = 0;
+    std::uint32_t depth = 0;
+};
+
+class Profiler {
+public:
+    static constexpr std::size_t TrackCapacity = 1 << 16; // events per track ring, power of two
+
+    // One producer per track: a thread's own track, or a virtual one such as the GPU timeline
+    struct Track {
+        std::string name;
+        std::uint32_t id = 0;
+        std::uint32_t depth = 0;
+        std::array<ProfileEvent, TrackCapacity> events{};
+        std::atomic<std::uint64_t> head{0};
+
+        std::uint64_t collected = 0; // collector-side read position
+        std::uint64_t lost = 0;
+    };
+
+    static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // Starts recording; the collector drains rings in the background until EndCapture
+    static void BeginCapture();
+    // Stops recording and writes everything gathered since BeginCapture as Chrome trace JSON
+    static void EndCapture(const std::string &path);
+    // Waits for the last trace to finish writing; call before exit
+    static void Shutdown();
+    static bool IsCapturing() { return capturing.load(std::memory_order_relaxed); }
+
+    static void SetThreadName(const char *name);
+    static Track *CreateTrack(const char *name);
+    static Track *ThreadTrack();
+
+    static std::uint64_t Now() {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch).count());
+    }
+
+    static void Record(Track *track, const char *name, std::uint64_t start, std::uint64_t end, std::uint32_t depth) {
+        const std::uint64_t head = track->head.load(std::memory_order_relaxed);
+        track->events[head & (TrackCapacity - 1)] = ProfileEvent{name, start, end, depth};
+        track->head.store(head + 1, std::memory_order_release);
+    }
+
+private:
+    static void collectorLoop();
+    static void collect(std::vector<std::pair<std::uint32_t, ProfileEvent>> &out);
+    static void writeTrace(const std::string &path, const std::vector<std::pair<std::uint32_t, ProfileEvent>> &events);
+
+    static inline const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    static inline std::atomic<bool> enabled{false};
+    static inline std::atomic<bool> capturing{false};
+
+    static inline std::mutex tracksMutex;
+    static inline std::vector<std::unique_ptr<Track>> tracks;
+
+    static inline std::mutex captureMutex;
+    static inline std::thread collectorThread;
+    static inline std::thread writerThread;
+    static inline std::vector<std::pair<std::uint32_t, ProfileEvent>> captured;
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char *name) {
+        if (!Profiler::IsEnabled()) return;
+        mTrack = Profiler::ThreadTrack();
+        mName = name;
+        mDepth = mTrack->depth++;
+        mStart = Profiler::Now();
+    }
+
+    ~ProfileScope() {
+        if (!mTrack) return;
+        mTrack->depth--;
+        Profiler::Record(mTrack, mName, mStart, Profiler::Now(), mDepth);
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    Profiler::Track *mTrack = nullptr;
+    const char *mName = nullptr;
+    std::uint64_t mStart = 0;
+    std::uint32_t mDepth = 0;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_THREAD(name) Profiler::SetThreadName(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
+
+#endif //PROFILER_H
@@ -0,0 +1,54 @@
+#ifndef RADIXSORT_H
+#define RADIXSORT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/*  Stable LSD radix sort of unsigned keys with a payload, a byte per pass.
+ *  All byte histograms are counted in one sweep up front and passes where
+ *  every key has the same byte are skipped, so keys that only use their
+ *  low bits cost only as many passes as they need. The scratch vectors are
+ *  the caller's so repeated sorts don't allocate.
+ */
+template<typename Key, typename Value>
+void RadixSort(std::vector<Key> &keys, std::vector<Value> &values,
+               std::vector<Key> &keyScratch, std::vector<Value> &valueScratch) {
+    static_assert(std::is_unsigned_v<Key>, "RadixSort needs unsigned keys");
+    constexpr std::size_t Passes = sizeof(Key);
+
+    const std::size_t count = keys.size();
+    if (count < 2) return;
+
+    std::array<std::array<std::size_t, 256>, Passes> histograms{};
+    for (const Key key: keys)
+        for (std::size_t pass = 0; pass < Passes; ++pass)
+            ++histograms[pass][(key >> (pass * 8)) & 0xFF];
+
+    keyScratch.resize(count);
+    valueScratch.resize(count);
+
+    for (std::size_t pass = 0; pass < Passes; ++pass) {
+        auto &histogram = histograms[pass];
+        if (histogram[(keys[0] >> (pass * 8)) & 0xFF] == count) continue; // every key shares this byte
+
+        std::size_t offset = 0;
+        for (std::size_t &bucket: histogram) {
+            const std::size_t size = bucket;
+            bucket = offset;
+            offset += size;
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::size_t destination = histogram[(keys[i] >> (pass * 8)) & 0xFF]++;
+            keyScratch[destination] = keys[i];
+            valueScratch[destination] = values[i];
+        }
+        keys.swap(keyScratch);
+        values.swap(valueScratch);
+    }
+}
+
+#endif //RADIXSORT_H
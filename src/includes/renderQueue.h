@@ -0,0 +1,136 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "bodyInstance.h"
+#include "glState.h"
+#include "shader.h"
+
+enum class RenderPass : std::uint8_t {
+    Opaque,      // front to back
+    Transparent, // back to front, after every opaque draw
+    Overlay      // back to front, last
+};
+
+struct DrawPacket;
+
+/*  Everything about a draw except the per-body data: program, geometry and
+ *  fixed-function state. Calls are registered once at start-up and
+ *  referenced by pointer from every packet recorded against them.
+ */
+struct DrawCall {
+    Shader *shader = nullptr;
+    GLuint vao = 0;
+    RenderState state{};
+
+    GLenum primitive = GL_TRIANGLES;
+    bool indexed = false;
+    GLenum indexType = GL_UNSIGNED_INT; // or GL_UNSIGNED_SHORT
+    GLsizei count = 0;       // indices (or vertices) per instance
+    std::size_t first = 0;   // first index (or vertex)
+    GLint baseVertex = 0;
+
+    // Instanced calls read their packets' BodyInstance from binding 0 and consecutive packets
+    // merge into one draw. Other calls draw once per packet.
+    bool instanced = true;
+
+    void (*prepare)(const DrawCall &) = nullptr; // per-call uniforms, once per run of packets
+    void (*custom)(const DrawPacket &) = nullptr; // replaces the built-in draw for non-instanced calls
+
+    // Filled in by RenderQueue::Register
+    std::uint8_t id = 0;
+};
+
+struct DrawPacket {
+    std::uint64_t key;
+    const DrawCall *call;
+    GLuint texture;          // bound to unit 0, 0 for none
+    std::uint32_t userData;
+    BodyInstance instance;
+};
+
+// Collects packets for one thread; get the current thread's with RenderQueue::Local
+class RenderRecorder {
+public:
+    // `depth` is the distance from the camera, used for ordering within the pass
+    void draw(RenderPass pass, const DrawCall &call, GLuint texture, float depth, const BodyInstance &instance);
+    // For non-instanced calls; `instance` is only passed through to the call's custom draw
+    void draw(RenderPass pass, const DrawCall &call, float depth, std::uint32_t userData = 0,
+              const BodyInstance &instance = BodyInstance());
+
+    [[nodiscard]] std::size_t size() const { return packets.size(); }
+
+private:
+    friend class RenderQueue;
+
+    static std::uint64_t makeKey(RenderPass pass, const DrawCall &call, GLuint texture, float depth);
+
+    std::vector<DrawPacket> packets;
+};
+
+/*  Frame render queue. Renderers record packets with a 64-bit sort key -
+ *  pass, then program, call and texture for opaque packets (depth last, so
+ *  state changes are minimised first and overdraw second), or depth first
+ *  for blended passes so they composite back to front. Submit radix sorts
+ *  every thread's packets, merges runs that share a call and texture into
+ *  one instanced draw, and goes through GlState so nothing is rebound that
+ *  is already bound.
+ *
+ *  Recording is thread safe as long as each thread uses its own recorder;
+ *  Register and Submit are main thread only.
+ */
+class RenderQueue {
+public:
+    struct Stats {
+        std::size_t packets = 0;
+        std::size_t draws = 0;
+        std::uint64_t stateChanges = 0;
+        std::uint64_t redundantSkipped = 0;
+    };
+
+    static constexpr std::size_t MaxCalls = 256; // call ids are 8 bits of the key
+
+    static void Initialise();
+    static void Shutdown();
+
+    // The returned pointer is stable for the life of the queue
+    static const DrawCall *Register(DrawCall call);
+
+    static RenderRecorder &Local();
+
+    static void SetWireframe(bool enabled) { wireframe = enabled; }
+
+    // Sorts and draws everything recorded since the last call, then clears the recorders
+    static void Submit();
+
+    static Stats LastStats() { return stats; }
+
+private:
+    static void execute(std::size_t begin, std::size_t end);
+    static void drawRun(const DrawPacket &packet, GLuint baseInstance, GLsizei instanceCount);
+
+    static inline std::deque<DrawCall> calls;
+
+    static inline std::mutex recordersMutex;
+    static inline std::deque<RenderRecorder> recorders;
+
+    static inline std::vector<std::uint64_t> keys, keyScratch;
+    static inline std::vector<const DrawPacket *> sorted, sortedScratch;
+    static inline std::vector<GLuint> baseInstances; // per sorted packet
+    static inline std::vector<BodyInstance> instanceData;
+
+    static inline GLuint sInstanceSSBO = 0;
+    static inline std::size_t instanceCapacity = 0;
+
+    static inline bool wireframe = false;
+    static Stats stats;
+};
+
+#endif //RENDERQUEUE_H
@@ -0,0 +1,107 @@
+#ifndef SCENETARGET_H
+#define SCENETARGET_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class Shader;
+
+/*  Off-screen framebuffer the scene is drawn into, with a 32-bit float
+ *  depth buffer - the window's own framebuffer only offers fixed-point
+ *  depth, which throws away what reversed-Z gains (see Camera).
+ *  Multisampled targets are resolved into single-sample textures, which
+ *  screen-space passes can sample; Present copies the colour to the output
+ *  framebuffer - the window's, or an offscreen one when there is no window.
+ *
+ *  The scene can render below the output resolution: Size() is the
+ *  output size times the render scale, and every scene-sized target
+ *  follows it. Present then upscales with a contrast-adaptive sharpen
+ *  rather than copying. SetQuality is what DynamicResolution drives; it
+ *  reallocates the scene targets, so callers shouldn't change it often.
+ */
+class SceneTarget {
+public:
+    static constexpr GLenum ColourFormat = GL_RGBA8;
+    static constexpr GLenum DepthFormat = GL_DEPTH_COMPONENT32F;
+    static constexpr float ClearDepth = 0.0f; // reversed-Z, so 0 is infinitely far away
+    static constexpr float ClearMotion = 1.0e4f; // NoMotion in motion.glsl: nothing opaque drew here
+
+    // samples == 0 renders straight into the resolve textures. An offscreen output is for headless
+    // rendering, where framebuffer 0 doesn't exist.
+    static void Initialise(glm::ivec2 size, int samples = 8, bool offscreenOutput = false);
+    static void Shutdown();
+
+    // Full-screen pass Present upscales with when rendering below the output resolution
+    static void InitialiseUpscale(const char *vertPath, const char *fragPath);
+
+    // The output size; the render size follows it at the current scale
+    static void Resize(glm::ivec2 size);
+    // scale is per axis, clamped to [MinScale, 1]
+    static void SetQuality(float scale, int samples);
+    static void SetSharpness(float amount) { sharpness = amount; }
+    // Adds the motion vector attachment TemporalAa reads; only single-sampled targets get one
+    static void SetMotionVectors(bool enabled);
+
+    // Binds the target for drawing and clears it
+    static void Begin();
+    static void Resolve();
+    // Brings `colour`, a render-sized texture - ColourTexture, CompositeTexture or a later pass's output -
+    // to the output framebuffer at the output size, and leaves that bound
+    static void Present(GLuint colour);
+
+    // Where full-screen passes write the finished scene, at the render size
+    static GLuint CompositeFramebuffer() { return compositeFbo; }
+    static GLuint CompositeTexture() { return compositeColour; }
+    // Where finished frames go; 0 is the window
+    static GLuint OutputFramebuffer() { return outputFbo; }
+
+    static GLuint ColourTexture() { return resolvedColour; }
+    static GLuint DepthTexture() { return resolvedDepth; }
+    // RG16F NDC motion per pixel, see motion.glsl; 0 unless motion vectors are on and samples == 0
+    static GLuint MotionTexture() { return motionTexture; }
+    static glm::ivec2 Size() { return size; }
+    static glm::ivec2 OutputSize() { return outputSize; }
+    static float RenderScale() { return scale; }
+    static int Samples() { return samples; }
+
+    static constexpr float MinScale = 0.5f;
+
+private:
+    static void create();
+    static void destroy();
+    static void createOutput();
+    static void destroyOutput();
+
+    static inline glm::ivec2 size{0};
+    static inline glm::ivec2 outputSize{0};
+    static inline float scale = 1.0f;
+    static inline int samples = 0;
+    static inline float sharpness = 0.5f;
+    static inline bool motionVectors = false;
+
+    static inline Shader *sUpscaleShader = nullptr;
+    static inline GLuint sVAO = 0;
+
+    static inline GLuint multisampleFbo = 0;
+    static inline GLuint multisampleColour = 0; // renderbuffers, never sampled
+    static inline GLuint multisampleDepth = 0;
+
+    static inline GLuint resolvedFbo = 0;
+    static inline GLuint resolvedColour = 0;
+    static inline GLuint resolvedDepth = 0;
+
+    static inline GLuint compositeFbo = 0;
+    static inline GLuint compositeColour = 0;
+
+    static inline GLuint motionTexture = 0;
+
+    // Read side of Present's copy, reattached when the source changes
+    static inline GLuint presentFbo = 0;
+    static inline GLuint presentSource = 0;
+
+    static inline bool offscreen = false;
+    static inline GLuint outputFbo = 0;
+    static inline GLuint outputColour = 0;
+};
+
+#endif //SCENETARGET_H
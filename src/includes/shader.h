@@ -5,29 +5,127 @@
 
 #include "glm/glm.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 
+/*  A linked vertex + fragment program. Active uniforms and uniform blocks
+ *  are reflected once after linking, so setting a uniform by name is a hash
+ *  lookup without allocating, and never a glGetUniformLocation call.
+ *  Sources may `#include "file"` relative to their own directory.
+ *
+ *  With the cache initialised, linked programs are saved with
+ *  glGetProgramBinary, keyed on a hash of the resolved sources and the
+ *  driver, and later runs load the binary instead of compiling. Cache
+ *  misses compile without waiting: the constructor only starts the
+ *  compile and link, and the program is finished on first use, so
+ *  programs created together compile together on drivers with
+ *  KHR_parallel_shader_compile. Update reloads any program whose source
+ *  files (includes too) change on disk, keeping the old one if the new
+ *  one fails to build.
+ */
 class Shader {
 public:
+    static constexpr double WatchInterval = 0.5; // seconds between checks for changed sources
+
+    // `loader` finds the parallel compile entry point, which glad wasn't generated with
+    static void InitialiseCache(const std::string &directory, GLADloadproc loader);
+    // Deletes every program; shaders outliving the context must not touch GL afterwards
+    static void ShutdownCache();
+
+    // Main thread, once per frame: finishes programs the driver is done with and hot-reloads changed ones
+    static void Update();
+
     Shader() = default;
-    Shader(const std::string vertexPath, const std::string fragmentPath); 
-   
+    Shader(const std::string vertexPath, const std::string fragmentPath);
+    ~Shader();
+
+    Shader(const Shader &) = delete;
+    Shader &operator=(const Shader &) = delete;
+
+    // Goes through GlState, so binding the program that is already in use is free
     void bind();
-   
-    void setBool(const std::string &name, bool value) const;
-    void setInt(const std::string &name, int value) const;
-    void setFloat(const std::string &name, float value) const;
-    void setVec2(const std::string &name, glm::vec2 value) const;
-    void setVec3(const std::string &name, glm::vec3 value) const;
-    void setVec4(const std::string &name, glm::vec4 value) const;
-    void setMat4(const std::string &name, glm::mat4 matrix) const;
-    
+
+    // 0 until the first build has finished; safe to read while recording on other threads
+    [[nodiscard]] GLuint program() const { return handle.load(std::memory_order_relaxed); }
+
+    // -1 if the program has no active uniform of that name (setting it is then a no-op, as in GL)
+    [[nodiscard]] GLint location(std::string_view name) const;
+    [[nodiscard]] bool hasUniformBlock(std::string_view name) const;
+
+    void setBool(std::string_view name, bool value) const { setInt(location(name), value); }
+    void setInt(std::string_view name, int value) const { setInt(location(name), value); }
+    void setFloat(std::string_view name, float value) const { setFloat(location(name), value); }
+    void setVec2(std::string_view name, glm::vec2 value) const { setVec2(location(name), value); }
+    void setVec3(std::string_view name, glm::vec3 value) const { setVec3(location(name), value); }
+    void setVec4(std::string_view name, glm::vec4 value) const { setVec4(location(name), value); }
+    void setMat4(std::string_view name, const glm::mat4 &matrix) const { setMat4(location(name), matrix); }
+
+    // Pre-resolved locations, for callers that look them up once. A hot reload can move them.
+    void setInt(GLint location, int value) const;
+    void setFloat(GLint location, float value) const;
+    void setVec2(GLint location, glm::vec2 value) const;
+    void setVec3(GLint location, glm::vec3 value) const;
+    void setVec4(GLint location, glm::vec4 value) const;
+    void setMat4(GLint location, const glm::mat4 &matrix) const;
+
     int getAttribLoc(const std::string attribName);
 private:
-    unsigned int handle;
+    struct NameHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+    using NameTable = std::unordered_map<std::string, GLint, NameHash, std::equal_to<>>;
+
+    struct WatchedFile {
+        std::filesystem::path path;
+        std::filesystem::file_time_type modified;
+    };
+
+    // A compile and link the driver may still be working on
+    struct Build {
+        GLuint program = 0;
+        GLuint vertex = 0, fragment = 0; // kept for their logs until the link is checked
+        std::uint64_t key = 0;
+    };
+
+    static std::string loadSource(const std::string &path, std::vector<WatchedFile> &files, int depth = 0);
+
+    void startBuild();
+    // Returns false if the driver is still busy and `wait` is false
+    bool finishBuild(bool wait) const;
+    void adopt(GLuint program) const;
+    void reflect() const;
+    [[nodiscard]] bool sourcesChanged() const;
+
+    static void saveBinary(GLuint program, std::uint64_t key);
+    static GLuint loadBinary(std::uint64_t key);
+    static std::string binaryPath(std::uint64_t key);
+
+    static inline std::string cacheDirectory;
+    static inline std::string driver;           // vendor, renderer and version, part of every key
+    static inline bool parallelCompile = false; // KHR/ARB_parallel_shader_compile
+    static inline std::vector<Shader *> sShaders;
+    static inline std::chrono::steady_clock::time_point lastWatch;
+
+    std::string vertexPath, fragmentPath;
+    std::vector<WatchedFile> files;
+
+    // Finished lazily from const lookups, hence mutable. Only written on the main thread, but recording
+    // threads read it through program() for their sort keys, so it's atomic.
+    mutable std::atomic<GLuint> handle{0};
+    mutable Build pending;
+
+    mutable NameTable uniformLocations;
+    mutable NameTable uniformBlocks;
 };
 
-#endif //SHADER_H
\ No newline at end of file
+#endif //SHADER_H
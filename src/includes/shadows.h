@@ -0,0 +1,71 @@
+#ifndef SHADOWS_H
+#define SHADOWS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+struct CelestialBody;
+
+/*  Eclipse shadows between bodies, worked out analytically per fragment
+ *  (shadows.glsl): the fraction of the light's disc left uncovered by each
+ *  occluder's disc, as seen from the fragment. That gives umbra, penumbra
+ *  and annular antumbra straight from the light's angular size, with no
+ *  shadow maps.
+ *
+ *  Testing every body from every fragment would be O(pixels x bodies), so
+ *  Build culls on the CPU first. For each receiver big enough to be shaded
+ *  it keeps the bodies whose penumbra cone can reach it - at most
+ *  MaxOccluders, the largest as seen from the receiver - and writes them to
+ *  a storage buffer. Receivers find their slice of it through the shadow
+ *  range in their BodyInstance. Candidates are found by walking Culling's
+ *  hierarchy rather than the whole body list, so Build has to follow Cull
+ *  with the same centres and radii.
+ */
+class Shadows {
+public:
+    static constexpr std::size_t MaxOccluders = 4; // per receiver
+    static constexpr GLuint Binding = 2;           // storage buffer binding of the occluder spheres
+    static constexpr std::size_t ParallelGrain = 16; // receivers per thread-pool job
+
+    struct Stats {
+        std::size_t receivers = 0;
+        std::size_t occluders = 0; // summed over receivers
+    };
+
+    static void Initialise();
+    static void Shutdown();
+
+    /*  Main thread, after culling and before recording. `centres` and `radii`
+     *  are camera-relative SU for every body; `visible` are the bodies that
+     *  will be drawn. Emissive bodies neither cast nor receive shadows.
+     *  Uploads the occluder spheres and binds them at Binding.
+     */
+    static void Build(const std::vector<CelestialBody> &bodies, const std::vector<glm::vec3> &centres,
+                      const std::vector<float> &radii, const std::vector<std::uint32_t> &visible,
+                      const glm::vec3 &lightCentre, float lightRadius, float pixelScale);
+
+    // First occluder and count for a body's BodyInstance; (0, 0) if it has none. Valid until the next Build.
+    static glm::uvec2 Range(std::uint32_t body) { return body < ranges.size() ? ranges[body] : glm::uvec2(0); }
+
+    static Stats LastStats() { return stats; }
+
+private:
+    static std::size_t findOccluders(const std::vector<CelestialBody> &bodies, const std::vector<glm::vec3> &centres,
+                                     const std::vector<float> &radii, std::uint32_t receiver,
+                                     const glm::vec3 &lightCentre, float lightRadius, glm::vec4 *found);
+
+    static inline GLuint sSSBO = 0;
+    static inline std::size_t capacity = 0; // occluder spheres the buffer holds
+
+    static inline std::vector<std::uint32_t> receivers;
+    static inline std::vector<glm::vec4> spheres; // MaxOccluders slots per receiver, centre and radius
+    static inline std::vector<std::uint32_t> counts;
+    static inline std::vector<glm::uvec2> ranges; // per body
+    static Stats stats;
+};
+
+#endif //SHADOWS_H
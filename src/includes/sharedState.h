@@ -0,0 +1,96 @@
+#ifndef SHAREDSTATE_H
+#define SHAREDSTATE_H
+
+/*  Layout of the shared-memory segment the simulation publishes its body
+ *  state into, and a small C reader for it. Plain C so any tool can use it.
+ *
+ *  The segment is a header followed by two slots. The physics thread
+ *  always writes the slot that isn't active, guarded by that slot's
+ *  sequence number (odd while writing), then flips `active_slot`. Readers
+ *  look at the active slot in place and afterwards check that neither the
+ *  slot sequence nor the segment generation moved - no copies, no locks,
+ *  and the writer never waits for anyone.
+ *
+ *  When the body count outgrows the slots the writer grows the segment:
+ *  `generation` is odd while that happens and readers re-map on their own.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPACESIM_SHARED_MAGIC 0x4D495353u /* "SSIM" */
+#define SPACESIM_SHARED_VERSION 1u
+#define SPACESIM_SHARED_DEFAULT_NAME "/spacesim-state"
+#define SPACESIM_SHARED_HEADER_SIZE 128u
+
+typedef struct spacesim_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;     /* even when stable, odd while the segment is being resized */
+    uint64_t capacity;       /* body records per slot */
+    uint64_t slot_size;      /* bytes per slot; slot i starts at SPACESIM_SHARED_HEADER_SIZE + i * slot_size */
+    uint64_t active_slot;    /* slot holding the latest complete state */
+    uint64_t publish_count;
+    int64_t writer_pid;
+} spacesim_header;
+
+typedef struct spacesim_slot {
+    uint64_t sequence;       /* odd while the writer is filling this slot */
+    double time;             /* simulation time in seconds */
+    uint64_t step;           /* fixed steps taken so far */
+    uint64_t layout;         /* changes whenever bodies are added, removed or reordered */
+    uint32_t body_count;
+    uint32_t reserved[7];
+    /* followed by `capacity` spacesim_body records */
+} spacesim_slot;
+
+typedef struct spacesim_body {
+    uint32_t id;             /* stable body id, as used by the simulation */
+    uint32_t reserved;
+    double mass;             /* kg */
+    double position[3];      /* km */
+    double velocity[3];      /* km/s */
+} spacesim_body;
+
+/* ---- Reader ---- */
+
+typedef struct spacesim_reader spacesim_reader;
+
+/* A state borrowed straight from the mapping; only valid if spacesim_reader_end agrees */
+typedef struct spacesim_view {
+    double time;
+    uint64_t step;
+    uint64_t layout;
+    uint32_t body_count;
+    const spacesim_body *bodies;
+
+    uint64_t slot;
+    uint64_t sequence;
+    uint64_t generation;
+} spacesim_view;
+
+/* NULL if the segment doesn't exist or isn't a compatible version */
+spacesim_reader *spacesim_reader_open(const char *name);
+void spacesim_reader_close(spacesim_reader *reader);
+
+/* 0 on success, -1 if nothing consistent could be read right now (just try again) */
+int spacesim_reader_begin(spacesim_reader *reader, spacesim_view *view);
+/* 1 if the view was consistent the whole time it was used, 0 if it must be discarded */
+int spacesim_reader_end(spacesim_reader *reader, const spacesim_view *view);
+
+/* Copies a consistent state, retrying up to `attempts` times.
+ * Returns the number of bodies in the state (may exceed max_bodies, only max_bodies are copied) or -1. */
+int64_t spacesim_reader_copy(spacesim_reader *reader, spacesim_view *info,
+                             spacesim_body *bodies, uint32_t max_bodies, int attempts);
+
+/* Process id of the simulation that owns the segment */
+int64_t spacesim_reader_writer_pid(const spacesim_reader *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SHAREDSTATE_H
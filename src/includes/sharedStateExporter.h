@@ -0,0 +1,44 @@
+#ifndef SHAREDSTATEEXPORTER_H
+#define SHAREDSTATEEXPORTER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "physics.h"
+#include "sharedState.h"
+
+/*  Writer side of the shared-memory segment described in sharedState.h.
+ *  The physics thread calls Publish with every snapshot it makes; that is
+ *  a memcpy into the inactive slot and two atomic stores, nothing else.
+ *  External tools attach with the C reader (spacesim_reader_open).
+ */
+class SharedStateExporter {
+public:
+    static constexpr std::uint64_t InitialCapacity = 1024;
+
+    // Creates (or replaces) the segment; call before Physics::Initialise
+    static bool Initialise(const std::string &name = SPACESIM_SHARED_DEFAULT_NAME);
+    // Removes the name so no new readers attach. The mapping itself stays valid for the physics thread.
+    static void Shutdown();
+
+    static bool IsEnabled() { return enabled.load(std::memory_order_acquire); }
+
+    // Physics thread only
+    static void Publish(const PhysicsSnapshot &snapshot);
+
+private:
+    static std::uint64_t slotSizeFor(std::uint64_t capacity);
+    static bool map(std::uint64_t capacity);
+
+    static spacesim_header *header() { return reinterpret_cast<spacesim_header *>(mapping); }
+    static spacesim_slot *slot(std::uint64_t index);
+
+    static inline std::atomic<bool> enabled{false};
+    static inline std::string segmentName;
+    static inline int fd = -1;
+    static inline unsigned char *mapping = nullptr;
+    static inline std::size_t mappingSize = 0;
+};
+
+#endif //SHAREDSTATEEXPORTER_H
@@ -0,0 +1,151 @@
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "physics.h"
+
+struct SpatialIndexSettings {
+    std::chrono::milliseconds interval{16}; // how often the worker looks for a new snapshot
+    std::size_t leafSize = 4;               // bodies per leaf
+    unsigned int refitsPerRebuild = 600;    // refitted bounds loosen as bodies move apart; rebuild after this many
+};
+
+struct SpatialHit {
+    BodyId id = 0;
+    double distance = 0.0; // km: along the ray for Raycast, to the surface for the others
+};
+
+struct NameMatch {
+    BodyId id = 0;
+    std::string name;
+    int score = 0; // lower is better: 0 exact, 1 prefix, 2 substring, 2 + n for n edits away
+};
+
+/*  Bounding volume hierarchy over every simulated body, for picking,
+ *  nearest-body and radius queries without scanning the whole catalogue.
+ *
+ *  A worker thread reads Physics snapshots. When the set of bodies has
+ *  changed it builds the tree from scratch, splitting at the median along
+ *  the widest axis; otherwise it keeps the topology and only refits the
+ *  bounds bottom-up, which is linear and cheap, until refitsPerRebuild
+ *  refits have let the boxes grow loose. Node bounds are float, rounded
+ *  outwards so they always contain their bodies; the bodies themselves
+ *  are tested in double.
+ *
+ *  Finished trees are immutable and published like OrbitTrajectories, so
+ *  queries run on any thread without locking, against the snapshot the
+ *  latest tree was built from. Trees nobody holds any more are reused by
+ *  the worker rather than reallocated.
+ *
+ *  Names and radii only exist on render bodies; the main thread hands
+ *  them over with SyncCatalogue. Bodies without one are indexed as
+ *  points and can't be found by name.
+ */
+class SpatialIndex {
+public:
+    struct Stats {
+        std::size_t bodies = 0;
+        std::size_t nodes = 0;
+        double buildMs = 0.0;  // last full build
+        double refitMs = 0.0;  // last refit
+        std::uint64_t builds = 0;
+        std::uint64_t refits = 0;
+    };
+
+    static void Initialise(const SpatialIndexSettings &settings = {});
+    static void Shutdown();
+
+    // Main thread, after SyncBodies. Cheap when nothing was added or removed.
+    static void SyncCatalogue(const std::vector<CelestialBody> &bodies);
+
+    // Bodies `accept` turns down are passed over, when given
+    using Filter = std::function<bool(BodyId)>;
+
+    // The body whose surface the ray meets first or, failing that, the one passing closest to it within
+    // `tolerance` radians - how small and distant bodies get picked at all. Positions in km.
+    static std::optional<SpatialHit> Raycast(const glm::dvec3 &origin, const glm::dvec3 &direction,
+                                             double tolerance, const Filter &accept = {});
+    // Closest to `point` first
+    static std::vector<SpatialHit> Nearest(const glm::dvec3 &point, std::size_t count, const Filter &accept = {});
+    // Unordered
+    static std::vector<SpatialHit> WithinRadius(const glm::dvec3 &point, double radius);
+    // Case-insensitive, best first. Needs only the catalogue, not a finished tree.
+    static std::vector<NameMatch> FindByName(std::string_view query, std::size_t maxResults = 8);
+
+    static Stats LastStats();
+
+private:
+    // Leaves hold bodies [offset, offset + count); an internal node has count 0, its left child straight
+    // after it and its right child at offset. Children always come after their parent.
+    struct Node {
+        glm::vec3 min;
+        std::uint32_t offset;
+        glm::vec3 max;
+        std::uint32_t count;
+    };
+
+    struct Catalogue {
+        std::uint64_t signature = 0;
+        std::unordered_map<BodyId, float> radii; // km
+        std::vector<BodyId> ids;
+        std::vector<std::string> names;
+        std::vector<std::string> folded;         // lower case, for matching
+    };
+
+    // Bodies are stored in leaf order
+    struct Tree {
+        std::uint64_t build = 0;    // topology generation; refits share it
+        std::uint64_t step = 0;
+        std::uint64_t layout = 0;
+        std::uint64_t catalogue = 0;
+        std::vector<Node> nodes;
+        std::vector<BodyId> ids;
+        std::vector<std::uint32_t> sources; // snapshot index of each body
+        std::vector<glm::dvec3> centres;    // km
+        std::vector<float> radii;           // km
+    };
+
+    static void workerLoop();
+    static void update(const PhysicsSnapshot &snapshot, const Catalogue &catalogue,
+                       const SpatialIndexSettings &settings);
+    static std::uint32_t buildNode(Tree &tree, const std::vector<glm::dvec3> &positions, std::uint32_t begin,
+                                   std::uint32_t end, std::size_t leafSize);
+    static void refitBounds(Tree &tree);
+    static std::shared_ptr<Tree> acquireTree();
+
+    static std::thread workerThread;
+    static std::mutex settingsMutex;
+    static std::condition_variable wake;
+    static SpatialIndexSettings currentSettings;
+    static bool running;
+
+    // Worker-owned
+    static std::vector<std::shared_ptr<Tree>> pool;
+    static std::shared_ptr<Tree> latest;
+    static unsigned int refitsSinceBuild;
+    static std::uint64_t builds;
+
+    static std::atomic<std::shared_ptr<const Tree>> published;
+    static std::atomic<std::shared_ptr<const Catalogue>> catalogue;
+    static std::uint64_t catalogueSignature; // main thread
+
+    static std::mutex statsMutex;
+    static Stats stats;
+};
+
+#endif //SPATIALINDEX_H
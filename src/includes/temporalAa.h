@@ -0,0 +1,73 @@
+#ifndef TEMPORALAA_H
+#define TEMPORALAA_H
+
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+enum class AntiAliasing : std::uint8_t {
+    Multisample, // SceneTarget's 8x MSAA
+    Temporal
+};
+
+struct TemporalAaSettings {
+    float feedbackStill = 0.92f; // history weight where nothing moves
+    float feedbackMoving = 0.8f; // and where the image moves by several pixels a frame
+    float clipGamma = 1.25f;     // half-size of the neighbourhood box, in standard deviations
+};
+
+/*  Temporal anti-aliasing: the camera's projection is jittered by a
+ *  different sub-pixel offset every frame (a Halton 2,3 sequence), and
+ *  Resolve blends each single-sampled frame into an accumulated history,
+ *  so edges converge on a supersampled result over a few frames at the
+ *  cost of one full-screen pass instead of eight samples per pixel.
+ *
+ *  The history is reprojected with per-pixel motion vectors: opaque scene
+ *  programs write one from their body's movement relative to the camera
+ *  (BodyInstance::motion, see motion.glsl); pixels without one - blended
+ *  draws and empty sky - are reprojected from depth as if only the camera
+ *  had moved. The reprojected history is clipped to the current frame's
+ *  3x3 neighbourhood in YCoCg, which is what stops ghosting when it
+ *  disagrees with what is on screen now.
+ */
+class TemporalAa {
+public:
+    static constexpr int JitterPhases = 8;
+
+    static void InitialiseShared(const char *vertPath, const char *fragPath);
+    static void ShutdownShared();
+
+    static void SetSettings(const TemporalAaSettings &newSettings) { settings = newSettings; }
+
+    // NDC offset for the camera this frame, for a target `size` pixels across
+    static glm::vec2 Jitter(std::uint64_t frameIndex, glm::ivec2 size);
+
+    // Drops the history, for cuts and mode switches where last frame has nothing to do with this one
+    static void Reset() { historyValid = false; }
+
+    // Blends `colour`, this frame's render-sized image, into the history using SceneTarget's depth and
+    // motion textures. `cameraMotion` is the camera's movement since last frame relative to the focus
+    // body, SU. Returns the anti-aliased image, which stays valid until the next call.
+    static GLuint Resolve(GLuint colour, const glm::vec3 &cameraMotion);
+
+private:
+    static void createTargets(glm::ivec2 size);
+    static void releaseTargets();
+
+    static inline Shader *sShader = nullptr;
+    static inline GLuint sVAO = 0;
+
+    static inline TemporalAaSettings settings{};
+
+    // Ping-ponged: one is read as last frame's history while the other is written
+    static inline GLuint historyFbo[2] = {};
+    static inline GLuint historyTexture[2] = {};
+    static inline glm::ivec2 historySize{0};
+    static inline int current = 0;
+    static inline bool historyValid = false;
+};
+
+#endif //TEMPORALAA_H
@@ -0,0 +1,173 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "heightField.h"
+#include "material.h"
+#include "mpscQueue.h"
+#include "renderQueue.h"
+#include "shader.h"
+
+/*  Near-field surface of one planet: a triangle quadtree on each of the
+ *  octahedron's eight faces, projected onto the sphere and displaced by a
+ *  HeightField.
+ *
+ *  Every patch is the same PatchSegments² triangle grid, so one index
+ *  buffer serves them all and their vertices live in fixed-size slots of
+ *  one vertex buffer. Patches split into four as the camera comes within
+ *  SplitDistance patch edges of them and merge back a little further out.
+ *  Heights are generated on pool workers, never on the main thread;
+ *  finished patches wait in a bounded staging queue and at most
+ *  UploadsPerFrame of them are copied to the GPU each frame, so the main
+ *  thread never waits for one. Until all
+ *  four children of a patch have arrived the parent keeps being drawn.
+ *
+ *  Neighbouring patches of different levels don't share their edge
+ *  vertices, so every patch hangs a skirt below its edges to cover the
+ *  cracks. Vertices are stored relative to each patch's centre, which is
+ *  placed relative to the camera in double every frame.
+ */
+class Terrain {
+public:
+    static constexpr int PatchSegments = 32;          // triangle grid edge, in segments
+    static constexpr int MaxResidentPatches = 1024;   // vertex buffer slots
+    static constexpr std::size_t StagingCapacity = 64; // patches generated or generating, not yet uploaded
+    static constexpr int UploadsPerFrame = 16;
+    static constexpr double SplitDistance = 2.0;      // patch edges between the camera and a patch before it splits
+    static constexpr double MergeHysteresis = 1.25;
+    static constexpr int MaxLevel = 16;               // about 10 m between vertices on Earth
+
+    struct Stats {
+        std::size_t resident = 0;
+        std::size_t drawn = 0;
+        std::size_t generating = 0;
+        std::size_t uploaded = 0; // this frame
+    };
+
+    static void InitialiseShared(const char *vertPath, const char *fragPath);
+    static void ShutdownShared();
+
+    Terrain(double radius, const TerrainSettings &settings); // radius in km
+    ~Terrain();
+
+    Terrain(const Terrain &) = delete;
+    Terrain &operator=(const Terrain &) = delete;
+
+    /*  Uploads finished patches, splits and merges against the camera and
+     *  requests what's missing. `cameraFromCentre` is the camera relative to
+     *  the planet's centre, in km. Main thread, every frame before recording.
+     */
+    void update(const glm::dvec3 &cameraFromCentre, const Material &material);
+
+    // All eight root patches have arrived; until then the body is drawn as a plain sphere
+    [[nodiscard]] bool ready() const { return rootsResident; }
+
+    // Safe from any thread between updates. `occluders` is the body's range from Shadows::Range,
+    // `motion` the planet's as in BodyInstance.
+    void record(RenderRecorder &recorder, float depth, glm::uvec2 occluders = glm::uvec2(0),
+                const glm::vec3 &motion = glm::vec3(0.0f)) const;
+
+    [[nodiscard]] Stats lastStats() const { return stats; }
+
+    // GL objects must go before the context does
+    void release();
+
+private:
+    struct TerrainVertex {
+        glm::vec3 position;     // SU, relative to the patch centre
+        std::int16_t normal[2]; // octahedral snorm, see PackedVertex
+    };
+
+    static constexpr int GridVertices = (PatchSegments + 1) * (PatchSegments + 2) / 2;
+    static constexpr int EdgeVertices = 3 * PatchSegments;
+    static constexpr int PatchVertices = GridVertices + EdgeVertices; // grid, then one skirt vertex per edge vertex
+
+    struct Node {
+        std::array<glm::dvec3, 3> corners; // on the unit octahedron, counter-clockwise from outside
+        glm::dvec3 centre;                 // km from the planet's centre, on the sphere
+        double bound;                      // km, radius around `centre` holding every vertex
+        double edge;                       // km, longest edge
+        std::int32_t children[4] = {-1, -1, -1, -1};
+        std::int32_t slot = -1;            // vertex buffer slot once resident
+        std::uint32_t ticket = 0;          // nonzero while generating; results with another ticket are stale
+        std::uint8_t level = 0;
+        bool alive = false;
+    };
+
+    struct PatchData {
+        std::uint32_t node;
+        std::uint32_t ticket;
+        std::vector<TerrainVertex> vertices;
+    };
+
+    // Shared with generation jobs, which may still be running when the terrain goes away
+    struct Streaming {
+        Streaming(double radius, const TerrainSettings &settings) : heights(radius, settings) { }
+        ~Streaming();
+
+        HeightField heights;
+        MpscQueue<PatchData *, StagingCapacity> finished;
+    };
+
+    struct Request {
+        double distance;
+        std::uint32_t node;
+    };
+
+    static void generate(const Streaming &streaming, double radius, const Node &node, PatchData &data);
+    static void drawPatches(const DrawPacket &packet);
+
+    std::uint32_t createNode(const std::array<glm::dvec3, 3> &corners, std::uint8_t level);
+    void releaseNode(std::uint32_t index);
+    void releaseChildren(Node &node);
+
+    void receive();
+    void visit(std::uint32_t index, const glm::dvec3 &camera);
+    void request(std::uint32_t index, const glm::dvec3 &camera);
+    void submitRequests();
+
+    static inline Shader *sShader = nullptr;
+    static inline GLuint sEBO = 0;
+    static inline GLsizei sIndexCount = 0;
+    static inline const DrawCall *sCall = nullptr;
+    static inline std::vector<Terrain *> sTerrains; // packets name their terrain by index here
+
+    double radius;
+    std::shared_ptr<Streaming> streaming;
+    std::uint32_t id = 0;
+
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint originSSBO = 0;
+    std::size_t originCapacity = 0;
+
+    std::vector<Node> nodes;
+    std::vector<std::uint32_t> freeNodes;
+    std::vector<std::int32_t> freeSlots;
+    std::array<std::uint32_t, 8> roots{};
+    bool rootsResident = false;
+
+    std::uint32_t nextTicket = 1;
+    std::size_t generating = 0;
+    std::vector<Request> requests;
+
+    // What the last update chose to draw, read by record and drawPatches
+    std::vector<glm::vec4> drawOrigins; // camera-relative patch centres, SU
+    std::vector<GLint> drawBaseVertices;
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void *> drawOffsets;
+    glm::vec3 drawCentre{0.0f};         // planet centre relative to the camera, SU
+    Material drawMaterial{};
+
+    Stats stats;
+};
+
+#endif //TERRAIN_H
@@ -0,0 +1,89 @@
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+/*  Loads textures without stalling the main thread. Request hands back a
+ *  texture name straight away, holding a 1x1 placeholder; the image is
+ *  read on the thread pool, and Update uploads it through a pixel buffer
+ *  object a few MiB per frame, smallest mip first. The texture's base
+ *  level follows the finest complete mip, so a blurry version shows up
+ *  almost at once and sharpens over the next frames.
+ *
+ *  The first load of an image decodes the PNG (or whatever stb_image
+ *  reads), builds its mip chain and compresses it to BC7, then writes the
+ *  result to the cache directory. Later runs read that file and upload it
+ *  as is, with no decoding at all. Cache entries are keyed on the source
+ *  path and invalidated when its size or modification time changes.
+ */
+class TextureStreamer {
+public:
+    static constexpr std::size_t UploadBudget = std::size_t(4) << 20; // bytes per frame through the PBO
+
+    struct Stats {
+        std::size_t loading = 0;   // on the thread pool
+        std::size_t uploading = 0; // decoded, waiting for or part way through upload
+        std::size_t uploadedBytes = 0; // this frame
+        std::size_t cacheHits = 0;
+        std::size_t cacheMisses = 0;
+    };
+
+    static void Initialise(const std::string &cacheDirectory);
+    static void Shutdown();
+
+    // Main thread. `placeholder` is shown until the first mip arrives; the texture repeats and is mipmapped.
+    static GLuint Request(const std::string &path, glm::vec4 placeholder = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+
+    // Main thread, once per frame
+    static void Update();
+
+    static Stats LastStats() { return stats; }
+
+private:
+    struct Level {
+        glm::ivec2 size;
+        std::size_t offset; // into Image::data
+        std::size_t bytes;
+    };
+
+    struct Image {
+        GLuint texture = 0;
+        std::vector<Level> levels; // finest first
+        std::vector<std::uint8_t> data;
+    };
+
+    struct Upload {
+        std::unique_ptr<Image> image;
+        int level;             // counts down from the coarsest
+        int blockRow = 0;      // next row of 4x4 blocks to copy
+    };
+
+    static void load(GLuint texture, const std::string &path);
+    static std::unique_ptr<Image> readCache(const std::string &cachePath, std::uint64_t sourceSize,
+                                            std::int64_t sourceTime);
+    static void writeCache(const std::string &cachePath, const Image &image, std::uint64_t sourceSize,
+                           std::int64_t sourceTime);
+
+    static inline std::string cacheDirectory;
+    static inline GLuint sPBO = 0;
+    static inline std::vector<GLuint> textures; // every texture handed out, deleted on shutdown
+
+    static inline std::mutex finishedMutex; // guards finished, loading and the cache counters
+    static inline std::vector<std::unique_ptr<Image>> finished;
+    static inline std::size_t loading = 0;
+    static inline std::size_t cacheHits = 0, cacheMisses = 0;
+
+    static inline std::deque<Upload> uploads;
+    static Stats stats;
+};
+
+#endif //TEXTURESTREAMER_H
@@ -0,0 +1,44 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*  A small shared pool of worker threads for background jobs (orbit
+ *  prediction, culling, asset decoding, ...). Everything is static in the
+ *  same way as Physics - there is only ever one pool per process.
+ */
+class ThreadPool {
+public:
+    // workerCount == 0 picks hardware_concurrency() - 1 (at least one)
+    static void Initialise(unsigned int workerCount = 0);
+    static void Shutdown();
+
+    static unsigned int WorkerCount() { return static_cast<unsigned int>(workers.size()); }
+
+    static std::future<void> Submit(std::function<void()> job);
+
+    // Splits [0, count) into chunks of at least `grain` items and runs fn(begin, end) on each.
+    // The calling thread takes part, running this loop's chunks and never other queued jobs, so it is
+    // safe to call from a worker and never stalls the caller on someone else's work.
+    static void ParallelFor(std::size_t count, std::size_t grain,
+                            const std::function<void(std::size_t, std::size_t)> &fn);
+
+private:
+    static void workerLoop();
+
+    static std::vector<std::thread> workers;
+    static std::deque<std::packaged_task<void()>> jobs;
+    static std::mutex jobsMutex;
+    static std::condition_variable jobsAvailable;
+    static bool stopping;
+};
+
+#endif //THREADPOOL_H
@@ -1,12 +1,82 @@
 #ifndef VERTEX_H
 #define VERTEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
 #include "glm/vec2.hpp"
 #include "glm/vec3.hpp"
 
+// Build-time vertex; meshes are generated with these and packed before upload
 struct Vertex {
     glm::vec3 position = glm::vec3(0);
     glm::vec3 normal = glm::vec3(0);
     glm::vec2 uv = glm::vec2(0);
 };
 
+/*  What the sphere meshes are uploaded as: 8 bytes instead of 32. On a
+ *  unit sphere the normal is the position, so a single unit direction
+ *  stands for both, octahedral-encoded into two snorm16s (under 0.01°
+ *  worst-case error). Uvs are unorm16.
+ */
+struct PackedVertex {
+    std::int16_t direction[2];
+    std::uint16_t uv[2];
+};
+
+static_assert(sizeof(PackedVertex) == 8, "PackedVertex must stay tightly packed");
+
+// Octahedral mapping of a unit vector onto [-1, 1]²; octahedralDecode in runtime/shaders/octahedral.glsl undoes it
+inline glm::vec2 OctahedralEncode(const glm::vec3 &v) {
+    const float l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    glm::vec2 e(v.x / l1, v.y / l1);
+    if (v.z < 0.0f) {
+        const glm::vec2 folded(1.0f - std::abs(e.y), 1.0f - std::abs(e.x));
+        e = glm::vec2(e.x >= 0.0f ? folded.x : -folded.x, e.y >= 0.0f ? folded.y : -folded.y);
+    }
+    return e;
+}
+
+inline glm::vec3 OctahedralDecode(const glm::vec2 &e) {
+    glm::vec3 v(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+    if (v.z < 0.0f) {
+        const glm::vec2 folded(1.0f - std::abs(e.y), 1.0f - std::abs(e.x));
+        v.x = e.x >= 0.0f ? folded.x : -folded.x;
+        v.y = e.y >= 0.0f ? folded.y : -folded.y;
+    }
+    const float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    return v / length;
+}
+
+inline PackedVertex PackVertex(const Vertex &vertex) {
+    constexpr float SnormMax = 32767.0f;
+    constexpr float UnormMax = 65535.0f;
+
+    // Rounding each component on its own isn't always nearest on the sphere; try all four neighbours
+    const glm::vec2 e = OctahedralEncode(vertex.position);
+    const float fx = std::floor(std::clamp(e.x, -1.0f, 1.0f) * SnormMax);
+    const float fy = std::floor(std::clamp(e.y, -1.0f, 1.0f) * SnormMax);
+
+    glm::vec2 best(fx, fy);
+    float bestDot = -2.0f;
+    for (int i = 0; i < 4; ++i) {
+        const glm::vec2 candidate(std::min(fx + (i & 1), SnormMax), std::min(fy + (i >> 1), SnormMax));
+        const glm::vec3 decoded = OctahedralDecode(candidate / SnormMax);
+        const float dot = decoded.x * vertex.position.x + decoded.y * vertex.position.y +
+                          decoded.z * vertex.position.z;
+        if (dot > bestDot) {
+            bestDot = dot;
+            best = candidate;
+        }
+    }
+
+    PackedVertex packed{};
+    packed.direction[0] = static_cast<std::int16_t>(best.x);
+    packed.direction[1] = static_cast<std::int16_t>(best.y);
+    packed.uv[0] = static_cast<std::uint16_t>(std::lround(std::clamp(vertex.uv.x, 0.0f, 1.0f) * UnormMax));
+    packed.uv[1] = static_cast<std::uint16_t>(std::lround(std::clamp(vertex.uv.y, 0.0f, 1.0f) * UnormMax));
+    return packed;
+}
+
 #endif //VERTEX_H
@@ -1,3 +1,6 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <thread>
@@ -12,16 +15,42 @@
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/norm.hpp>
+#include <glm/ext/scalar_constants.hpp>
 #include <glm/gtc/random.hpp>
 
 #include "atmosphere.h"
 #include "billboard.h"
 #include "camera.h"
 #include "celestialBody.h"
+#include "culling.h"
+#include "dynamicResolution.h"
+#include "eventDetector.h"
+#include "frameCapture.h"
+#include "frameUniforms.h"
+#include "glState.h"
+#include "gpuProfiler.h"
+#include "headlessContext.h"
+#include "lod.h"
 #include "maths.h"
+#include "metrics.h"
 #include "octahedron.h"
+#include "orbitLines.h"
+#include "orbitPredictor.h"
+#include "particles.h"
+#include "performanceHud.h"
 #include "physics.h"
+#include "pointSprites.h"
+#include "profiler.h"
+#include "renderQueue.h"
+#include "sceneTarget.h"
+#include "shadows.h"
 #include "shader.h"
+#include "spatialIndex.h"
+#include "temporalAa.h"
+#include "sharedStateExporter.h"
+#include "terrain.h"
+#include "textureStreamer.h"
+#include "threadPool.h"
 
 glm::ivec2 WindowSize = glm::ivec2(1920, 1080);
 
@@ -38,55 +67,117 @@ void framebuffer_resized(GLFWwindow *window, int width, int height);
 
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
+
 #if DEBUG
 void APIENTRY glDebugOutput(GLenum source, GLenum type, unsigned int id, GLenum severity,
                             GLsizei length, const char *message, const void *userParam);
 #endif
 
-GLuint framebuffer = 0;
-GLuint colorBuffer = 0;
-GLuint depthBuffer = 0;
-
+// Everything is drawn relative to the focused body. It is held by id, since removing a body reorders
+// Physics::Bodies; RelativeBodyIndex is where it sits this frame, resolved again after every SyncBodies
+BodyId FocusId = 0;
 int RelativeBodyIndex = 0;
 
 bool RenderGrid = false;
+bool RenderOrbits = true;
 
 unsigned int RenderMode = 0;
 
+AntiAliasing AntiAliasingMode = AntiAliasing::Multisample;
+constexpr int MultisampleSamples = 8;
+
+// Switches SceneTarget between MSAA and single-sampled with motion vectors
+void setAntiAliasing(AntiAliasing mode);
+
+std::string LastEvent;
+
+void updateWindowTitle(GLFWwindow *window);
+
+// Makes the render body with this id the one everything is drawn relative to; false for bodies without one
+bool focusBody(BodyId id);
+
 int main() {
-    if (glfwInit() == GLFW_FALSE) {
-        throw std::runtime_error("[GLFW] Failed to initialise");
+    PROFILE_THREAD("Main");
+
+    // SPACESIM_HEADLESS=1 renders without a window or display (EGL, see headlessContext.h), stepping the
+    // simulation a fixed amount per frame so the output doesn't depend on how fast frames render
+    const char *headlessFlag = std::getenv("SPACESIM_HEADLESS");
+    const bool headless = headlessFlag && headlessFlag[0] == '1';
+
+    // SPACESIM_CAPTURE=<directory> writes every frame as a PPM, SPACESIM_CAPTURE=<file>.rgb as raw RGB24 video.
+    // SPACESIM_CAPTURE_SIZE=WxH sets the resolution; headless runs also take SPACESIM_CAPTURE_FPS,
+    // SPACESIM_CAPTURE_FRAMES and SPACESIM_CAPTURE_WARP (simulated seconds per second of output)
+    const char *captureTarget = std::getenv("SPACESIM_CAPTURE");
+    const bool capturing = captureTarget && captureTarget[0];
+    if (const char *size = std::getenv("SPACESIM_CAPTURE_SIZE"); size && size[0]) {
+        glm::ivec2 requested;
+        if (std::sscanf(size, "%dx%d", &requested.x, &requested.y) == 2 && requested.x > 0 && requested.y > 0)
+            WindowSize = requested;
+        else
+            std::cerr << "[Capture] Ignoring SPACESIM_CAPTURE_SIZE=" << size << ", expected WxH" << std::endl;
     }
+    auto envNumber = [](const char *name, double fallback) {
+        const char *value = std::getenv(name);
+        return value && value[0] ? std::atof(value) : fallback;
+    };
+    const double captureFps = std::max(envNumber("SPACESIM_CAPTURE_FPS", 60.0), 1.0);
+    const auto captureFrames = static_cast<std::uint64_t>(envNumber("SPACESIM_CAPTURE_FRAMES", captureFps * 10.0));
+    const double captureWarp = envNumber("SPACESIM_CAPTURE_WARP", Physics::gTimeScale.load());
+
+    GLFWwindow *window = nullptr;
+    GLADloadproc loader;
+
+    if (headless) {
+#if DEBUG
+        const bool created = HeadlessContext::Create(true);
+#else
+        const bool created = HeadlessContext::Create(false);
+#endif
+        if (!created) {
+            throw std::runtime_error("[EGL] Failed to create a headless context");
+        }
+        loader = HeadlessContext::Loader();
+    } else {
+        if (glfwInit() == GLFW_FALSE) {
+            throw std::runtime_error("[GLFW] Failed to initialise");
+        }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_SAMPLES, 8);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        // The window only receives the resolved scene, multisampling happens in SceneTarget
+        glfwWindowHint(GLFW_SAMPLES, 0);
 #if DEBUG
-    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
 #endif
 
-    auto window = glfwCreateWindow(1920, 1080, "Space Simulation", nullptr, nullptr);
-    if (window == nullptr) {
-        throw std::runtime_error("[GLFW] Failed to create window");
-    }
+        window = glfwCreateWindow(WindowSize.x, WindowSize.y, "Space Simulation", nullptr, nullptr);
+        if (window == nullptr) {
+            throw std::runtime_error("[GLFW] Failed to create window");
+        }
 
-    std::cout << "[GLFW] Window created" << std::endl;
+        std::cout << "[GLFW] Window created" << std::endl;
 
-    glfwMakeContextCurrent(window);
+        glfwMakeContextCurrent(window);
 
-    glfwSwapInterval(0);
+        glfwSwapInterval(0);
+        loader = (GLADloadproc) glfwGetProcAddress;
+    }
 
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
-        throw std::runtime_error("[GLFW] Failed to initialise GLAD");
+    if (!gladLoadGLLoader(loader)) {
+        throw std::runtime_error("[GLAD] Failed to load OpenGL");
     }
 
-    std::cout << "[GLFW] OpenGL initialised" << std::endl;
+    std::cout << "[GLAD] OpenGL " << glGetString(GL_VERSION) << " on " << glGetString(GL_RENDERER) << std::endl;
 
-    glfwSetFramebufferSizeCallback(window, framebuffer_resized);
+    if (window) {
+        glfwSetFramebufferSizeCallback(window, framebuffer_resized);
 
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetMouseButtonCallback(window, mouse_button_callback);
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
 
 #if DEBUG
     int flags;
@@ -99,11 +190,15 @@ int main() {
     }
 #endif
 
-    glViewport(0, 0, 1920, 1080);
+    glViewport(0, 0, WindowSize.x, WindowSize.y);
 
     // glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClearColor(0, 0, 0, 1.0f);
 
+    // Reversed-Z: zero-to-one clip depth, cleared to 0, nearer fragments have greater depth
+    glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+    glDepthFunc(GL_GREATER);
+    glClearDepth(SceneTarget::ClearDepth);
     glEnable(GL_DEPTH_TEST);
 
     glEnable(GL_MULTISAMPLE);
@@ -114,70 +209,84 @@ int main() {
 
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    /*
-    // Create framebuffer
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-
-    // Create color attachment
-    glGenTextures(1, &colorBuffer);
-    glBindTexture(GL_TEXTURE_2D, colorBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WindowSize.x, WindowSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorBuffer, 0);
-
-    // Create depth attachment
-    glGenTextures(1, &depthBuffer);
-    glBindTexture(GL_TEXTURE_2D, depthBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, WindowSize.x, WindowSize.y, 0, GL_DEPTH_COMPONENT, GL_FLOAT,
-                 nullptr);
-    glBindTexture(GL_TEXTURE_2D, depthBuffer);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,   GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,   GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthBuffer, 0);
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        throw std::runtime_error("Framebuffer is not complete!");
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    */
+    GpuProfiler::Initialise();
+    FrameUniforms::Initialise();
+    RenderQueue::Initialise();
+    Shadows::Initialise();
+
+    if (window) PerformanceHud::Initialise(window);
+
+    // SPACESIM_METRICS=<file> or SPACESIM_METRICS=unix:<socket> streams a JSON line of metrics every second
+    if (const char *metricsTarget = std::getenv("SPACESIM_METRICS"); metricsTarget && metricsTarget[0])
+        Metrics::StartExporter(metricsTarget);
+
+    // SPACESIM_PROFILE=1 captures from start-up, otherwise F9 starts/stops a capture
+    if (const char *profile = std::getenv("SPACESIM_PROFILE"); profile && profile[0] == '1')
+        Profiler::BeginCapture();
+
+    // SPACESIM_AA=taa starts with temporal anti-aliasing instead of MSAA; T switches between them
+    if (const char *aa = std::getenv("SPACESIM_AA"); aa && std::string(aa) == "taa")
+        AntiAliasingMode = AntiAliasing::Temporal;
+
+    // Without a window there is no default framebuffer, so the final image goes to SceneTarget's own
+    SceneTarget::Initialise(WindowSize, AntiAliasingMode == AntiAliasing::Temporal ? 0 : MultisampleSamples,
+                            headless);
+    SceneTarget::SetMotionVectors(AntiAliasingMode == AntiAliasing::Temporal);
+    if (capturing) FrameCapture::Initialise(captureTarget, WindowSize);
+
+    // Programs load from the binary cache, or start compiling here and finish when first drawn
+    Shader::InitialiseCache("../runtime/cache/shaders", loader);
+    SceneTarget::InitialiseUpscale("../runtime/shaders/ssbase.vert", "../runtime/shaders/upscale.frag");
+    TemporalAa::InitialiseShared("../runtime/shaders/ssbase.vert", "../runtime/shaders/taa-resolve.frag");
+
+    // SPACESIM_TARGET_FPS=<fps> sets the frame rate render scale and MSAA are traded to hold, 0 fixes them.
+    // Headless runs keep full quality: every frame is wanted anyway and captures should be reproducible
+    if (const double targetFps = envNumber("SPACESIM_TARGET_FPS", 60.0); !headless && targetFps > 0.0) {
+        DynamicResolutionSettings resolutionSettings;
+        resolutionSettings.targetFrameMs = 1000.0 / targetFps;
+        resolutionSettings.maxSamples = AntiAliasingMode == AntiAliasing::Temporal ? 0 : MultisampleSamples;
+        DynamicResolution::Initialise(resolutionSettings);
+    }
 
     Shader gridShader = Shader("../runtime/shaders/grid.vert", "../runtime/shaders/grid.frag");
     unsigned int gridVao;
     glGenVertexArrays(1, &gridVao);
 
-    MainCamera = new Camera(1920.0 / 1080.0);
-    MainCamera->setPosition(glm::vec3(0, kmToSu(6500), 0));
+    // The grid uses transparency, so it goes in the overlay pass after everything else
+    DrawCall gridCall;
+    gridCall.shader = &gridShader;
+    gridCall.vao = gridVao;
+    gridCall.state.blend = BlendMode::Alpha;
+    gridCall.state.cullBackFaces = false;
+    gridCall.state.allowWireframe = false;
+    gridCall.instanced = false;
+    gridCall.count = 6;
+    gridCall.prepare = [](const DrawCall &call) {
+        call.shader->setFloat("fadeDistance", 5000.0f);
+        // The grid lies in the focus body's y = 0 plane, and only near the camera, so float is plenty here
+        call.shader->setVec3("cameraOffset", glm::vec3(MainCamera->Position));
+    };
+    const DrawCall *gridDraw = RenderQueue::Register(gridCall);
+
+    MainCamera = new Camera(static_cast<float>(WindowSize.x) / static_cast<float>(WindowSize.y));
+    MainCamera->setPosition(glm::dvec3(0, kmToSu(6500), 0));
     MainCamera->setRotation(-90, -90);
 
-    Billboard::InitialiseShared("../runtime/shaders/planet-billboard.vert", "../runtime/shaders/planet-billboard.frag");
-
-    Octahedron::InitialiseShared(7, "../runtime/shaders/octahedron.vert", "../runtime/shaders/octahedron.frag");
+    Billboard::InitialiseShared();
 
-    stbi_set_flip_vertically_on_load(1);
+    Octahedron::InitialiseShared(7);
+    Octahedron::InitialiseInstancing("../runtime/shaders/octahedron-instanced.vert",
+                                     "../runtime/shaders/octahedron-instanced.frag");
+    Billboard::InitialiseImpostors("../runtime/shaders/sphere-impostor.vert",
+                                   "../runtime/shaders/sphere-impostor.frag");
+    PointSprites::InitialiseShared("../runtime/shaders/point-sprite.vert", "../runtime/shaders/point-sprite.frag");
 
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load("../runtime/textures/planet-diffuse-specular.png", &width, &height, &nrChannels, 0);
-
-    unsigned int texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    if (data) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        throw std::runtime_error("Failed to load texture");
-    }
+    OrbitLines::InitialiseShared("../runtime/shaders/orbit.vert", "../runtime/shaders/orbit.frag");
+    Particles::InitialiseShared("../runtime/shaders/particle.vert", "../runtime/shaders/particle.frag");
+    Terrain::InitialiseShared("../runtime/shaders/terrain.vert", "../runtime/shaders/terrain.frag");
 
-    stbi_image_free(data);
+    TextureStreamer::Initialise("../runtime/cache/textures");
+    const GLuint texture = TextureStreamer::Request("../runtime/textures/planet-diffuse-specular.png");
 
     Physics::Bodies.reserve(10);
 
@@ -185,11 +294,11 @@ int main() {
     sun.emissive = true;
     sun.emission = glm::vec4(1, 1, 1, 1);
     Material planet{glm::vec3(1, 1, 1)};
-    planet.albedoTexture = texture;
+    planet.albedoTexture = static_cast<int>(texture);
     Material mars{glm::vec3(153, 42, 2) / 255.0f};
 
-    Physics::Bodies.emplace_back("Sun", 1988470000000000000000000000000.0, 696340.0, glm::dvec3(0), glm::dvec3(0), sun);
-    Physics::Bodies.emplace_back("Earth", 5972200000000000000000000.0, 6371.0, glm::dvec3(149597870.7, 0, 0), glm::dvec3(0, 0, mToKm(29783)), planet); // 0,0,5
+    Physics::AddBody("Sun", 1988470000000000000000000000000.0, 696340.0, glm::dvec3(0), glm::dvec3(0), sun);
+    Physics::AddBody("Earth", 5972200000000000000000000.0, 6371.0, glm::dvec3(149597870.7, 0, 0), glm::dvec3(0, 0, mToKm(29783)), planet); // 0,0,5
 
     Material moon{glm::vec3(0.8f)}; // Slightly dimmer than Earth
 
@@ -199,13 +308,19 @@ int main() {
     glm::dvec3 moonPosition = earthPosition + glm::dvec3(384400.0, 0, 0);
     glm::dvec3 moonVelocity = earthVelocity + glm::dvec3(0, 0, mToKm(1022));
 
-    Physics::Bodies.emplace_back("Moon", 7.34767309e22, 1737.4, moonPosition, moonVelocity, moon);
+    Physics::AddBody("Moon", 7.34767309e22, 1737.4, moonPosition, moonVelocity, moon);
+
+    Physics::Bodies[1].terrain = std::make_unique<Terrain>(Physics::Bodies[1].radius, TerrainSettings{});
 
     std::cout << "Sun gravity: " << Physics::Bodies[0].surfaceGravity << " m/s²" << std::endl;
     std::cout << "Earth gravity: " << Physics::Bodies[1].surfaceGravity << " m/s²" << std::endl;
 
     Shader *atmosphereShader = new Shader("../runtime/shaders/ssbase.vert", "../runtime/shaders/atmosphere.frag");
-    Atmosphere::Initialise(atmosphereShader);
+    Shader *atmosphereReducedShader = new Shader("../runtime/shaders/ssbase.vert",
+                                                 "../runtime/shaders/atmosphere-reduced.frag");
+    Shader *atmosphereUpsampleShader = new Shader("../runtime/shaders/ssbase.vert",
+                                                  "../runtime/shaders/atmosphere-upsample.frag");
+    Atmosphere::Initialise(atmosphereShader, atmosphereReducedShader, atmosphereUpsampleShader);
 
     Atmosphere earthAtmosphere = Atmosphere();
     AtmosphereSettings earthAtmosphereSettings;
@@ -214,104 +329,386 @@ int main() {
     earthAtmosphereSettings.densityFalloff = 1;
     earthAtmosphereSettings.scatteringStrength = 4;
 
+    // Moon apsides, eclipses of Earth by the Moon, and the Moon against Earth's sphere of influence
+    const double earthSoi = deriveSphereOfInfluence(Physics::Bodies[0].mass, Physics::Bodies[1].mass,
+                                                    glm::length(earthPosition));
+    const BodyId sunId = Physics::Bodies[0].instanceId;
+    const BodyId earthId = Physics::Bodies[1].instanceId;
+    const BodyId moonId = Physics::Bodies[2].instanceId;
+    FocusId = sunId;
+    EventDetector::TrackApsides(earthId, moonId, 500000.0);
+    EventDetector::TrackSphereOfInfluence(earthId, moonId, earthSoi);
+    EventDetector::TrackEclipse(sunId, moonId, earthId, Physics::Bodies[0].radius, Physics::Bodies[2].radius,
+                                Physics::Bodies[1].radius, 1000000.0);
+
+    ThreadPool::Initialise();
+
+    // SPACESIM_SHARED_STATE=1 (or a segment name) lets external tools map the body state, see sharedState.h
+    if (const char *sharedState = std::getenv("SPACESIM_SHARED_STATE"); sharedState && sharedState[0]) {
+        std::string name = std::string(sharedState) == "1" ? SPACESIM_SHARED_DEFAULT_NAME : sharedState;
+        SharedStateExporter::Initialise(name);
+    }
+
+    // Headless runs step the simulation by hand, see the start of the loop. Frame n shows floor(n * stepsPerFrame)
+    // steps, so a fractional rate is kept exactly on average rather than rounded for every frame.
+    const double stepsPerFrame = std::max(captureWarp, 0.0) / captureFps / Physics::FixedTimeStep;
+    auto stepsAtFrame = [stepsPerFrame](std::uint64_t frame) {
+        return static_cast<std::uint64_t>(std::floor(static_cast<double>(frame) * stepsPerFrame + 1e-9));
+    };
+    if (headless) {
+        Physics::SetPaused(true);
+        if (stepsPerFrame <= 0.0)
+            std::cerr << "[Capture] SPACESIM_CAPTURE_WARP=" << captureWarp << " never advances the simulation"
+                      << std::endl;
+        else if (stepsPerFrame < 1.0)
+            std::cerr << "[Capture] SPACESIM_CAPTURE_WARP=" << captureWarp << " is under one "
+                      << Physics::FixedTimeStep << " s step per frame, frames will repeat" << std::endl;
+    }
+
     Physics::Initialise();
 
-    float lastFrameTime = 0;
-    float nextFpsUpdateTime = 0;
-    int fps = 0;
-    float frameTime = 0;
+    // SPACESIM_PARTICLES=<count> fills an asteroid belt with massless probes on circular orbits, drawn by
+    // Particles. Spawned after Initialise, as the command queue only drains once the physics thread runs.
+    if (const char *particleCount = std::getenv("SPACESIM_PARTICLES"); particleCount && particleCount[0]) {
+        const std::uint64_t count = std::strtoull(particleCount, nullptr, 10);
+        const double sunMass = Physics::Bodies[0].mass;
+        const double au = 149597870.7;
+        for (std::uint64_t i = 0; i < count; ++i) {
+            const double radius = glm::linearRand(2.2, 3.3) * au;
+            const double angle = glm::linearRand(0.0, 2.0 * glm::pi<double>());
+            const glm::dvec3 position(std::cos(angle) * radius, glm::gaussRand(0.0, 0.03) * radius,
+                                      std::sin(angle) * radius);
+            const glm::dvec3 velocity = glm::dvec3(-std::sin(angle), 0.0, std::cos(angle)) *
+                                        std::sqrt(GravitationalConstant * sunMass / radius);
+            Physics::SpawnBody(0.0, position, velocity);
+        }
+        std::cout << "[Particles] Spawned " << count << " belt particles" << std::endl;
+    }
+
+    OrbitPredictor::Initialise();
+    SpatialIndex::Initialise();
+
+    // SPACESIM_FOCUS=<name> starts focused on the closest match by name
+    if (const char *focus = std::getenv("SPACESIM_FOCUS"); focus && focus[0]) {
+        SpatialIndex::SyncCatalogue(Physics::Bodies);
+        const std::vector<NameMatch> matches = SpatialIndex::FindByName(focus, 1);
+        if (matches.empty() || !focusBody(matches.front().id))
+            std::cerr << "[Focus] No body called anything like \"" << focus << "\"" << std::endl;
+        else std::cout << "[Focus] " << matches.front().name << std::endl;
+    }
+
+    double lastFrameTime = headless ? -1.0 / captureFps : glfwGetTime();
+    std::uint64_t frameIndex = 0;
+
+    // Reused every frame: camera-relative body centres and radii in SU, and how far each centre moved
+    // relative to the camera since last frame (last minus now)
+    std::vector<glm::vec3> bodyCentres;
+    std::vector<float> bodyRadii;
+    std::vector<glm::vec3> bodyMotion;
+
+    // For TAA's reprojection of pixels without a motion vector, and to drop its history on a change of focus
+    glm::dvec3 lastCameraPosition = MainCamera->Position;
+    BodyId lastFocus = FocusId;
 
-    while (!glfwWindowShouldClose(window)) {
-        float time = glfwGetTime();
-        DeltaTime = time - lastFrameTime;
+    // The Sun by id like the focus; if it is removed the scene stays lit from where it last was
+    glm::dvec3 lightKm = Physics::Bodies[0].position;
+    double lightRadiusKm = Physics::Bodies[0].radius;
+
+    while (headless ? frameIndex < captureFrames : !glfwWindowShouldClose(window)) {
+        PROFILE_SCOPE("Frame");
+        GpuProfiler::BeginFrame();
+
+        // Headless time is the output's time, one frame every 1 / fps seconds however long rendering takes
+        double time = headless ? static_cast<double>(frameIndex) / captureFps : glfwGetTime();
+        double frameSeconds = time - lastFrameTime;
+        DeltaTime = static_cast<float>(frameSeconds);
         lastFrameTime = time;
 
-        if (time > nextFpsUpdateTime) {
-            nextFpsUpdateTime += 1.0f / 3; // 3 fps updates per second
+        Metrics::RecordFrame(static_cast<std::uint64_t>(frameSeconds * 1e9));
+
+        if (headless) {
+            PROFILE_SCOPE("Headless::WaitForPhysics");
+
+            // Frame n shows the state after exactly stepsAtFrame(n) steps
+            const std::uint64_t targetStep = stepsAtFrame(frameIndex);
+            if (frameIndex > 0 && targetStep > stepsAtFrame(frameIndex - 1))
+                Physics::SingleStep(static_cast<std::uint32_t>(targetStep - stepsAtFrame(frameIndex - 1)));
+            std::shared_ptr<const PhysicsSnapshot> snapshot;
+            while (!(snapshot = Physics::GetSnapshot()) || snapshot->step < targetStep)
+                std::this_thread::yield();
+        } else {
+            processInput(window);
+            glfwPollEvents();
+        }
+        ++frameIndex;
 
-            fps = static_cast<int>(1.0f / DeltaTime);
-            frameTime = DeltaTime * 1000;
+        // Pull the latest physics state into the render bodies; bodies may have been added or removed
+        Physics::SyncBodies();
+        if (Physics::Bodies.empty()) {
+            if (window) glfwSwapBuffers(window);
+            continue;
+        }
+        // A removed focus falls back to the first body still there
+        if (!focusBody(FocusId)) focusBody(Physics::Bodies.front().instanceId);
+        if (const CelestialBody *sun = Physics::FindBody(sunId)) {
+            lightKm = sun->position;
+            lightRadiusKm = sun->radius;
         }
+        SpatialIndex::SyncCatalogue(Physics::Bodies);
 
-        processInput(window);
-        glfwPollEvents();
+        // Start-up code and ImGui set state behind the cache's back, and glClear needs depth writes on
+        GlState::Invalidate();
+        GlState::Apply(RenderState{}, false);
 
-        // glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        DynamicResolution::BeginFrame();
+        SceneTarget::Begin();
 
+        // Each frame samples a different point inside the pixel, which TemporalAa accumulates
+        MainCamera->setJitter(AntiAliasingMode == AntiAliasing::Temporal
+                                  ? TemporalAa::Jitter(frameIndex, SceneTarget::Size())
+                                  : glm::vec2(0.0f));
         MainCamera->update();
 
-        if (RenderMode == 0)
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        else if (RenderMode == 1)
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
-        // TODO: Helper function for calculating relative positions
-        for (auto &body: Physics::Bodies) {
-            body.draw(MainCamera->worldToClip(),
-                      MainCamera->Position,
-                      /* lightPosWS */ Physics::Bodies[0].position - Physics::Bodies[RelativeBodyIndex].position,
-                      /* lightColour*/ glm::vec3(1),
-                      Physics::Bodies[RelativeBodyIndex].position);
+        const glm::vec3 cameraMotion(MainCamera->Position - lastCameraPosition);
+        lastCameraPosition = MainCamera->Position;
+        if (FocusId != lastFocus) {
+            TemporalAa::Reset();
+            lastFocus = FocusId;
+        }
+
+        // Everything is drawn relative to the camera; this is the camera's position in the simulation, in km
+        const glm::dvec3 originKm = Physics::Bodies[RelativeBodyIndex].position + suToKm(MainCamera->Position);
+
+        {
+            const std::shared_ptr<const PhysicsSnapshot> snapshot = Physics::GetSnapshot();
+
+            FrameUniformData frame;
+            frame.worldToClip = MainCamera->worldToClip();
+            frame.view = MainCamera->getViewMatrix();
+            frame.proj = MainCamera->getProjectionMatrix();
+            frame.invView = MainCamera->getInvViewMatrix();
+            frame.invProj = MainCamera->getInvProjectionMatrix();
+            frame.prevWorldToClip = MainCamera->previousWorldToClip();
+            frame.cameraPos = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            frame.lightPos = glm::vec4(relativeSu(lightKm, originKm), static_cast<float>(kmToSu(lightRadiusKm)));
+            frame.lightColour = glm::vec4(1.0f);
+            const glm::vec2 renderSize = SceneTarget::Size();
+            frame.screenSize = glm::vec4(renderSize.x, renderSize.y, 1.0f / renderSize.x, 1.0f / renderSize.y);
+            frame.time = glm::vec4(time, snapshot ? snapshot->time : 0.0, frameSeconds, 0.0f);
+            frame.jitter = glm::vec4(MainCamera->getJitter().x, MainCamera->getJitter().y,
+                                     MainCamera->previousJitter().x, MainCamera->previousJitter().y);
+            FrameUniforms::Update(frame);
         }
 
-        // Render the grid last as it uses transparency
-        if (RenderGrid) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
-            glEnable(GL_BLEND);
-            glDisable(GL_CULL_FACE);
-
-            gridShader.bind();
-            gridShader.setMat4("proj", MainCamera->getProjectionNearMatrix());
-            gridShader.setMat4("projFar", MainCamera->getProjectionMatrix());
-            gridShader.setMat4("inv_proj", MainCamera->getInvProjectionNearMatrix());
-            gridShader.setMat4("view", MainCamera->getViewMatrix());
-            gridShader.setMat4("inv_view", MainCamera->getInvViewMatrix());
-            gridShader.setVec3("cameraPos", MainCamera->Position);
-            gridShader.setFloat("nearPlane", 0.5f);
-            gridShader.setFloat("farPlane", 5000.0f);
-            glBindVertexArray(gridVao);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            glBindVertexArray(0);
-
-            glDisable(GL_BLEND);
-            glEnable(GL_CULL_FACE);
-
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            glViewport(0, 0, WindowSize.x, WindowSize.y);
+        RenderQueue::SetWireframe(RenderMode == 1);
+
+        Shader::Update();
+        TextureStreamer::Update();
+
+        {
+            PROFILE_SCOPE("Terrain::Update");
+
+            // Uploads whatever patches finished since last frame and asks for the ones now in reach
+            if (CelestialBody *earth = Physics::FindBody(earthId); earth && earth->terrain)
+                earth->terrain->update(originKm - earth->position, earth->material);
         }
 
-        /*
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        {
+            PROFILE_SCOPE("Render::Record");
+
+            // In rendered pixels, so a lower render scale also lowers detail
+            const float pixelScale = Lod::PixelScale(static_cast<float>(SceneTarget::Size().y),
+                                                     glm::radians(Camera::FieldOfView));
+
+            // Camera-relative centres, worked out in double for every body in one pass; culling and drawing
+            // both use them, so nothing downstream ever sees a large float coordinate
+            const std::size_t bodyCount = Physics::Bodies.size();
+            bodyCentres.resize(bodyCount);
+            bodyRadii.resize(bodyCount);
+            bodyMotion.resize(bodyCount);
+            ThreadPool::ParallelFor(bodyCount, 8192, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; ++i) {
+                    CelestialBody &body = Physics::Bodies[i];
+                    bodyCentres[i] = relativeSu(body.position, originKm);
+                    bodyRadii[i] = static_cast<float>(kmToSu(body.radius));
+                    bodyMotion[i] = body.lastCentre.w > 0.0f ? glm::vec3(body.lastCentre) - bodyCentres[i]
+                                                             : glm::vec3(0.0f);
+                    body.lastCentre = glm::vec4(bodyCentres[i], 1.0f);
+                }
+            });
+
+            // Only bodies that survive frustum and occlusion culling are recorded at all
+            const std::vector<std::uint32_t> &visible =
+                    Culling::Cull(bodyCentres, bodyRadii, MainCamera->worldToClip(), glm::vec3(0.0f));
+
+            // Eclipses: each visible body gets the few bodies that can come between it and the Sun
+            Shadows::Build(Physics::Bodies, bodyCentres, bodyRadii, visible, relativeSu(lightKm, originKm),
+                           static_cast<float>(kmToSu(lightRadiusKm)), pixelScale);
+
+            // Each worker records into its own queue; the sort in Submit makes the order they finish in irrelevant
+            ThreadPool::ParallelFor(visible.size(), 2048, [&](std::size_t begin, std::size_t end) {
+                RenderRecorder &recorder = RenderQueue::Local();
+                for (std::size_t i = begin; i < end; ++i)
+                    Physics::Bodies[visible[i]].queueDraw(recorder, bodyCentres[visible[i]], pixelScale,
+                                                          Shadows::Range(visible[i]), bodyMotion[visible[i]]);
+            });
+
+            // Predicted orbits are drawn from the last finished prediction, never waiting on the predictor
+            if (RenderOrbits) {
+                if (auto trajectories = OrbitPredictor::GetTrajectories())
+                    OrbitLines::Record(RenderQueue::Local(), *trajectories,
+                                       trajectories->indexOf(Physics::Bodies[RelativeBodyIndex].instanceId),
+                                       glm::vec3(-MainCamera->Position));
+            }
+
+            // Everything simulated without a render body, straight from the snapshot into the mapped buffer
+            if (const std::shared_ptr<const PhysicsSnapshot> snapshot = Physics::GetSnapshot()) {
+                Particles::Update(*snapshot, originKm);
+                Particles::Record(RenderQueue::Local());
+            }
+
+            if (RenderGrid)
+                RenderQueue::Local().draw(RenderPass::Overlay, *gridDraw, 0.0f);
+        }
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffer);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, depthBuffer);
+        RenderQueue::Submit();
+        SceneTarget::Resolve();
+
+        // The atmosphere composites the resolved scene at the render size; until its tables are baked, present it as is
+        {
+            CelestialBody *earth = Physics::FindBody(earthId);
+            CelestialBody *sunBody = Physics::FindBody(sunId);
+            bool composited = false;
+            if (earth && sunBody) {
+                GPU_PROFILE_SCOPE("Render::Atmosphere");
+                composited = earthAtmosphere.render(earthAtmosphereSettings, relativeSu(earth->position, originKm),
+                                                    relativeSu(sunBody->position, originKm));
+            }
+            // TAA goes last, over the composited image, so the atmosphere is anti-aliased along with the rest
+            GLuint finished = composited ? SceneTarget::CompositeTexture() : SceneTarget::ColourTexture();
+            if (AntiAliasingMode == AntiAliasing::Temporal) finished = TemporalAa::Resolve(finished, cameraMotion);
+            SceneTarget::Present(finished);
+        }
+
+        // Before the HUD, so recordings show only the scene
+        FrameCapture::Capture(SceneTarget::OutputFramebuffer());
+        DynamicResolution::EndFrame();
 
-        earthAtmosphere.render(earthAtmosphereSettings, MainCamera, Bodies[1].position - Bodies[RelativeBodyIndex].position, Bodies[0].position - Bodies[RelativeBodyIndex].position);
-        */
+        if (window) {
+            GPU_PROFILE_SCOPE("Render::Hud");
+            PerformanceHud::Draw(frameSeconds * 1000.0);
+        }
 
         // std::cout << "Camera Position: (" << MainCamera->Position.x << ", " << MainCamera->Position.y << ", " << MainCamera->Position.z << ") Rotation: (" << MainCamera->Yaw << ", " << MainCamera->Pitch << ")" << std::endl;
 
-        glfwSwapBuffers(window);
+        if (window) {
+            PROFILE_SCOPE("SwapBuffers");
+            glfwSwapBuffers(window);
+        } else if (frameIndex % static_cast<std::uint64_t>(captureFps) == 0 || frameIndex == captureFrames) {
+            std::cout << "[Headless] Rendered " << frameIndex << " / " << captureFrames << " frames" << std::endl;
+        }
+
+        SimulationEvent event;
+        while (EventDetector::PollEvent(event)) {
+            auto bodyName = [](BodyId id) {
+                CelestialBody *body = Physics::FindBody(id);
+                return body ? body->name : "#" + std::to_string(id);
+            };
+
+            std::ostringstream message;
+            message << eventTypeName(event.type) << ": " << bodyName(event.bodyB) << " / "
+                    << bodyName(event.bodyA) << " at " << event.distance << " km (t = " << event.time << " s)";
+            LastEvent = message.str();
+            std::cout << "[Events] " << LastEvent << std::endl;
+        }
 
-        std::ostringstream title;
-        title << frameTime << " ms (" << fps << " fps)  ×" << Physics::gTimeScale.load() << " | Rendering relative to body: " <<
-                Physics::Bodies[RelativeBodyIndex].name;
-        glfwSetWindowTitle(window, title.str().c_str());
+        if (window) updateWindowTitle(window);
     }
 
-    glfwDestroyWindow(window);
-    glfwPollEvents();
-    glfwTerminate();
+    // Everything still in flight is written out before the context goes
+    FrameCapture::Finish();
+
+    if (Profiler::IsCapturing())
+        Profiler::EndCapture("profile-exit.json");
+    Profiler::Shutdown();
+
+    Metrics::StopExporter();
+    SharedStateExporter::Shutdown();
+
+    OrbitPredictor::Shutdown();
+    SpatialIndex::Shutdown();
+    ThreadPool::Shutdown();
+
+    if (window) PerformanceHud::Shutdown();
+    GpuProfiler::Shutdown();
+    FrameUniforms::Shutdown();
+    Shadows::Shutdown();
+
+    OrbitLines::ShutdownShared();
+    Particles::ShutdownShared();
+    PointSprites::ShutdownShared();
+    Billboard::ShutdownShared();
+    Octahedron::ShutdownShared();
+    for (CelestialBody &body: Physics::Bodies) body.terrain.reset();
+    Terrain::ShutdownShared();
+    TextureStreamer::Shutdown();
+    earthAtmosphere.release();
+    RenderQueue::Shutdown();
+    DynamicResolution::Shutdown();
+    TemporalAa::ShutdownShared();
+    SceneTarget::Shutdown();
+    Shader::ShutdownCache();
+
+    if (window) {
+        glfwDestroyWindow(window);
+        glfwPollEvents();
+        glfwTerminate();
+    } else {
+        HeadlessContext::Destroy();
+    }
 
     return 0;
 }
 
+// Performance numbers live in the HUD now, so the title only changes with focus, warp or events
+void updateWindowTitle(GLFWwindow *window) {
+    static BodyId titleBody = UINT32_MAX;
+    static double titleTimeScale = -1.0;
+    static bool titleSkipping = false;
+    static bool titlePaused = false;
+    static std::string titleEvent;
+
+    const double timeScale = Physics::gTimeScale.load();
+    const bool skipping = Physics::gSkipToNextEvent.load();
+    const bool paused = Physics::IsPaused();
+    const BodyId body = Physics::Bodies[RelativeBodyIndex].instanceId;
+    if (titleBody == body && titleTimeScale == timeScale && titleSkipping == skipping &&
+        titlePaused == paused && titleEvent == LastEvent)
+        return;
+
+    titleBody = body;
+    titleTimeScale = timeScale;
+    titleSkipping = skipping;
+    titlePaused = paused;
+    titleEvent = LastEvent;
+
+    std::ostringstream title;
+    title << "Space Simulation  ×" << timeScale << " | Rendering relative to body: " <<
+            Physics::Bodies[RelativeBodyIndex].name;
+    if (paused) title << " | Paused";
+    if (skipping) title << " | Skipping to next event...";
+    else if (!LastEvent.empty()) title << " | " << LastEvent;
+    glfwSetWindowTitle(window, title.str().c_str());
+}
+
+bool focusBody(BodyId id) {
+    CelestialBody *body = Physics::FindBody(id);
+    if (!body) return false;
+    FocusId = id;
+    RelativeBodyIndex = static_cast<int>(body - Physics::Bodies.data());
+    return true;
+}
+
 void framebuffer_resized(GLFWwindow *window, int width, int height) {
     glViewport(0, 0, width, height);
 
@@ -320,17 +717,28 @@ void framebuffer_resized(GLFWwindow *window, int width, int height) {
     float aspect = width / (float) height;
     MainCamera->setAspect(aspect);
 
-    /*
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    glBindTexture(GL_TEXTURE_2D, colorBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    glBindTexture(GL_TEXTURE_2D, depthBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    */
+    SceneTarget::Resize(WindowSize);
+}
+
+void setAntiAliasing(AntiAliasing mode) {
+    if (mode == AntiAliasingMode) return;
+    AntiAliasingMode = mode;
+
+    // TAA replaces the samples rather than adding to them; dynamic resolution keeps its current scale
+    const int samples = mode == AntiAliasing::Temporal ? 0 : MultisampleSamples;
+    SceneTarget::SetMotionVectors(mode == AntiAliasing::Temporal);
+    SceneTarget::SetQuality(SceneTarget::RenderScale(), samples);
+    DynamicResolution::SetMaxSamples(samples);
+    TemporalAa::Reset();
+
+    std::cout << "[Render] Anti-aliasing: " << (mode == AntiAliasing::Temporal ? "temporal" : "8x MSAA")
+              << std::endl;
 }
 
 void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
+    // A released cursor is for clicking on bodies, not for looking around
+    if (glfwGetInputMode(window, GLFW_CURSOR) != GLFW_CURSOR_DISABLED) return;
+
     if (firstMouse) {
         firstMouse = false;
         lastX = xpos;
@@ -349,6 +757,32 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
     MainCamera->rotate(xoffset, yoffset);
 }
 
+// Clicking focuses the body under the cursor - the crosshair at the centre while the cursor drives the camera
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods) {
+    if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS || Physics::Bodies.empty()) return;
+
+    glm::vec2 ndc(0.0f);
+    if (glfwGetInputMode(window, GLFW_CURSOR) != GLFW_CURSOR_DISABLED) {
+        double x, y;
+        glfwGetCursorPos(window, &x, &y);
+        int width, height;
+        glfwGetWindowSize(window, &width, &height);
+        ndc = glm::vec2(2.0 * x / std::max(width, 1) - 1.0, 1.0 - 2.0 * y / std::max(height, 1));
+    }
+
+    // A few pixels of slack, or nothing smaller than a pixel could ever be clicked on
+    constexpr double PickPixels = 4.0;
+    const double pixelAngle = 2.0 * std::tan(glm::radians(Camera::FieldOfView) * 0.5) / std::max(WindowSize.y, 1);
+
+    const glm::dvec3 originKm = Physics::Bodies[RelativeBodyIndex].position + suToKm(MainCamera->Position);
+    // Probes have no render body to focus on
+    const auto hit = SpatialIndex::Raycast(originKm, glm::dvec3(MainCamera->screenRay(ndc)), PickPixels * pixelAngle,
+                                           [](BodyId id) { return Physics::FindBody(id) != nullptr; });
+    if (hit && focusBody(hit->id))
+        std::cout << "[Focus] " << Physics::Bodies[RelativeBodyIndex].name << ", " << hit->distance << " km away"
+                  << std::endl;
+}
+
 void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) glfwSetWindowShouldClose(window, GLFW_TRUE);
 
@@ -400,13 +834,30 @@ void processInput(GLFWwindow *window) {
 
     if (glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS) {
         if (!tabKeyHeld) {
-            RelativeBodyIndex = (RelativeBodyIndex + 1) % Physics::Bodies.size();
+            focusBody(Physics::Bodies[(RelativeBodyIndex + 1) % Physics::Bodies.size()].instanceId);
             tabKeyHeld = true;
         }
     } else {
         tabKeyHeld = false;
     }
 
+    // N focuses the nearest body other than the current one
+    static bool nKeyHeld = false;
+
+    if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) {
+        if (!nKeyHeld) {
+            const CelestialBody &focus = Physics::Bodies[RelativeBodyIndex];
+            const glm::dvec3 originKm = focus.position + suToKm(MainCamera->Position);
+            const auto nearest = SpatialIndex::Nearest(originKm, 1, [&focus](BodyId id) {
+                return id != focus.instanceId && Physics::FindBody(id) != nullptr;
+            });
+            if (!nearest.empty()) focusBody(nearest.front().id);
+            nKeyHeld = true;
+        }
+    } else {
+        nKeyHeld = false;
+    }
+
     static bool gKeyHeld = false;
 
     if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
@@ -417,6 +868,107 @@ void processInput(GLFWwindow *window) {
     } else {
         gKeyHeld = false;
     }
+
+    static bool jKeyHeld = false;
+
+    // Jump the clock to the next tracked event
+    if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS) {
+        if (!jKeyHeld) {
+            Physics::gSkipToNextEvent = !Physics::gSkipToNextEvent.load();
+            jKeyHeld = true;
+        }
+    } else {
+        jKeyHeld = false;
+    }
+
+    static bool f9KeyHeld = false;
+
+    // Start / stop a profiler capture, written as Chrome trace JSON (chrome://tracing or ui.perfetto.dev)
+    if (glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS) {
+        if (!f9KeyHeld) {
+            if (Profiler::IsCapturing()) {
+                std::ostringstream path;
+                path << "profile-" << std::chrono::system_clock::now().time_since_epoch().count() << ".json";
+                Profiler::EndCapture(path.str());
+            } else {
+                Profiler::BeginCapture();
+            }
+            f9KeyHeld = true;
+        }
+    } else {
+        f9KeyHeld = false;
+    }
+
+    static bool pKeyHeld = false;
+
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
+        if (!pKeyHeld) {
+            Physics::SetPaused(!Physics::IsPaused());
+            pKeyHeld = true;
+        }
+    } else {
+        pKeyHeld = false;
+    }
+
+    static bool periodKeyHeld = false;
+
+    // Single fixed step while paused
+    if (glfwGetKey(window, GLFW_KEY_PERIOD) == GLFW_PRESS) {
+        if (!periodKeyHeld) {
+            Physics::SingleStep();
+            periodKeyHeld = true;
+        }
+    } else {
+        periodKeyHeld = false;
+    }
+
+    static bool f3KeyHeld = false;
+
+    if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS) {
+        if (!f3KeyHeld) {
+            PerformanceHud::Visible = !PerformanceHud::Visible;
+            f3KeyHeld = true;
+        }
+    } else {
+        f3KeyHeld = false;
+    }
+
+    static bool tKeyHeld = false;
+
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) {
+        if (!tKeyHeld) {
+            setAntiAliasing(AntiAliasingMode == AntiAliasing::Temporal ? AntiAliasing::Multisample
+                                                                       : AntiAliasing::Temporal);
+            tKeyHeld = true;
+        }
+    } else {
+        tKeyHeld = false;
+    }
+
+    static bool oKeyHeld = false;
+
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) {
+        if (!oKeyHeld) {
+            RenderOrbits = !RenderOrbits;
+            oKeyHeld = true;
+        }
+    } else {
+        oKeyHeld = false;
+    }
+
+    // C releases the cursor so bodies can be clicked on where they are, and captures it again for mouse-look
+    static bool cKeyHeld = false;
+
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
+        if (!cKeyHeld) {
+            const bool captured = glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_DISABLED;
+            glfwSetInputMode(window, GLFW_CURSOR, captured ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
+            firstMouse = true; // the cursor has moved on since it was last captured, don't jerk the camera
+            cKeyHeld = true;
+        }
+    } else {
+        cKeyHeld = false;
+    }
 }
 
 #if DEBUG
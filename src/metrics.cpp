@@ -0,0 +1,187 @@
+#include "metrics.h"
+
+#include <bit>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef __unix__
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "profiler.h"
+
+int LatencyHistogram::bucketOf(std::uint64_t ns) {
+    if (ns < SubBuckets) return static_cast<int>(ns);
+
+    // Top three bits below the most significant one pick the linear step inside its power of two
+    int msb = 63 - std::countl_zero(ns);
+    int sub = static_cast<int>((ns >> (msb - 3)) & (SubBuckets - 1));
+    int bucket = (msb - 2) * SubBuckets + sub;
+    return bucket < BucketCount ? bucket : BucketCount - 1;
+}
+
+double LatencyHistogram::bucketValue(int bucket) {
+    if (bucket < SubBuckets) return bucket;
+
+    int msb = bucket / SubBuckets + 2;
+    int sub = bucket % SubBuckets;
+    double width = static_cast<double>(1ull << (msb - 3));
+    return (SubBuckets + sub) * width + width * 0.5;
+}
+
+double LatencyHistogram::percentile(const Counts &from, const Counts &to, double p) {
+    std::uint64_t total = 0;
+    for (int i = 0; i < BucketCount; ++i) total += to[i] - from[i];
+    if (total == 0) return 0.0;
+
+    const double target = p * static_cast<double>(total);
+    std::uint64_t cumulative = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        cumulative += to[i] - from[i];
+        if (static_cast<double>(cumulative) >= target && to[i] != from[i]) return bucketValue(i);
+    }
+    return bucketValue(BucketCount - 1);
+}
+
+MetricsSnapshot Metrics::Sample(Window &window) {
+    Window now;
+    now.time = std::chrono::steady_clock::now();
+    frameTimes.read(now.frameCounts);
+    now.frames = frames.load(std::memory_order_relaxed);
+    now.frameNanoseconds = frameNanoseconds.load(std::memory_order_relaxed);
+    now.physicsSteps = physicsSteps.load(std::memory_order_relaxed);
+    now.forceEvaluations = forceEvaluations.load(std::memory_order_relaxed);
+    now.simulationTime = simulationTime.load(std::memory_order_relaxed);
+
+    MetricsSnapshot snapshot;
+    snapshot.wallTime = std::chrono::duration<double>(now.time - startTime).count();
+    snapshot.windowSeconds = std::chrono::duration<double>(now.time - window.time).count();
+
+    const double seconds = snapshot.windowSeconds > 0.0 ? snapshot.windowSeconds : 1.0;
+    const std::uint64_t windowFrames = now.frames - window.frames;
+
+    snapshot.fps = windowFrames / seconds;
+    snapshot.frameTimeAverage = windowFrames ? (now.frameNanoseconds - window.frameNanoseconds) / 1e6 / windowFrames : 0.0;
+    snapshot.frameTimeP50 = LatencyHistogram::percentile(window.frameCounts, now.frameCounts, 0.50) / 1e6;
+    snapshot.frameTimeP99 = LatencyHistogram::percentile(window.frameCounts, now.frameCounts, 0.99) / 1e6;
+    snapshot.frameTimeMax = LatencyHistogram::percentile(window.frameCounts, now.frameCounts, 1.0) / 1e6;
+
+    snapshot.physicsStepsPerSecond = (now.physicsSteps - window.physicsSteps) / seconds;
+    snapshot.requestedWarp = requestedWarp.load(std::memory_order_relaxed);
+    snapshot.achievedWarp = (now.simulationTime - window.simulationTime) / seconds;
+    snapshot.accumulatorBacklog = accumulatorBacklog.load(std::memory_order_relaxed);
+    snapshot.simulationTime = now.simulationTime;
+
+    snapshot.forceEvaluations = now.forceEvaluations;
+    snapshot.forceEvaluationsPerSecond = (now.forceEvaluations - window.forceEvaluations) / seconds;
+    snapshot.bodyCount = bodyCount.load(std::memory_order_relaxed);
+
+    snapshot.residentBytes = ResidentMemoryBytes();
+
+    window = now;
+    return snapshot;
+}
+
+std::uint64_t Metrics::ResidentMemoryBytes() {
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    std::uint64_t size = 0, resident = 0;
+    if (statm >> size >> resident) return resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+    return 0;
+}
+
+std::string MetricsSnapshot::toJson() const {
+    std::ostringstream json;
+    json << "{\"wallTime\":" << wallTime
+         << ",\"window\":" << windowSeconds
+         << ",\"fps\":" << fps
+         << ",\"frameMs\":{\"avg\":" << frameTimeAverage << ",\"p50\":" << frameTimeP50
+         << ",\"p99\":" << frameTimeP99 << ",\"max\":" << frameTimeMax << "}"
+         << ",\"physicsStepsPerSecond\":" << physicsStepsPerSecond
+         << ",\"warp\":{\"requested\":" << requestedWarp << ",\"achieved\":" << achievedWarp << "}"
+         << ",\"accumulatorBacklog\":" << accumulatorBacklog
+         << ",\"simulationTime\":" << simulationTime
+         << ",\"forceEvaluations\":" << forceEvaluations
+         << ",\"forceEvaluationsPerSecond\":" << forceEvaluationsPerSecond
+         << ",\"bodies\":" << bodyCount
+         << ",\"residentBytes\":" << residentBytes << "}";
+    return json.str();
+}
+
+void Metrics::StartExporter(const std::string &target, std::chrono::milliseconds interval) {
+    if (exporterRunning.exchange(true)) return;
+    // A previous exporter that gave up on its target has exited but not been joined
+    if (exporterThread.joinable()) exporterThread.join();
+    exporterThread = std::thread(&Metrics::exporterLoop, target, interval);
+}
+
+void Metrics::StopExporter() {
+    // Joined even when the exporter already gave up, or the thread would still be joinable at exit
+    exporterRunning = false;
+    if (exporterThread.joinable()) exporterThread.join();
+}
+
+void Metrics::exporterLoop(std::string target, std::chrono::milliseconds interval) {
+    PROFILE_THREAD("MetricsExporter");
+
+    const std::string socketPrefix = "unix:";
+    const bool useSocket = target.rfind(socketPrefix, 0) == 0;
+
+    std::ofstream file;
+    int socketHandle = -1;
+#ifdef __unix__
+    sockaddr_un address{};
+#endif
+
+    if (useSocket) {
+#ifdef __unix__
+        const std::string socketPath = target.substr(socketPrefix.size());
+        socketHandle = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if (socketHandle < 0) {
+            std::cerr << "[Metrics] Failed to create a socket for " << socketPath << std::endl;
+            exporterRunning = false;
+            return;
+        }
+        address.sun_family = AF_UNIX;
+        socketPath.copy(address.sun_path, sizeof(address.sun_path) - 1);
+#else
+        std::cerr << "[Metrics] Unix sockets are not supported on this platform" << std::endl;
+        exporterRunning = false;
+        return;
+#endif
+    } else {
+        file.open(target, std::ios::app);
+        if (!file) {
+            std::cerr << "[Metrics] Failed to open " << target << std::endl;
+            exporterRunning = false;
+            return;
+        }
+    }
+
+    std::cout << "[Metrics] Exporting to " << target << std::endl;
+
+    Window window;
+    while (exporterRunning.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(interval);
+
+        const std::string line = Sample(window).toJson();
+        if (useSocket) {
+#ifdef __unix__
+            // Datagrams are simply dropped while nobody is listening
+            sendto(socketHandle, line.data(), line.size(), MSG_DONTWAIT,
+                   reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+#endif
+        } else {
+            file << line << '\n';
+            file.flush();
+        }
+    }
+
+#ifdef __unix__
+    if (socketHandle >= 0) close(socketHandle);
+#endif
+}
@@ -0,0 +1,223 @@
+#include "orbitPredictor.h"
+
+#include <cmath>
+
+#include "profiler.h"
+#include "threadPool.h"
+
+std::thread OrbitPredictor::workerThread;
+std::mutex OrbitPredictor::settingsMutex;
+std::condition_variable OrbitPredictor::wake;
+OrbitPredictionSettings OrbitPredictor::currentSettings{};
+bool OrbitPredictor::running = false;
+bool OrbitPredictor::dirty = true;
+
+std::deque<OrbitPredictor::Frame> OrbitPredictor::frames{};
+std::vector<BodyId> OrbitPredictor::ids{};
+std::vector<double> OrbitPredictor::masses{};
+std::uint64_t OrbitPredictor::version = 0;
+
+std::atomic<std::shared_ptr<const OrbitTrajectories>> OrbitPredictor::trajectories{};
+
+// Bodies below this count aren't worth splitting across the pool
+constexpr std::size_t ParallelForceThreshold = 64;
+
+void OrbitPredictor::Initialise(const OrbitPredictionSettings &settings) {
+    if (running) return;
+
+    currentSettings = settings;
+    dirty = true;
+    running = true;
+    workerThread = std::thread(&OrbitPredictor::workerLoop);
+}
+
+void OrbitPredictor::Shutdown() {
+    {
+        std::lock_guard lock(settingsMutex);
+        if (!running) return;
+        running = false;
+    }
+    wake.notify_all();
+    if (workerThread.joinable()) workerThread.join();
+}
+
+void OrbitPredictor::SetSettings(const OrbitPredictionSettings &settings) {
+    {
+        std::lock_guard lock(settingsMutex);
+        currentSettings = settings;
+        dirty = true;
+    }
+    wake.notify_all();
+}
+
+OrbitPredictionSettings OrbitPredictor::GetSettings() {
+    std::lock_guard lock(settingsMutex);
+    return currentSettings;
+}
+
+void OrbitPredictor::Invalidate() {
+    {
+        std::lock_guard lock(settingsMutex);
+        dirty = true;
+    }
+    wake.notify_all();
+}
+
+void OrbitPredictor::workerLoop() {
+    PROFILE_THREAD("OrbitPredictor");
+
+    std::uint64_t lastStep = UINT64_MAX;
+
+    while (true) {
+        OrbitPredictionSettings settings;
+        bool full;
+        {
+            std::unique_lock lock(settingsMutex);
+            wake.wait_for(lock, currentSettings.interval, [] { return !running || dirty; });
+            if (!running) return;
+
+            settings = currentSettings;
+            full = dirty;
+            dirty = false;
+        }
+
+        std::shared_ptr<const PhysicsSnapshot> snapshot = Physics::GetSnapshot();
+        if (!snapshot) continue;
+        if (!full && snapshot->step == lastStep) continue;
+
+        lastStep = snapshot->step;
+        update(*snapshot, settings, full);
+    }
+}
+
+void OrbitPredictor::update(const PhysicsSnapshot &snapshot, const OrbitPredictionSettings &settings, bool full) {
+    PROFILE_SCOPE("OrbitPredictor::Update");
+
+    const double sampleInterval = settings.horizon / std::max(1u, settings.sampleCount);
+
+    // Massless probes don't pull on anything, so leaving them out changes none of the other paths,
+    // and spawning or removing one doesn't force a recompute
+    std::vector<BodyId> massiveIds;
+    std::vector<double> massiveMasses;
+    Frame now{snapshot.time};
+    for (std::size_t i = 0; i < snapshot.masses.size(); ++i) {
+        if (snapshot.masses[i] == 0.0) continue;
+        massiveIds.push_back(snapshot.ids[i]);
+        massiveMasses.push_back(snapshot.masses[i]);
+        now.positions.push_back(snapshot.positions[i]);
+        now.velocities.push_back(snapshot.velocities[i]);
+    }
+
+    if (!full) {
+        full = frames.empty() || massiveIds != ids || massiveMasses != masses ||
+               frames.front().time > snapshot.time;
+    }
+
+    if (!full) {
+        // Drop samples that are now in the past, keeping the one just before `now` to interpolate from
+        std::size_t dropped = 0;
+        while (frames.size() >= 2 && frames[1].time <= snapshot.time) {
+            frames.pop_front();
+            ++dropped;
+        }
+
+        if (frames.size() < 2 || diverged(now, settings)) {
+            full = true;
+        } else if (dropped == 0) {
+            return; // Nothing went stale, the published prediction is still valid
+        }
+    }
+
+    if (full) {
+        ids = std::move(massiveIds);
+        masses = std::move(massiveMasses);
+        frames.clear();
+        frames.push_back(std::move(now));
+    }
+
+    // Only the stale tail is integrated - everything still ahead of `now` is kept as is
+    const double endTime = snapshot.time + settings.horizon;
+    while (frames.back().time < endTime) {
+        frames.push_back(integrate(frames.back(), sampleInterval, settings.integrationStep));
+    }
+
+    publish();
+}
+
+bool OrbitPredictor::diverged(const Frame &now, const OrbitPredictionSettings &settings) {
+    const Frame &a = frames[0];
+    const Frame &b = frames[1];
+    const double dt = b.time - a.time;
+    const double s = dt > 0.0 ? (now.time - a.time) / dt : 0.0;
+
+    const double positionTolerance2 = settings.positionTolerance * settings.positionTolerance;
+    const double velocityTolerance2 = settings.velocityTolerance * settings.velocityTolerance;
+
+    for (std::size_t i = 0; i < masses.size(); ++i) {
+        glm::dvec3 predictedPosition = hermitePosition(a.positions[i], a.velocities[i],
+                                                       b.positions[i], b.velocities[i], dt, s);
+        glm::dvec3 predictedVelocity = glm::mix(a.velocities[i], b.velocities[i], s);
+
+        if (glm::distance2(predictedPosition, now.positions[i]) > positionTolerance2) return true;
+        if (glm::distance2(predictedVelocity, now.velocities[i]) > velocityTolerance2) return true;
+    }
+
+    return false;
+}
+
+OrbitPredictor::Frame OrbitPredictor::integrate(const Frame &from, double duration, double maxStep) {
+    const std::size_t count = masses.size();
+    const int steps = std::max(1, static_cast<int>(std::ceil(duration / maxStep)));
+    const double h = duration / steps;
+
+    Frame frame = from;
+    frame.time += duration;
+
+    std::vector<glm::dvec3> accelerations(count);
+    auto evaluate = [&] {
+        if (count >= ParallelForceThreshold) {
+            ThreadPool::ParallelFor(count, ParallelForceThreshold / 4, [&](std::size_t begin, std::size_t end) {
+                Physics::computeAccelerations(masses, frame.positions, accelerations, begin, end);
+            });
+        } else {
+            Physics::computeAccelerations(masses, frame.positions, accelerations, 0, count);
+        }
+    };
+
+    // Same kick-drift-kick scheme as the physics thread, just with a coarser step
+    evaluate();
+    for (int s = 0; s < steps; ++s) {
+        for (std::size_t i = 0; i < count; ++i)
+            frame.velocities[i] += accelerations[i] * (h * 0.5);
+        for (std::size_t i = 0; i < count; ++i)
+            frame.positions[i] += frame.velocities[i] * h;
+
+        evaluate();
+
+        for (std::size_t i = 0; i < count; ++i)
+            frame.velocities[i] += accelerations[i] * (h * 0.5);
+    }
+
+    return frame;
+}
+
+void OrbitPredictor::publish() {
+    PROFILE_SCOPE("OrbitPredictor::Publish");
+
+    auto result = std::make_shared<OrbitTrajectories>();
+    result->version = ++version;
+    result->startTime = frames.front().time;
+    result->sampleInterval = frames.size() > 1 ? frames[1].time - frames[0].time : 0.0;
+    result->bodyCount = masses.size();
+    result->sampleCount = frames.size();
+    result->ids = ids;
+    result->points.resize(result->bodyCount * result->sampleCount);
+
+    for (std::size_t k = 0; k < frames.size(); ++k) {
+        for (std::size_t body = 0; body < result->bodyCount; ++body) {
+            result->points[body * result->sampleCount + k] = frames[k].positions[body];
+        }
+    }
+
+    trajectories.store(std::move(result), std::memory_order_release);
+}
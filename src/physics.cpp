@@ -1,90 +1,372 @@
 #include "physics.h"
 
+#include <algorithm>
+
+#include "eventDetector.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "sharedStateExporter.h"
+
 // Define static members
 std::atomic<double> Physics::gTimeScale{1.0};
+std::atomic<bool> Physics::gSkipToNextEvent{false};
 std::vector<CelestialBody> Physics::Bodies{};
 std::thread Physics::physicsThread;
+std::atomic<std::shared_ptr<const PhysicsSnapshot>> Physics::latestSnapshot{};
+MpscQueue<PhysicsCommand, Physics::CommandCapacity> Physics::commands{};
+std::atomic<bool> Physics::pausedState{false};
+std::uint64_t Physics::syncedLayout = UINT64_MAX;
+std::unordered_map<BodyId, std::size_t> Physics::syncedIndices{};
 
 void Physics::Initialise() {
     physicsThread = std::thread(&Physics::updatePhysics);
     physicsThread.detach();
 }
 
-std::vector<glm::dvec3> Physics::computeAccelerations(const std::vector<CelestialBody> &Bodies, const std::vector<glm::dvec3> &positions) {
-    std::vector<glm::dvec3> accelerations(Bodies.size(), glm::dvec3(0));
+void Physics::Submit(const PhysicsCommand &command) {
+    while (!commands.tryPush(command)) std::this_thread::yield();
+}
+
+BodyId Physics::SpawnBody(double mass, const glm::dvec3 &position, const glm::dvec3 &velocity) {
+    const BodyId id = CelestialBody::nextId.fetch_add(1, std::memory_order_relaxed);
+    Submit({PhysicsCommandType::Spawn, id, 0, mass, position, velocity});
+    return id;
+}
+
+void Physics::RemoveBody(BodyId id) {
+    Submit({PhysicsCommandType::Remove, id});
+}
+
+void Physics::SetBodyMass(BodyId id, double mass) {
+    Submit({PhysicsCommandType::SetMass, id, 0, mass});
+}
+
+void Physics::SetBodyState(BodyId id, const glm::dvec3 &position, const glm::dvec3 &velocity) {
+    Submit({PhysicsCommandType::SetState, id, 0, 0.0, position, velocity});
+}
+
+void Physics::SetPaused(bool paused) {
+    Submit({paused ? PhysicsCommandType::Pause : PhysicsCommandType::Resume});
+}
+
+void Physics::SingleStep(std::uint32_t steps) {
+    Submit({PhysicsCommandType::Step, 0, steps});
+}
+
+void Physics::SyncBodies() {
+    PROFILE_SCOPE("Physics::SyncBodies");
+
+    std::shared_ptr<const PhysicsSnapshot> snapshot = GetSnapshot();
+    if (!snapshot) return;
+
+    if (snapshot->layout != syncedLayout) {
+        syncedIndices.clear();
+        for (std::size_t i = 0; i < snapshot->ids.size(); ++i) syncedIndices[snapshot->ids[i]] = i;
+        syncedLayout = snapshot->layout;
+    }
+
+    bool removed = false;
+    for (auto &body: Bodies) {
+        auto found = syncedIndices.find(body.instanceId);
+        if (found == syncedIndices.end()) {
+            // Either its spawn hasn't been applied yet, or the simulation has dropped it
+            removed |= body.simulated;
+            continue;
+        }
 
-    for (size_t i = 0; i < Bodies.size(); ++i) {
-        for (size_t j = 0; j < Bodies.size(); ++j) {
+        body.simulated = true;
+        body.mass = snapshot->masses[found->second];
+        body.position = snapshot->positions[found->second];
+        body.velocity = snapshot->velocities[found->second];
+    }
+
+    if (removed) {
+        // CelestialBody can't be move-assigned (const members), so rebuild the list instead of erasing
+        std::vector<CelestialBody> kept;
+        kept.reserve(Bodies.capacity());
+        for (auto &body: Bodies)
+            if (!body.simulated || syncedIndices.contains(body.instanceId)) kept.push_back(std::move(body));
+        Bodies = std::move(kept);
+    }
+}
+
+CelestialBody *Physics::FindBody(BodyId id) {
+    for (auto &body: Bodies)
+        if (body.instanceId == id) return &body;
+    return nullptr;
+}
+
+std::vector<glm::dvec3> Physics::computeAccelerations(const std::vector<double> &masses, const std::vector<glm::dvec3> &positions) {
+    std::vector<glm::dvec3> accelerations(masses.size(), glm::dvec3(0));
+    computeAccelerations(masses, positions, accelerations, 0, masses.size());
+    return accelerations;
+}
+
+void Physics::computeAccelerations(const std::vector<double> &masses, const std::vector<glm::dvec3> &positions,
+                                   std::vector<glm::dvec3> &accelerations, std::size_t begin, std::size_t end) {
+    PROFILE_SCOPE("Physics::ForceEval");
+
+    // Massless probes feel gravity but don't pull on anything, so only the massive bodies are sources.
+    // With many probes (particle rings and belts) that makes the loop O(bodies x massive bodies).
+    thread_local std::vector<std::size_t> sources;
+    sources.clear();
+    for (size_t j = 0; j < masses.size(); ++j)
+        if (masses[j] != 0.0) sources.push_back(j);
+
+    for (size_t i = begin; i < end; ++i) {
+        glm::dvec3 acceleration(0);
+
+        for (const size_t j: sources) {
             if (i == j) continue;
 
             glm::dvec3 dir = positions[j] - positions[i];
             double sqrDist = glm::length2(dir);
 
             if (sqrDist > 0.0001) {
-                glm::dvec3 forceDir = glm::normalize(dir);
-                glm::dvec3 force = forceDir * GravitationalConstant *
-                                   (Bodies[i].mass * Bodies[j].mass) / sqrDist;
-
-                accelerations[i] += force / Bodies[i].mass;
+                // a = G·m_j / r² along the unit direction, the mass of body i cancels out
+                acceleration += dir * (GravitationalConstant * masses[j] / (sqrDist * std::sqrt(sqrDist)));
             }
         }
-    }
 
-    return accelerations;
+        accelerations[i] = acceleration;
+    }
 }
 
 void Physics::updatePhysics() {
-    const double fixedTimeStep = 1.0 / 100;
+    PROFILE_THREAD("Physics");
+
+    const double fixedTimeStep = FixedTimeStep;
     double accumulator = 0.0;
+    double simulationTime = 0.0;
+    std::uint64_t stepCount = 0;
+    std::uint64_t layout = 0;
     auto lastTime = std::chrono::high_resolution_clock::now();
 
-    // Initialise shadow state
+    bool paused = false;
+    std::uint64_t requestedSteps = 0;
+
+    // Simulation state, owned by this thread. Removing a body moves the last one into its slot, so the
+    // arrays stay dense; they only ever grow by push_back, so spawning many bodies reallocates rarely.
+    std::vector<BodyId> ids;
+    std::vector<double> masses;
     std::vector<glm::dvec3> positions;
     std::vector<glm::dvec3> velocities;
+    std::vector<glm::dvec3> accelerations;
+    std::vector<glm::dvec3> newAccelerations;
+    std::unordered_map<BodyId, std::size_t> indices;
 
-    for (const auto& body : Bodies) {
-        positions.push_back(body.position);
-        velocities.push_back(body.velocity);
-    }
+    // State at the start of the current step, only kept while events are being watched
+    std::vector<glm::dvec3> previousPositions;
+    std::vector<glm::dvec3> previousVelocities;
 
-    std::vector<glm::dvec3> accelerations = computeAccelerations(Bodies, positions);
+    auto evaluateForces = [&](std::vector<glm::dvec3> &target) {
+        target.resize(masses.size());
+        computeAccelerations(masses, positions, target, 0, masses.size());
+    };
+
+    // Drains the command queue; returns true if the bodies changed
+    auto applyCommands = [&] {
+        bool layoutChanged = false;
+        bool stateChanged = false;
+
+        PhysicsCommand command;
+        while (commands.tryPop(command)) {
+            auto found = indices.find(command.id);
+            const bool exists = found != indices.end();
+
+            switch (command.type) {
+                case PhysicsCommandType::Spawn:
+                    if (exists) break;
+                    indices[command.id] = ids.size();
+                    ids.push_back(command.id);
+                    masses.push_back(command.mass);
+                    positions.push_back(command.position);
+                    velocities.push_back(command.velocity);
+                    layoutChanged = true;
+                    break;
+
+                case PhysicsCommandType::Remove: {
+                    if (!exists) break;
+                    const std::size_t index = found->second;
+                    const std::size_t last = ids.size() - 1;
+                    if (index != last) {
+                        ids[index] = ids[last];
+                        masses[index] = masses[last];
+                        positions[index] = positions[last];
+                        velocities[index] = velocities[last];
+                        indices[ids[index]] = index;
+                    }
+                    ids.pop_back();
+                    masses.pop_back();
+                    positions.pop_back();
+                    velocities.pop_back();
+                    indices.erase(command.id);
+                    layoutChanged = true;
+                    break;
+                }
+
+                case PhysicsCommandType::SetMass:
+                    if (!exists) break;
+                    masses[found->second] = command.mass;
+                    stateChanged = true;
+                    break;
+
+                case PhysicsCommandType::SetState:
+                    if (!exists) break;
+                    positions[found->second] = command.position;
+                    velocities[found->second] = command.velocity;
+                    stateChanged = true;
+                    break;
+
+                case PhysicsCommandType::Pause:
+                    paused = true;
+                    break;
+
+                case PhysicsCommandType::Resume:
+                    paused = false;
+                    requestedSteps = 0;
+                    break;
+
+                case PhysicsCommandType::Step:
+                    requestedSteps += command.steps;
+                    break;
+            }
+        }
+
+        pausedState.store(paused, std::memory_order_relaxed);
+
+        if (layoutChanged) {
+            ++layout;
+            EventDetector::SetBodyLayout(ids);
+        }
+
+        // One O(N²) evaluation for the whole batch, however many commands it held
+        if (layoutChanged || stateChanged) evaluateForces(accelerations);
+        return layoutChanged || stateChanged;
+    };
+
+    // Snapshots are recycled once no reader holds them any more, so publishing doesn't allocate every loop
+    std::vector<std::shared_ptr<PhysicsSnapshot>> snapshotPool;
+    auto publishSnapshot = [&] {
+        PROFILE_SCOPE("Physics::PublishSnapshot");
+
+        std::shared_ptr<PhysicsSnapshot> snapshot;
+        for (auto &candidate: snapshotPool) {
+            if (candidate.use_count() == 1) {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                snapshot = candidate;
+                break;
+            }
+        }
+        if (!snapshot) snapshot = snapshotPool.emplace_back(std::make_shared<PhysicsSnapshot>());
+
+        snapshot->time = simulationTime;
+        snapshot->step = stepCount;
+        snapshot->layout = layout;
+        snapshot->ids = ids;
+        snapshot->masses = masses;
+        snapshot->positions = positions;
+        snapshot->velocities = velocities;
+
+        latestSnapshot.store(snapshot, std::memory_order_release);
+
+        if (SharedStateExporter::IsEnabled()) SharedStateExporter::Publish(*snapshot);
+    };
+
+    applyCommands();
+    publishSnapshot();
 
     while (true) {
+        const bool changed = applyCommands();
+
         auto now = std::chrono::high_resolution_clock::now();
         double frameTime = std::chrono::duration<double>(now - lastTime).count();
         lastTime = now;
 
         frameTime = std::min(frameTime, 0.05); // cap huge spikes
-        frameTime *= gTimeScale.load(std::memory_order_relaxed);
-        accumulator += frameTime;
+        const double timeScale = gTimeScale.load(std::memory_order_relaxed);
+        frameTime *= timeScale;
+
+        if (paused) {
+            // Only requested steps run; half a step of slack so rounding can't swallow the last one
+            accumulator = requestedSteps > 0 ? (requestedSteps + 0.5) * fixedTimeStep : 0.0;
+            requestedSteps = 0;
+        } else {
+            accumulator += frameTime;
+
+            if (gSkipToNextEvent.load(std::memory_order_relaxed))
+                accumulator = std::max(accumulator, SkipBatchSteps * fixedTimeStep);
+        }
+
+        bool stepped = accumulator >= fixedTimeStep;
+        const std::uint64_t firstStep = stepCount;
+        const std::size_t count = ids.size();
 
         while (accumulator >= fixedTimeStep) {
-            // Kick: update velocity by half-step
-            for (size_t i = 0; i < Bodies.size(); ++i)
-                velocities[i] += accelerations[i] * (fixedTimeStep * 0.5);
+            PROFILE_SCOPE("Physics::Step");
+
+            const bool detectEvents = EventDetector::HasWatches();
+            if (detectEvents) {
+                previousPositions = positions;
+                previousVelocities = velocities;
+            }
+
+            {
+                PROFILE_SCOPE("Physics::KickDrift");
 
-            // Drift: update position
-            for (size_t i = 0; i < Bodies.size(); ++i)
-                positions[i] += velocities[i] * fixedTimeStep;
+                // Kick: update velocity by half-step
+                for (size_t i = 0; i < count; ++i)
+                    velocities[i] += accelerations[i] * (fixedTimeStep * 0.5);
+
+                // Drift: update position
+                for (size_t i = 0; i < count; ++i)
+                    positions[i] += velocities[i] * fixedTimeStep;
+            }
 
             // Recompute accelerations at new positions
-            std::vector<glm::dvec3> newAccelerations = computeAccelerations(Bodies, positions);
+            evaluateForces(newAccelerations);
 
-            // Kick: complete velocity update
-            for (size_t i = 0; i < Bodies.size(); ++i)
-                velocities[i] += newAccelerations[i] * (fixedTimeStep * 0.5);
+            {
+                PROFILE_SCOPE("Physics::Kick");
+
+                // Kick: complete velocity update
+                for (size_t i = 0; i < count; ++i)
+                    velocities[i] += newAccelerations[i] * (fixedTimeStep * 0.5);
+            }
 
             // Prepare for next iteration
-            accelerations = std::move(newAccelerations);
+            std::swap(accelerations, newAccelerations);
             accumulator -= fixedTimeStep;
+
+            if (detectEvents && EventDetector::ProcessStep(simulationTime, fixedTimeStep,
+                                                           previousPositions, previousVelocities,
+                                                           positions, velocities)) {
+                // Stop right after the step containing the event when the user asked to jump to it
+                if (gSkipToNextEvent.exchange(false)) accumulator = 0.0;
+            }
+
+            simulationTime += fixedTimeStep;
+            ++stepCount;
         }
 
-        // Push state back to Bodies (once per frame)
-        for (size_t i = 0; i < Bodies.size(); ++i) {
-            Bodies[i].position = positions[i];
-            Bodies[i].velocity = velocities[i];
+        if (paused) accumulator = 0.0;
+
+        // One force evaluation is one pairwise interaction, so this stays comparable if the solver changes.
+        // Only massive bodies are sources: every body feels each of them except itself.
+        const std::uint64_t batchSteps = stepCount - firstStep;
+        const std::uint64_t sources = std::count_if(masses.begin(), masses.end(), [](double m) { return m != 0.0; });
+        const std::uint64_t pairs = masses.size() * sources - sources;
+        Metrics::RecordPhysics(batchSteps, simulationTime, accumulator, paused ? 0.0 : timeScale, masses.size());
+        Metrics::RecordForceEvaluations(batchSteps * pairs);
+
+        if (!stepped && !changed) {
+            // Nothing to integrate while paused, so don't spin a core waiting for commands
+            if (paused) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
         }
 
+        publishSnapshot();
+
         // Allow background thread to yield
         // std::this_thread::sleep_for(std::chrono::milliseconds(1)); // Removed to allow the simulation to run at full speed, even if it causes visually laggy results
     }
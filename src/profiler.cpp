@@ -0,0 +1,151 @@
+#include "profiler.h"
+
+#include <fstream>
+#include <iostream>
+
+Profiler::Track *Profiler::CreateTrack(const char *name) {
+    std::lock_guard lock(tracksMutex);
+    auto &track = tracks.emplace_back(std::make_unique<Track>());
+    track->name = name;
+    track->id = static_cast<std::uint32_t>(tracks.size());
+    track->collected = 0;
+    return track.get();
+}
+
+namespace {
+    thread_local Profiler::Track *threadTrack = nullptr;
+    thread_local const char *threadName = "Thread";
+}
+
+Profiler::Track *Profiler::ThreadTrack() {
+    // Created on the first recorded zone, so threads cost nothing until a capture actually runs
+    if (!threadTrack) threadTrack = CreateTrack(threadName);
+    return threadTrack;
+}
+
+void Profiler::SetThreadName(const char *name) {
+    threadName = name;
+    if (!threadTrack) return;
+
+    std::lock_guard lock(tracksMutex);
+    threadTrack->name = name;
+}
+
+void Profiler::BeginCapture() {
+    std::lock_guard lock(captureMutex);
+    if (capturing) return;
+
+    captured.clear();
+    {
+        std::lock_guard tracksLock(tracksMutex);
+        for (auto &track: tracks) {
+            track->collected = track->head.load(std::memory_order_acquire);
+            track->lost = 0;
+        }
+    }
+
+    capturing = true;
+    enabled = true;
+    collectorThread = std::thread(&Profiler::collectorLoop);
+
+    std::cout << "[Profiler] Capture started" << std::endl;
+}
+
+void Profiler::EndCapture(const std::string &path) {
+    std::lock_guard lock(captureMutex);
+    if (!capturing) return;
+
+    enabled = false;
+    capturing = false;
+    if (collectorThread.joinable()) collectorThread.join();
+
+    collect(captured);
+
+    std::uint64_t lost = 0;
+    {
+        std::lock_guard tracksLock(tracksMutex);
+        for (auto &track: tracks) lost += track->lost;
+    }
+
+    std::cout << "[Profiler] Captured " << captured.size() << " zones (" << lost << " lost), writing " << path << std::endl;
+
+    // Serialising can take a while for long captures, keep it off the calling (usually render) thread.
+    // One trace is written at a time; a capture ended while the last is still writing waits for it here.
+    if (writerThread.joinable()) writerThread.join();
+    writerThread = std::thread([events = std::move(captured), path] { writeTrace(path, events); });
+    captured = {};
+}
+
+void Profiler::Shutdown() {
+    std::lock_guard lock(captureMutex);
+    if (writerThread.joinable()) writerThread.join();
+}
+
+void Profiler::collectorLoop() {
+    PROFILE_THREAD("Profiler");
+
+    while (capturing.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        collect(captured);
+    }
+}
+
+void Profiler::collect(std::vector<std::pair<std::uint32_t, ProfileEvent>> &out) {
+    std::lock_guard lock(tracksMutex);
+
+    for (auto &track: tracks) {
+        const std::uint64_t head = track->head.load(std::memory_order_acquire);
+        std::uint64_t begin = track->collected;
+        if (head - begin > TrackCapacity) {
+            track->lost += head - TrackCapacity - begin;
+            begin = head - TrackCapacity;
+        }
+
+        const std::size_t firstOut = out.size();
+        for (std::uint64_t i = begin; i < head; ++i)
+            out.emplace_back(track->id, track->events[i & (TrackCapacity - 1)]);
+
+        // Anything the producer lapped while we were copying may be torn, drop it
+        const std::uint64_t headAfter = track->head.load(std::memory_order_acquire);
+        if (headAfter - begin > TrackCapacity) {
+            std::uint64_t overwritten = std::min<std::uint64_t>(headAfter - TrackCapacity - begin, head - begin);
+            out.erase(out.begin() + static_cast<std::ptrdiff_t>(firstOut),
+                      out.begin() + static_cast<std::ptrdiff_t>(firstOut + overwritten));
+            track->lost += overwritten;
+        }
+
+        track->collected = head;
+    }
+}
+
+void Profiler::writeTrace(const std::string &path, const std::vector<std::pair<std::uint32_t, ProfileEvent>> &events) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "[Profiler] Failed to open " << path << std::endl;
+        return;
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool first = true;
+    {
+        std::lock_guard lock(tracksMutex);
+        for (auto &track: tracks) {
+            file << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << track->id
+                 << ",\"args\":{\"name\":\"" << track->name << "\"}}";
+            first = false;
+        }
+    }
+
+    file.precision(3);
+    file << std::fixed;
+    for (const auto &[tid, event]: events) {
+        file << (first ? "" : ",\n") << "{\"ph\":\"X\",\"name\":\"" << event.name << "\",\"pid\":1,\"tid\":" << tid
+             << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0
+             << ",\"args\":{\"depth\":" << event.depth << "}}";
+        first = false;
+    }
+
+    file << "\n]}\n";
+    std::cout << "[Profiler] Wrote " << path << std::endl;
+}
@@ -0,0 +1,415 @@
+#include "atmosphere.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "glState.h"
+#include "gpuProfiler.h"
+#include "profiler.h"
+#include "sceneTarget.h"
+#include "threadPool.h"
+
+namespace {
+    constexpr float Pi = 3.14159265358979f;
+    constexpr int ScatteringSteps = 20; // per direction when baking multiple scattering
+
+    // Everything the bake needs, in the same SU units as the shader
+    struct Geometry {
+        float planetRadius;
+        float atmosphereRadius;
+        float horizon; // distance to the horizon from the top of the atmosphere
+        float scaleHeight;
+        glm::vec3 scattering;
+    };
+
+    glm::vec3 extinction(const glm::vec3 &opticalDepth) {
+        return {std::exp(-opticalDepth.x), std::exp(-opticalDepth.y), std::exp(-opticalDepth.z)};
+    }
+
+    float density(const Geometry &g, float r) {
+        return std::exp(-(r - g.planetRadius) / g.scaleHeight);
+    }
+
+    float distanceToTop(const Geometry &g, float r, float mu) {
+        const float discriminant = r * r * (mu * mu - 1.0f) + g.atmosphereRadius * g.atmosphereRadius;
+        return std::max(0.0f, -r * mu + std::sqrt(std::max(discriminant, 0.0f)));
+    }
+
+    bool hitsPlanet(const Geometry &g, float r, float mu) {
+        return mu < 0.0f && r * r * (mu * mu - 1.0f) + g.planetRadius * g.planetRadius >= 0.0f;
+    }
+
+    // Transmittance texture coordinates, mirrored by transmittanceUv in atmosphere.frag
+    glm::vec2 transmittanceUv(const Geometry &g, float r, float mu) {
+        const float rho = std::sqrt(std::max(r * r - g.planetRadius * g.planetRadius, 0.0f));
+        const float d = distanceToTop(g, r, mu);
+        const float dMin = g.atmosphereRadius - r;
+        const float dMax = rho + g.horizon;
+        return {dMax > dMin ? (d - dMin) / (dMax - dMin) : 0.0f, rho / g.horizon};
+    }
+
+    void transmittanceParameters(const Geometry &g, glm::vec2 uv, float &r, float &mu) {
+        const float rho = g.horizon * uv.y;
+        r = std::sqrt(rho * rho + g.planetRadius * g.planetRadius);
+        const float dMin = g.atmosphereRadius - r;
+        const float dMax = rho + g.horizon;
+        const float d = dMin + uv.x * (dMax - dMin);
+        mu = d <= 0.0f ? 1.0f : (g.horizon * g.horizon - rho * rho - d * d) / (2.0f * r * d);
+        mu = std::clamp(mu, -1.0f, 1.0f);
+    }
+
+    // Bilinear lookup into the CPU copy of the transmittance table
+    glm::vec3 sunTransmittance(const Geometry &g, const std::vector<float> &table, float r, float mu) {
+        if (hitsPlanet(g, r, mu)) return glm::vec3(0.0f);
+
+        const glm::vec2 uv = transmittanceUv(g, r, mu);
+        const float x = std::clamp(uv.x * AtmosphereLuts::TransmittanceWidth - 0.5f, 0.0f,
+                                   AtmosphereLuts::TransmittanceWidth - 1.0f);
+        const float y = std::clamp(uv.y * AtmosphereLuts::TransmittanceHeight - 0.5f, 0.0f,
+                                   AtmosphereLuts::TransmittanceHeight - 1.0f);
+        const int x0 = static_cast<int>(x), y0 = static_cast<int>(y);
+        const int x1 = std::min(x0 + 1, AtmosphereLuts::TransmittanceWidth - 1);
+        const int y1 = std::min(y0 + 1, AtmosphereLuts::TransmittanceHeight - 1);
+        const float fx = x - x0, fy = y - y0;
+
+        auto at = [&](int px, int py) { return table[py * AtmosphereLuts::TransmittanceWidth + px]; };
+        const float depth = (at(x0, y0) * (1 - fx) + at(x1, y0) * fx) * (1 - fy) +
+                            (at(x0, y1) * (1 - fx) + at(x1, y1) * fx) * fy;
+        return extinction(g.scattering * depth);
+    }
+}
+
+glm::vec3 AtmosphereSettings::scatteringCoefficients() const {
+    return glm::vec3(std::pow(400.0f / wavelengths.r, 4.0f),
+                     std::pow(400.0f / wavelengths.g, 4.0f),
+                     std::pow(400.0f / wavelengths.b, 4.0f)) * scatteringStrength;
+}
+
+bool AtmosphereSettings::sameTables(const AtmosphereSettings &other) const {
+    return atmosphereRadius == other.atmosphereRadius && planetRadius == other.planetRadius &&
+           numOpticalDepthPoints == other.numOpticalDepthPoints && scaleHeight == other.scaleHeight &&
+           wavelengths == other.wavelengths && scatteringStrength == other.scatteringStrength;
+}
+
+std::shared_ptr<AtmosphereLuts::Tables> AtmosphereLuts::bake(const AtmosphereSettings &settings) {
+    PROFILE_SCOPE("Atmosphere::BakeLuts");
+
+    Geometry g{};
+    g.planetRadius = settings.planetRadius;
+    g.atmosphereRadius = std::max(settings.atmosphereRadius, settings.planetRadius * 1.0001f);
+    g.horizon = std::sqrt(g.atmosphereRadius * g.atmosphereRadius - g.planetRadius * g.planetRadius);
+    g.scaleHeight = std::max(settings.scaleHeight, 1e-3f);
+    g.scattering = settings.scatteringCoefficients();
+
+    const int steps = std::max(settings.numOpticalDepthPoints, 2);
+
+    auto tables = std::make_shared<Tables>();
+    tables->opticalDepth.resize(TransmittanceWidth * TransmittanceHeight);
+    tables->multipleScattering.resize(ScatteringWidth * ScatteringHeight);
+
+    // Optical depth to the top of the atmosphere, midpoint rule
+    ThreadPool::ParallelFor(TransmittanceHeight, 4, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t y = begin; y < end; ++y) {
+            for (int x = 0; x < TransmittanceWidth; ++x) {
+                float r, mu;
+                transmittanceParameters(g, {(x + 0.5f) / TransmittanceWidth, (y + 0.5f) / TransmittanceHeight}, r, mu);
+
+                const float length = distanceToTop(g, r, mu);
+                const float dt = length / steps;
+                float depth = 0.0f;
+                for (int i = 0; i < steps; ++i) {
+                    const float t = (i + 0.5f) * dt;
+                    const float sampleR = std::sqrt(r * r + t * t + 2.0f * r * mu * t);
+                    depth += density(g, sampleR) * dt;
+                }
+                tables->opticalDepth[y * TransmittanceWidth + x] = depth;
+            }
+        }
+    });
+
+    // Directions spread evenly over the sphere (Fibonacci lattice)
+    std::vector<glm::vec3> directions(ScatteringDirections);
+    const float goldenAngle = Pi * (3.0f - std::sqrt(5.0f));
+    for (int k = 0; k < ScatteringDirections; ++k) {
+        const float y = 1.0f - 2.0f * (k + 0.5f) / ScatteringDirections;
+        const float ring = std::sqrt(1.0f - y * y);
+        directions[k] = glm::vec3(std::cos(goldenAngle * k) * ring, y, std::sin(goldenAngle * k) * ring);
+    }
+
+    ThreadPool::ParallelFor(ScatteringHeight, 2, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t y = begin; y < end; ++y) {
+            const float r = g.planetRadius + (g.atmosphereRadius - g.planetRadius) * (y + 0.5f) / ScatteringHeight;
+            const glm::vec3 position(0.0f, r, 0.0f);
+
+            for (int x = 0; x < ScatteringWidth; ++x) {
+                const float muS = 2.0f * (x + 0.5f) / ScatteringWidth - 1.0f;
+                const glm::vec3 toSun(std::sqrt(1.0f - muS * muS), muS, 0.0f);
+
+                glm::vec3 secondOrder(0.0f); // light scattered twice, isotropic phase
+                glm::vec3 transfer(0.0f);    // fraction of light at a point scattered back to it
+
+                for (const glm::vec3 &direction: directions) {
+                    const float mu = direction.y;
+                    float length = distanceToTop(g, r, mu);
+                    if (hitsPlanet(g, r, mu)) {
+                        const float discriminant = r * r * (mu * mu - 1.0f) + g.planetRadius * g.planetRadius;
+                        length = std::max(0.0f, -r * mu - std::sqrt(std::max(discriminant, 0.0f)));
+                    }
+
+                    const float dt = length / ScatteringSteps;
+                    float viewDepth = 0.0f;
+                    for (int i = 0; i < ScatteringSteps; ++i) {
+                        const glm::vec3 point = position + direction * ((i + 0.5f) * dt);
+                        const float pointR = glm::length(point);
+                        const float sigma = density(g, pointR) * dt;
+
+                        const glm::vec3 viewTransmittance = extinction(g.scattering * (viewDepth + 0.5f * sigma));
+                        const glm::vec3 scattered = g.scattering * sigma * viewTransmittance;
+                        const glm::vec3 sun = sunTransmittance(g, tables->opticalDepth, pointR,
+                                                               glm::dot(point / pointR, toSun));
+
+                        secondOrder += scattered * sun;
+                        transfer += scattered;
+                        viewDepth += sigma;
+                    }
+                }
+
+                // ∫ ... p dω with p = 1/4π over the sphere is the mean over the directions; the sun side
+                // uses the same phase. Higher orders are a geometric series in the transfer factor.
+                secondOrder *= 1.0f / (4.0f * Pi * ScatteringDirections);
+                transfer = glm::min(transfer / static_cast<float>(ScatteringDirections), glm::vec3(0.99f));
+                tables->multipleScattering[y * ScatteringWidth + x] = secondOrder / (glm::vec3(1.0f) - transfer);
+            }
+        }
+    });
+
+    return tables;
+}
+
+void AtmosphereLuts::upload(const Tables &tables) {
+    PROFILE_SCOPE("Atmosphere::UploadLuts");
+
+    auto create = [](GLuint &texture) {
+        if (!texture) glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    };
+
+    create(transmittance);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, TransmittanceWidth, TransmittanceHeight, 0, GL_RED, GL_FLOAT,
+                 tables.opticalDepth.data());
+
+    create(multipleScattering);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, ScatteringWidth, ScatteringHeight, 0, GL_RGB, GL_FLOAT,
+                 tables.multipleScattering.data());
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GlState::Invalidate();
+}
+
+void AtmosphereLuts::update(const AtmosphereSettings &settings) {
+    if (pending.valid()) {
+        if (pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+        pending.get();
+        if (*pendingResult) upload(**pendingResult);
+        pendingResult.reset();
+    }
+
+    if (hasSettings && requested.sameTables(settings)) return;
+
+    hasSettings = true;
+    requested = settings;
+    pendingResult = std::make_shared<std::shared_ptr<Tables>>();
+    pending = ThreadPool::Submit([settings, result = pendingResult] { *result = bake(settings); });
+    std::cout << "[Atmosphere] Baking lookup tables" << std::endl;
+}
+
+void AtmosphereLuts::release() {
+    if (pending.valid()) pending.wait();
+    pendingResult.reset();
+    hasSettings = false;
+
+    if (transmittance) glDeleteTextures(1, &transmittance);
+    if (multipleScattering) glDeleteTextures(1, &multipleScattering);
+    transmittance = multipleScattering = 0;
+}
+
+void Atmosphere::setUniforms(const Shader &shader, const AtmosphereSettings &settings,
+                             glm::vec3 atmospherePosition, glm::vec3 sunPosition) const {
+    shader.setInt("TransmittanceLut", 2);
+    shader.setInt("MultipleScatteringLut", 3);
+
+    shader.setVec3("sunPosition", sunPosition);
+
+    shader.setVec3("atmospherePosition", atmospherePosition);
+
+    shader.setFloat("atmosphereRadius", settings.atmosphereRadius);
+    shader.setFloat("planetRadius", settings.planetRadius);
+    shader.setFloat("scaleHeight", settings.scaleHeight);
+    shader.setInt("numInScatteringPoints", settings.numInScatteringPoints);
+    shader.setVec3("scatteringCoefficients", settings.scatteringCoefficients());
+}
+
+bool Atmosphere::render(const AtmosphereSettings &settings, glm::vec3 atmospherePosition, glm::vec3 sunPosition) {
+    luts.update(settings);
+    if (!luts.ready()) return false;
+
+    PROFILE_SCOPE("Atmosphere::Render");
+
+    updateTargets(settings.resolutionDivisor);
+
+    // Full-screen passes over the scene, nothing to test or write depth against
+    RenderState state;
+    state.depthTest = false;
+    state.depthWrite = false;
+    state.cullBackFaces = false;
+    state.allowWireframe = false;
+    GlState::Apply(state, false);
+
+    GlState::BindTexture2D(0, SceneTarget::ColourTexture());
+    GlState::BindTexture2D(1, SceneTarget::DepthTexture());
+    GlState::BindTexture2D(2, luts.transmittanceTexture());
+    GlState::BindTexture2D(3, luts.multipleScatteringTexture());
+    GlState::BindVertexArray(sVAO);
+
+    if (settings.resolutionDivisor > 1) {
+        renderReduced(settings, atmospherePosition, sunPosition);
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, SceneTarget::CompositeFramebuffer());
+        glViewport(0, 0, SceneTarget::Size().x, SceneTarget::Size().y);
+        sShader->bind();
+        sShader->setInt("MainTex", 0);
+        sShader->setInt("DepthTex", 1);
+        setUniforms(*sShader, settings, atmospherePosition, sunPosition);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+
+    // Back to the defaults the scene pass starts from
+    GlState::Apply(RenderState{}, false);
+    return true;
+}
+
+void Atmosphere::renderReduced(const AtmosphereSettings &settings, glm::vec3 atmospherePosition,
+                               glm::vec3 sunPosition) {
+    const glm::ivec2 fullSize = SceneTarget::Size();
+    const int divisor = settings.resolutionDivisor;
+
+    const int previous = current;
+    current ^= 1;
+
+    {
+        GPU_PROFILE_SCOPE("Atmosphere::March");
+        glBindFramebuffer(GL_FRAMEBUFFER, reducedFbo[current]);
+        glViewport(0, 0, reducedSize.x, reducedSize.y);
+
+        GlState::BindTexture2D(4, scatteringTexture[previous]);
+        GlState::BindTexture2D(5, transmittanceTexture[previous]);
+
+        sReducedShader->bind();
+        sReducedShader->setInt("DepthTex", 1);
+        sReducedShader->setInt("HistoryScattering", 4);
+        sReducedShader->setInt("HistoryTransmittance", 5);
+        setUniforms(*sReducedShader, settings, atmospherePosition, sunPosition);
+        sReducedShader->setInt("resolutionDivisor", divisor);
+        sReducedShader->setBool("historyValid", historyValid);
+        sReducedShader->setFloat("historyWeight", std::clamp(settings.historyWeight, 0.0f, 0.98f));
+        sReducedShader->setVec3("atmosphereMotion", previousPosition - atmospherePosition);
+        sReducedShader->setInt("frameIndex", frameIndex);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+
+    historyValid = true;
+    previousPosition = atmospherePosition;
+    frameIndex = (frameIndex + 1) & 0xFFFF;
+
+    {
+        GPU_PROFILE_SCOPE("Atmosphere::Upsample");
+        glBindFramebuffer(GL_FRAMEBUFFER, SceneTarget::CompositeFramebuffer());
+        glViewport(0, 0, fullSize.x, fullSize.y);
+
+        GlState::BindTexture2D(4, scatteringTexture[current]);
+        GlState::BindTexture2D(5, transmittanceTexture[current]);
+
+        sUpsampleShader->bind();
+        sUpsampleShader->setInt("MainTex", 0);
+        sUpsampleShader->setInt("DepthTex", 1);
+        sUpsampleShader->setInt("ScatteringTex", 4);
+        sUpsampleShader->setInt("TransmittanceTex", 5);
+        sUpsampleShader->setInt("resolutionDivisor", divisor);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+}
+
+void Atmosphere::updateTargets(int divisor) {
+    if (divisor <= 1) {
+        releaseTargets();
+        return;
+    }
+
+    const glm::ivec2 size = glm::max((SceneTarget::Size() + divisor - 1) / divisor, glm::ivec2(1));
+    if (size != reducedSize || divisor != reducedDivisor) {
+        releaseTargets();
+        createTargets(size);
+        reducedDivisor = divisor;
+    }
+}
+
+void Atmosphere::createTargets(glm::ivec2 size) {
+    auto create = [size](GLuint &texture) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, size.x, size.y, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+        // Linear for reading the reprojected history between texels; the upsample fetches exact texels
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    };
+
+    const GLenum attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    for (int i = 0; i < 2; ++i) {
+        create(scatteringTexture[i]);
+        create(transmittanceTexture[i]);
+
+        glGenFramebuffers(1, &reducedFbo[i]);
+        glBindFramebuffer(GL_FRAMEBUFFER, reducedFbo[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scatteringTexture[i], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, transmittanceTexture[i], 0);
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "[Atmosphere] Reduced resolution framebuffer is not complete" << std::endl;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GlState::Invalidate();
+
+    reducedSize = size;
+    historyValid = false;
+    std::cout << "[Atmosphere] Marching at " << size.x << "x" << size.y << std::endl;
+}
+
+void Atmosphere::releaseTargets() {
+    if (!reducedFbo[0]) return;
+
+    glDeleteFramebuffers(2, reducedFbo);
+    glDeleteTextures(2, scatteringTexture);
+    glDeleteTextures(2, transmittanceTexture);
+    for (int i = 0; i < 2; ++i) reducedFbo[i] = scatteringTexture[i] = transmittanceTexture[i] = 0;
+
+    reducedSize = glm::ivec2(0);
+    reducedDivisor = 0;
+    historyValid = false;
+}
+
+void Atmosphere::release() {
+    luts.release();
+    releaseTargets();
+    if (sVAO) glDeleteVertexArrays(1, &sVAO);
+    sVAO = 0;
+}
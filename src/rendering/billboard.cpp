@@ -1,16 +1,9 @@
 #include "billboard.h"
 #include <glad/glad.h>
 
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/norm.hpp>
-
-void Billboard::InitialiseShared(const char* vertPath,
-                                 const char* fragPath)
+void Billboard::InitialiseShared()
 {
-    if (sShader) return;               // already initialised
-
-    /* ---------- shader ---------- */
-    sShader = new Shader(vertPath, fragPath);
+    if (sVAO) return;                  // already initialised
 
     /* ---------- quad geometry (two‑tri strip) ---------- */
     const float vertices[] = {
@@ -42,53 +35,38 @@ void Billboard::InitialiseShared(const char* vertPath,
 
 void Billboard::ShutdownShared()
 {
-    if(!sShader) return;
+    if(!sVAO) return;
     glDeleteVertexArrays(1,&sVAO);
     glDeleteBuffers(1,&sVBO);
     glDeleteBuffers(1,&sEBO);
-    delete sShader;
-    sShader = nullptr;
-}
+    sVAO = sVBO = sEBO = 0;
 
-Billboard::Billboard(const glm::vec3& worldPos, float radius)
-    : mPosWS(worldPos), mRadius(radius)
-{}
+    if (sImpostorShader) {
+        delete sImpostorShader;
+        sImpostorShader = nullptr;
+        sImpostorCall = nullptr;
+    }
+}
 
-void Billboard::draw(const glm::mat4& view,
-                     const glm::mat4& proj,
-                     const glm::vec3& cameraPos,
-                     const glm::vec3& lightPosWS,
-                     const glm::vec3& lightColour) const
+void Billboard::InitialiseImpostors(const char* vertPath,
+                                    const char* fragPath)
 {
-    sShader->bind();
-
-    /* standard camera uniforms */
-    sShader->setMat4 ("view", view);
-    sShader->setMat4 ("proj", proj);
-
-    /* per‑billboard data */
-    sShader->setVec3 ("spherePosWS", mPosWS);
-    sShader->setFloat("radius",      mRadius);
+    if (sImpostorShader) return;       // already initialised
 
-    /* face the camera */
-    glm::vec3 viewDir = glm::normalize(cameraPos - mPosWS);
-    const glm::vec3 worldUp(0,1,0);
+    sImpostorShader = new Shader(vertPath, fragPath);
 
-    glm::vec3 bbRight = glm::cross(worldUp, viewDir);
-    if (glm::length2(bbRight) < 1e-4f) bbRight = glm::vec3(1,0,0);
-    bbRight = glm::normalize(bbRight);
-    glm::vec3 bbUp = glm::cross(viewDir, bbRight);
-
-    sShader->setVec3("bbRight",   bbRight);
-    sShader->setVec3("bbUp",      bbUp);
-    sShader->setVec3("bbForward", viewDir);
-
-    /* lighting */
-    sShader->setVec3("lightPosWS",  lightPosWS);
-    sShader->setVec3("lightColour", lightColour);
+    DrawCall call;
+    call.shader  = sImpostorShader;
+    call.vao     = sVAO;
+    call.indexed = true;
+    call.count   = 6;
+    sImpostorCall = RenderQueue::Register(call);
+}
 
-    /* kick the GPU */
-    glBindVertexArray(sVAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-    glBindVertexArray(0);
+void Billboard::RecordImpostor(RenderRecorder& recorder, const glm::vec3& position, float radius,
+                               const Material& material, float depth, glm::uvec2 occluders,
+                               const glm::vec3& motion)
+{
+    recorder.draw(RenderPass::Opaque, *sImpostorCall, material.albedoTexture > 0 ? material.albedoTexture : 0,
+                  depth, BodyInstance(position, radius, material, occluders, motion));
 }
@@ -0,0 +1,225 @@
+#include "blockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "profiler.h"
+#include "threadPool.h"
+
+namespace {
+    // BC7's 4-bit interpolation weights, out of 64
+    constexpr int Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    struct Endpoints {
+        int quantised[2][4]; // 7 bits per channel
+        int pBit[2];
+        int colour[2][4];    // what the decoder rebuilds, (quantised << 1) | pBit
+    };
+
+    // Picks each endpoint's shared low bit to suit all four of its channels best
+    Endpoints quantise(const glm::vec4 &a, const glm::vec4 &b) {
+        Endpoints e{};
+        const glm::vec4 ends[2] = {a, b};
+        for (int end = 0; end < 2; ++end) {
+            float bestError = 1e30f;
+            for (int p = 0; p < 2; ++p) {
+                float error = 0.0f;
+                int q[4], c[4];
+                for (int ch = 0; ch < 4; ++ch) {
+                    q[ch] = std::clamp(static_cast<int>(std::lround((ends[end][ch] - p) / 2.0f)), 0, 127);
+                    c[ch] = (q[ch] << 1) | p;
+                    const float d = static_cast<float>(c[ch]) - ends[end][ch];
+                    error += d * d;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    e.pBit[end] = p;
+                    std::copy(q, q + 4, e.quantised[end]);
+                    std::copy(c, c + 4, e.colour[end]);
+                }
+            }
+        }
+        return e;
+    }
+
+    // Nearest of the 16 palette entries for every texel; returns the squared error
+    int assignIndices(const Endpoints &e, const std::uint8_t texels[64], int indices[16]) {
+        int palette[16][4];
+        for (int i = 0; i < 16; ++i)
+            for (int ch = 0; ch < 4; ++ch)
+                palette[i][ch] = ((64 - Weights[i]) * e.colour[0][ch] + Weights[i] * e.colour[1][ch] + 32) >> 6;
+
+        int total = 0;
+        for (int t = 0; t < 16; ++t) {
+            int best = 0, bestError = 1 << 30;
+            for (int i = 0; i < 16; ++i) {
+                int error = 0;
+                for (int ch = 0; ch < 4; ++ch) {
+                    const int d = palette[i][ch] - texels[t * 4 + ch];
+                    error += d * d;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    best = i;
+                }
+            }
+            indices[t] = best;
+            total += bestError;
+        }
+        return total;
+    }
+
+    // Least-squares endpoints for fixed indices: minimises Σ |(1 - w)a + wb - x|² per channel
+    bool refit(const std::uint8_t texels[64], const int indices[16], glm::vec4 &a, glm::vec4 &b) {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        glm::vec4 ax(0.0f), bx(0.0f);
+        for (int t = 0; t < 16; ++t) {
+            const float w = Weights[indices[t]] / 64.0f;
+            const glm::vec4 x(texels[t * 4], texels[t * 4 + 1], texels[t * 4 + 2], texels[t * 4 + 3]);
+            aa += (1.0f - w) * (1.0f - w);
+            ab += (1.0f - w) * w;
+            bb += w * w;
+            ax += (1.0f - w) * x;
+            bx += w * x;
+        }
+        const float det = aa * bb - ab * ab;
+        if (std::abs(det) < 1e-6f) return false; // every texel on one index
+        a = glm::clamp((ax * bb - bx * ab) / det, 0.0f, 255.0f);
+        b = glm::clamp((bx * aa - ax * ab) / det, 0.0f, 255.0f);
+        return true;
+    }
+
+    class BitWriter {
+    public:
+        explicit BitWriter(std::uint8_t *out) : out(out) { std::memset(out, 0, BlockCompression::BlockBytes); }
+
+        void write(unsigned int value, int bits) {
+            for (int i = 0; i < bits; ++i, ++position)
+                if (value >> i & 1u) out[position >> 3] |= static_cast<std::uint8_t>(1u << (position & 7));
+        }
+
+    private:
+        std::uint8_t *out;
+        int position = 0;
+    };
+}
+
+std::vector<BlockCompression::MipLevel> BlockCompression::BuildMipChain(const std::uint8_t *rgba, glm::ivec2 size) {
+    std::vector<MipLevel> levels;
+    levels.push_back({size, std::vector<std::uint8_t>(rgba, rgba + static_cast<std::size_t>(size.x) * size.y * 4)});
+
+    while (levels.back().size.x > 1 || levels.back().size.y > 1) {
+        const MipLevel &source = levels.back();
+        const glm::ivec2 from = source.size;
+        const glm::ivec2 to = glm::max(from / 2, glm::ivec2(1));
+
+        MipLevel level{to, std::vector<std::uint8_t>(static_cast<std::size_t>(to.x) * to.y * 4)};
+        for (int y = 0; y < to.y; ++y) {
+            const int y0 = std::min(2 * y, from.y - 1), y1 = std::min(2 * y + 1, from.y - 1);
+            for (int x = 0; x < to.x; ++x) {
+                const int x0 = std::min(2 * x, from.x - 1), x1 = std::min(2 * x + 1, from.x - 1);
+                for (int ch = 0; ch < 4; ++ch) {
+                    const int sum = source.rgba[(y0 * from.x + x0) * 4 + ch] + source.rgba[(y0 * from.x + x1) * 4 + ch] +
+                                    source.rgba[(y1 * from.x + x0) * 4 + ch] + source.rgba[(y1 * from.x + x1) * 4 + ch];
+                    level.rgba[(static_cast<std::size_t>(y) * to.x + x) * 4 + ch] = static_cast<std::uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+        levels.push_back(std::move(level));
+    }
+    return levels;
+}
+
+std::size_t BlockCompression::CompressedSize(glm::ivec2 size) {
+    return static_cast<std::size_t>((size.x + 3) / 4) * ((size.y + 3) / 4) * BlockBytes;
+}
+
+std::vector<std::uint8_t> BlockCompression::CompressBc7(const MipLevel &level) {
+    PROFILE_SCOPE("BlockCompression::CompressBc7");
+
+    const int blocksWide = (level.size.x + 3) / 4;
+    const int blocksHigh = (level.size.y + 3) / 4;
+    std::vector<std::uint8_t> blocks(CompressedSize(level.size));
+
+    ThreadPool::ParallelFor(static_cast<std::size_t>(blocksHigh), 4, [&](std::size_t begin, std::size_t end) {
+        std::uint8_t texels[64];
+        for (std::size_t by = begin; by < end; ++by) {
+            for (int bx = 0; bx < blocksWide; ++bx) {
+                for (int t = 0; t < 16; ++t) {
+                    const int x = std::min(bx * 4 + (t & 3), level.size.x - 1);
+                    const int y = std::min(static_cast<int>(by) * 4 + (t >> 2), level.size.y - 1);
+                    std::memcpy(texels + t * 4, &level.rgba[(static_cast<std::size_t>(y) * level.size.x + x) * 4], 4);
+                }
+                EncodeBc7Block(texels, &blocks[(by * blocksWide + bx) * BlockBytes]);
+            }
+        }
+    });
+    return blocks;
+}
+
+void BlockCompression::EncodeBc7Block(const std::uint8_t texels[64], std::uint8_t out[BlockBytes]) {
+    // Principal axis of the block's colours, by power iteration on their covariance
+    glm::vec4 mean(0.0f);
+    for (int t = 0; t < 16; ++t) mean += glm::vec4(texels[t * 4], texels[t * 4 + 1], texels[t * 4 + 2], texels[t * 4 + 3]);
+    mean /= 16.0f;
+
+    glm::mat4 covariance(0.0f);
+    for (int t = 0; t < 16; ++t) {
+        const glm::vec4 d = glm::vec4(texels[t * 4], texels[t * 4 + 1], texels[t * 4 + 2], texels[t * 4 + 3]) - mean;
+        for (int c = 0; c < 4; ++c) covariance[c] += d * d[c];
+    }
+
+    glm::vec4 axis(1.0f, 1.0f, 1.0f, 0.25f);
+    for (int i = 0; i < 8; ++i) {
+        const glm::vec4 next = covariance * axis;
+        const float length = glm::length(next);
+        if (length < 1e-6f) break; // flat block, any axis will do
+        axis = next / length;
+    }
+
+    float low = 1e30f, high = -1e30f;
+    for (int t = 0; t < 16; ++t) {
+        const float along = glm::dot(glm::vec4(texels[t * 4], texels[t * 4 + 1], texels[t * 4 + 2], texels[t * 4 + 3]) - mean,
+                                     axis);
+        low = std::min(low, along);
+        high = std::max(high, along);
+    }
+
+    glm::vec4 a = glm::clamp(mean + axis * low, 0.0f, 255.0f);
+    glm::vec4 b = glm::clamp(mean + axis * high, 0.0f, 255.0f);
+
+    Endpoints best = quantise(a, b);
+    int bestIndices[16];
+    int bestError = assignIndices(best, texels, bestIndices);
+
+    int indices[16];
+    std::copy(bestIndices, bestIndices + 16, indices);
+    for (int iteration = 0; iteration < 2 && bestError > 0; ++iteration) {
+        if (!refit(texels, indices, a, b)) break;
+        const Endpoints candidate = quantise(a, b);
+        const int error = assignIndices(candidate, texels, indices);
+        if (error >= bestError) break;
+        best = candidate;
+        bestError = error;
+        std::copy(indices, indices + 16, bestIndices);
+    }
+
+    // The first index is stored without its top bit, so it must be below 8; swapping the ends mirrors every index
+    if (bestIndices[0] >= 8) {
+        for (int ch = 0; ch < 4; ++ch) std::swap(best.quantised[0][ch], best.quantised[1][ch]);
+        std::swap(best.pBit[0], best.pBit[1]);
+        for (int &index: bestIndices) index = 15 - index;
+    }
+
+    BitWriter bits(out);
+    bits.write(1u << 6, 7); // mode 6
+    for (int ch = 0; ch < 4; ++ch) {
+        bits.write(static_cast<unsigned int>(best.quantised[0][ch]), 7);
+        bits.write(static_cast<unsigned int>(best.quantised[1][ch]), 7);
+    }
+    bits.write(static_cast<unsigned int>(best.pBit[0]), 1);
+    bits.write(static_cast<unsigned int>(best.pBit[1]), 1);
+    bits.write(static_cast<unsigned int>(bestIndices[0]), 3);
+    for (int t = 1; t < 16; ++t) bits.write(static_cast<unsigned int>(bestIndices[t]), 4);
+}
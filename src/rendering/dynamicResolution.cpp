@@ -0,0 +1,160 @@
+#include "dynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "profiler.h"
+#include "sceneTarget.h"
+
+DynamicResolution::Stats DynamicResolution::stats{};
+
+namespace {
+    constexpr double Smoothing = 0.15; // weight of the newest frame in the running averages
+}
+
+void DynamicResolution::Initialise(const DynamicResolutionSettings &newSettings) {
+    if (enabled) return; // already initialised
+    if (glQueryCounter == nullptr || glGetQueryObjectui64v == nullptr) {
+        std::cerr << "[DynamicResolution] Timer queries unavailable, resolution stays fixed" << std::endl;
+        return;
+    }
+
+    settings = newSettings;
+    settings.maxSamples = std::max(settings.maxSamples, 0);
+    for (auto &frame: queries) {
+        glGenQueries(1, &frame.begin);
+        glGenQueries(1, &frame.end);
+        frame.pending = false;
+    }
+
+    stats = Stats{};
+    stats.scale = SceneTarget::RenderScale();
+    stats.samples = SceneTarget::Samples();
+    haveGpuTime = false;
+    overFrames = underFrames = cooldown = 0;
+    enabled = true;
+}
+
+void DynamicResolution::Shutdown() {
+    if (!enabled) return;
+    for (auto &frame: queries) {
+        glDeleteQueries(1, &frame.begin);
+        glDeleteQueries(1, &frame.end);
+        frame = FrameQueries{};
+    }
+    enabled = false;
+}
+
+void DynamicResolution::SetMaxSamples(int samples) {
+    settings.maxSamples = std::max(samples, 0);
+    if (!enabled) return;
+
+    stats.scale = SceneTarget::RenderScale();
+    stats.samples = SceneTarget::Samples();
+    overFrames = underFrames = 0;
+    cooldown = settings.cooldownFrames;
+}
+
+void DynamicResolution::BeginFrame() {
+    if (!enabled) return;
+
+    cpuBegin = std::chrono::steady_clock::now();
+    frameIndex = (frameIndex + 1) % FramesInFlight;
+    readBack();
+    glQueryCounter(queries[frameIndex].begin, GL_TIMESTAMP);
+}
+
+void DynamicResolution::EndFrame() {
+    if (!enabled) return;
+
+    glQueryCounter(queries[frameIndex].end, GL_TIMESTAMP);
+    queries[frameIndex].pending = true;
+
+    const double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuBegin).count();
+    decide(cpuMs);
+}
+
+void DynamicResolution::readBack() {
+    FrameQueries &frame = queries[frameIndex];
+    if (!frame.pending) return;
+    frame.pending = false;
+
+    // Anything still in flight after FramesInFlight frames is dropped instead of stalling
+    GLint ready = GL_FALSE;
+    glGetQueryObjectiv(frame.end, GL_QUERY_RESULT_AVAILABLE, &ready);
+    if (!ready) return;
+
+    GLuint64 begin = 0, end = 0;
+    glGetQueryObjectui64v(frame.begin, GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(frame.end, GL_QUERY_RESULT, &end);
+    const double gpuMs = static_cast<double>(end - begin) * 1e-6;
+
+    stats.gpuMs = haveGpuTime ? stats.gpuMs + (gpuMs - stats.gpuMs) * Smoothing : gpuMs;
+    haveGpuTime = true;
+}
+
+void DynamicResolution::decide(double cpuMs) {
+    stats.cpuMs = stats.cpuMs > 0.0 ? stats.cpuMs + (cpuMs - stats.cpuMs) * Smoothing : cpuMs;
+    if (!haveGpuTime) return;
+
+    // The GPU span runs from the frame's first command to its last, so when the GPU sits waiting on the CPU
+    // it reads about the same as the CPU time; only a GPU running behind the CPU is worth lowering quality for
+    stats.gpuBound = stats.gpuMs > stats.cpuMs;
+
+    if (cooldown > 0) {
+        --cooldown;
+        return;
+    }
+
+    const double target = settings.targetFrameMs;
+    overFrames = stats.gpuBound && stats.gpuMs > target * settings.lowerAbove ? overFrames + 1 : 0;
+    underFrames = stats.gpuMs < target * settings.raiseBelow ? underFrames + 1 : 0;
+
+    if (overFrames >= settings.lowerAfterFrames) lower();
+    else if (underFrames >= settings.raiseAfterFrames) raise();
+}
+
+void DynamicResolution::lower() {
+    const float scale = SceneTarget::RenderScale();
+    const int samples = SceneTarget::Samples();
+    const int mid = std::min(MidSamples, settings.maxSamples);
+
+    if (samples > mid) {
+        apply(scale, mid);
+    } else if (scale > SceneTarget::MinScale) {
+        // Aim just under the lowering threshold, in whole steps, and always by at least one
+        const double wanted = scale * std::sqrt(settings.targetFrameMs * settings.lowerAbove * 0.9 / stats.gpuMs);
+        const float stepped = std::floor(static_cast<float>(wanted) / settings.scaleStep) * settings.scaleStep;
+        apply(std::max(std::min(stepped, scale - settings.scaleStep), SceneTarget::MinScale), samples);
+    } else if (samples > 0) {
+        apply(scale, samples / 2 >= 2 ? samples / 2 : 0);
+    }
+}
+
+void DynamicResolution::raise() {
+    const float scale = SceneTarget::RenderScale();
+    const int samples = SceneTarget::Samples();
+    const int mid = std::min(MidSamples, settings.maxSamples);
+
+    // The exact reverse of lower(), so the last thing given up is the first thing back
+    if (samples < mid) {
+        apply(scale, std::min(samples == 0 ? 2 : samples * 2, mid));
+    } else if (scale < 1.0f) {
+        apply(std::min(scale + settings.scaleStep, 1.0f), samples);
+    } else if (samples < settings.maxSamples) {
+        apply(scale, settings.maxSamples);
+    } else {
+        underFrames = 0; // already at full quality
+    }
+}
+
+void DynamicResolution::apply(float scale, int samples) {
+    SceneTarget::SetQuality(scale, samples);
+
+    stats.scale = SceneTarget::RenderScale();
+    stats.samples = SceneTarget::Samples();
+    ++stats.changes;
+    overFrames = underFrames = 0;
+    cooldown = settings.cooldownFrames;
+}
@@ -0,0 +1,195 @@
+#include "frameCapture.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "profiler.h"
+
+FrameCapture::Slot FrameCapture::slots[FrameCapture::RingSize] = {};
+
+bool FrameCapture::Initialise(const std::string &path, glm::ivec2 frameSize) {
+    if (enabled) return true;
+
+    output = path;
+    size = frameSize;
+    rawStream = path.ends_with(".rgb");
+
+    if (rawStream) {
+        stream = std::fopen(path.c_str(), "wb");
+        if (!stream) {
+            std::cerr << "[Capture] Failed to open " << path << std::endl;
+            return false;
+        }
+    } else {
+        std::error_code error;
+        std::filesystem::create_directories(path, error);
+        if (error) {
+            std::cerr << "[Capture] Failed to create " << path << ": " << error.message() << std::endl;
+            return false;
+        }
+    }
+
+    const GLsizeiptr frameBytes = GLsizeiptr(size.x) * size.y * 4;
+    for (Slot &slot: slots) {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    pool.clear();
+    for (std::size_t i = 0; i < PoolSize; ++i) {
+        pool.push_back(std::make_unique<Frame>());
+        pool.back()->pixels.resize(frameBytes);
+        available.tryPush(pool.back().get());
+    }
+
+    issued = collected = 0;
+    written = 0;
+    stopping = false;
+    writer = std::thread(writerLoop);
+    enabled = true;
+
+    std::cout << "[Capture] Writing " << size.x << "x" << size.y << " frames to " << path
+              << (rawStream ? " (raw RGB24)" : " (PPM sequence)") << std::endl;
+    return true;
+}
+
+void FrameCapture::Finish() {
+    if (!enabled) return;
+
+    while (collected < issued) collect(slots[collected % RingSize], true);
+
+    stopping.store(true, std::memory_order_release);
+    writer.join();
+
+    if (stream) {
+        std::fclose(stream);
+        stream = nullptr;
+    }
+    for (Slot &slot: slots) {
+        glDeleteBuffers(1, &slot.pbo);
+        slot = {};
+    }
+
+    Frame *frame;
+    while (available.tryPop(frame)) {}
+    pool.clear();
+    enabled = false;
+
+    std::cout << "[Capture] Wrote " << FramesWritten() << " frames to " << output << std::endl;
+}
+
+void FrameCapture::Capture(GLuint framebuffer) {
+    if (!enabled) return;
+    PROFILE_SCOPE("FrameCapture::Capture");
+
+    // Only a full ring makes us wait, and then for the oldest readback, started RingSize frames ago
+    if (issued - collected == RingSize) collect(slots[collected % RingSize], true);
+
+    Slot &slot = slots[issued % RingSize];
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(framebuffer ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.index = issued++;
+    // Push the read to the GPU now, so the zero-timeout checks on later frames can see it finish
+    glFlush();
+
+    // Hand over whatever earlier readbacks the GPU has got through, oldest first so frames stay in order
+    while (collected < issued - 1 && collect(slots[collected % RingSize], false)) {}
+}
+
+bool FrameCapture::collect(Slot &slot, bool wait) {
+    const GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                           wait ? GL_TIMEOUT_IGNORED : 0);
+    if (status == GL_TIMEOUT_EXPIRED) return false;
+    if (status == GL_WAIT_FAILED) std::cerr << "[Capture] Waiting for frame " << slot.index << " failed" << std::endl;
+
+    // Backpressure: every frame is kept, so a slow writer slows the renderer down instead
+    Frame *frame;
+    while (!available.tryPop(frame)) {
+        PROFILE_SCOPE("FrameCapture::WaitForWriter");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const auto *pixels = static_cast<const std::uint8_t *>(
+            glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(frame->pixels.size()), GL_MAP_READ_BIT));
+    if (pixels) {
+        std::memcpy(frame->pixels.data(), pixels, frame->pixels.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    ++collected;
+
+    frame->index = slot.index;
+    pending.tryPush(frame); // can't fail: there are only PoolSize frames
+    return true;
+}
+
+void FrameCapture::writerLoop() {
+    std::vector<std::uint8_t> rgb(std::size_t(size.x) * size.y * 3);
+    bool failed = false;
+
+    while (true) {
+        Frame *frame;
+        if (!pending.tryPop(frame)) {
+            if (stopping.load(std::memory_order_acquire) && pending.empty()) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // Keep draining after a failure so the renderer isn't left waiting on a full pool
+        if (!failed) {
+            PROFILE_SCOPE("FrameCapture::Write");
+            failed = !writeFrame(*frame, rgb);
+            if (!failed) written.fetch_add(1, std::memory_order_relaxed);
+        }
+        available.tryPush(frame);
+    }
+}
+
+bool FrameCapture::writeFrame(const Frame &frame, std::vector<std::uint8_t> &rgb) {
+    // GL rows start at the bottom; image files start at the top
+    const std::size_t width = size.x;
+    for (int y = 0; y < size.y; ++y) {
+        const std::uint8_t *source = frame.pixels.data() + std::size_t(size.y - 1 - y) * width * 4;
+        std::uint8_t *target = rgb.data() + std::size_t(y) * width * 3;
+        for (std::size_t x = 0; x < width; ++x) {
+            target[x * 3 + 0] = source[x * 4 + 0];
+            target[x * 3 + 1] = source[x * 4 + 1];
+            target[x * 3 + 2] = source[x * 4 + 2];
+        }
+    }
+
+    if (rawStream) {
+        if (std::fwrite(rgb.data(), 1, rgb.size(), stream) == rgb.size()) return true;
+        std::cerr << "[Capture] Failed writing frame " << frame.index << " to " << output << std::endl;
+        return false;
+    }
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame-%06llu.ppm", static_cast<unsigned long long>(frame.index));
+    const std::string path = (std::filesystem::path(output) / name).string();
+
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "[Capture] Failed to open " << path << std::endl;
+        return false;
+    }
+    std::fprintf(file, "P6\n%d %d\n255\n", size.x, size.y);
+    const bool ok = std::fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+    std::fclose(file);
+    if (!ok) std::cerr << "[Capture] Failed writing " << path << std::endl;
+    return ok;
+}
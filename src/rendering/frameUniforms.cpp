@@ -0,0 +1,31 @@
+#include "frameUniforms.h"
+
+#include "profiler.h"
+
+void FrameUniforms::Initialise() {
+    if (sUBO) return; // already initialised
+
+    glGenBuffers(1, &sUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, sUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniformData), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, Binding, sUBO);
+}
+
+void FrameUniforms::Shutdown() {
+    if (!sUBO) return;
+    glDeleteBuffers(1, &sUBO);
+    sUBO = 0;
+}
+
+void FrameUniforms::Update(const FrameUniformData &data) {
+    PROFILE_SCOPE("FrameUniforms::Update");
+
+    glBindBuffer(GL_UNIFORM_BUFFER, sUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniformData), &data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // Re-bound every frame in case anything else used the binding point in between
+    glBindBufferBase(GL_UNIFORM_BUFFER, Binding, sUBO);
+}
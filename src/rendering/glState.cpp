@@ -0,0 +1,94 @@
+#include "glState.h"
+
+void GlState::Invalidate() {
+    program = vertexArray = activeUnit = Unknown;
+    textures.fill(Unknown);
+    storageBuffers.fill(Unknown);
+    blend = depthTest = depthWrite = cullFace = wireframe = -1;
+}
+
+bool GlState::update(GLuint &cached, GLuint value) {
+    if (cached == value) {
+        ++skipped;
+        return false;
+    }
+    cached = value;
+    ++changes;
+    return true;
+}
+
+bool GlState::update(int &cached, int value) {
+    if (cached == value) {
+        ++skipped;
+        return false;
+    }
+    cached = value;
+    ++changes;
+    return true;
+}
+
+void GlState::Apply(const RenderState &state, bool wireframeRequested) {
+    if (update(blend, static_cast<int>(state.blend))) {
+        switch (state.blend) {
+            case BlendMode::None:
+                glDisable(GL_BLEND);
+                break;
+            case BlendMode::Alpha:
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                break;
+            case BlendMode::Additive:
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+                break;
+        }
+        // Blended draws leave SceneTarget's motion vectors alone: a blended vector means nothing, and
+        // the shaders for them don't write one
+        const GLboolean opaque = state.blend == BlendMode::None ? GL_TRUE : GL_FALSE;
+        glColorMaski(1, opaque, opaque, opaque, opaque);
+    }
+    if (update(depthTest, state.depthTest)) {
+        if (depthTest) glEnable(GL_DEPTH_TEST);
+        else glDisable(GL_DEPTH_TEST);
+    }
+    if (update(depthWrite, state.depthWrite))
+        glDepthMask(depthWrite ? GL_TRUE : GL_FALSE);
+    if (update(cullFace, state.cullBackFaces)) {
+        if (cullFace) glEnable(GL_CULL_FACE);
+        else glDisable(GL_CULL_FACE);
+    }
+    if (update(wireframe, wireframeRequested && state.allowWireframe))
+        glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
+}
+
+void GlState::UseProgram(GLuint newProgram) {
+    if (update(program, newProgram)) glUseProgram(program);
+}
+
+void GlState::BindVertexArray(GLuint vao) {
+    if (update(vertexArray, vao)) glBindVertexArray(vertexArray);
+}
+
+void GlState::BindTexture2D(GLuint unit, GLuint texture) {
+    if (unit >= TextureUnits) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        activeUnit = unit;
+        return;
+    }
+
+    if (!update(textures[unit], texture)) return;
+    if (activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void GlState::BindStorageBuffer(GLuint index, GLuint buffer) {
+    if (index >= StorageBindings) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, buffer);
+        return;
+    }
+    if (update(storageBuffers[index], buffer)) glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, buffer);
+}
@@ -0,0 +1,95 @@
+#include "gpuProfiler.h"
+
+void GpuProfiler::Initialise() {
+    available = glQueryCounter != nullptr && glGetQueryObjectui64v != nullptr;
+    if (available) calibrate();
+}
+
+void GpuProfiler::Shutdown() {
+    for (auto &frame: frames) {
+        for (auto &zone: frame.zones) {
+            frame.freeQueries.push_back(zone.beginQuery);
+            frame.freeQueries.push_back(zone.endQuery);
+        }
+        frame.zones.clear();
+
+        if (!frame.freeQueries.empty())
+            glDeleteQueries(static_cast<GLsizei>(frame.freeQueries.size()), frame.freeQueries.data());
+        frame.freeQueries.clear();
+    }
+    available = false;
+}
+
+void GpuProfiler::calibrate() {
+    GLint64 gpuTime = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+    std::uint64_t cpuTime = Profiler::Now();
+
+    gpuToCpuOffset = static_cast<std::int64_t>(cpuTime) - gpuTime;
+    lastCalibration = cpuTime;
+}
+
+GLuint GpuProfiler::acquireQuery(FrameQueries &frame) {
+    if (frame.freeQueries.empty()) {
+        GLuint queries[16];
+        glGenQueries(16, queries);
+        frame.freeQueries.insert(frame.freeQueries.end(), std::begin(queries), std::end(queries));
+    }
+
+    GLuint query = frame.freeQueries.back();
+    frame.freeQueries.pop_back();
+    return query;
+}
+
+void GpuProfiler::BeginFrame() {
+    if (!available) return;
+
+    frameIndex = (frameIndex + 1) % FramesInFlight;
+    FrameQueries &frame = frames[frameIndex];
+
+    const bool recording = Profiler::IsEnabled();
+    if (recording && !track) track = Profiler::CreateTrack("GPU");
+
+    for (auto &zone: frame.zones) {
+        GLint ready = GL_FALSE;
+        glGetQueryObjectiv(zone.endQuery, GL_QUERY_RESULT_AVAILABLE, &ready);
+
+        // Anything still pending after FramesInFlight frames is dropped instead of stalling
+        if (ready && recording) {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(zone.beginQuery, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(zone.endQuery, GL_QUERY_RESULT, &end);
+
+            Profiler::Record(track, zone.name,
+                             static_cast<std::uint64_t>(static_cast<std::int64_t>(begin) + gpuToCpuOffset),
+                             static_cast<std::uint64_t>(static_cast<std::int64_t>(end) + gpuToCpuOffset),
+                             zone.depth);
+        }
+
+        frame.freeQueries.push_back(zone.beginQuery);
+        frame.freeQueries.push_back(zone.endQuery);
+    }
+    frame.zones.clear();
+    depth = 0;
+
+    // GPU and CPU clocks drift apart slowly, re-anchor them about once a second while recording
+    if (recording && Profiler::Now() - lastCalibration > 1000000000ull) calibrate();
+}
+
+std::size_t GpuProfiler::BeginZone(const char *name) {
+    if (!available || !Profiler::IsEnabled()) return InvalidZone;
+
+    FrameQueries &frame = frames[frameIndex];
+    Zone zone{name, acquireQuery(frame), acquireQuery(frame), depth++};
+    glQueryCounter(zone.beginQuery, GL_TIMESTAMP);
+
+    frame.zones.push_back(zone);
+    return frame.zones.size() - 1;
+}
+
+void GpuProfiler::EndZone(std::size_t zone) {
+    if (zone == InvalidZone) return;
+
+    depth--;
+    glQueryCounter(frames[frameIndex].zones[zone].endQuery, GL_TIMESTAMP);
+}
@@ -0,0 +1,119 @@
+#include "headlessContext.h"
+
+#include <iostream>
+
+#if SPACESIM_EGL
+#include <cstring>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+namespace {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+
+    bool hasExtension(const char *extensions, const char *name) {
+        if (!extensions) return false;
+        const std::size_t length = std::strlen(name);
+        for (const char *found = std::strstr(extensions, name); found; found = std::strstr(found + length, name)) {
+            const bool starts = found == extensions || found[-1] == ' ';
+            const bool ends = found[length] == ' ' || found[length] == '\0';
+            if (starts && ends) return true;
+        }
+        return false;
+    }
+
+    EGLDisplay openDisplay() {
+        // Surfaceless needs no X, Wayland or DRM device - the only thing there is on a render node
+        const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+            auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                    eglGetProcAddress("eglGetPlatformDisplayEXT"));
+            if (getPlatformDisplay) {
+                EGLDisplay surfaceless = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+                if (surfaceless != EGL_NO_DISPLAY) return surfaceless;
+            }
+        }
+        return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+}
+
+bool HeadlessContext::Create(bool debug) {
+    display = openDisplay();
+    EGLint major = 0, minor = 0;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cerr << "[EGL] No display to render on" << std::endl;
+        return false;
+    }
+    std::cout << "[EGL] " << eglQueryString(display, EGL_VENDOR) << ", EGL " << major << "." << minor << std::endl;
+
+    if (!hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+        std::cerr << "[EGL] Display can't make a context current without a surface" << std::endl;
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "[EGL] Desktop OpenGL isn't available" << std::endl;
+        return false;
+    }
+
+    const EGLint configAttributes[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+            EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+        std::cerr << "[EGL] No OpenGL config" << std::endl;
+        return false;
+    }
+
+    // Every shader is #version 460 and terrain relies on gl_DrawID, so there is nothing older to fall back to
+    const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, 6,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_CONTEXT_OPENGL_DEBUG, debug ? EGL_TRUE : EGL_FALSE,
+            EGL_NONE
+    };
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT) {
+        std::cerr << "[EGL] Failed to create an OpenGL 4.6 core context, the driver doesn't support it" << std::endl;
+        return false;
+    }
+
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cerr << "[EGL] Failed to make the context current" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void HeadlessContext::Destroy() {
+    if (display == EGL_NO_DISPLAY) return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+    eglTerminate(display);
+    context = EGL_NO_CONTEXT;
+    display = EGL_NO_DISPLAY;
+}
+
+GLADloadproc HeadlessContext::Loader() {
+    return reinterpret_cast<GLADloadproc>(eglGetProcAddress);
+}
+
+#else
+
+bool HeadlessContext::Create(bool) {
+    std::cerr << "[EGL] Built without EGL, headless rendering is unavailable" << std::endl;
+    return false;
+}
+
+void HeadlessContext::Destroy() {}
+
+GLADloadproc HeadlessContext::Loader() {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#include "lod.h"
+
+#include <cmath>
+#include <limits>
+
+float Lod::PixelScale(float viewportHeight, float fovYRadians) {
+    return 0.5f * viewportHeight / std::tan(0.5f * fovYRadians);
+}
+
+float Lod::ProjectedRadius(float radius, float distance, float pixelScale) {
+    // The silhouette of a sphere subtends asin(r / d), i.e. a tangent of r / sqrt(d^2 - r^2)
+    const float tangentSquared = distance * distance - radius * radius;
+    if (tangentSquared <= 0.0f) return std::numeric_limits<float>::max();
+    return radius / std::sqrt(tangentSquared) * pixelScale;
+}
+
+LodSelection Lod::classify(float projectedRadius, const std::vector<float> &meshThresholds) {
+    if (projectedRadius < PointBelowPx) return {LodTier::Point, 0};
+    if (projectedRadius < ImpostorBelowPx || meshThresholds.empty()) return {LodTier::Impostor, 0};
+
+    for (std::size_t level = 0; level < meshThresholds.size(); ++level)
+        if (projectedRadius >= meshThresholds[level]) return {LodTier::Mesh, static_cast<std::uint8_t>(level)};
+    return {LodTier::Mesh, static_cast<std::uint8_t>(meshThresholds.size() - 1)};
+}
+
+// Orders selections from finest (0) to coarsest
+unsigned Lod::rank(LodSelection selection, std::size_t meshLevels) {
+    switch (selection.tier) {
+        case LodTier::Mesh: return selection.meshLevel;
+        case LodTier::Impostor: return static_cast<unsigned>(meshLevels);
+        case LodTier::Point: return static_cast<unsigned>(meshLevels) + 1;
+    }
+    return 0;
+}
+
+LodSelection Lod::Select(LodSelection previous, float projectedRadius, const std::vector<float> &meshThresholds) {
+    const std::size_t levels = meshThresholds.size();
+
+    // A body that was drawn with a level that no longer exists starts over
+    if (previous.tier == LodTier::Mesh && previous.meshLevel >= levels) return classify(projectedRadius, meshThresholds);
+
+    const LodSelection finer = classify(projectedRadius, meshThresholds);
+    if (rank(finer, levels) < rank(previous, levels)) return finer;
+
+    // Coarsen only as far as the body would still go if it were HysteresisBand larger
+    const LodSelection coarser = classify(projectedRadius * (1.0f + HysteresisBand), meshThresholds);
+    if (rank(coarser, levels) > rank(previous, levels)) return coarser;
+
+    return previous;
+}
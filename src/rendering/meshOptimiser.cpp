@@ -0,0 +1,191 @@
+#include "meshOptimiser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "profiler.h"
+
+namespace {
+    constexpr std::size_t MaxValence = 32; // valences above this all score the same
+    constexpr unsigned int NoTriangle = std::numeric_limits<unsigned int>::max();
+
+    // Forsyth's scoring: the three most recent vertices score a flat 0.75 so the triangle just emitted
+    // isn't immediately followed by its neighbour in strip order, older entries fall off with their
+    // age, and vertices with few triangles left get a boost so they are finished off and leave the mesh
+    struct ScoreTable {
+        float cache[MeshOptimiser::CacheSize];
+        float valence[MaxValence + 1];
+
+        ScoreTable() {
+            for (std::size_t i = 0; i < MeshOptimiser::CacheSize; ++i) {
+                if (i < 3) cache[i] = 0.75f;
+                else cache[i] = std::pow(1.0f - static_cast<float>(i - 3) / (MeshOptimiser::CacheSize - 3), 1.5f);
+            }
+            valence[0] = 0.0f;
+            for (std::size_t i = 1; i <= MaxValence; ++i) valence[i] = 2.0f / std::sqrt(static_cast<float>(i));
+        }
+
+        [[nodiscard]] float score(int cachePosition, unsigned int remaining) const {
+            if (remaining == 0) return -1.0f; // nothing left to draw with it
+            const float fromCache = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+            return fromCache + valence[std::min<std::size_t>(remaining, MaxValence)];
+        }
+    };
+}
+
+void MeshOptimiser::OptimiseVertexCache(std::vector<unsigned int> &indices, std::size_t vertexCount) {
+    PROFILE_SCOPE("MeshOptimiser::OptimiseVertexCache");
+
+    static const ScoreTable scores;
+    const std::size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // Triangles around each vertex, as offsets into one array; `remaining` counts the ones not yet emitted
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index: indices) ++remaining[index];
+
+    std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    for (std::size_t v = 0; v < vertexCount; ++v) adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+
+    std::vector<unsigned int> adjacency(indices.size());
+    {
+        std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (std::size_t i = 0; i < indices.size(); ++i) adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (std::size_t v = 0; v < vertexCount; ++v) vertexScore[v] = scores.score(-1, remaining[v]);
+
+    std::vector<bool> emitted(triangleCount, false);
+
+    // Three spare slots hold the vertices pushed out by the triangle just added, so their scores get updated
+    std::vector<unsigned int> cache, nextCache;
+    cache.reserve(CacheSize + 3);
+    nextCache.reserve(CacheSize + 3);
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    unsigned int best = 0;
+    std::size_t scan = 0; // triangles before this have all been emitted
+
+    for (std::size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount) {
+        // Nothing in the cache leads anywhere: restart from the next triangle in input order
+        if (best == NoTriangle) {
+            while (emitted[scan]) ++scan;
+            best = static_cast<unsigned int>(scan);
+        }
+
+        emitted[best] = true;
+        nextCache.clear();
+        for (int corner = 0; corner < 3; ++corner) {
+            const unsigned int v = indices[best * 3 + corner];
+            output.push_back(v);
+            nextCache.push_back(v);
+
+            // Drop the triangle from the vertex's list by swapping it with the last live entry
+            unsigned int *list = adjacency.data() + adjacencyOffset[v];
+            const unsigned int live = remaining[v]--;
+            for (unsigned int i = 0; i < live; ++i) {
+                if (list[i] == best) {
+                    std::swap(list[i], list[live - 1]);
+                    break;
+                }
+            }
+        }
+        for (unsigned int v: cache)
+            if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) nextCache.push_back(v);
+
+        for (std::size_t i = 0; i < nextCache.size(); ++i)
+            cachePosition[nextCache[i]] = i < CacheSize ? static_cast<int>(i) : -1;
+
+        // Rescore every vertex whose cache position changed, and pick the best triangle they touch - only
+        // triangles sharing a cached vertex are candidates, which is what keeps this linear
+        float bestScore = -1.0f;
+        best = NoTriangle;
+        for (unsigned int v: nextCache) {
+            vertexScore[v] = scores.score(cachePosition[v], remaining[v]);
+
+            const unsigned int *list = adjacency.data() + adjacencyOffset[v];
+            for (unsigned int i = 0; i < remaining[v]; ++i) {
+                const unsigned int t = list[i];
+                const float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+                                    vertexScore[indices[t * 3 + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+
+        if (nextCache.size() > CacheSize) nextCache.resize(CacheSize);
+        std::swap(cache, nextCache);
+    }
+
+    indices.swap(output);
+}
+
+std::vector<unsigned int> MeshOptimiser::OptimiseVertexFetch(std::vector<unsigned int> &indices,
+                                                             std::size_t vertexCount) {
+    constexpr unsigned int Unused = std::numeric_limits<unsigned int>::max();
+
+    std::vector<unsigned int> remap(vertexCount, Unused);
+    unsigned int next = 0;
+    for (unsigned int &index: indices) {
+        if (remap[index] == Unused) remap[index] = next++;
+        index = remap[index];
+    }
+
+    // Vertices no triangle uses go at the end, so the vertex count doesn't change
+    for (unsigned int &target: remap)
+        if (target == Unused) target = next++;
+    return remap;
+}
+
+float MeshOptimiser::AverageCacheMissRatio(const std::vector<unsigned int> &indices, std::size_t vertexCount) {
+    if (indices.size() < 3) return 0.0f;
+
+    // FIFO: a vertex's entry is valid while fewer than CacheSize misses have happened since it was loaded
+    std::vector<std::size_t> loadedAt(vertexCount, 0);
+    std::size_t misses = 0;
+    for (unsigned int index: indices) {
+        if (loadedAt[index] == 0 || misses - loadedAt[index] >= CacheSize) {
+            ++misses;
+            loadedAt[index] = misses;
+        }
+    }
+    return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+}
+
+std::vector<MeshOptimiser::Chunk> MeshOptimiser::SplitShortIndices(const std::vector<unsigned int> &indices,
+                                                                   std::vector<std::uint16_t> &shortIndices) {
+    constexpr unsigned int MaxSpan = std::numeric_limits<std::uint16_t>::max();
+
+    std::vector<Chunk> chunks;
+    std::size_t begin = 0;
+    while (begin + 3 <= indices.size()) {
+        // Grow the run a triangle at a time while its vertices still fit one 16-bit range
+        unsigned int low = indices[begin], high = indices[begin];
+        std::size_t end = begin;
+        while (end + 3 <= indices.size()) {
+            const unsigned int triangleLow = std::min({indices[end], indices[end + 1], indices[end + 2]});
+            const unsigned int triangleHigh = std::max({indices[end], indices[end + 1], indices[end + 2]});
+            if (std::max(high, triangleHigh) - std::min(low, triangleLow) > MaxSpan) break;
+            low = std::min(low, triangleLow);
+            high = std::max(high, triangleHigh);
+            end += 3;
+        }
+
+        // A single triangle spanning more than 16 bits can't go in any run; carrying on would add empty ones forever
+        if (end == begin)
+            throw std::runtime_error("[MeshOptimiser] A triangle spans more than 65536 vertices, 16-bit indices can't hold it");
+
+        chunks.push_back({shortIndices.size(), end - begin, low});
+        for (std::size_t i = begin; i < end; ++i) shortIndices.push_back(static_cast<std::uint16_t>(indices[i] - low));
+        begin = end;
+    }
+    return chunks;
+}
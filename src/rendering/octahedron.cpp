@@ -1,5 +1,11 @@
 #include "octahedron.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+#include "meshOptimiser.h"
 #include "vertex.h"
 
 #include <glm/ext/scalar_constants.hpp>
@@ -48,19 +54,12 @@ void Octahedron::CreateUpperStrip(int steps, int vTop, int vBottom, std::vector<
     }
 }
 
-void Octahedron::InitialiseShared(unsigned int subdivisions, const char *vertPath, const char *fragPath) {
-    sShader = new Shader(vertPath, fragPath);
-
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> triangles;
-
+void Octahedron::BuildSphere(unsigned int subdivisions, std::vector<Vertex> &vertices, std::vector<unsigned int> &triangles) {
     int resolution = 1 << subdivisions;
     std::size_t vertexCount   = (resolution + 1) * (resolution + 1) * 4
                           - (resolution * 2 - 1) * 3;
     std::size_t triangleCount = (1u << (subdivisions * 2 + 3)) * 3;
 
-    numTriangles = triangleCount;
-
     vertices.resize(vertexCount);
     triangles.reserve(triangleCount);
 
@@ -140,6 +139,62 @@ void Octahedron::InitialiseShared(unsigned int subdivisions, const char *vertPat
     vertices[vertices.size() - 3].uv.x = vertices[1].uv.x = 0.375f;
     vertices[vertices.size() - 2].uv.x = vertices[2].uv.x = 0.625f;
     vertices[vertices.size() - 1].uv.x = vertices[3].uv.x = 0.875f;
+}
+
+void Octahedron::InitialiseShared(unsigned int subdivisions) {
+    if (sVAO) return; // already initialised
+
+    // One buffer holds the whole chain, each chunk drawn with its own first index and base vertex
+    std::vector<PackedVertex> vertices;
+    std::vector<std::uint16_t> indices;
+    std::vector<Vertex> levelVertices;
+    std::vector<unsigned int> levelTriangles;
+
+    sLevels.clear();
+    sLevelThresholds.clear();
+    float missRatioBefore = 0.0f, missRatioAfter = 0.0f;
+    for (unsigned int level = subdivisions; ; --level) {
+        levelVertices.clear();
+        levelTriangles.clear();
+        BuildSphere(level, levelVertices, levelTriangles);
+
+        // Triangles in cache-friendly order, then vertices in the order those triangles first use them
+        if (level == subdivisions) missRatioBefore = MeshOptimiser::AverageCacheMissRatio(levelTriangles, levelVertices.size());
+        MeshOptimiser::OptimiseVertexCache(levelTriangles, levelVertices.size());
+        const std::vector<unsigned int> remap = MeshOptimiser::OptimiseVertexFetch(levelTriangles, levelVertices.size());
+        if (level == subdivisions) missRatioAfter = MeshOptimiser::AverageCacheMissRatio(levelTriangles, levelVertices.size());
+
+        const std::size_t levelBase = vertices.size();
+        vertices.resize(levelBase + levelVertices.size());
+        for (std::size_t i = 0; i < levelVertices.size(); ++i)
+            vertices[levelBase + remap[i]] = PackVertex(levelVertices[i]);
+
+        MeshLevel mesh{level, {}};
+        for (const MeshOptimiser::Chunk &chunk: MeshOptimiser::SplitShortIndices(levelTriangles, indices)) {
+            mesh.chunks.push_back({
+                static_cast<GLsizei>(chunk.indexCount),
+                chunk.firstIndex,
+                static_cast<GLint>(levelBase + chunk.baseVertex)
+            });
+        }
+        sLevels.push_back(std::move(mesh));
+
+        if (level <= std::min(subdivisions, MinLevelSubdivisions)) break;
+    }
+
+    std::cout << "[Octahedron] " << sLevels.size() << " levels, " << vertices.size() << " vertices in "
+              << (vertices.size() * sizeof(PackedVertex) + indices.size() * sizeof(std::uint16_t)) / 1024 << " KiB"
+              << ", finest level ACMR " << missRatioBefore << " -> " << missRatioAfter << std::endl;
+
+    // A level is needed once the next coarser one would show edges longer than Lod::TargetEdgePx
+    for (std::size_t i = 0; i < sLevels.size(); ++i) {
+        if (i + 1 == sLevels.size()) {
+            sLevelThresholds.push_back(0.0f);
+            continue;
+        }
+        const float coarserSegments = 4.0f * static_cast<float>(1u << sLevels[i + 1].subdivisions);
+        sLevelThresholds.push_back(coarserSegments * Lod::TargetEdgePx / (2.0f * glm::pi<float>()));
+    }
 
     glGenVertexArrays(1, &sVAO);
     glGenBuffers(1, &sVBO);
@@ -147,53 +202,61 @@ void Octahedron::InitialiseShared(unsigned int subdivisions, const char *vertPat
 
     glBindVertexArray(sVAO);
     glBindBuffer(GL_ARRAY_BUFFER, sVBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(PackedVertex), vertices.data(), GL_STATIC_DRAW);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangles.size() * sizeof(unsigned int), triangles.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(std::uint16_t), indices.data(), GL_STATIC_DRAW);
 
-    glVertexAttribPointer(0, 3,GL_FLOAT,GL_FALSE, 8 * sizeof(float), (void *) 0); // pos
+    // Normalised integers, so the shader sees the direction in [-1, 1] and the uv in [0, 1]
+    glVertexAttribPointer(0, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex),
+                          (void *) offsetof(PackedVertex, direction)); // octahedral direction
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3,GL_FLOAT,GL_FALSE, 8 * sizeof(float), (void *) (3 * sizeof(float))); // normal
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex),
+                          (void *) offsetof(PackedVertex, uv)); // uv
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2,GL_FLOAT,GL_FALSE, 8 * sizeof(float), (void *) (6 * sizeof(float))); // uv
-    glEnableVertexAttribArray(2);
 
     glBindVertexArray(0);
 }
 
 void Octahedron::ShutdownShared() {
-    if(!sShader) return;
-    glDeleteVertexArrays(1,&sVAO);
-    glDeleteBuffers(1,&sVBO);
-    glDeleteBuffers(1,&sEBO);
-    delete sShader;
-    sShader = nullptr;
+    if (!sVAO) return;
+    glDeleteVertexArrays(1, &sVAO);
+    glDeleteBuffers(1, &sVBO);
+    glDeleteBuffers(1, &sEBO);
+    sVAO = sVBO = sEBO = 0;
+
+    if (sInstancedShader) {
+        delete sInstancedShader;
+        sInstancedShader = nullptr;
+        sLevelCalls.clear();
+    }
 }
 
-void Octahedron::draw(const glm::mat4 &worldToClip, const glm::vec3 &cameraPos, const Material& material,
-                      const glm::vec3 &lightPos, const glm::vec3 &lightColour) const {
-    sShader->bind();
-    sShader->setMat4("worldToClip", worldToClip);
-    sShader->setVec3("cameraPos", cameraPos);
-    sShader->setVec3("lightPos", lightPos);
-    sShader->setVec3("lightColour", lightColour);
-
-    sShader->setVec3 ("spherePos", position);
-    sShader->setFloat("radius",      radius);
-
-    sShader->setVec3("material.diffuse", material.diffuse);
-    sShader->setInt("material.emissive", material.emissive);
-    sShader->setVec4("material.emission", material.emission);
-
-    sShader->setInt("material.hasTexture", material.albedoTexture <= 0 ? 0 : 1);
-    sShader->setInt("material.albedoTex", 0);
-
-    if (material.albedoTexture > 0) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, material.albedoTexture);
+void Octahedron::InitialiseInstancing(const char *vertPath, const char *fragPath) {
+    if (sInstancedShader) return; // already initialised
+
+    sInstancedShader = new Shader(vertPath, fragPath);
+
+    for (const MeshLevel &mesh: sLevels) {
+        std::vector<const DrawCall *> &calls = sLevelCalls.emplace_back();
+        for (const MeshChunk &chunk: mesh.chunks) {
+            DrawCall call;
+            call.shader = sInstancedShader;
+            call.vao = sVAO;
+            call.indexed = true;
+            call.indexType = GL_UNSIGNED_SHORT;
+            call.count = chunk.indexCount;
+            call.first = chunk.firstIndex;
+            call.baseVertex = chunk.baseVertex;
+            calls.push_back(RenderQueue::Register(call));
+        }
     }
+}
 
-    glBindVertexArray(sVAO);
-    glDrawElements(GL_TRIANGLES, numTriangles, GL_UNSIGNED_INT, nullptr);
-    glBindVertexArray(0);
+void Octahedron::Record(RenderRecorder &recorder, const glm::vec3 &position, float radius, const Material &material,
+                        unsigned int level, float depth, glm::uvec2 occluders, const glm::vec3 &motion) {
+    level = std::min<unsigned int>(level, sLevelCalls.size() - 1);
+    const BodyInstance instance(position, radius, material, occluders, motion);
+    for (const DrawCall *call: sLevelCalls[level])
+        recorder.draw(RenderPass::Opaque, *call, material.albedoTexture > 0 ? material.albedoTexture : 0, depth,
+                      instance);
 }
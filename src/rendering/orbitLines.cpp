@@ -0,0 +1,99 @@
+#include "orbitLines.h"
+
+#include "maths.h"
+#include "profiler.h"
+
+void OrbitLines::InitialiseShared(const char *vertPath, const char *fragPath) {
+    if (sShader) return; // already initialised
+
+    sShader = new Shader(vertPath, fragPath);
+
+    glGenVertexArrays(1, &sVAO);
+    glGenBuffers(1, &sVBO);
+
+    glBindVertexArray(sVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, sVBO);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *) 0); // pos.xyz, progress
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    DrawCall call;
+    call.shader = sShader;
+    call.vao = sVAO;
+    call.state.blend = BlendMode::Alpha;
+    call.state.allowWireframe = false;
+    call.instanced = false;
+    call.custom = drawPaths;
+    sCall = RenderQueue::Register(call);
+}
+
+void OrbitLines::ShutdownShared() {
+    if (!sShader) return;
+    glDeleteVertexArrays(1, &sVAO);
+    glDeleteBuffers(1, &sVBO);
+    delete sShader;
+    sShader = nullptr;
+    sCall = nullptr;
+    uploadedVersion = 0;
+    uploadedRelativeIndex = SIZE_MAX;
+    vboCapacity = 0;
+}
+
+void OrbitLines::upload(const OrbitTrajectories &trajectories, std::size_t relativeBodyIndex) {
+    PROFILE_SCOPE("OrbitLines::Upload");
+
+    const std::size_t samples = trajectories.sampleCount;
+
+    std::vector<glm::vec4> vertices;
+    vertices.reserve(trajectories.bodyCount * samples);
+    firsts.clear();
+    counts.clear();
+
+    // Massless probes never make it into the trajectories, so there's no polyline per particle to skip here
+    for (std::size_t body = 0; body < trajectories.bodyCount; ++body) {
+        if (body == relativeBodyIndex) continue; // its own path is a single point
+
+        firsts.push_back(static_cast<GLint>(vertices.size()));
+        counts.push_back(static_cast<GLsizei>(samples));
+
+        for (std::size_t k = 0; k < samples; ++k) {
+            glm::dvec3 p = trajectories.points[body * samples + k];
+            if (relativeBodyIndex < trajectories.bodyCount)
+                p -= trajectories.points[relativeBodyIndex * samples + k];
+
+            float progress = samples > 1 ? static_cast<float>(k) / (samples - 1) : 0.0f;
+            vertices.emplace_back(glm::vec3(p / SU_IN_KM), progress);
+        }
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, sVBO);
+    if (vertices.size() > vboCapacity) {
+        vboCapacity = vertices.size();
+        glBufferData(GL_ARRAY_BUFFER, vboCapacity * sizeof(glm::vec4), vertices.data(), GL_DYNAMIC_DRAW);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(glm::vec4), vertices.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    uploadedVersion = trajectories.version;
+    uploadedRelativeIndex = relativeBodyIndex;
+}
+
+void OrbitLines::Record(RenderRecorder &recorder, const OrbitTrajectories &trajectories,
+                        std::size_t relativeBodyIndex, const glm::vec3 &focusOffset, const glm::vec4 &colour) {
+    if (trajectories.version != uploadedVersion || relativeBodyIndex != uploadedRelativeIndex)
+        upload(trajectories, relativeBodyIndex);
+
+    if (firsts.empty()) return;
+
+    // Paths span the whole system, so they have no meaningful depth; 0 draws them after other blended bodies
+    drawColour = colour;
+    drawOffset = focusOffset;
+    recorder.draw(RenderPass::Transparent, *sCall, 0.0f);
+}
+
+void OrbitLines::drawPaths(const DrawPacket &packet) {
+    packet.call->shader->setVec4("colour", drawColour);
+    packet.call->shader->setVec3("focusOffset", drawOffset);
+    glMultiDrawArrays(GL_LINE_STRIP, firsts.data(), counts.data(), static_cast<GLsizei>(firsts.size()));
+}
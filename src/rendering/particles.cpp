@@ -0,0 +1,156 @@
+#include "particles.h"
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_set>
+
+#include "maths.h"
+#include "physics.h"
+#include "profiler.h"
+#include "threadPool.h"
+
+Particles::Stats Particles::stats{};
+
+namespace {
+    constexpr GLbitfield MapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+}
+
+void Particles::InitialiseShared(const char *vertPath, const char *fragPath) {
+    if (sShader) return; // already initialised
+
+    sShader = new Shader(vertPath, fragPath);
+    glGenVertexArrays(1, &sVAO);
+    allocate(InitialCapacity);
+
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    // Light adds up, so overlapping particles brighten instead of hiding each other and order doesn't matter
+    DrawCall call;
+    call.shader = sShader;
+    call.vao = sVAO;
+    call.state.blend = BlendMode::Additive;
+    call.state.depthWrite = false;
+    call.state.allowWireframe = false;
+    call.primitive = GL_POINTS;
+    call.instanced = false;
+    call.custom = drawParticles;
+    sCall = RenderQueue::Register(call);
+}
+
+void Particles::ShutdownShared() {
+    if (!sShader) return;
+    for (int i = 0; i < Regions; ++i) waitForRegion(i);
+
+    glBindBuffer(GL_ARRAY_BUFFER, sVBO);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDeleteBuffers(1, &sVBO);
+    glDeleteVertexArrays(1, &sVAO);
+    delete sShader;
+
+    sShader = nullptr;
+    sCall = nullptr;
+    sVBO = sVAO = 0;
+    mapped = nullptr;
+    capacity = 0;
+    sourcesLayout = UINT64_MAX;
+}
+
+void Particles::allocate(std::size_t newCapacity) {
+    PROFILE_SCOPE("Particles::Allocate");
+
+    // Storage is immutable, so growing means a new buffer; the GPU must be done with the old one first
+    if (sVBO) {
+        for (int i = 0; i < Regions; ++i) waitForRegion(i);
+        glBindBuffer(GL_ARRAY_BUFFER, sVBO);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glDeleteBuffers(1, &sVBO);
+    }
+
+    capacity = newCapacity;
+    const GLsizeiptr bytes = GLsizeiptr(Regions * capacity * sizeof(glm::vec3));
+
+    glGenBuffers(1, &sVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, sVBO);
+    glBufferStorage(GL_ARRAY_BUFFER, bytes, nullptr, MapFlags);
+    mapped = static_cast<glm::vec3 *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, MapFlags));
+    if (!mapped) std::cerr << "[Particles] Failed to map " << bytes << " bytes" << std::endl;
+
+    // Through GlState, since this can run mid-frame when the particle count grows
+    GlState::BindVertexArray(sVAO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *) 0);
+    glEnableVertexAttribArray(0);
+    GlState::BindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Particles::waitForRegion(int index) {
+    GLsync &fence = fences[index];
+    if (!fence) return;
+
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        PROFILE_SCOPE("Particles::WaitForGpu");
+        ++stats.stalls;
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void Particles::Update(const PhysicsSnapshot &snapshot, const glm::dvec3 &originKm) {
+    PROFILE_SCOPE("Particles::Update");
+
+    drawCount = 0;
+    if (!mapped) return;
+
+    if (snapshot.layout != sourcesLayout) {
+        std::unordered_set<BodyId> rendered;
+        for (const CelestialBody &body: Physics::Bodies) rendered.insert(body.instanceId);
+
+        sources.clear();
+        for (std::size_t i = 0; i < snapshot.ids.size(); ++i)
+            if (!rendered.contains(snapshot.ids[i])) sources.push_back(static_cast<std::uint32_t>(i));
+        sourcesLayout = snapshot.layout;
+    }
+
+    const std::size_t count = sources.size();
+    stats.particles = count;
+    if (count == 0) return;
+    if (count > capacity) allocate(std::max(count, capacity * 2));
+    stats.capacity = capacity;
+
+    region = (region + 1) % Regions;
+    waitForRegion(region);
+
+    // Coherent, write-only memory: every element is written once, in order, and never read back
+    glm::vec3 *target = mapped + region * capacity;
+    const std::vector<glm::dvec3> &positions = snapshot.positions;
+    ThreadPool::ParallelFor(count, ParallelGrain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+            target[i] = relativeSu(positions[sources[i]], originKm);
+    });
+
+    drawFirst = static_cast<GLint>(region * capacity);
+    drawCount = static_cast<GLsizei>(count);
+}
+
+void Particles::Record(RenderRecorder &recorder) {
+    if (drawCount == 0) return;
+    // Additive, so where in the pass they land doesn't matter
+    recorder.draw(RenderPass::Transparent, *sCall, 0.0f);
+}
+
+void Particles::drawParticles(const DrawPacket &packet) {
+    const Shader &shader = *packet.call->shader;
+    shader.setVec3("colour", settings.colour * settings.brightness);
+    shader.setFloat("pointSize", settings.pointSizePx);
+    shader.setFloat("referenceDistance", settings.referenceDistance);
+    shader.setInt("attenuateSize", settings.attenuateSize ? 1 : 0);
+    shader.setInt("attenuateBrightness", settings.attenuateBrightness ? 1 : 0);
+    shader.setFloat("minBrightness", settings.minBrightness);
+
+    glDrawArrays(GL_POINTS, drawFirst, drawCount);
+
+    // The region can be written again once this has signalled
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
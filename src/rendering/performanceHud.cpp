@@ -0,0 +1,135 @@
+#include "performanceHud.h"
+
+#include <algorithm>
+
+#include <imgui.h>
+#include <imgui_impl_glfw.h>
+#include <imgui_impl_opengl3.h>
+
+#include "culling.h"
+#include "dynamicResolution.h"
+#include "glState.h"
+#include "particles.h"
+#include "profiler.h"
+#include "renderQueue.h"
+#include "sceneTarget.h"
+#include "spatialIndex.h"
+#include "textureStreamer.h"
+
+void PerformanceHud::Initialise(GLFWwindow *glfwWindow) {
+    if (initialised) return;
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.ConfigFlags |= ImGuiConfigFlags_NoMouse;
+
+    ImGui::StyleColorsDark();
+    ImGui::GetStyle().WindowRounding = 4.0f;
+
+    ImGui_ImplGlfw_InitForOpenGL(glfwWindow, false);
+    ImGui_ImplOpenGL3_Init("#version 430 core");
+
+    window = Metrics::Window{};
+    lastSample = std::chrono::steady_clock::now();
+    initialised = true;
+}
+
+void PerformanceHud::Shutdown() {
+    if (!initialised) return;
+
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+    initialised = false;
+}
+
+void PerformanceHud::Draw(double frameMilliseconds) {
+    if (!initialised) return;
+
+    frameHistory[historyOffset] = static_cast<float>(frameMilliseconds);
+    historyOffset = (historyOffset + 1) % HistoryLength;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastSample >= SampleInterval) {
+        latest = Metrics::Sample(window);
+        lastSample = now;
+    }
+
+    if (!Visible) return;
+
+    PROFILE_SCOPE("PerformanceHud::Draw");
+
+    ImGui_ImplOpenGL3_NewFrame();
+    ImGui_ImplGlfw_NewFrame();
+    ImGui::NewFrame();
+
+    ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_Always);
+    ImGui::SetNextWindowBgAlpha(0.6f);
+    ImGui::Begin("Performance", nullptr,
+                 ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoInputs |
+                 ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav);
+
+    ImGui::Text("%.0f fps   avg %.2f ms", latest.fps, latest.frameTimeAverage);
+    ImGui::Text("p50 %.2f ms   p99 %.2f ms   max %.2f ms", latest.frameTimeP50, latest.frameTimeP99, latest.frameTimeMax);
+
+    // Scale the graph to the recent worst frame, with a floor so a quiet scene isn't all noise
+    float worst = *std::max_element(frameHistory.begin(), frameHistory.end());
+    ImGui::PlotLines("##frameTimes", frameHistory.data(), static_cast<int>(HistoryLength),
+                     static_cast<int>(historyOffset), nullptr, 0.0f, std::max(worst, 20.0f), ImVec2(320, 60));
+
+    ImGui::Separator();
+    ImGui::Text("Physics      %.0f steps/s", latest.physicsStepsPerSecond);
+    ImGui::Text("Warp         x%.1f requested, x%.1f achieved", latest.requestedWarp, latest.achievedWarp);
+    ImGui::Text("Backlog      %.3f s", latest.accumulatorBacklog);
+    ImGui::Text("Forces       %.3g/s (%llu bodies)", latest.forceEvaluationsPerSecond,
+                static_cast<unsigned long long>(latest.bodyCount));
+    ImGui::Text("Memory       %.1f MiB", latest.residentBytes / (1024.0 * 1024.0));
+
+    ImGui::Separator();
+    if (SceneTarget::MotionTexture()) ImGui::Text("Anti-alias   temporal");
+    else ImGui::Text("Anti-alias   %dx MSAA", SceneTarget::Samples());
+
+    if (DynamicResolution::IsEnabled()) {
+        const DynamicResolution::Stats resolution = DynamicResolution::LastStats();
+        const glm::ivec2 size = SceneTarget::Size();
+        ImGui::Text("Resolution   %.0f%% (%dx%d)", resolution.scale * 100.0f, size.x, size.y);
+        ImGui::Text("Frame        GPU %.2f ms, CPU %.2f ms%s", resolution.gpuMs, resolution.cpuMs,
+                    resolution.gpuBound ? ", GPU bound" : "");
+    }
+
+    const Culling::Stats culling = Culling::LastStats();
+    ImGui::Separator();
+    ImGui::Text("Drawn        %zu of %zu bodies", culling.visible, culling.bodies);
+    ImGui::Text("Culled       %zu frustum, %zu occluded (%zu occluders)", culling.frustumCulled, culling.occluded,
+                culling.occluders);
+
+    const RenderQueue::Stats queue = RenderQueue::LastStats();
+    ImGui::Text("Queue        %zu packets in %zu draws", queue.packets, queue.draws);
+    ImGui::Text("GL state     %llu changes, %llu redundant skipped",
+                static_cast<unsigned long long>(queue.stateChanges),
+                static_cast<unsigned long long>(queue.redundantSkipped));
+
+    const TextureStreamer::Stats textures = TextureStreamer::LastStats();
+    ImGui::Text("Textures     %zu loading, %zu uploading, %.1f MiB this frame", textures.loading, textures.uploading,
+                textures.uploadedBytes / (1024.0 * 1024.0));
+    ImGui::Text("Tex cache    %zu hits, %zu misses", textures.cacheHits, textures.cacheMisses);
+
+    const Particles::Stats particles = Particles::LastStats();
+    ImGui::Text("Particles    %zu of %zu capacity, %llu GPU stalls", particles.particles, particles.capacity,
+                static_cast<unsigned long long>(particles.stalls));
+
+    const SpatialIndex::Stats index = SpatialIndex::LastStats();
+    ImGui::Text("Spatial      %zu bodies, %zu nodes, refit %.2f ms, build %.1f ms", index.bodies, index.nodes,
+                index.refitMs, index.buildMs);
+
+    ImGui::End();
+
+    ImGui::Render();
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+    // ImGui binds its own program, buffers and textures
+    GlState::Invalidate();
+}
@@ -0,0 +1,39 @@
+#include "pointSprites.h"
+
+void PointSprites::InitialiseShared(const char *vertPath, const char *fragPath) {
+    if (sShader) return; // already initialised
+
+    sShader = new Shader(vertPath, fragPath);
+    glGenVertexArrays(1, &sVAO);
+
+    // Only programs that write gl_PointSize are affected, so this can stay on
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    // Faded points blend over what's behind them but don't hide it from later draws
+    DrawCall call;
+    call.shader = sShader;
+    call.vao = sVAO;
+    call.state.blend = BlendMode::Alpha;
+    call.state.depthWrite = false;
+    call.primitive = GL_POINTS;
+    call.count = 1;
+    call.prepare = prepare;
+    sCall = RenderQueue::Register(call);
+}
+
+void PointSprites::ShutdownShared() {
+    if (!sShader) return;
+    glDeleteVertexArrays(1, &sVAO);
+    delete sShader;
+    sShader = nullptr;
+    sCall = nullptr;
+}
+
+void PointSprites::prepare(const DrawCall &call) {
+    call.shader->setFloat("pointSize", PointSizePx);
+}
+
+void PointSprites::Record(RenderRecorder &recorder, const glm::vec3 &position, float radius,
+                          const Material &material, float depth) {
+    recorder.draw(RenderPass::Transparent, *sCall, 0, depth, BodyInstance(position, radius, material));
+}
@@ -0,0 +1,229 @@
+#include "renderQueue.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#include "gpuProfiler.h"
+#include "profiler.h"
+#include "radixSort.h"
+
+namespace {
+    constexpr unsigned int PassShift = 60;
+    constexpr std::uint64_t DepthMask = 0xFFFFFF;
+
+    // Top 24 bits of the float, which order the same way as the value for non-negative depths
+    std::uint64_t depthBits(float depth) {
+        if (!(depth > 0.0f)) return 0;
+        return (std::bit_cast<std::uint32_t>(depth) >> 8) & DepthMask;
+    }
+}
+
+RenderQueue::Stats RenderQueue::stats{};
+
+std::uint64_t RenderRecorder::makeKey(RenderPass pass, const DrawCall &call, GLuint texture, float depth) {
+    const std::uint64_t passBits = static_cast<std::uint64_t>(pass) << PassShift;
+    const std::uint64_t program = call.shader->program() & 0xFFF;
+    const std::uint64_t id = call.id;
+    const std::uint64_t textureBits = texture & 0xFFFF;
+
+    if (pass == RenderPass::Opaque)
+        return passBits | program << 48 | id << 40 | textureBits << 24 | depthBits(depth);
+
+    // Blended passes must composite far to near, whatever that costs in state changes
+    return passBits | (DepthMask - depthBits(depth)) << 36 | program << 24 | id << 16 | textureBits;
+}
+
+void RenderRecorder::draw(RenderPass pass, const DrawCall &call, GLuint texture, float depth,
+                          const BodyInstance &instance) {
+    packets.push_back({makeKey(pass, call, texture, depth), &call, texture, 0, instance});
+}
+
+void RenderRecorder::draw(RenderPass pass, const DrawCall &call, float depth, std::uint32_t userData,
+                          const BodyInstance &instance) {
+    packets.push_back({makeKey(pass, call, 0, depth), &call, 0, userData, instance});
+}
+
+void RenderQueue::Initialise() {
+    if (sInstanceSSBO) return; // already initialised
+    glGenBuffers(1, &sInstanceSSBO);
+}
+
+void RenderQueue::Shutdown() {
+    if (!sInstanceSSBO) return;
+    glDeleteBuffers(1, &sInstanceSSBO);
+    sInstanceSSBO = 0;
+    instanceCapacity = 0;
+
+    // Recorders stay allocated, threads keep pointers to theirs
+    std::lock_guard lock(recordersMutex);
+    for (auto &recorder: recorders) recorder.packets.clear();
+    calls.clear();
+}
+
+const DrawCall *RenderQueue::Register(DrawCall call) {
+    if (calls.size() >= MaxCalls)
+        throw std::runtime_error("[RenderQueue] Too many draw calls registered");
+
+    call.id = static_cast<std::uint8_t>(calls.size());
+
+    // Nothing here touches the program, which may still be compiling
+    calls.push_back(call);
+    return &calls.back();
+}
+
+RenderRecorder &RenderQueue::Local() {
+    thread_local RenderRecorder *recorder = nullptr;
+    if (!recorder) {
+        std::lock_guard lock(recordersMutex);
+        recorder = &recorders.emplace_back();
+    }
+    return *recorder;
+}
+
+void RenderQueue::Submit() {
+    PROFILE_SCOPE("RenderQueue::Submit");
+
+    const std::uint64_t changesBefore = GlState::Changes();
+    const std::uint64_t skippedBefore = GlState::Skipped();
+
+    keys.clear();
+    sorted.clear();
+    {
+        std::lock_guard lock(recordersMutex);
+        for (const auto &recorder: recorders) {
+            for (const DrawPacket &packet: recorder.packets) {
+                keys.push_back(packet.key);
+                sorted.push_back(&packet);
+            }
+        }
+    }
+
+    stats = {};
+    stats.packets = sorted.size();
+
+    if (!sorted.empty()) {
+        {
+            PROFILE_SCOPE("RenderQueue::Sort");
+            RadixSort(keys, sorted, keyScratch, sortedScratch);
+        }
+
+        // Instance data in draw order, so every run of packets is one contiguous range
+        instanceData.clear();
+        baseInstances.resize(sorted.size());
+        for (std::size_t i = 0; i < sorted.size(); ++i) {
+            baseInstances[i] = static_cast<GLuint>(instanceData.size());
+            if (sorted[i]->call->instanced) instanceData.push_back(sorted[i]->instance);
+        }
+
+        if (!instanceData.empty()) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, sInstanceSSBO);
+            if (instanceData.size() > instanceCapacity) {
+                instanceCapacity = std::max(instanceData.size(), instanceCapacity * 2);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, instanceCapacity * sizeof(BodyInstance), nullptr,
+                             GL_DYNAMIC_DRAW);
+            }
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instanceData.size() * sizeof(BodyInstance),
+                            instanceData.data());
+            GlState::BindStorageBuffer(0, sInstanceSSBO);
+        }
+
+        std::size_t begin = 0;
+        while (begin < sorted.size()) {
+            const std::uint64_t pass = keys[begin] >> PassShift;
+            std::size_t end = begin + 1;
+            while (end < sorted.size() && keys[end] >> PassShift == pass) ++end;
+
+            switch (static_cast<RenderPass>(pass)) {
+                case RenderPass::Opaque: {
+                    GPU_PROFILE_SCOPE("Render::Opaque");
+                    execute(begin, end);
+                    break;
+                }
+                case RenderPass::Transparent: {
+                    GPU_PROFILE_SCOPE("Render::Transparent");
+                    execute(begin, end);
+                    break;
+                }
+                case RenderPass::Overlay: {
+                    GPU_PROFILE_SCOPE("Render::Overlay");
+                    execute(begin, end);
+                    break;
+                }
+            }
+            begin = end;
+        }
+    }
+
+    // Hand back the defaults the rest of the frame expects - glClear needs depth writes on
+    GlState::Apply(RenderState{}, false);
+    GlState::BindVertexArray(0);
+
+    stats.stateChanges = GlState::Changes() - changesBefore;
+    stats.redundantSkipped = GlState::Skipped() - skippedBefore;
+
+    std::lock_guard lock(recordersMutex);
+    for (auto &recorder: recorders) recorder.packets.clear();
+}
+
+void RenderQueue::execute(std::size_t begin, std::size_t end) {
+    const DrawCall *current = nullptr;
+    GLint hasTextureLocation = -1;
+    int hasTexture = -1;
+
+    for (std::size_t i = begin; i < end;) {
+        const DrawPacket &packet = *sorted[i];
+        const DrawCall &call = *packet.call;
+
+        std::size_t last = i + 1;
+        if (call.instanced) {
+            while (last < end && sorted[last]->call == &call && sorted[last]->texture == packet.texture) ++last;
+        }
+
+        if (&call != current) {
+            GlState::Apply(call.state, wireframe);
+            call.shader->bind();
+            GlState::BindVertexArray(call.vao);
+            // Looked up per run rather than at Register, so programs can finish compiling late and be reloaded
+            hasTextureLocation = call.shader->location("hasTexture");
+            if (GLint sampler = call.shader->location("albedoTex"); sampler >= 0)
+                call.shader->setInt(sampler, 0); // packets bind their texture to unit 0
+            if (call.prepare) call.prepare(call);
+            current = &call;
+            hasTexture = -1;
+        }
+
+        const int textured = packet.texture ? 1 : 0;
+        if (hasTextureLocation >= 0 && textured != hasTexture) {
+            call.shader->setInt(hasTextureLocation, textured);
+            hasTexture = textured;
+        }
+        if (textured) GlState::BindTexture2D(0, packet.texture);
+
+        drawRun(packet, baseInstances[i], static_cast<GLsizei>(last - i));
+        ++stats.draws;
+        i = last;
+    }
+}
+
+void RenderQueue::drawRun(const DrawPacket &packet, GLuint baseInstance, GLsizei instanceCount) {
+    const DrawCall &call = *packet.call;
+    const std::size_t indexSize = call.indexType == GL_UNSIGNED_SHORT ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+    const void *firstIndex = reinterpret_cast<const void *>(call.first * indexSize);
+
+    if (!call.instanced) {
+        if (call.custom) call.custom(packet);
+        else if (call.indexed)
+            glDrawElementsBaseVertex(call.primitive, call.count, call.indexType, firstIndex, call.baseVertex);
+        else
+            glDrawArrays(call.primitive, static_cast<GLint>(call.first), call.count);
+        return;
+    }
+
+    if (call.indexed)
+        glDrawElementsInstancedBaseVertexBaseInstance(call.primitive, call.count, call.indexType, firstIndex,
+                                                      instanceCount, call.baseVertex, baseInstance);
+    else
+        glDrawArraysInstancedBaseInstance(call.primitive, static_cast<GLint>(call.first), call.count,
+                                          instanceCount, baseInstance);
+}
@@ -0,0 +1,266 @@
+#include "sceneTarget.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "glState.h"
+#include "gpuProfiler.h"
+#include "profiler.h"
+#include "shader.h"
+
+namespace {
+    GLuint createTexture(GLenum internalFormat, GLenum format, GLenum type, glm::ivec2 size) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size.x, size.y, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    glm::ivec2 scaledSize(glm::ivec2 size, float scale) {
+        return glm::max(glm::ivec2(std::lround(size.x * scale), std::lround(size.y * scale)), glm::ivec2(1));
+    }
+
+    // The upscale reads between texels; at the same size it samples texel centres, where linear changes nothing
+    void filterLinear(GLuint texture) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    bool checkComplete(const char *name) {
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) return true;
+        std::cerr << "[SceneTarget] " << name << " framebuffer is not complete" << std::endl;
+        return false;
+    }
+}
+
+void SceneTarget::Initialise(glm::ivec2 newSize, int sampleCount, bool offscreenOutput) {
+    if (resolvedFbo) return; // already initialised
+
+    outputSize = glm::max(newSize, glm::ivec2(1));
+    size = scaledSize(outputSize, scale);
+    samples = sampleCount;
+    offscreen = offscreenOutput;
+    create();
+    createOutput();
+}
+
+void SceneTarget::InitialiseUpscale(const char *vertPath, const char *fragPath) {
+    if (sUpscaleShader) return; // already initialised
+
+    sUpscaleShader = new Shader(vertPath, fragPath);
+    glGenVertexArrays(1, &sVAO);
+}
+
+void SceneTarget::Shutdown() {
+    destroy();
+    destroyOutput();
+
+    if (sUpscaleShader) {
+        delete sUpscaleShader;
+        glDeleteVertexArrays(1, &sVAO);
+        sUpscaleShader = nullptr;
+        sVAO = 0;
+    }
+}
+
+void SceneTarget::Resize(glm::ivec2 newSize) {
+    newSize = glm::max(newSize, glm::ivec2(1));
+    if (!resolvedFbo || newSize == outputSize) return;
+
+    outputSize = newSize;
+    size = scaledSize(outputSize, scale);
+    destroy();
+    destroyOutput();
+    create();
+    createOutput();
+}
+
+void SceneTarget::SetQuality(float newScale, int sampleCount) {
+    newScale = std::clamp(newScale, MinScale, 1.0f);
+    const glm::ivec2 newSize = scaledSize(outputSize, newScale);
+    scale = newScale;
+    if (!resolvedFbo || (newSize == size && sampleCount == samples)) return;
+
+    PROFILE_SCOPE("SceneTarget::SetQuality");
+    size = newSize;
+    samples = sampleCount;
+    // The output is untouched, so a capture in progress keeps its framebuffer
+    destroy();
+    create();
+}
+
+void SceneTarget::SetMotionVectors(bool enabled) {
+    if (enabled == motionVectors) return;
+    motionVectors = enabled;
+    if (!resolvedFbo) return;
+
+    destroy();
+    create();
+}
+
+void SceneTarget::create() {
+    resolvedColour = createTexture(ColourFormat, GL_RGBA, GL_UNSIGNED_BYTE, size);
+    filterLinear(resolvedColour);
+    resolvedDepth = createTexture(DepthFormat, GL_DEPTH_COMPONENT, GL_FLOAT, size);
+    compositeColour = createTexture(ColourFormat, GL_RGBA, GL_UNSIGNED_BYTE, size);
+    filterLinear(compositeColour);
+    // A resolve blit would write every draw buffer, so multisampled targets go without
+    if (motionVectors && samples == 0) motionTexture = createTexture(GL_RG16F, GL_RG, GL_HALF_FLOAT, size);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &resolvedFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, resolvedFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resolvedColour, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, resolvedDepth, 0);
+    if (motionTexture) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, motionTexture, 0);
+        const GLenum buffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, buffers);
+    }
+    checkComplete("Resolve");
+
+    if (samples > 0) {
+        glGenRenderbuffers(1, &multisampleColour);
+        glBindRenderbuffer(GL_RENDERBUFFER, multisampleColour);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, ColourFormat, size.x, size.y);
+
+        glGenRenderbuffers(1, &multisampleDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, multisampleDepth);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, DepthFormat, size.x, size.y);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &multisampleFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, multisampleFbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, multisampleColour);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, multisampleDepth);
+        checkComplete("Multisampled");
+    }
+
+    glGenFramebuffers(1, &compositeFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, compositeFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, compositeColour, 0);
+    checkComplete("Composite");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+}
+
+void SceneTarget::createOutput() {
+    if (offscreen) {
+        outputColour = createTexture(ColourFormat, GL_RGBA, GL_UNSIGNED_BYTE, outputSize);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &outputFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, outputColour, 0);
+        checkComplete("Output");
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+}
+
+void SceneTarget::destroy() {
+    presentSource = 0; // may be one of the textures going, and a new one can reuse its name
+    if (multisampleFbo) {
+        glDeleteFramebuffers(1, &multisampleFbo);
+        glDeleteRenderbuffers(1, &multisampleColour);
+        glDeleteRenderbuffers(1, &multisampleDepth);
+        multisampleFbo = multisampleColour = multisampleDepth = 0;
+    }
+    if (resolvedFbo) {
+        glDeleteFramebuffers(1, &resolvedFbo);
+        glDeleteTextures(1, &resolvedColour);
+        glDeleteTextures(1, &resolvedDepth);
+        resolvedFbo = resolvedColour = resolvedDepth = 0;
+    }
+    if (motionTexture) {
+        glDeleteTextures(1, &motionTexture);
+        motionTexture = 0;
+    }
+    if (compositeFbo) {
+        glDeleteFramebuffers(1, &compositeFbo);
+        glDeleteTextures(1, &compositeColour);
+        compositeFbo = compositeColour = 0;
+    }
+}
+
+void SceneTarget::destroyOutput() {
+    if (presentFbo) {
+        glDeleteFramebuffers(1, &presentFbo);
+        presentFbo = presentSource = 0;
+    }
+    if (outputFbo) {
+        glDeleteFramebuffers(1, &outputFbo);
+        glDeleteTextures(1, &outputColour);
+        outputFbo = outputColour = 0;
+    }
+}
+
+void SceneTarget::Begin() {
+    glBindFramebuffer(GL_FRAMEBUFFER, multisampleFbo ? multisampleFbo : resolvedFbo);
+    glViewport(0, 0, size.x, size.y);
+    glClearDepth(ClearDepth);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (motionTexture) {
+        const GLfloat noMotion[] = {ClearMotion, ClearMotion, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 1, noMotion);
+    }
+}
+
+void SceneTarget::Resolve() {
+    if (!multisampleFbo) return;
+
+    GPU_PROFILE_SCOPE("SceneTarget::Resolve");
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, multisampleFbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolvedFbo);
+    glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    // Depth can't be averaged; one sample per pixel is what later passes want anyway
+    glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, resolvedFbo);
+}
+
+void SceneTarget::Present(GLuint colour) {
+    PROFILE_SCOPE("SceneTarget::Present");
+
+    // At full resolution, or before the upscale program exists, a copy does
+    if (size == outputSize || !sUpscaleShader) {
+        if (!presentFbo) glGenFramebuffers(1, &presentFbo);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, presentFbo);
+        if (colour != presentSource) {
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour, 0);
+            presentSource = colour;
+        }
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFbo);
+        glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, outputSize.x, outputSize.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+        glViewport(0, 0, outputSize.x, outputSize.y);
+        return;
+    }
+
+    GPU_PROFILE_SCOPE("SceneTarget::Upscale");
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+    glViewport(0, 0, outputSize.x, outputSize.y);
+
+    RenderState state;
+    state.depthTest = false;
+    state.depthWrite = false;
+    state.cullBackFaces = false;
+    state.allowWireframe = false;
+    GlState::Apply(state, false);
+
+    GlState::BindTexture2D(0, colour);
+    GlState::BindVertexArray(sVAO);
+    sUpscaleShader->bind();
+    sUpscaleShader->setInt("MainTex", 0);
+    // Sharpen harder the further the scene is scaled, since there is more blur to undo
+    sUpscaleShader->setFloat("sharpness", sharpness * std::clamp((1.0f - scale) / (1.0f - MinScale), 0.0f, 1.0f));
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+
+    GlState::Apply(RenderState{}, false);
+}
@@ -1,114 +1,463 @@
 #include "shader.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <vector>
 #include <glm/gtc/type_ptr.hpp>
 
-Shader::Shader(const std::string vertexPath, const std::string fragmentPath) {
-    std::string vSource;
-    std::string fSource;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
+#include "frameUniforms.h"
+#include "glState.h"
+#include "maths.h"
+#include "profiler.h"
+#include "threadPool.h"
+
+namespace {
+    constexpr GLenum CompletionStatus = 0x91B1; // GL_COMPLETION_STATUS_KHR, the ARB extension shares it
+    using MaxShaderCompilerThreadsProc = void (APIENTRYP)(GLuint count);
+
+    constexpr char BinaryMagic[4] = {'P', 'B', 'I', 'N'};
+    constexpr std::uint32_t BinaryVersion = 1;
+
+    struct BinaryHeader {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t key;
+        std::uint32_t format;
+        std::uint32_t length;
+    };
+
+    GLuint compileStage(GLenum type, const std::string &source) {
+        const char *code = source.c_str();
+        const GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &code, nullptr);
+        glCompileShader(shader);
+        return shader;
+    }
+
+    void printCompileLog(GLuint shader, const char *stage) {
+        int success;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (success) return;
+
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+        std::ostringstream s;
+        s << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED\n" << infoLog;
+        std::cerr << s.str() << std::endl;
+    }
+
+    // Carries values set once at start-up (sampler units mostly) over to a reloaded program
+    void copyUniforms(GLuint from, GLuint to) {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(to, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(to, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> name(std::max(maxLength, 1));
+
+        for (GLint i = 0; i < count; ++i) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(to, i, static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+            const GLint target = glGetUniformLocation(to, name.data());
+            const GLint source = glGetUniformLocation(from, name.data());
+            if (target < 0 || source < 0 || size != 1) continue;
+
+            GLfloat f[16];
+            GLint n[4];
+            switch (type) {
+                case GL_FLOAT: glGetUniformfv(from, source, f); glProgramUniform1fv(to, target, 1, f); break;
+                case GL_FLOAT_VEC2: glGetUniformfv(from, source, f); glProgramUniform2fv(to, target, 1, f); break;
+                case GL_FLOAT_VEC3: glGetUniformfv(from, source, f); glProgramUniform3fv(to, target, 1, f); break;
+                case GL_FLOAT_VEC4: glGetUniformfv(from, source, f); glProgramUniform4fv(to, target, 1, f); break;
+                case GL_FLOAT_MAT4:
+                    glGetUniformfv(from, source, f);
+                    glProgramUniformMatrix4fv(to, target, 1, GL_FALSE, f);
+                    break;
+                case GL_INT_VEC2: glGetUniformiv(from, source, n); glProgramUniform2iv(to, target, 1, n); break;
+                case GL_INT_VEC3: glGetUniformiv(from, source, n); glProgramUniform3iv(to, target, 1, n); break;
+                case GL_INT_VEC4: glGetUniformiv(from, source, n); glProgramUniform4iv(to, target, 1, n); break;
+                case GL_INT:
+                case GL_BOOL:
+                case GL_SAMPLER_2D:
+                case GL_SAMPLER_3D:
+                case GL_SAMPLER_CUBE:
+                case GL_SAMPLER_2D_ARRAY:
+                case GL_SAMPLER_2D_SHADOW:
+                case GL_SAMPLER_2D_MULTISAMPLE:
+                    glGetUniformiv(from, source, n);
+                    glProgramUniform1iv(to, target, 1, n);
+                    break;
+                default:
+                    break; // set every frame by whoever uses it
+            }
+        }
+    }
+}
+
+void Shader::InitialiseCache(const std::string &directory, GLADloadproc loader) {
+    cacheDirectory = directory;
+
+    driver = std::string(reinterpret_cast<const char *>(glGetString(GL_VENDOR))) + '\n' +
+             reinterpret_cast<const char *>(glGetString(GL_RENDERER)) + '\n' +
+             reinterpret_cast<const char *>(glGetString(GL_VERSION));
+
+    GLint extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions && !parallelCompile; ++i) {
+        const std::string_view name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+        const char *entry = name == "GL_KHR_parallel_shader_compile" ? "glMaxShaderCompilerThreadsKHR"
+                          : name == "GL_ARB_parallel_shader_compile" ? "glMaxShaderCompilerThreadsARB"
+                          : nullptr;
+        if (!entry) continue;
+        if (auto maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(loader(entry))) {
+            maxThreads(0xFFFFFFFFu); // as many as the driver likes
+            parallelCompile = true;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(cacheDirectory, error);
+    lastWatch = std::chrono::steady_clock::now();
+
+    std::cout << "[Shader] Program cache in " << cacheDirectory
+              << (parallelCompile ? ", compiling in parallel" : "") << std::endl;
+}
+
+void Shader::ShutdownCache() {
+    for (Shader *shader: sShaders) {
+        shader->finishBuild(true);
+        if (shader->handle) glDeleteProgram(shader->handle);
+        shader->handle.store(0, std::memory_order_release);
+        shader->uniformLocations.clear();
+        shader->uniformBlocks.clear();
+    }
+}
+
+void Shader::Update() {
+    PROFILE_SCOPE("Shader::Update");
+
+    for (Shader *shader: sShaders) shader->finishBuild(false);
+
+    const auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - lastWatch).count() < WatchInterval) return;
+    lastWatch = now;
+
+    for (Shader *shader: sShaders) {
+        if (shader->pending.program || !shader->sourcesChanged()) continue;
+        std::cout << "[Shader] Reloading " << shader->vertexPath << " + " << shader->fragmentPath << std::endl;
+        shader->startBuild();
+    }
+}
+
+std::string Shader::loadSource(const std::string &path, std::vector<WatchedFile> &files, int depth) {
+    std::error_code error;
+    files.push_back({path, std::filesystem::last_write_time(path, error)});
+
+    std::ifstream file;
 
     // ensure ifstream objects can throw exceptions
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
+    std::string source;
     try {
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
+        file.open(path);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        file.close();
+        source = stream.str();
+    }
+    catch (std::ifstream::failure e) {
+        std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ " << path << std::endl;
+        return source;
+    }
 
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
+    // Resolve `#include "file"` lines relative to this file, so shared blocks are written once
+    const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    std::istringstream lines(source);
+    std::ostringstream resolved;
+    std::string line;
+    while (std::getline(lines, line)) {
+        const std::size_t directive = line.find("#include");
+        const std::size_t open = line.find('"');
+        const std::size_t close = line.rfind('"');
+        if (directive != std::string::npos && line.find_first_not_of(" \t") == directive &&
+            open != std::string::npos && close > open) {
+            if (depth >= 8) {
+                std::cerr << "ERROR::SHADER::INCLUDE_TOO_DEEP " << path << std::endl;
+                continue;
+            }
+            resolved << loadSource((directory / line.substr(open + 1, close - open - 1)).string(), files, depth + 1)
+                     << '\n';
+        } else {
+            resolved << line << '\n';
+        }
+    }
+    return resolved.str();
+}
 
-        vShaderFile.close();
-        fShaderFile.close();
+Shader::Shader(const std::string vertexPath, const std::string fragmentPath)
+    : vertexPath(vertexPath), fragmentPath(fragmentPath) {
+    sShaders.push_back(this);
+    startBuild();
+}
 
-        vSource = vShaderStream.str();
-        fSource = fShaderStream.str();
+Shader::~Shader() {
+    std::erase(sShaders, this);
+    if (pending.program) {
+        glDeleteShader(pending.vertex);
+        glDeleteShader(pending.fragment);
+        glDeleteProgram(pending.program);
     }
-    catch (std::ifstream::failure e) {
-        std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+    if (handle) glDeleteProgram(handle);
+}
+
+void Shader::startBuild() {
+    PROFILE_SCOPE("Shader::startBuild");
+
+    std::vector<WatchedFile> read;
+    const std::string vSource = loadSource(vertexPath, read);
+    const std::string fSource = loadSource(fragmentPath, read);
+    files = std::move(read); // watched even if they don't compile, so fixing them reloads
+
+    const std::uint64_t key = fnv1a(fSource, fnv1a(std::string_view("\0", 1), fnv1a(vSource, fnv1a(driver))));
+
+    if (pending.program) {
+        glDeleteShader(pending.vertex);
+        glDeleteShader(pending.fragment);
+        glDeleteProgram(pending.program);
+        pending = {};
     }
 
-    const char* vShaderCode = vSource.c_str();
-    const char* fShaderCode = fSource.c_str();
+    if (const GLuint cached = loadBinary(key)) {
+        adopt(cached);
+        return;
+    }
 
-    unsigned int vertex, fragment;
-    int success;
-    char infoLog[512];
+    // Nothing here waits on the driver; finishBuild checks the result once it's needed or done
+    pending.key = key;
+    pending.vertex = compileStage(GL_VERTEX_SHADER, vSource);
+    pending.fragment = compileStage(GL_FRAGMENT_SHADER, fSource);
+    pending.program = glCreateProgram();
+    if (!cacheDirectory.empty()) glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(pending.program, pending.vertex);
+    glAttachShader(pending.program, pending.fragment);
+    glLinkProgram(pending.program);
+}
+
+bool Shader::finishBuild(bool wait) const {
+    if (!pending.program) return true;
 
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, nullptr);
-    glCompileShader(vertex);
+    if (!wait && parallelCompile) {
+        GLint done = 0;
+        glGetProgramiv(pending.program, CompletionStatus, &done);
+        if (!done) return false;
+    }
+
+    const Build build = pending;
+    pending = {};
 
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+    int success;
+    glGetProgramiv(build.program, GL_LINK_STATUS, &success);
     if (!success) {
-        glGetShaderInfoLog(vertex, 512, nullptr, infoLog);
+        printCompileLog(build.vertex, "VERTEX");
+        printCompileLog(build.fragment, "FRAGMENT");
 
+        char infoLog[512];
+        glGetProgramInfoLog(build.program, 512, nullptr, infoLog);
         std::ostringstream s;
-        s << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog;
+        s << "ERROR::SHADER::LINKING_FAILED\n" << infoLog;
         std::cerr << s.str() << std::endl;
     }
 
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, nullptr);
-    glCompileShader(fragment);
+    glDetachShader(build.program, build.vertex);
+    glDetachShader(build.program, build.fragment);
+    glDeleteShader(build.vertex);
+    glDeleteShader(build.fragment);
 
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragment, 512, nullptr, infoLog);
+    if (success) {
+        if (!cacheDirectory.empty()) saveBinary(build.program, build.key);
+        adopt(build.program);
+    } else if (handle) {
+        std::cerr << "[Shader] Keeping the previous " << vertexPath << " + " << fragmentPath << std::endl;
+        glDeleteProgram(build.program);
+    } else {
+        adopt(build.program); // nothing to fall back on; every uniform lookup fails, as it always has
+    }
+    return true;
+}
 
-        std::ostringstream s;
-        s << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog;
-        std::cerr << s.str() << std::endl;
+void Shader::adopt(GLuint program) const {
+    const GLuint previous = handle;
+    handle.store(program, std::memory_order_release);
+    uniformLocations.clear();
+    uniformBlocks.clear();
+    reflect();
+
+    if (previous) {
+        copyUniforms(previous, program);
+        glDeleteProgram(previous);
+        GlState::Invalidate(); // the old name may come back for another program
+    }
+}
+
+bool Shader::sourcesChanged() const {
+    for (const WatchedFile &file: files) {
+        std::error_code error;
+        const auto modified = std::filesystem::last_write_time(file.path, error);
+        if (!error && modified != file.modified) return true; // a file missing mid-save is checked again next time
     }
+    return false;
+}
 
-    handle = glCreateProgram();
-    glAttachShader(handle, vertex);
-    glAttachShader(handle, fragment);
-    glLinkProgram(handle);
+std::string Shader::binaryPath(std::uint64_t key) {
+    char name[21];
+    std::snprintf(name, sizeof name, "%016llx.bin", static_cast<unsigned long long>(key));
+    return cacheDirectory + "/" + name;
+}
 
-    glGetProgramiv(handle, GL_LINK_STATUS, &success);
+GLuint Shader::loadBinary(std::uint64_t key) {
+    if (cacheDirectory.empty()) return 0;
+
+    std::ifstream file(binaryPath(key), std::ios::binary);
+    if (!file) return 0;
+
+    BinaryHeader header{};
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof header)) return 0;
+    if (std::memcmp(header.magic, BinaryMagic, sizeof BinaryMagic) != 0 || header.version != BinaryVersion ||
+        header.key != key)
+        return 0;
+
+    std::vector<char> data(header.length);
+    if (!file.read(data.data(), static_cast<std::streamsize>(data.size()))) return 0;
+
+    // Drivers may refuse binaries from an older version of themselves; that's just a miss
+    const GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, data.data(), static_cast<GLsizei>(data.size()));
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
     if (!success) {
-        glGetProgramInfoLog(handle, 512, nullptr, infoLog);
-        std::ostringstream s;
-        s << "ERROR::SHADER::LINKING_FAILED\n" << infoLog;
-        std::cerr << s.str() << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void Shader::saveBinary(GLuint program, std::uint64_t key) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    BinaryHeader header{};
+    std::memcpy(header.magic, BinaryMagic, sizeof BinaryMagic);
+    header.version = BinaryVersion;
+    header.key = key;
+
+    std::vector<char> data(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, data.data());
+    header.format = format;
+    header.length = static_cast<std::uint32_t>(length);
+
+    // Disk writes stay off the main thread; a temporary name keeps a half-written file from being loaded
+    ThreadPool::Submit([path = binaryPath(key), header, data = std::move(data)] {
+        const std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char *>(&header), sizeof header);
+            file.write(data.data(), header.length);
+            if (!file) {
+                std::cerr << "[Shader] Failed to write " << temporary << std::endl;
+                return;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+    });
+}
+
+void Shader::reflect() const {
+    GLint count = 0, maxLength = 0;
+
+    glGetProgramiv(handle, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(handle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(std::max(maxLength, 1));
+
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(handle, i, static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+
+        std::string uniform(name.data(), length);
+        GLint loc = glGetUniformLocation(handle, uniform.c_str());
+        if (loc < 0) continue; // lives in a uniform block
+
+        // Arrays are reported as "name[0]"; make the bare name work too
+        if (uniform.size() > 3 && uniform.ends_with("[0]"))
+            uniformLocations.emplace(uniform.substr(0, uniform.size() - 3), loc);
+        uniformLocations.emplace(std::move(uniform), loc);
     }
 
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    count = maxLength = 0;
+    glGetProgramiv(handle, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(handle, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    name.resize(std::max(maxLength, 1));
+
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(handle, i, static_cast<GLsizei>(name.size()), &length, name.data());
+        std::string block(name.data(), length);
+
+        // Every program shares the frame block at one binding, whatever the shader declared
+        if (block == FrameUniforms::BlockName)
+            glUniformBlockBinding(handle, i, FrameUniforms::Binding);
+
+        uniformBlocks.emplace(std::move(block), i);
+    }
 }
 
 void Shader::bind() {
-    glUseProgram(handle);
+    PROFILE_SCOPE("Shader::Bind");
+    if (!handle) finishBuild(true);
+    GlState::UseProgram(handle);
 }
 
-void Shader::setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(handle, name.c_str()), (int)value);
+GLint Shader::location(std::string_view name) const {
+    if (!handle) finishBuild(true);
+    auto found = uniformLocations.find(name);
+    return found != uniformLocations.end() ? found->second : -1;
 }
-void Shader::setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(handle, name.c_str()), value);
+
+bool Shader::hasUniformBlock(std::string_view name) const {
+    if (!handle) finishBuild(true);
+    return uniformBlocks.find(name) != uniformBlocks.end();
 }
-void Shader::setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(handle, name.c_str()), value);
+
+void Shader::setInt(GLint location, int value) const {
+    glUniform1i(location, value);
+}
+
+void Shader::setFloat(GLint location, float value) const {
+    glUniform1f(location, value);
 }
 
-void Shader::setVec2(const std::string &name, glm::vec2 value) const {
-    glUniform2fv(glGetUniformLocation(handle, name.c_str()), 1, glm::value_ptr(value));
+void Shader::setVec2(GLint location, glm::vec2 value) const {
+    glUniform2fv(location, 1, glm::value_ptr(value));
 }
 
-void Shader::setVec3(const std::string &name, glm::vec3 value) const {
-    glUniform3fv(glGetUniformLocation(handle, name.c_str()), 1, glm::value_ptr(value));
+void Shader::setVec3(GLint location, glm::vec3 value) const {
+    glUniform3fv(location, 1, glm::value_ptr(value));
 }
 
-void Shader::setVec4(const std::string &name, glm::vec4 value) const {
-    glUniform4fv(glGetUniformLocation(handle, name.c_str()), 1, glm::value_ptr(value));
+void Shader::setVec4(GLint location, glm::vec4 value) const {
+    glUniform4fv(location, 1, glm::value_ptr(value));
 }
 
-void Shader::setMat4(const std::string &name, glm::mat4 matrix) const {
-    glUniformMatrix4fv(glGetUniformLocation(handle, name.c_str()), 1, GL_FALSE, glm::value_ptr(matrix));
+void Shader::setMat4(GLint location, const glm::mat4 &matrix) const {
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
 int Shader::getAttribLoc(const std::string attribName) {
+    if (!handle) finishBuild(true);
     return glGetAttribLocation(handle, attribName.c_str());
 }
\ No newline at end of file
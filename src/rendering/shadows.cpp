@@ -0,0 +1,140 @@
+#include "shadows.h"
+
+#include <algorithm>
+
+#include "celestialBody.h"
+#include "culling.h"
+#include "glState.h"
+#include "lod.h"
+#include "profiler.h"
+#include "threadPool.h"
+
+Shadows::Stats Shadows::stats{};
+
+void Shadows::Initialise() {
+    if (sSSBO) return; // already initialised
+
+    // Never left empty, so the binding is always valid even on frames nothing is shadowed
+    capacity = 64;
+    glGenBuffers(1, &sSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, sSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Shadows::Shutdown() {
+    if (sSSBO) glDeleteBuffers(1, &sSSBO);
+    sSSBO = 0;
+    capacity = 0;
+}
+
+void Shadows::Build(const std::vector<CelestialBody> &bodies, const std::vector<glm::vec3> &centres,
+                    const std::vector<float> &radii, const std::vector<std::uint32_t> &visible,
+                    const glm::vec3 &lightCentre, float lightRadius, float pixelScale) {
+    PROFILE_SCOPE("Shadows::Build");
+
+    ranges.assign(centres.size(), glm::uvec2(0));
+
+    // Point sprites are a pixel or two across, too small for an eclipse to read
+    receivers.clear();
+    for (const std::uint32_t body: visible) {
+        if (bodies[body].material.emissive) continue;
+        if (Lod::ProjectedRadius(radii[body], glm::length(centres[body]), pixelScale) >= Lod::PointBelowPx)
+            receivers.push_back(body);
+    }
+
+    // Every receiver owns MaxOccluders slots, so the jobs write without sharing anything
+    spheres.resize(receivers.size() * MaxOccluders);
+    counts.resize(receivers.size());
+    ThreadPool::ParallelFor(receivers.size(), ParallelGrain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+            counts[i] = findOccluders(bodies, centres, radii, receivers[i], lightCentre, lightRadius,
+                                      &spheres[i * MaxOccluders]);
+    });
+
+    stats = Stats{};
+    stats.receivers = receivers.size();
+    for (std::size_t i = 0; i < receivers.size(); ++i) {
+        ranges[receivers[i]] = glm::uvec2(i * MaxOccluders, counts[i]);
+        stats.occluders += counts[i];
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, sSSBO);
+    if (spheres.size() > capacity) {
+        capacity = std::max(spheres.size(), capacity * 2);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+    }
+    if (stats.occluders > 0)
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, spheres.size() * sizeof(glm::vec4), spheres.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    GlState::BindStorageBuffer(Binding, sSSBO);
+}
+
+std::size_t Shadows::findOccluders(const std::vector<CelestialBody> &bodies, const std::vector<glm::vec3> &centres,
+                                   const std::vector<float> &radii, std::uint32_t receiver,
+                                   const glm::vec3 &lightCentre, float lightRadius, glm::vec4 *found) {
+    const glm::vec3 toReceiver = centres[receiver] - lightCentre;
+    const float receiverDistance = glm::length(toReceiver);
+    if (receiverDistance <= lightRadius) return 0;
+
+    const glm::vec3 axis = toReceiver / receiverDistance;
+    const float receiverRadius = radii[receiver];
+
+    // Candidates come from the culling hierarchy, so whole subtrees nowhere near the light-to-receiver path
+    // are passed over. The test below, multiplied through by `along`, is linear in it:
+    //   offAxis d < d (lightRadius + radius) + along (receiverRadius - lightRadius)
+    // and no body inside a sphere of radius r is bigger than r or more than r from its centre.
+    thread_local std::vector<std::uint32_t> candidates;
+    candidates.clear();
+    Culling::Query([&](const glm::vec3 &centre, float r) {
+        const glm::vec3 fromLight = centre - lightCentre;
+        const float along = glm::dot(fromLight, axis);
+        const float nearest = std::max(along - r, 0.0f), furthest = along + r;
+        if (furthest <= 0.0f || nearest >= receiverDistance + receiverRadius) return false;
+
+        const float offAxis = std::max(glm::length(fromLight - axis * along) - r, 0.0f);
+        if (furthest > receiverDistance && offAxis < r + receiverRadius) return true; // level with the receiver
+        if (nearest > receiverDistance) return false;
+        const float best = receiverRadius > lightRadius ? std::min(furthest, receiverDistance) : nearest;
+        return offAxis * receiverDistance <
+               receiverDistance * (lightRadius + r) + best * (receiverRadius - lightRadius);
+    }, candidates);
+
+    // Kept in descending order of angular radius as seen from the receiver
+    float sizes[MaxOccluders];
+    std::size_t count = 0;
+
+    for (const std::uint32_t body: candidates) {
+        if (body == receiver || bodies[body].material.emissive) continue;
+
+        // Only something between the light and the far side of the receiver can shade it
+        const glm::vec3 fromLight = centres[body] - lightCentre;
+        const float along = glm::dot(fromLight, axis);
+        if (along <= 0.0f || along >= receiverDistance + receiverRadius) continue;
+
+        // The penumbra cone leaves the occluder bounded by lines from the light's opposite limb, so it
+        // widens by (lightRadius + radius) / along per unit of distance behind the occluder
+        const float radius = radii[body];
+        const float behind = std::max(receiverDistance - along, 0.0f);
+        const float penumbra = radius + behind * (lightRadius + radius) / along;
+        // The cone's own axis runs from the light through the occluder, so by the receiver it has drifted
+        // away from the receiver's axis by d / along times the occluder's offset
+        const float offAxis = glm::length(fromLight - axis * along) * std::max(receiverDistance / along, 1.0f);
+        if (offAxis >= penumbra + receiverRadius) continue;
+
+        const float size = radius / std::max(glm::length(centres[body] - centres[receiver]), 1e-6f);
+        if (count == MaxOccluders && size <= sizes[count - 1]) continue;
+
+        std::size_t slot = std::min(count, MaxOccluders - 1);
+        while (slot > 0 && sizes[slot - 1] < size) {
+            sizes[slot] = sizes[slot - 1];
+            found[slot] = found[slot - 1];
+            --slot;
+        }
+        sizes[slot] = size;
+        found[slot] = glm::vec4(centres[body], radius);
+        count = std::min(count + 1, MaxOccluders);
+    }
+    return count;
+}
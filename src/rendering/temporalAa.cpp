@@ -0,0 +1,132 @@
+#include "temporalAa.h"
+
+#include <iostream>
+
+#include "glState.h"
+#include "gpuProfiler.h"
+#include "profiler.h"
+#include "sceneTarget.h"
+
+namespace {
+    // Radical inverse in `base`, the index-th point of the Halton sequence along one axis
+    float halton(std::uint32_t index, std::uint32_t base) {
+        float fraction = 1.0f;
+        float result = 0.0f;
+        while (index > 0) {
+            fraction /= static_cast<float>(base);
+            result += fraction * static_cast<float>(index % base);
+            index /= base;
+        }
+        return result;
+    }
+}
+
+void TemporalAa::InitialiseShared(const char *vertPath, const char *fragPath) {
+    if (sShader) return; // already initialised
+
+    sShader = new Shader(vertPath, fragPath);
+    glGenVertexArrays(1, &sVAO);
+}
+
+void TemporalAa::ShutdownShared() {
+    if (!sShader) return;
+
+    releaseTargets();
+    glDeleteVertexArrays(1, &sVAO);
+    delete sShader;
+    sShader = nullptr;
+    sVAO = 0;
+}
+
+glm::vec2 TemporalAa::Jitter(std::uint64_t frameIndex, glm::ivec2 size) {
+    // Starting at 1 skips the sequence's first point, which is the pixel corner for both axes
+    const auto index = static_cast<std::uint32_t>(frameIndex % JitterPhases) + 1;
+    const glm::vec2 pixels(halton(index, 2) - 0.5f, halton(index, 3) - 0.5f);
+    return pixels * 2.0f / glm::vec2(glm::max(size, glm::ivec2(1)));
+}
+
+void TemporalAa::createTargets(glm::ivec2 size) {
+    for (int i = 0; i < 2; ++i) {
+        glGenTextures(1, &historyTexture[i]);
+        glBindTexture(GL_TEXTURE_2D, historyTexture[i]);
+        // Half float, so the small per-frame blends don't band the way 8 bits would
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, size.x, size.y, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+        // Linear for reading the reprojected history between texels, and for Present's upscale
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glGenFramebuffers(1, &historyFbo[i]);
+        glBindFramebuffer(GL_FRAMEBUFFER, historyFbo[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, historyTexture[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "[TemporalAa] History framebuffer is not complete" << std::endl;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GlState::Invalidate();
+
+    historySize = size;
+    historyValid = false;
+}
+
+void TemporalAa::releaseTargets() {
+    if (!historyFbo[0]) return;
+
+    glDeleteFramebuffers(2, historyFbo);
+    glDeleteTextures(2, historyTexture);
+    historyFbo[0] = historyFbo[1] = 0;
+    historyTexture[0] = historyTexture[1] = 0;
+    historySize = glm::ivec2(0);
+    historyValid = false;
+}
+
+GLuint TemporalAa::Resolve(GLuint colour, const glm::vec3 &cameraMotion) {
+    // Without motion vectors (MSAA on) there is nothing to reproject with
+    if (!sShader || !SceneTarget::MotionTexture()) return colour;
+
+    GPU_PROFILE_SCOPE("TemporalAa::Resolve");
+
+    // Dynamic resolution changes the size; history at another size is no use
+    const glm::ivec2 size = SceneTarget::Size();
+    if (size != historySize) {
+        releaseTargets();
+        createTargets(size);
+    }
+
+    const int previous = current;
+    current ^= 1;
+
+    RenderState state;
+    state.depthTest = false;
+    state.depthWrite = false;
+    state.cullBackFaces = false;
+    state.allowWireframe = false;
+    GlState::Apply(state, false);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, historyFbo[current]);
+    glViewport(0, 0, size.x, size.y);
+
+    GlState::BindTexture2D(0, colour);
+    GlState::BindTexture2D(1, SceneTarget::DepthTexture());
+    GlState::BindTexture2D(2, SceneTarget::MotionTexture());
+    GlState::BindTexture2D(3, historyTexture[previous]);
+    GlState::BindVertexArray(sVAO);
+
+    sShader->bind();
+    sShader->setInt("MainTex", 0);
+    sShader->setInt("DepthTex", 1);
+    sShader->setInt("MotionTex", 2);
+    sShader->setInt("HistoryTex", 3);
+    sShader->setBool("historyValid", historyValid);
+    sShader->setVec3("cameraMotion", cameraMotion);
+    sShader->setFloat("feedbackStill", settings.feedbackStill);
+    sShader->setFloat("feedbackMoving", settings.feedbackMoving);
+    sShader->setFloat("clipGamma", settings.clipGamma);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+
+    GlState::Apply(RenderState{}, false);
+    historyValid = true;
+    return historyTexture[current];
+}
@@ -0,0 +1,427 @@
+#include "terrain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "glState.h"
+#include "maths.h"
+#include "profiler.h"
+#include "threadPool.h"
+#include "vertex.h"
+
+namespace {
+    constexpr int N = Terrain::PatchSegments;
+
+    // Row i runs from the edge AB (j = 0) to the edge AC (j = i); row N is the edge BC
+    constexpr int gridIndex(int i, int j) {
+        return i * (i + 1) / 2 + j;
+    }
+
+    // Grid vertices around the edge, A to B to C and back, so the interior is on the left seen from outside
+    std::vector<int> perimeter() {
+        std::vector<int> loop;
+        for (int i = 0; i < N; ++i) loop.push_back(gridIndex(i, 0));
+        for (int j = 0; j < N; ++j) loop.push_back(gridIndex(N, j));
+        for (int i = N; i > 0; --i) loop.push_back(gridIndex(i, i));
+        return loop;
+    }
+
+    glm::dvec3 gridPoint(const std::array<glm::dvec3, 3> &corners, int i, int j) {
+        return corners[0] + (corners[1] - corners[0]) * (static_cast<double>(i - j) / N) +
+               (corners[2] - corners[0]) * (static_cast<double>(j) / N);
+    }
+
+    std::int16_t snorm(float value) {
+        return static_cast<std::int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    double skirtDepth(double edge) {
+        // Deep enough to cover the height error of a coarser neighbour's edge, two segments of this patch
+        return 2.0 * edge / N;
+    }
+}
+
+Terrain::Streaming::~Streaming() {
+    PatchData *data;
+    while (finished.tryPop(data)) delete data;
+}
+
+void Terrain::InitialiseShared(const char *vertPath, const char *fragPath) {
+    if (sShader) return; // already initialised
+
+    sShader = new Shader(vertPath, fragPath);
+
+    // Every patch has the same topology, so one 16-bit index buffer serves all of them
+    std::vector<std::uint16_t> indices;
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            indices.insert(indices.end(), {static_cast<std::uint16_t>(gridIndex(i, j)),
+                                           static_cast<std::uint16_t>(gridIndex(i + 1, j)),
+                                           static_cast<std::uint16_t>(gridIndex(i + 1, j + 1))});
+            if (j < i)
+                indices.insert(indices.end(), {static_cast<std::uint16_t>(gridIndex(i, j)),
+                                               static_cast<std::uint16_t>(gridIndex(i + 1, j + 1)),
+                                               static_cast<std::uint16_t>(gridIndex(i, j + 1))});
+        }
+    }
+
+    // Skirt quads facing outwards, each edge vertex paired with the one hanging below it
+    const std::vector<int> loop = perimeter();
+    for (int k = 0; k < EdgeVertices; ++k) {
+        const int next = (k + 1) % EdgeVertices;
+        const auto top = static_cast<std::uint16_t>(loop[k]), topNext = static_cast<std::uint16_t>(loop[next]);
+        const auto bottom = static_cast<std::uint16_t>(GridVertices + k);
+        const auto bottomNext = static_cast<std::uint16_t>(GridVertices + next);
+        indices.insert(indices.end(), {top, bottom, topNext, topNext, bottom, bottomNext});
+    }
+    sIndexCount = static_cast<GLsizei>(indices.size());
+
+    glGenBuffers(1, &sEBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(std::uint16_t), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    DrawCall call;
+    call.shader = sShader;
+    call.instanced = false;
+    call.custom = drawPatches;
+    sCall = RenderQueue::Register(call);
+}
+
+void Terrain::ShutdownShared() {
+    if (!sShader) return;
+    glDeleteBuffers(1, &sEBO);
+    sEBO = 0;
+    delete sShader;
+    sShader = nullptr;
+    sCall = nullptr;
+}
+
+Terrain::Terrain(double radius, const TerrainSettings &settings)
+    : radius(radius), streaming(std::make_shared<Streaming>(radius, settings)) {
+    const auto free = std::find(sTerrains.begin(), sTerrains.end(), nullptr);
+    id = static_cast<std::uint32_t>(free - sTerrains.begin());
+    if (free == sTerrains.end()) sTerrains.push_back(this);
+    else *free = this;
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &originSSBO);
+
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(MaxResidentPatches) * PatchVertices * sizeof(TerrainVertex),
+                 nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sEBO);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex),
+                          (void *) offsetof(TerrainVertex, position)); // relative to the patch centre
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(TerrainVertex),
+                          (void *) offsetof(TerrainVertex, normal)); // octahedral normal
+    glEnableVertexAttribArray(1);
+
+    glBindVertexArray(0);
+    GlState::Invalidate();
+
+    freeSlots.reserve(MaxResidentPatches);
+    for (int slot = MaxResidentPatches - 1; slot >= 0; --slot) freeSlots.push_back(slot);
+
+    // The octahedron's faces, wound counter-clockwise seen from outside
+    int root = 0;
+    for (int sx = -1; sx <= 1; sx += 2) {
+        for (int sy = -1; sy <= 1; sy += 2) {
+            for (int sz = -1; sz <= 1; sz += 2) {
+                std::array<glm::dvec3, 3> corners = {glm::dvec3(sx, 0, 0), glm::dvec3(0, sy, 0), glm::dvec3(0, 0, sz)};
+                if (glm::dot(glm::cross(corners[1] - corners[0], corners[2] - corners[0]), glm::dvec3(sx, sy, sz)) < 0.0)
+                    std::swap(corners[1], corners[2]);
+                roots[root++] = createNode(corners, 0);
+            }
+        }
+    }
+}
+
+Terrain::~Terrain() {
+    release();
+    if (id < sTerrains.size()) sTerrains[id] = nullptr;
+}
+
+void Terrain::release() {
+    if (vao) glDeleteVertexArrays(1, &vao);
+    if (vbo) glDeleteBuffers(1, &vbo);
+    if (originSSBO) glDeleteBuffers(1, &originSSBO);
+    vao = vbo = originSSBO = 0;
+    originCapacity = 0;
+    drawOrigins.clear();
+    drawBaseVertices.clear();
+    drawCounts.clear();
+    drawOffsets.clear();
+}
+
+std::uint32_t Terrain::createNode(const std::array<glm::dvec3, 3> &corners, std::uint8_t level) {
+    std::uint32_t index;
+    if (!freeNodes.empty()) {
+        index = freeNodes.back();
+        freeNodes.pop_back();
+    } else {
+        index = static_cast<std::uint32_t>(nodes.size());
+        nodes.emplace_back();
+    }
+
+    Node &node = nodes[index];
+    node = Node{};
+    node.corners = corners;
+    node.level = level;
+    node.alive = true;
+    node.centre = glm::normalize(corners[0] + corners[1] + corners[2]) * radius;
+
+    node.edge = 0.0;
+    double reach = 0.0;
+    for (int k = 0; k < 3; ++k) {
+        const glm::dvec3 corner = glm::normalize(corners[k]) * radius;
+        const glm::dvec3 next = glm::normalize(corners[(k + 1) % 3]) * radius;
+        node.edge = std::max(node.edge, glm::length(next - corner));
+        reach = std::max(reach, glm::length(corner - node.centre));
+    }
+    node.bound = reach + streaming->heights.maxHeight() + skirtDepth(node.edge);
+    return index;
+}
+
+void Terrain::releaseNode(std::uint32_t index) {
+    Node &node = nodes[index];
+    releaseChildren(node);
+    if (node.slot >= 0) freeSlots.push_back(node.slot);
+    node.slot = -1;
+    node.ticket = 0; // anything still generating for it is dropped on arrival
+    node.alive = false;
+    freeNodes.push_back(index);
+}
+
+void Terrain::releaseChildren(Node &node) {
+    if (node.children[0] < 0) return;
+    const std::array<std::int32_t, 4> children = {node.children[0], node.children[1], node.children[2], node.children[3]};
+    for (int k = 0; k < 4; ++k) node.children[k] = -1;
+    for (std::int32_t child: children) releaseNode(static_cast<std::uint32_t>(child));
+}
+
+void Terrain::generate(const Streaming &streaming, double radius, const Node &node, PatchData &data) {
+    PROFILE_SCOPE("Terrain::Generate");
+
+    const HeightField &heights = streaming.heights;
+    auto surface = [&](const glm::dvec3 &flat) {
+        const glm::dvec3 direction = glm::normalize(flat);
+        return direction * (radius + heights.height(direction));
+    };
+
+    // Normals by central differences of the height field itself, so neighbouring patches agree on them
+    const glm::dvec3 du = (node.corners[1] - node.corners[0]) * (0.5 / N);
+    const glm::dvec3 dv = (node.corners[2] - node.corners[0]) * (0.5 / N);
+
+    data.vertices.resize(PatchVertices);
+    std::vector<glm::dvec3> directions(GridVertices);
+
+    for (int i = 0; i <= N; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            const glm::dvec3 flat = gridPoint(node.corners, i, j);
+            const glm::dvec3 position = surface(flat);
+            glm::dvec3 normal = glm::normalize(glm::cross(surface(flat + du) - surface(flat - du),
+                                                          surface(flat + dv) - surface(flat - dv)));
+            directions[gridIndex(i, j)] = glm::normalize(flat);
+
+            TerrainVertex &vertex = data.vertices[gridIndex(i, j)];
+            vertex.position = glm::vec3(kmToSu(position - node.centre));
+            const glm::vec2 encoded = OctahedralEncode(glm::vec3(normal));
+            vertex.normal[0] = snorm(encoded.x);
+            vertex.normal[1] = snorm(encoded.y);
+        }
+    }
+
+    // Skirt vertices hang straight down from the edge, sharing its normals so they shade like the edge
+    const std::vector<int> loop = perimeter();
+    const double depth = skirtDepth(node.edge);
+    for (int k = 0; k < EdgeVertices; ++k) {
+        const TerrainVertex &top = data.vertices[loop[k]];
+        TerrainVertex &skirt = data.vertices[GridVertices + k];
+        skirt = top;
+        skirt.position -= glm::vec3(kmToSu(directions[loop[k]] * depth));
+    }
+}
+
+void Terrain::receive() {
+    PatchData *data;
+    int uploads = 0;
+    while (uploads < UploadsPerFrame && streaming->finished.tryPop(data)) {
+        --generating;
+
+        const bool current = data->node < nodes.size() && nodes[data->node].alive &&
+                             nodes[data->node].ticket == data->ticket;
+        if (current && !freeSlots.empty()) {
+            Node &node = nodes[data->node];
+            node.slot = freeSlots.back();
+            node.ticket = 0;
+            freeSlots.pop_back();
+
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferSubData(GL_ARRAY_BUFFER,
+                            static_cast<GLintptr>(node.slot) * PatchVertices * sizeof(TerrainVertex),
+                            PatchVertices * sizeof(TerrainVertex), data->vertices.data());
+            ++uploads;
+        } else if (current) {
+            nodes[data->node].ticket = 0; // asked for again once a slot frees up
+        }
+        delete data;
+    }
+    if (uploads) glBindBuffer(GL_ARRAY_BUFFER, 0);
+    stats.uploaded = uploads;
+}
+
+void Terrain::request(std::uint32_t index, const glm::dvec3 &camera) {
+    const Node &node = nodes[index];
+    if (node.slot >= 0 || node.ticket != 0) return;
+    requests.push_back({glm::length(camera - node.centre), index});
+}
+
+void Terrain::submitRequests() {
+    // Nearest first; only as many as there is staging room and a vertex buffer slot waiting for each
+    std::sort(requests.begin(), requests.end(), [](const Request &a, const Request &b) {
+        return a.distance < b.distance;
+    });
+
+    for (const Request &request: requests) {
+        if (generating >= StagingCapacity || generating >= freeSlots.size()) break;
+
+        Node &node = nodes[request.node];
+        node.ticket = nextTicket++;
+        if (nextTicket == 0) nextTicket = 1;
+        ++generating;
+
+        // Only ever runs on a pool worker: a ParallelFor on the main thread helps with its own chunks, not
+        // with queued jobs like this one
+        ThreadPool::Submit([streaming = streaming, radius = radius, copy = node, index = request.node] {
+            auto *data = new PatchData{index, copy.ticket, {}};
+            generate(*streaming, radius, copy, *data);
+            // Can't fail: no more than StagingCapacity patches are ever generating or waiting
+            if (!streaming->finished.tryPush(data)) delete data;
+        });
+    }
+}
+
+void Terrain::visit(std::uint32_t index, const glm::dvec3 &camera) {
+    const double distance = std::max(0.0, glm::length(camera - nodes[index].centre) - nodes[index].bound);
+    const bool hasChildren = nodes[index].children[0] >= 0;
+    const double splitAt = SplitDistance * nodes[index].edge * (hasChildren ? MergeHysteresis : 1.0);
+
+    if (nodes[index].level < MaxLevel && distance < splitAt) {
+        if (!hasChildren) {
+            // Corners and edge midpoints on the flat face; the children keep the parent's winding
+            const std::array<glm::dvec3, 3> c = nodes[index].corners;
+            const glm::dvec3 ab = (c[0] + c[1]) * 0.5, bc = (c[1] + c[2]) * 0.5, ca = (c[2] + c[0]) * 0.5;
+            const auto level = static_cast<std::uint8_t>(nodes[index].level + 1);
+
+            const std::array<std::array<glm::dvec3, 3>, 4> childCorners = {{
+                {c[0], ab, ca}, {ab, c[1], bc}, {ca, bc, c[2]}, {ab, bc, ca}
+            }};
+            std::int32_t created[4];
+            for (int k = 0; k < 4; ++k) created[k] = static_cast<std::int32_t>(createNode(childCorners[k], level));
+            for (int k = 0; k < 4; ++k) nodes[index].children[k] = created[k];
+        }
+
+        bool childrenResident = true;
+        for (std::int32_t child: nodes[index].children) {
+            if (nodes[child].slot < 0) {
+                childrenResident = false;
+                request(static_cast<std::uint32_t>(child), camera);
+            }
+        }
+
+        if (childrenResident) {
+            // Copied first: visiting may create nodes and move the array
+            const std::array<std::int32_t, 4> children = {nodes[index].children[0], nodes[index].children[1],
+                                                          nodes[index].children[2], nodes[index].children[3]};
+            for (std::int32_t child: children) visit(static_cast<std::uint32_t>(child), camera);
+            return;
+        }
+    } else if (hasChildren) {
+        releaseChildren(nodes[index]);
+    }
+
+    // This patch stands in until all of its children have arrived
+    const Node &node = nodes[index];
+    if (node.slot < 0) {
+        request(index, camera);
+        return;
+    }
+
+    drawOrigins.emplace_back(glm::vec3(kmToSu(node.centre - camera)), 0.0f);
+    drawBaseVertices.push_back(node.slot * PatchVertices);
+    drawCounts.push_back(sIndexCount);
+    drawOffsets.push_back(nullptr);
+}
+
+void Terrain::update(const glm::dvec3 &cameraFromCentre, const Material &material) {
+    PROFILE_SCOPE("Terrain::Update");
+    if (!vao) return;
+
+    receive();
+
+    drawOrigins.clear();
+    drawBaseVertices.clear();
+    drawCounts.clear();
+    drawOffsets.clear();
+    requests.clear();
+
+    rootsResident = std::all_of(roots.begin(), roots.end(), [&](std::uint32_t root) { return nodes[root].slot >= 0; });
+    for (std::uint32_t root: roots) visit(root, cameraFromCentre);
+    submitRequests();
+
+    drawCentre = glm::vec3(kmToSu(-cameraFromCentre));
+    drawMaterial = material;
+
+    // Patch origins, read by gl_DrawID in terrain.vert
+    if (!drawOrigins.empty()) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, originSSBO);
+        if (drawOrigins.size() > originCapacity) {
+            originCapacity = std::max(drawOrigins.size(), originCapacity * 2);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, originCapacity * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+        }
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, drawOrigins.size() * sizeof(glm::vec4), drawOrigins.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    stats.resident = MaxResidentPatches - freeSlots.size();
+    stats.drawn = drawOrigins.size();
+    stats.generating = generating;
+}
+
+void Terrain::record(RenderRecorder &recorder, float depth, glm::uvec2 occluders, const glm::vec3 &motion) const {
+    if (drawOrigins.empty()) return;
+    BodyInstance instance;
+    instance.shadow = glm::uvec4(occluders.x, occluders.y, 0u, 0u);
+    instance.motion = glm::vec4(motion, 0.0f);
+    recorder.draw(RenderPass::Opaque, *sCall, depth, id, instance);
+}
+
+void Terrain::drawPatches(const DrawPacket &packet) {
+    const Terrain &terrain = *sTerrains[packet.userData];
+    const Shader &shader = *packet.call->shader;
+
+    shader.setVec3("planetCentre", terrain.drawCentre);
+    shader.setFloat("planetRadius", static_cast<float>(kmToSu(terrain.radius)));
+    shader.setFloat("maxHeight", static_cast<float>(kmToSu(terrain.streaming->heights.maxHeight())));
+
+    shader.setVec3("diffuse", terrain.drawMaterial.diffuse);
+    shader.setVec4("emission", terrain.drawMaterial.emission);
+    shader.setInt("useAlbedo", terrain.drawMaterial.albedoTexture > 0 ? 1 : 0);
+    shader.setInt("albedo", 0);
+    shader.setInt("occluderFirst", static_cast<int>(packet.instance.shadow.x));
+    shader.setInt("occluderCount", static_cast<int>(packet.instance.shadow.y));
+    shader.setVec3("bodyMotion", glm::vec3(packet.instance.motion));
+    if (terrain.drawMaterial.albedoTexture > 0) GlState::BindTexture2D(0, terrain.drawMaterial.albedoTexture);
+
+    GlState::BindVertexArray(terrain.vao);
+    GlState::BindStorageBuffer(1, terrain.originSSBO);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, terrain.drawCounts.data(), GL_UNSIGNED_SHORT,
+                                  terrain.drawOffsets.data(), static_cast<GLsizei>(terrain.drawCounts.size()),
+                                  terrain.drawBaseVertices.data());
+}
@@ -0,0 +1,288 @@
+#include "textureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include <stb/stb_image.h>
+
+#include "blockCompression.h"
+#include "glState.h"
+#include "maths.h"
+#include "profiler.h"
+#include "threadPool.h"
+
+namespace {
+    constexpr char CacheMagic[4] = {'B', 'C', '7', 'C'};
+    constexpr std::uint32_t CacheVersion = 1;
+    constexpr GLenum CompressedFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+
+    struct CacheHeader {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t sourceSize;
+        std::int64_t sourceTime;
+        std::int32_t width, height;
+        std::uint32_t levels;
+        std::uint32_t reserved;
+    };
+
+    // Mip sizes and offsets for a `size` image, finest first
+    std::size_t layoutLevels(glm::ivec2 size, std::uint32_t count, auto &&emit) {
+        std::size_t offset = 0;
+        for (std::uint32_t i = 0; i < count; ++i) {
+            const std::size_t bytes = BlockCompression::CompressedSize(size);
+            emit(size, offset, bytes);
+            offset += bytes;
+            size = glm::max(size / 2, glm::ivec2(1));
+        }
+        return offset;
+    }
+}
+
+TextureStreamer::Stats TextureStreamer::stats{};
+
+void TextureStreamer::Initialise(const std::string &directory) {
+    cacheDirectory = directory;
+
+    // Images are stored bottom row first, as GL expects
+    stbi_set_flip_vertically_on_load(1);
+
+    glGenBuffers(1, &sPBO);
+}
+
+void TextureStreamer::Shutdown() {
+    // The pool has stopped by now; anything it dropped was only ever headed for `finished`
+    if (!textures.empty()) glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
+    textures.clear();
+    if (sPBO) glDeleteBuffers(1, &sPBO);
+    sPBO = 0;
+    uploads.clear();
+
+    std::lock_guard lock(finishedMutex);
+    finished.clear();
+}
+
+GLuint TextureStreamer::Request(const std::string &path, glm::vec4 placeholder) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    GlState::BindTexture2D(0, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    std::uint8_t colour[4];
+    for (int ch = 0; ch < 4; ++ch) colour[ch] = static_cast<std::uint8_t>(std::lround(std::clamp(placeholder[ch], 0.0f, 1.0f) * 255.0f));
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, colour);
+
+    textures.push_back(texture);
+    {
+        std::lock_guard lock(finishedMutex);
+        ++loading;
+    }
+    ThreadPool::Submit([texture, path] { load(texture, path); });
+    return texture;
+}
+
+void TextureStreamer::load(GLuint texture, const std::string &path) {
+    PROFILE_SCOPE("TextureStreamer::load");
+
+    std::error_code error;
+    const std::uint64_t sourceSize = std::filesystem::file_size(path, error);
+    const std::int64_t sourceTime = error ? 0 : std::filesystem::last_write_time(path, error).time_since_epoch().count();
+
+    const std::string stem = std::filesystem::path(path).stem().string();
+    char hash[17];
+    std::snprintf(hash, sizeof hash, "%016llx", static_cast<unsigned long long>(fnv1a(path)));
+    const std::string cachePath = cacheDirectory + "/" + stem + "-" + hash + ".bc7";
+
+    std::unique_ptr<Image> image = error ? nullptr : readCache(cachePath, sourceSize, sourceTime);
+    const bool hit = image != nullptr;
+
+    if (!image) {
+        int width, height, channels;
+        unsigned char *pixels = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        if (!pixels) {
+            std::cerr << "[Textures] Failed to load " << path << ": " << stbi_failure_reason() << std::endl;
+        } else {
+            const std::vector<BlockCompression::MipLevel> mips = BlockCompression::BuildMipChain(pixels, {width, height});
+            stbi_image_free(pixels);
+
+            image = std::make_unique<Image>();
+            for (const BlockCompression::MipLevel &mip: mips) {
+                const std::vector<std::uint8_t> blocks = BlockCompression::CompressBc7(mip);
+                image->levels.push_back({mip.size, image->data.size(), blocks.size()});
+                image->data.insert(image->data.end(), blocks.begin(), blocks.end());
+            }
+
+            if (!error) writeCache(cachePath, *image, sourceSize, sourceTime);
+        }
+    }
+
+    std::lock_guard lock(finishedMutex);
+    --loading;
+    ++(hit ? cacheHits : cacheMisses);
+    if (image) {
+        image->texture = texture;
+        finished.push_back(std::move(image));
+    }
+}
+
+std::unique_ptr<TextureStreamer::Image> TextureStreamer::readCache(const std::string &cachePath,
+                                                                   std::uint64_t sourceSize, std::int64_t sourceTime) {
+    std::ifstream file(cachePath, std::ios::binary);
+    if (!file) return nullptr;
+
+    CacheHeader header{};
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof header)) return nullptr;
+    if (std::memcmp(header.magic, CacheMagic, sizeof CacheMagic) != 0 || header.version != CacheVersion ||
+        header.sourceSize != sourceSize || header.sourceTime != sourceTime || header.width <= 0 || header.height <= 0 ||
+        header.levels == 0 || header.levels > 32)
+        return nullptr; // stale, or not ours
+
+    auto image = std::make_unique<Image>();
+    const std::size_t total = layoutLevels({header.width, header.height}, header.levels,
+                                           [&](glm::ivec2 size, std::size_t offset, std::size_t bytes) {
+                                               image->levels.push_back({size, offset, bytes});
+                                           });
+    image->data.resize(total);
+    if (!file.read(reinterpret_cast<char *>(image->data.data()), static_cast<std::streamsize>(total)))
+        return nullptr; // truncated
+
+    return image;
+}
+
+void TextureStreamer::writeCache(const std::string &cachePath, const Image &image, std::uint64_t sourceSize,
+                                 std::int64_t sourceTime) {
+    std::error_code error;
+    std::filesystem::create_directories(cacheDirectory, error);
+
+    CacheHeader header{};
+    std::memcpy(header.magic, CacheMagic, sizeof CacheMagic);
+    header.version = CacheVersion;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.width = image.levels.front().size.x;
+    header.height = image.levels.front().size.y;
+    header.levels = static_cast<std::uint32_t>(image.levels.size());
+
+    // Written aside and renamed into place, so a crash never leaves a truncated entry under the real name
+    const std::string temporary = cachePath + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof header);
+        file.write(reinterpret_cast<const char *>(image.data.data()), static_cast<std::streamsize>(image.data.size()));
+        if (!file) {
+            std::cerr << "[Textures] Failed to write cache " << temporary << std::endl;
+            return;
+        }
+    }
+    std::filesystem::rename(temporary, cachePath, error);
+    if (error) std::cerr << "[Textures] Failed to write cache " << cachePath << ": " << error.message() << std::endl;
+}
+
+void TextureStreamer::Update() {
+    {
+        std::lock_guard lock(finishedMutex);
+        for (std::unique_ptr<Image> &image: finished) {
+            const int coarsest = static_cast<int>(image->levels.size()) - 1;
+            uploads.push_back({std::move(image), coarsest});
+        }
+        finished.clear();
+        stats.loading = loading;
+        stats.cacheHits = cacheHits;
+        stats.cacheMisses = cacheMisses;
+    }
+
+    stats.uploadedBytes = 0;
+    if (uploads.empty()) {
+        stats.uploading = 0;
+        return;
+    }
+
+    PROFILE_SCOPE("TextureStreamer::Update");
+
+    struct Copy {
+        GLuint texture;
+        int level, levelCount;
+        glm::ivec2 size;
+        int firstRow, rows, blockRows; // in rows of 4x4 blocks
+        std::size_t offset, bytes;     // in the PBO
+    };
+    std::vector<Copy> copies;
+
+    // Orphan last frame's staging memory rather than wait for the GPU to finish reading it
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, sPBO);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(UploadBudget), nullptr, GL_STREAM_DRAW);
+    auto *staging = static_cast<std::uint8_t *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+                                                                 static_cast<GLsizeiptr>(UploadBudget),
+                                                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (!staging) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+
+    std::size_t used = 0;
+    while (!uploads.empty()) {
+        Upload &upload = uploads.front();
+        const Level &level = upload.image->levels[upload.level];
+        const int blocksWide = (level.size.x + 3) / 4;
+        const int blocksHigh = (level.size.y + 3) / 4;
+        const std::size_t rowBytes = static_cast<std::size_t>(blocksWide) * BlockCompression::BlockBytes;
+
+        const int rows = static_cast<int>(std::min<std::size_t>(blocksHigh - upload.blockRow, (UploadBudget - used) / rowBytes));
+        if (rows == 0) break; // budget spent
+
+        const std::size_t bytes = rows * rowBytes;
+        std::memcpy(staging + used, upload.image->data.data() + level.offset + upload.blockRow * rowBytes, bytes);
+        copies.push_back({upload.image->texture, upload.level, static_cast<int>(upload.image->levels.size()),
+                          level.size, upload.blockRow, rows, blocksHigh, used, bytes});
+        used += bytes;
+
+        upload.blockRow += rows;
+        if (upload.blockRow == blocksHigh) {
+            upload.blockRow = 0;
+            if (--upload.level < 0) uploads.pop_front();
+        }
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    for (const Copy &copy: copies) {
+        GlState::BindTexture2D(0, copy.texture);
+        const auto *source = reinterpret_cast<const void *>(copy.offset); // offset into the bound PBO
+
+        if (copy.firstRow == 0 && copy.rows == copy.blockRows) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, copy.level, CompressedFormat, copy.size.x, copy.size.y, 0,
+                                   static_cast<GLsizei>(copy.bytes), source);
+        } else {
+            // A level spread over several frames is allocated first and filled in strips
+            if (copy.firstRow == 0) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                glCompressedTexImage2D(GL_TEXTURE_2D, copy.level, CompressedFormat, copy.size.x, copy.size.y, 0,
+                                       static_cast<GLsizei>(BlockCompression::CompressedSize(copy.size)), nullptr);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, sPBO);
+            }
+            const int y = copy.firstRow * 4;
+            const int height = std::min(copy.rows * 4, copy.size.y - y);
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, copy.level, 0, y, copy.size.x, height, CompressedFormat,
+                                      static_cast<GLsizei>(copy.bytes), source);
+        }
+
+        // Sample from the finest level that's complete; everything coarser already is
+        if (copy.firstRow + copy.rows == copy.blockRows) {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, copy.levelCount - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, copy.level);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    stats.uploadedBytes = used;
+    stats.uploading = uploads.size();
+}
@@ -0,0 +1,158 @@
+#include "sharedStateExporter.h"
+
+#include <iostream>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "profiler.h"
+
+namespace {
+    // The format header is shared with C, so its fields are plain integers accessed through atomic_ref
+    void storeRelease(std::uint64_t &value, std::uint64_t newValue) {
+        std::atomic_ref(value).store(newValue, std::memory_order_release);
+    }
+}
+
+std::uint64_t SharedStateExporter::slotSizeFor(std::uint64_t capacity) {
+    std::uint64_t size = sizeof(spacesim_slot) + capacity * sizeof(spacesim_body);
+    return (size + 63) & ~std::uint64_t(63);
+}
+
+spacesim_slot *SharedStateExporter::slot(std::uint64_t index) {
+    return reinterpret_cast<spacesim_slot *>(mapping + SPACESIM_SHARED_HEADER_SIZE + index * header()->slot_size);
+}
+
+bool SharedStateExporter::Initialise(const std::string &name) {
+#ifdef __unix__
+    if (enabled) return true;
+
+    // Start from a fresh segment - readers still attached to a previous run keep their own copy
+    shm_unlink(name.c_str());
+    fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cerr << "[SharedState] Failed to create " << name << std::endl;
+        return false;
+    }
+
+    segmentName = name;
+    if (!map(InitialCapacity)) {
+        close(fd);
+        shm_unlink(name.c_str());
+        fd = -1;
+        return false;
+    }
+
+    spacesim_header *h = header();
+    h->version = SPACESIM_SHARED_VERSION;
+    h->generation = 0;
+    h->capacity = InitialCapacity;
+    h->slot_size = slotSizeFor(InitialCapacity);
+    h->active_slot = 0;
+    h->publish_count = 0;
+    h->writer_pid = getpid();
+    std::atomic_ref(h->magic).store(SPACESIM_SHARED_MAGIC, std::memory_order_release);
+
+    std::cout << "[SharedState] Publishing body state to " << name << std::endl;
+    enabled.store(true, std::memory_order_release);
+    return true;
+#else
+    std::cerr << "[SharedState] Shared memory export is only supported on POSIX systems" << std::endl;
+    return false;
+#endif
+}
+
+void SharedStateExporter::Shutdown() {
+#ifdef __unix__
+    if (!enabled) return;
+    shm_unlink(segmentName.c_str());
+#endif
+}
+
+bool SharedStateExporter::map(std::uint64_t capacity) {
+#ifdef __unix__
+    const std::size_t size = SPACESIM_SHARED_HEADER_SIZE + 2 * slotSizeFor(capacity);
+
+    // Only ever grows, so readers' older, smaller mappings stay valid until they re-map
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        std::cerr << "[SharedState] Failed to resize the segment to " << size << " bytes" << std::endl;
+        return false;
+    }
+
+    void *newMapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (newMapping == MAP_FAILED) {
+        std::cerr << "[SharedState] Failed to map the segment" << std::endl;
+        return false;
+    }
+
+    if (mapping) munmap(mapping, mappingSize);
+    mapping = static_cast<unsigned char *>(newMapping);
+    mappingSize = size;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SharedStateExporter::Publish(const PhysicsSnapshot &snapshot) {
+    PROFILE_SCOPE("SharedState::Publish");
+
+    spacesim_header *h = header();
+    const std::size_t count = snapshot.ids.size();
+
+    std::uint64_t target = h->active_slot ^ 1;
+
+    if (count > h->capacity) {
+        std::uint64_t capacity = h->capacity;
+        while (capacity < count) capacity *= 2;
+
+        // Odd generation tells readers to back off; the new state is written before it turns even again
+        storeRelease(h->generation, h->generation + 1);
+        if (!map(capacity)) {
+            storeRelease(header()->generation, header()->generation + 1);
+            enabled.store(false, std::memory_order_relaxed);
+            return;
+        }
+
+        h = header();
+        h->capacity = capacity;
+        h->slot_size = slotSizeFor(capacity);
+        slot(0)->sequence = 0;
+        slot(1)->sequence = 0;
+        slot(1)->body_count = 0;
+        target = 0;
+    }
+
+    spacesim_slot *state = slot(target);
+    const std::uint64_t sequence = state->sequence;
+
+    storeRelease(state->sequence, sequence + 1);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    state->time = snapshot.time;
+    state->step = snapshot.step;
+    state->layout = snapshot.layout;
+    state->body_count = static_cast<std::uint32_t>(count);
+
+    auto *bodies = reinterpret_cast<spacesim_body *>(state + 1);
+    for (std::size_t i = 0; i < count; ++i) {
+        spacesim_body &body = bodies[i];
+        body.id = snapshot.ids[i];
+        body.mass = snapshot.masses[i];
+        body.position[0] = snapshot.positions[i].x;
+        body.position[1] = snapshot.positions[i].y;
+        body.position[2] = snapshot.positions[i].z;
+        body.velocity[0] = snapshot.velocities[i].x;
+        body.velocity[1] = snapshot.velocities[i].y;
+        body.velocity[2] = snapshot.velocities[i].z;
+    }
+
+    storeRelease(state->sequence, sequence + 2);
+    storeRelease(h->active_slot, target);
+    storeRelease(h->publish_count, h->publish_count + 1);
+
+    if (h->generation & 1) storeRelease(h->generation, h->generation + 1);
+}
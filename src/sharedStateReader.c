@@ -0,0 +1,156 @@
+#include "sharedState.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct spacesim_reader {
+    int fd;
+    unsigned char *mapping;
+    size_t size;
+    uint64_t generation;
+    uint64_t slot_size;  /* as of the last begin, checked against the mapping */
+};
+
+static uint64_t load_acquire(const uint64_t *value) {
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static const spacesim_header *header_of(const spacesim_reader *reader) {
+    return (const spacesim_header *) reader->mapping;
+}
+
+/* Takes the slot size from the reader rather than the header, which the writer may change under us */
+static const spacesim_slot *slot_of(const spacesim_reader *reader, uint64_t slot) {
+    return (const spacesim_slot *) (reader->mapping + SPACESIM_SHARED_HEADER_SIZE + slot * reader->slot_size);
+}
+
+/* Maps the whole segment at its current size */
+static int remap(spacesim_reader *reader) {
+    struct stat info;
+    if (fstat(reader->fd, &info) != 0 || info.st_size < (off_t) SPACESIM_SHARED_HEADER_SIZE) return -1;
+
+    if (reader->mapping) munmap(reader->mapping, reader->size);
+
+    void *mapping = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_SHARED, reader->fd, 0);
+    if (mapping == MAP_FAILED) {
+        reader->mapping = NULL;
+        reader->size = 0;
+        return -1;
+    }
+
+    reader->mapping = (unsigned char *) mapping;
+    reader->size = (size_t) info.st_size;
+    return 0;
+}
+
+spacesim_reader *spacesim_reader_open(const char *name) {
+    int fd = shm_open(name ? name : SPACESIM_SHARED_DEFAULT_NAME, O_RDONLY, 0);
+    if (fd < 0) return NULL;
+
+    spacesim_reader *reader = (spacesim_reader *) calloc(1, sizeof(spacesim_reader));
+    if (!reader) {
+        close(fd);
+        return NULL;
+    }
+    reader->fd = fd;
+    reader->generation = UINT64_MAX;
+
+    if (remap(reader) != 0 ||
+        __atomic_load_n(&header_of(reader)->magic, __ATOMIC_ACQUIRE) != SPACESIM_SHARED_MAGIC ||
+        header_of(reader)->version != SPACESIM_SHARED_VERSION) {
+        spacesim_reader_close(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+void spacesim_reader_close(spacesim_reader *reader) {
+    if (!reader) return;
+    if (reader->mapping) munmap(reader->mapping, reader->size);
+    close(reader->fd);
+    free(reader);
+}
+
+int spacesim_reader_begin(spacesim_reader *reader, spacesim_view *view) {
+    const spacesim_header *header = header_of(reader);
+
+    uint64_t generation = load_acquire(&header->generation);
+    if (generation & 1u) return -1; /* being resized */
+
+    if (generation != reader->generation) {
+        if (remap(reader) != 0) return -1;
+        header = header_of(reader);
+        reader->generation = generation;
+    }
+
+    /* The mapping must cover both slots at the size the header describes; read once, since a resize
+     * starting now could change it */
+    uint64_t slot_size = __atomic_load_n(&header->slot_size, __ATOMIC_RELAXED);
+    size_t needed = SPACESIM_SHARED_HEADER_SIZE + 2u * (size_t) slot_size;
+    if (needed > reader->size) {
+        reader->generation = UINT64_MAX;
+        return -1;
+    }
+    reader->slot_size = slot_size;
+
+    uint64_t slot = load_acquire(&header->active_slot) & 1u;
+    const spacesim_slot *state = slot_of(reader, slot);
+
+    uint64_t sequence = load_acquire(&state->sequence);
+    if (sequence & 1u) return -1; /* the writer lapped us and is filling this slot */
+
+    view->time = state->time;
+    view->step = state->step;
+    view->layout = state->layout;
+    view->body_count = state->body_count;
+    if (view->body_count > header->capacity) return -1;
+    view->bodies = (const spacesim_body *) (state + 1);
+
+    view->slot = slot;
+    view->sequence = sequence;
+    view->generation = generation;
+    return 0;
+}
+
+int spacesim_reader_end(spacesim_reader *reader, const spacesim_view *view) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    /* Generation first: after a resize the slot may lie outside what we have mapped. The writer only ever
+     * grows the segment, so once the generation matches, the slot the view was taken from is still mapped. */
+    const spacesim_header *header = header_of(reader);
+    if (__atomic_load_n(&header->generation, __ATOMIC_RELAXED) != view->generation) return 0;
+    if (view->generation != reader->generation) return 0;
+    if (__atomic_load_n(&slot_of(reader, view->slot)->sequence, __ATOMIC_RELAXED) != view->sequence) return 0;
+    /* ...and again, in case a resize started in between and the slots were laid out anew */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&header->generation, __ATOMIC_RELAXED) == view->generation;
+}
+
+int64_t spacesim_reader_copy(spacesim_reader *reader, spacesim_view *info,
+                             spacesim_body *bodies, uint32_t max_bodies, int attempts) {
+    for (int attempt = 0; attempt < attempts; ++attempt) {
+        spacesim_view view;
+        if (spacesim_reader_begin(reader, &view) != 0) continue;
+
+        uint32_t count = view.body_count < max_bodies ? view.body_count : max_bodies;
+        if (count) memcpy(bodies, view.bodies, count * sizeof(spacesim_body));
+
+        if (spacesim_reader_end(reader, &view)) {
+            if (info) {
+                *info = view;
+                info->bodies = bodies;
+            }
+            return view.body_count;
+        }
+    }
+    return -1;
+}
+
+int64_t spacesim_reader_writer_pid(const spacesim_reader *reader) {
+    return header_of(reader)->writer_pid;
+}
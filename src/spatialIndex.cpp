@@ -0,0 +1,481 @@
+#include "spatialIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <queue>
+
+#include "profiler.h"
+#include "threadPool.h"
+
+std::thread SpatialIndex::workerThread;
+std::mutex SpatialIndex::settingsMutex;
+std::condition_variable SpatialIndex::wake;
+SpatialIndexSettings SpatialIndex::currentSettings{};
+bool SpatialIndex::running = false;
+
+std::vector<std::shared_ptr<SpatialIndex::Tree>> SpatialIndex::pool{};
+std::shared_ptr<SpatialIndex::Tree> SpatialIndex::latest{};
+unsigned int SpatialIndex::refitsSinceBuild = 0;
+std::uint64_t SpatialIndex::builds = 0;
+
+std::atomic<std::shared_ptr<const SpatialIndex::Tree>> SpatialIndex::published{};
+std::atomic<std::shared_ptr<const SpatialIndex::Catalogue>> SpatialIndex::catalogue{};
+std::uint64_t SpatialIndex::catalogueSignature = 0;
+
+std::mutex SpatialIndex::statsMutex;
+SpatialIndex::Stats SpatialIndex::stats{};
+
+namespace {
+    constexpr double Infinity = std::numeric_limits<double>::infinity();
+
+    // Leaves below this count aren't worth splitting across the pool
+    constexpr std::size_t ParallelRefitThreshold = 4096;
+
+    // Median splits keep the depth to log2 of the body count; each level leaves at most one sibling waiting
+    constexpr std::size_t MaxStack = 80;
+
+    // Float bounds that still contain the double value they came from
+    float roundDown(double value) {
+        const auto rounded = static_cast<float>(value);
+        return static_cast<double>(rounded) > value ? std::nextafter(rounded, -std::numeric_limits<float>::infinity())
+                                                    : rounded;
+    }
+
+    float roundUp(double value) {
+        const auto rounded = static_cast<float>(value);
+        return static_cast<double>(rounded) < value ? std::nextafter(rounded, std::numeric_limits<float>::infinity())
+                                                    : rounded;
+    }
+
+    double boxDistance2(const glm::vec3 &min, const glm::vec3 &max, const glm::dvec3 &point) {
+        double total = 0.0;
+        for (int axis = 0; axis < 3; ++axis) {
+            const double below = static_cast<double>(min[axis]) - point[axis];
+            const double above = point[axis] - static_cast<double>(max[axis]);
+            const double outside = std::max({below, above, 0.0});
+            total += outside * outside;
+        }
+        return total;
+    }
+
+    std::string fold(std::string_view text) {
+        std::string folded(text);
+        for (char &c: folded) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return folded;
+    }
+
+    // Levenshtein distance, giving up with limit + 1 as soon as it can't come in under the limit
+    int editDistance(std::string_view a, std::string_view b, int limit) {
+        if (std::abs(static_cast<int>(a.size()) - static_cast<int>(b.size())) > limit) return limit + 1;
+
+        std::vector<int> row(b.size() + 1);
+        std::iota(row.begin(), row.end(), 0);
+        for (std::size_t i = 1; i <= a.size(); ++i) {
+            int diagonal = row[0];
+            row[0] = static_cast<int>(i);
+            int best = row[0];
+            for (std::size_t j = 1; j <= b.size(); ++j) {
+                const int above = row[j];
+                row[j] = std::min({row[j] + 1, row[j - 1] + 1, diagonal + (a[i - 1] != b[j - 1] ? 1 : 0)});
+                diagonal = above;
+                best = std::min(best, row[j]);
+            }
+            if (best > limit) return limit + 1;
+        }
+        return row.back();
+    }
+}
+
+void SpatialIndex::Initialise(const SpatialIndexSettings &settings) {
+    if (running) return;
+
+    currentSettings = settings;
+    currentSettings.leafSize = std::max<std::size_t>(currentSettings.leafSize, 1);
+    running = true;
+    workerThread = std::thread(&SpatialIndex::workerLoop);
+}
+
+void SpatialIndex::Shutdown() {
+    {
+        std::lock_guard lock(settingsMutex);
+        if (!running) return;
+        running = false;
+    }
+    wake.notify_all();
+    if (workerThread.joinable()) workerThread.join();
+
+    published.store(nullptr);
+    latest.reset();
+    pool.clear();
+}
+
+void SpatialIndex::SyncCatalogue(const std::vector<CelestialBody> &bodies) {
+    // Ids are never reused, so the same ids in the same order means the same bodies
+    std::uint64_t signature = 14695981039346656037ull;
+    for (const CelestialBody &body: bodies) signature = (signature ^ body.instanceId) * 1099511628211ull;
+    if (signature == catalogueSignature) return;
+    catalogueSignature = signature;
+
+    auto next = std::make_shared<Catalogue>();
+    next->signature = signature;
+    next->radii.reserve(bodies.size());
+    next->ids.reserve(bodies.size());
+    next->names.reserve(bodies.size());
+    next->folded.reserve(bodies.size());
+    for (const CelestialBody &body: bodies) {
+        next->radii[body.instanceId] = static_cast<float>(body.radius);
+        next->ids.push_back(body.instanceId);
+        next->names.push_back(body.name);
+        next->folded.push_back(fold(body.name));
+    }
+    catalogue.store(std::move(next));
+    wake.notify_all();
+}
+
+void SpatialIndex::workerLoop() {
+    PROFILE_THREAD("SpatialIndex");
+
+    std::uint64_t lastStep = UINT64_MAX;
+    std::uint64_t lastCatalogue = 0;
+    const Catalogue empty{};
+
+    while (true) {
+        SpatialIndexSettings settings;
+        {
+            std::unique_lock lock(settingsMutex);
+            wake.wait_for(lock, currentSettings.interval, [] { return !running; });
+            if (!running) return;
+            settings = currentSettings;
+        }
+
+        std::shared_ptr<const PhysicsSnapshot> snapshot = Physics::GetSnapshot();
+        if (!snapshot) continue;
+
+        const std::shared_ptr<const Catalogue> names = catalogue.load();
+        const Catalogue &current = names ? *names : empty;
+        if (snapshot->step == lastStep && current.signature == lastCatalogue) continue;
+
+        lastStep = snapshot->step;
+        lastCatalogue = current.signature;
+        update(*snapshot, current, settings);
+    }
+}
+
+std::shared_ptr<SpatialIndex::Tree> SpatialIndex::acquireTree() {
+    // Only the pool holding it means it's neither published nor still being read by a query
+    for (const std::shared_ptr<Tree> &tree: pool) {
+        if (tree.use_count() == 1) return tree;
+    }
+    pool.push_back(std::make_shared<Tree>());
+    return pool.back();
+}
+
+void SpatialIndex::update(const PhysicsSnapshot &snapshot, const Catalogue &names,
+                          const SpatialIndexSettings &settings) {
+    PROFILE_SCOPE("SpatialIndex::Update");
+    const auto start = std::chrono::steady_clock::now();
+
+    const bool rebuild = !latest || latest->layout != snapshot.layout || latest->catalogue != names.signature ||
+                         refitsSinceBuild >= settings.refitsPerRebuild;
+
+    std::shared_ptr<Tree> tree = acquireTree();
+    if (rebuild) {
+        const auto count = static_cast<std::uint32_t>(snapshot.ids.size());
+        tree->build = ++builds;
+        tree->sources.resize(count);
+        std::iota(tree->sources.begin(), tree->sources.end(), 0u);
+        tree->nodes.clear();
+        tree->nodes.reserve(2 * (count / settings.leafSize) + 1);
+        if (count > 0) buildNode(*tree, snapshot.positions, 0, count, settings.leafSize);
+
+        tree->ids.resize(count);
+        tree->radii.resize(count);
+        for (std::uint32_t i = 0; i < count; ++i) {
+            const BodyId id = snapshot.ids[tree->sources[i]];
+            const auto radius = names.radii.find(id);
+            tree->ids[i] = id;
+            tree->radii[i] = radius != names.radii.end() ? radius->second : 0.0f;
+        }
+        refitsSinceBuild = 0;
+    } else if (tree->build != latest->build) {
+        // Recycled from an older build: take the current topology over, the bounds are redone below
+        tree->build = latest->build;
+        tree->nodes = latest->nodes;
+        tree->ids = latest->ids;
+        tree->sources = latest->sources;
+        tree->radii = latest->radii;
+    }
+
+    tree->step = snapshot.step;
+    tree->layout = snapshot.layout;
+    tree->catalogue = names.signature;
+    tree->centres.resize(tree->sources.size());
+    for (std::size_t i = 0; i < tree->sources.size(); ++i) tree->centres[i] = snapshot.positions[tree->sources[i]];
+    refitBounds(*tree);
+    if (!rebuild) ++refitsSinceBuild;
+
+    latest = tree;
+    published.store(std::shared_ptr<const Tree>(tree));
+
+    const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard lock(statsMutex);
+    stats.bodies = tree->ids.size();
+    stats.nodes = tree->nodes.size();
+    if (rebuild) {
+        stats.buildMs = elapsed;
+        ++stats.builds;
+    } else {
+        stats.refitMs = elapsed;
+        ++stats.refits;
+    }
+}
+
+std::uint32_t SpatialIndex::buildNode(Tree &tree, const std::vector<glm::dvec3> &positions, std::uint32_t begin,
+                                      std::uint32_t end, std::size_t leafSize) {
+    const auto index = static_cast<std::uint32_t>(tree.nodes.size());
+    tree.nodes.push_back(Node{});
+
+    if (end - begin <= leafSize) {
+        tree.nodes[index].offset = begin;
+        tree.nodes[index].count = end - begin;
+        return index;
+    }
+
+    // Split at the median centre along the axis the centres spread furthest on; bounds come later, in refitBounds
+    glm::dvec3 min(Infinity), max(-Infinity);
+    for (std::uint32_t i = begin; i < end; ++i) {
+        min = glm::min(min, positions[tree.sources[i]]);
+        max = glm::max(max, positions[tree.sources[i]]);
+    }
+    const glm::dvec3 extent = max - min;
+    const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+
+    const std::uint32_t middle = begin + (end - begin) / 2;
+    std::nth_element(tree.sources.begin() + begin, tree.sources.begin() + middle, tree.sources.begin() + end,
+                     [&](std::uint32_t a, std::uint32_t b) { return positions[a][axis] < positions[b][axis]; });
+
+    buildNode(tree, positions, begin, middle, leafSize);
+    const std::uint32_t right = buildNode(tree, positions, middle, end, leafSize);
+    tree.nodes[index].offset = right;
+    tree.nodes[index].count = 0;
+    return index;
+}
+
+void SpatialIndex::refitBounds(Tree &tree) {
+    PROFILE_SCOPE("SpatialIndex::Refit");
+
+    // Leaves straight from their bodies
+    const auto fitLeaves = [&tree](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            Node &node = tree.nodes[i];
+            if (node.count == 0) continue;
+
+            glm::dvec3 min(Infinity), max(-Infinity);
+            for (std::uint32_t b = node.offset; b < node.offset + node.count; ++b) {
+                const double radius = tree.radii[b];
+                min = glm::min(min, tree.centres[b] - radius);
+                max = glm::max(max, tree.centres[b] + radius);
+            }
+            node.min = glm::vec3(roundDown(min.x), roundDown(min.y), roundDown(min.z));
+            node.max = glm::vec3(roundUp(max.x), roundUp(max.y), roundUp(max.z));
+        }
+    };
+    if (tree.nodes.size() >= ParallelRefitThreshold) ThreadPool::ParallelFor(tree.nodes.size(), ParallelRefitThreshold, fitLeaves);
+    else fitLeaves(0, tree.nodes.size());
+
+    // Then parents from their children, which always come after them, so walking backwards sees them first
+    for (std::size_t i = tree.nodes.size(); i-- > 0;) {
+        Node &node = tree.nodes[i];
+        if (node.count != 0) continue;
+        const Node &left = tree.nodes[i + 1];
+        const Node &right = tree.nodes[node.offset];
+        node.min = glm::min(left.min, right.min);
+        node.max = glm::max(left.max, right.max);
+    }
+}
+
+std::optional<SpatialHit> SpatialIndex::Raycast(const glm::dvec3 &origin, const glm::dvec3 &direction,
+                                                double tolerance, const Filter &accept) {
+    const std::shared_ptr<const Tree> tree = published.load();
+    if (!tree || tree->nodes.empty()) return std::nullopt;
+    PROFILE_SCOPE("SpatialIndex::Raycast");
+
+    const glm::dvec3 ray = glm::normalize(direction);
+    const glm::dvec3 inverse = 1.0 / ray;
+    const double slope = std::tan(std::clamp(tolerance, 0.0, 1.5));
+
+    // How far outside a body's surface the ray passes, as a slope from the origin; 0 for a hit
+    double bestMiss = Infinity;
+    std::optional<SpatialHit> best;
+
+    std::uint32_t stack[MaxStack];
+    std::size_t depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const std::uint32_t index = stack[--depth];
+        const Node &node = tree->nodes[index];
+        const glm::dvec3 min(node.min), max(node.max);
+
+        // Widened by as far as the cone has spread at the box's furthest corner
+        const double margin = slope * glm::length(glm::max(glm::abs(min - origin), glm::abs(max - origin)));
+        const glm::dvec3 t0 = (min - margin - origin) * inverse;
+        const glm::dvec3 t1 = (max + margin - origin) * inverse;
+        const glm::dvec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+        const double enter = std::max({near.x, near.y, near.z, 0.0});
+        const double exit = std::min({far.x, far.y, far.z});
+        if (exit < enter) continue;
+        if (bestMiss == 0.0 && enter > best->distance) continue;
+
+        if (node.count == 0) {
+            stack[depth++] = node.offset;
+            stack[depth++] = index + 1;
+            continue;
+        }
+
+        for (std::uint32_t b = node.offset; b < node.offset + node.count; ++b) {
+            const glm::dvec3 toCentre = tree->centres[b] - origin;
+            const double along = glm::dot(toCentre, ray);
+            if (along <= 0.0) continue;
+
+            const double radius = tree->radii[b];
+            const double closest2 = std::max(glm::dot(toCentre, toCentre) - along * along, 0.0);
+            double miss = 0.0;
+            double distance = along;
+            if (closest2 <= radius * radius) {
+                distance = along - std::sqrt(radius * radius - closest2);
+            } else {
+                miss = (std::sqrt(closest2) - radius) / along;
+                if (miss > slope) continue;
+            }
+
+            if (miss > bestMiss || (miss == bestMiss && distance >= best->distance)) continue;
+            if (accept && !accept(tree->ids[b])) continue;
+            bestMiss = miss;
+            best = SpatialHit{tree->ids[b], distance};
+        }
+    }
+    return best;
+}
+
+std::vector<SpatialHit> SpatialIndex::Nearest(const glm::dvec3 &point, std::size_t count, const Filter &accept) {
+    const std::shared_ptr<const Tree> tree = published.load();
+    if (!tree || tree->nodes.empty() || count == 0) return {};
+    PROFILE_SCOPE("SpatialIndex::Nearest");
+
+    // Nodes nearest first, and the best `count` bodies so far as a max-heap on distance
+    using Open = std::pair<double, std::uint32_t>;
+    std::priority_queue<Open, std::vector<Open>, std::greater<>> open;
+    open.emplace(boxDistance2(tree->nodes[0].min, tree->nodes[0].max, point), 0);
+
+    const auto further = [](const SpatialHit &a, const SpatialHit &b) { return a.distance < b.distance; };
+    std::vector<SpatialHit> found;
+    found.reserve(count + 1);
+
+    while (!open.empty()) {
+        const auto [distance2, index] = open.top();
+        if (found.size() == count && distance2 > found.front().distance * found.front().distance) break;
+        open.pop();
+
+        const Node &node = tree->nodes[index];
+        if (node.count == 0) {
+            open.emplace(boxDistance2(tree->nodes[index + 1].min, tree->nodes[index + 1].max, point), index + 1);
+            open.emplace(boxDistance2(tree->nodes[node.offset].min, tree->nodes[node.offset].max, point), node.offset);
+            continue;
+        }
+
+        for (std::uint32_t b = node.offset; b < node.offset + node.count; ++b) {
+            const double distance = std::max(glm::length(tree->centres[b] - point) - tree->radii[b], 0.0);
+            if (found.size() == count && distance >= found.front().distance) continue;
+            if (accept && !accept(tree->ids[b])) continue;
+
+            found.push_back(SpatialHit{tree->ids[b], distance});
+            std::push_heap(found.begin(), found.end(), further);
+            if (found.size() > count) {
+                std::pop_heap(found.begin(), found.end(), further);
+                found.pop_back();
+            }
+        }
+    }
+
+    std::sort_heap(found.begin(), found.end(), further);
+    return found;
+}
+
+std::vector<SpatialHit> SpatialIndex::WithinRadius(const glm::dvec3 &point, double radius) {
+    const std::shared_ptr<const Tree> tree = published.load();
+    if (!tree || tree->nodes.empty() || radius < 0.0) return {};
+    PROFILE_SCOPE("SpatialIndex::WithinRadius");
+
+    std::vector<SpatialHit> found;
+    std::uint32_t stack[MaxStack];
+    std::size_t depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const std::uint32_t index = stack[--depth];
+        const Node &node = tree->nodes[index];
+        // Boxes contain their bodies, so nothing inside one is closer than the box itself
+        if (boxDistance2(node.min, node.max, point) > radius * radius) continue;
+
+        if (node.count == 0) {
+            stack[depth++] = node.offset;
+            stack[depth++] = index + 1;
+            continue;
+        }
+
+        for (std::uint32_t b = node.offset; b < node.offset + node.count; ++b) {
+            const double distance = std::max(glm::length(tree->centres[b] - point) - tree->radii[b], 0.0);
+            if (distance <= radius) found.push_back(SpatialHit{tree->ids[b], distance});
+        }
+    }
+    return found;
+}
+
+std::vector<NameMatch> SpatialIndex::FindByName(std::string_view query, std::size_t maxResults) {
+    const std::shared_ptr<const Catalogue> names = catalogue.load();
+    if (!names || query.empty() || maxResults == 0) return {};
+    PROFILE_SCOPE("SpatialIndex::FindByName");
+
+    const std::string folded = fold(query);
+    // Roughly one typo in every three letters
+    const int limit = std::max(1, static_cast<int>(folded.size()) / 3);
+
+    std::vector<std::pair<int, std::size_t>> scored;
+    for (std::size_t i = 0; i < names->folded.size(); ++i) {
+        const std::string &name = names->folded[i];
+        int score;
+        if (name == folded) score = 0;
+        else if (name.starts_with(folded)) score = 1;
+        else if (name.find(folded) != std::string::npos) score = 2;
+        else {
+            const int edits = editDistance(name, folded, limit);
+            if (edits > limit) continue;
+            score = 2 + edits;
+        }
+        scored.emplace_back(score, i);
+    }
+
+    // Equal scores favour the shorter name, the closer fit for a prefix or substring
+    const std::size_t kept = std::min(maxResults, scored.size());
+    std::partial_sort(scored.begin(), scored.begin() + static_cast<std::ptrdiff_t>(kept), scored.end(),
+                      [&](const auto &a, const auto &b) {
+                          if (a.first != b.first) return a.first < b.first;
+                          return names->folded[a.second].size() < names->folded[b.second].size();
+                      });
+
+    std::vector<NameMatch> matches;
+    matches.reserve(kept);
+    for (std::size_t i = 0; i < kept; ++i) {
+        const std::size_t index = scored[i].second;
+        matches.push_back(NameMatch{names->ids[index], names->names[index], scored[i].first});
+    }
+    return matches;
+}
+
+SpatialIndex::Stats SpatialIndex::LastStats() {
+    std::lock_guard lock(statsMutex);
+    return stats;
+}
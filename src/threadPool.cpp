@@ -0,0 +1,119 @@
+#include "threadPool.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "profiler.h"
+
+std::vector<std::thread> ThreadPool::workers{};
+std::deque<std::packaged_task<void()>> ThreadPool::jobs{};
+std::mutex ThreadPool::jobsMutex;
+std::condition_variable ThreadPool::jobsAvailable;
+bool ThreadPool::stopping = false;
+
+void ThreadPool::Initialise(unsigned int workerCount) {
+    if (!workers.empty()) return; // already initialised
+
+    if (workerCount == 0) {
+        unsigned int hardware = std::thread::hardware_concurrency();
+        workerCount = hardware > 1 ? hardware - 1 : 1;
+    }
+
+    stopping = false;
+    for (unsigned int i = 0; i < workerCount; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop);
+}
+
+void ThreadPool::Shutdown() {
+    {
+        std::lock_guard lock(jobsMutex);
+        stopping = true;
+    }
+    jobsAvailable.notify_all();
+
+    for (auto &worker: workers)
+        if (worker.joinable()) worker.join();
+    workers.clear();
+}
+
+std::future<void> ThreadPool::Submit(std::function<void()> job) {
+    std::packaged_task<void()> task(std::move(job));
+    std::future<void> result = task.get_future();
+
+    if (workers.empty()) {
+        // No pool (e.g. during start-up) - run inline rather than never
+        task();
+        return result;
+    }
+
+    {
+        std::lock_guard lock(jobsMutex);
+        jobs.push_back(std::move(task));
+    }
+    jobsAvailable.notify_one();
+    return result;
+}
+
+void ThreadPool::ParallelFor(std::size_t count, std::size_t grain,
+                             const std::function<void(std::size_t, std::size_t)> &fn) {
+    if (count == 0) return;
+
+    grain = std::max<std::size_t>(grain, 1);
+    std::size_t chunks = std::min<std::size_t>((count + grain - 1) / grain, WorkerCount() + 1);
+    if (chunks <= 1) {
+        fn(0, count);
+        return;
+    }
+
+    // Helpers can start long after the caller has returned if the queue is busy, so what they touch is
+    // shared rather than on the caller's stack. fn is only used after claiming a chunk, and the caller
+    // doesn't return until every chunk has been claimed and finished.
+    struct Batch {
+        const std::function<void(std::size_t, std::size_t)> *fn;
+        std::size_t count;
+        std::size_t chunks;
+        std::size_t chunkSize;
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> done{0};
+    };
+    auto batch = std::make_shared<Batch>();
+    batch->fn = &fn;
+    batch->count = count;
+    batch->chunks = chunks;
+    batch->chunkSize = (count + chunks - 1) / chunks;
+
+    auto runChunks = [](Batch &b) {
+        for (std::size_t c; (c = b.next.fetch_add(1, std::memory_order_relaxed)) < b.chunks;) {
+            std::size_t begin = c * b.chunkSize;
+            std::size_t end = std::min(b.count, begin + b.chunkSize);
+            if (begin < end) (*b.fn)(begin, end);
+            b.done.fetch_add(1, std::memory_order_release);
+        }
+    };
+
+    for (std::size_t c = 1; c < chunks; ++c)
+        Submit([batch, runChunks] { runChunks(*batch); });
+
+    // The caller claims chunks too, and only its own: anything else queued (texture decodes, terrain
+    // patches) could take far longer than the loop itself and must never end up on this thread
+    runChunks(*batch);
+
+    while (batch->done.load(std::memory_order_acquire) < chunks)
+        std::this_thread::yield();
+}
+
+void ThreadPool::workerLoop() {
+    PROFILE_THREAD("Worker");
+
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock lock(jobsMutex);
+            jobsAvailable.wait(lock, [] { return stopping || !jobs.empty(); });
+            if (stopping && jobs.empty()) return;
+            task = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        task();
+    }
+}